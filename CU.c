@@ -1,16 +1,87 @@
 /*-----------------------------Central Unit-------------------------------
 	A Tmote Sky sensor node with Rime Address 3.0 Firmware!
 	Placed in Living Room and accessible by the user:
-	Output	--> SERIAL MONITOR
+	Output	--> SERIAL MONITOR (text) & BINARY SERIAL FRAMES (host/)
 	Input	--> Number of CONSECUTIVE ( < 4sec) BUTTON PRESS
+			--> SERIAL CONSOLE (configuration & firmware update commands)
 	------------------------------------------------------------------
 	COMMANDS:
 		1) ACTIVATE/DEACTIVATE ALARM.			(Node1 & Node2)
 		2) LOCK/UNLOCK GATE.					(Node2)
 		3) OPEN DOOR and GATE.					(Node1 & Node2)
-		4) GET AVERAGE TEMPERATURE by Node1.
+		4) GET TEMPERATURE STATISTICS by Node1.
 		5) GET EXTERNAL LIGHT by Node2.
 		6) ACTIVATE/DEACTIVATE COMFORT BEDROOM
+		7) GET TEMPERATURE LOG by Node1 (streamed from its flash).
+		8) SHOW LINK & COMMAND STATS (link quality of every node, CU
+			radio queueing delays, confirmation latency and failures).
+		9) LEAVE HOUSE / COME HOME scene.	(Node1, Node2 & Node4)
+			Leaving: alarm on, gate locked, comfort bedroom off.
+			Coming home: alarm off, gate unlocked, comfort bedroom on.
+		10) GET ALL: house overview (Node1 temperature, Node2 light,
+			Node4 bedroom temperature) from one broadcast query, every
+			node replying in its own slot, reported in a single table.
+
+	LINK QUALITY:
+		Every firmware estimates RSSI, LQI and ETX of its neighbours
+		and sizes the runicast retransmissions on them, lowering the
+		transmit power of each link while deliveries stay clean; the
+		nodes report their link table (with the energy per delivered
+		packet at full and adapted power) with the state digest.
+
+	RADIO PRIORITIES:
+		Outgoing runicasts wait in per-class queues (alarm & gate,
+		commands, telemetry) on every firmware, so alarm and security
+		messages overtake the queued sensor traffic.
+
+	HOUSE TEMPERATURE:
+		Node1 and Node4 aggregate their temperature samples in network
+		(Node4 -> Node1 -> CU): every minute the CU receives a single
+		summary (average, min, max, sensors) of the whole house.
+
+	SCENES:
+		The operations of a scene bound for the same node (and any
+		other requested within a short window) are merged in a single
+		BATCH frame per node, confirmed by one combined reply.
+
+	COMMAND CONFIRMATION:
+		Every actuator command carries a sequence number and is
+		confirmed by the node executing it with the resulting state.
+		Unconfirmed commands are retried by runicast and reported
+		as FAILED after the last retry.
+
+	STATE SYNCH:
+		The CU state (alarm, gate, comfort, thresholds) is persisted on
+		flash and sent as a snapshot to every node asking it at boot.
+		The nodes send a periodic state digest: the snapshot is sent
+		again only to a node whose digest diverges from the CU view.
+
+	CONFIGURATION:
+		Typed on the serial console:
+			config <node>							read back
+			config <node> <key> <value> ...			update
+		keys: period, ack, retx, temp_min, temp_optimal, temp_max,
+		control, band, min_cycle (config.h). The update of a node is sent in one CONFIG frame
+		and confirmed with the resulting config version; the node
+		applies it live & persists it. <node> 3 is the CU itself
+		(ack, retx); the thresholds are always set on the CU state
+		and reach Node4 with the state snapshot.
+
+	FIRMWARE UPDATE:
+		Typed on the serial console:
+			ota load <version> <node1|node2|node4> <bytes>
+			ota data <hex>							32 bytes a line, in order
+			ota seed
+			ota										status
+		(e.g. xxd -p -c 32 image.bin | sed 's/^/ota data /'). The CU
+		seeds the image, disseminated page by page by all the nodes
+		(ota.h): every node reports its rollout time since the seed
+		and its OTA bytes, acknowledged by the CU, then the targets
+		reboot into the image.
+
+	TIME SYNCH:
+		The CU is the network time authority: the nodes synchronise
+		their clock with it and timestamp their readings.
 
 	EXTENSIONS:
 		1.a) ACK Mechanism when BROACASTING the ALARM SWITCH:
@@ -20,7 +91,8 @@
 		3.a) ALARM INPUT BLOCK Mechanism:
 				When WAITING GATE and DOOR OPENING-CLOSING is not allowed
 				to give ACTIVATE ALARM command.
-				BLINKING the BLUE LED every 2s for 16s!
+				BLINKING the BLUE LED every 2s until Node1 and Node2
+				report the end of the phases scheduled by the CU!
 		6) A new mote, Node4, located in Bedroom to check temperature
 				and automatically start and stop the Air-Conditionating
 				System to regulate the room temperature!
@@ -29,49 +101,74 @@
 #include "contiki.h"
 #include "stdio.h"
 #include "dev/button-sensor.h"
+#include "dev/serial-line.h"
 #include "sys/etimer.h"
 #include "net/rime/rime.h"
 #include "string.h"
+#include "stdlib.h"
 #include "leds.h"
+#include "window-stats.h"
+#include "templog.h"
+#include "nettime.h"
+#include "node-state.h"
+#include "confirm.h"
+#include "link-quality.h"
+#include "radio-queue.h"
+#include "batch.h"
+#include "aggregate.h"
+#include "serial-frame.h"
+#include "logbuf.h"
+#include "trace.h"
+#include "core.h"
+#include "config.h"
+#include "ota.h"
+#include "bench.h"
+
+#ifndef CU_CONF_TEXT_OUTPUT
+#define CU_CONF_TEXT_OUTPUT		1
+#endif
+
+#if !CU_CONF_TEXT_OUTPUT
+/*binary serial frames only: no text formatting on the UART*/
+#define printf(...)
+#endif
 
 //status values
-#define	ACTIVE 					1
-#define	NOT_ACTIVE				0
-#define LOCKED					1
-#define UNLOCKED				0
-#define AVAILABLE_COMMANDS		6
+#define AVAILABLE_COMMANDS		10
 #define INPUT_INTERVAL			4
-#define ALARM_ACK_INTERVAL		5
+#define ALARM_ACK_INTERVAL		5	/*default, CONFIG_ALARM_ACK*/
 #define OPEN_CLOSE_INTERVAL		2
 #define OPEN_CLOSE_DURATION		16
-
-//communication values
-#define MAX_RETRANSMISSIONS		5
-#define ALARM_ON				"ALARM_ON"
-#define ALARM_ON_SIZE			9
-#define ALARM_OFF				"ALARM_OFF"
-#define ALARM_OFF_SIZE			10
-#define ALARM_ACK				"ALARM_ACK"
-#define ALARM_ACK_SIZE			10
-#define LOCK_GATE				"LOCK"
-#define LOCK_GATE_SIZE			5
-#define UNLOCK_GATE				"UNLOCK"
-#define UNLOCK_GATE_SIZE		7
-#define OPEN_GATE_DOOR			"OPEN"
-#define OPEN_GATE_DOOR_SIZE		5
-#define GET_TEMP				"GET_TEMP"
-#define GET_TEMP_SIZE			9
-#define GET_LIGHT				"GET_LIGHT"
-#define GET_LIGHT_SIZE			10
-#define START_COMFORT_BED		"COMFORT"
-#define START_COMFORT_BED_SIZE	8
-#define STOP_COMFORT_BED		"NO_COMFORT"
-#define STOP_COMFORT_BED_SIZE	11
-#define RECEIVED				1
-#define NOT_RECEIVED			0
-#define NODE1_RIME_ADDR			1
-#define NODE2_RIME_ADDR			2
-#define NODE4_RIME_ADDR			4
+#define OPEN_LEAD_TIME			(CLOCK_SECOND/2)	/*to deliver the schedule*/
+#define DOOR_OPEN_DURATION		2	/*at the end of the gate phase*/
+#define OPEN_DONE_MARGIN		4	/*waiting the completions after the schedule end*/
+#define COMFORT_TEMP_MIN		15	/*Node4 default thresholds, sent in the state snapshot*/
+#define COMFORT_TEMP_OPTIMAL	19
+#define COMFORT_TEMP_MAX		23
+#define LOG_QUERY_RECORDS		120	/*newest log records requested*/
+#define LOG_WINDOW				4	/*log frames granted per credit*/
+#define GET_ALL_NODES			3
+#define GET_ALL_DEADLINE		2	/*seconds to collect the overview replies*/
+#define CONSOLE_LINE_SIZE		80	/*serial-line buffer*/
+#define CONSOLE_ARGS			(2 + 2*CONFIG_MAX_ENTRIES)
+#define OTA_LINE_BYTES			32	/*of an ota data line*/
+#define OTA_CONSOLE_ARGS		5
+
+//log events (deferred, see print_log_record)
+#define LOG_COMMANDS			0	/*available commands menu*/
+#define LOG_COMFORT_ON			1
+#define LOG_COMFORT_OFF			2
+#define LOG_DELIVERY_FAILED		3	/*address, retransmissions*/
+#define LOG_CONFIRMED			4	/*cmd | state << 8, address, latency ms*/
+#define LOG_DIVERGENCE_COMFORT	5	/*address, comfort status*/
+#define LOG_DIVERGENCE			6	/*address, node version, CU version*/
+#define LOG_CONFIG_CONFIRMED	7	/*address, config version, latency ms*/
+#define LOG_TEMP_STATS			8	/*temp_stats*/
+#define LOG_LIGHT				9	/*lux, network time, error ms*/
+#define LOG_OPENING_DONE		10	/*phase, network time, error ms*/
+#define LOG_BATCH_CONFIRMED		11	/*address, NODE_STATE_* flags, latency ms*/
+#define LOG_CONFIG_REPLY		12	/*address, config version, count (config_replies)*/
+#define LOG_OTA_REPORT			13	/*address (ota_reports)*/
 
 //status variables
 static int alarm_status = NOT_ACTIVE;
@@ -79,12 +176,49 @@ static int gate_status = LOCKED;
 static int opening_status = NOT_ACTIVE;
 static int comfort_status = NOT_ACTIVE;
 static int command = 0;
+static uint8_t state_version = 0;
 
 static int alarm_ACK_Node1 = NOT_RECEIVED;
 static int alarm_ACK_Node2 = NOT_RECEIVED;
 
+static int gate_done = NOT_RECEIVED;
+static int door_done = NOT_RECEIVED;
+
 static process_event_t handle_command_event;
 
+/*network time of the newest readings, to order them*/
+static uint32_t last_temp_time = 0;
+static uint32_t last_light_time = 0;
+static uint32_t last_opening_time = 0;
+static uint32_t last_bedroom_time = 0;
+
+//house overview collected by the Get All Process
+static const int get_all_addrs[GET_ALL_NODES] = {NODE1_RIME_ADDR, NODE2_RIME_ADDR, NODE4_RIME_ADDR};
+static struct nettime_reading get_all_readings[GET_ALL_NODES];
+static unsigned long get_all_latency[GET_ALL_NODES];	/*ms, 0 if no reply*/
+static int get_all_replies = 0;
+static uint8_t get_all_seq = 0;
+static clock_time_t get_all_start;
+
+//firmware image seeded from the console
+static uint32_t ota_seed_time = 0;
+
+//link tables reported by the nodes, by rime address
+static struct link_quality_report node_links[NODE4_RIME_ADDR + 1][LINK_QUALITY_REPORT_ENTRIES];
+static int node_links_count[NODE4_RIME_ADDR + 1];
+
+//replies too large for a log record, kept for the log process (the newest one is printed)
+static struct window_stats_summary temp_stats;
+static struct config_entry config_replies[NODE4_RIME_ADDR + 1][CONFIG_KEYS];
+static struct serial_frame_ota ota_reports[NODE4_RIME_ADDR + 1];
+
+//configuration of the CU, persisted by config.c
+static const struct config_entry config_defaults[] = {{CONFIG_ALARM_ACK, 0, ALARM_ACK_INTERVAL},
+														{CONFIG_MAX_RETX, 0, LINK_QUALITY_MAX_RETX},
+														{CONFIG_TEMP_MIN, 0, COMFORT_TEMP_MIN},
+														{CONFIG_TEMP_OPTIMAL, 0, COMFORT_TEMP_OPTIMAL},
+														{CONFIG_TEMP_MAX, 0, COMFORT_TEMP_MAX}};
+
 //communication variables
 static struct runicast_conn runicast;
 static struct broadcast_conn broadcast;
@@ -103,7 +237,35 @@ PROCESS(wait_alarm_ack_process, "Wait Alarm Ack Process");
 /*Waiting for gate and door opening & closing*/
 PROCESS(wait_opening_process, "Wait Gate and Door Opening-Closing Process");
 
-AUTOSTART_PROCESSES(&input_reader_process, &command_handler_process);
+/*Collecting the replies to a GET_ALL query until the deadline*/
+PROCESS(get_all_process, "Get All Process");
+
+/*Reading the configuration & firmware update commands typed on the serial console*/
+PROCESS(console_process, "Console Process");
+
+#if BENCH_ENABLED
+AUTOSTART_PROCESSES(&input_reader_process, &command_handler_process, &console_process, &bench_process);
+#else
+AUTOSTART_PROCESSES(&input_reader_process, &command_handler_process, &console_process);
+#endif
+
+/*Utility functions used by the RIME callbacks*/
+void print_avail_commands();
+void handle_temp_stats();
+void handle_light();
+void handle_get_all_reply(const char* rcvd_msg, const linkaddr_t *from);
+void handle_time_request(const char* rcvd_msg, const linkaddr_t *from);
+void handle_opening_done(const char* rcvd_msg);
+void handle_confirm(const char* rcvd_msg, int tag_size, const linkaddr_t *from);
+void handle_state_request(const linkaddr_t *from);
+void handle_state_digest(const char* rcvd_msg, const linkaddr_t *from);
+void save_state();
+void report_house_temperature(const struct aggregate_partial *summary);
+void handle_log_frame();
+void handle_config_reply(const char* rcvd_msg, const linkaddr_t *from);
+void handle_ota_report(const char* rcvd_msg, const linkaddr_t *from);
+void print_ota_report(int rime_addr);
+void print_log_record(const struct logbuf_record *record);
 
 
 /*----------------------------------RIME--------------------------------*/
@@ -114,8 +276,39 @@ static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8
 
 	char* rcvd_msg = (char *)packetbuf_dataptr();
 
-	if(strcmp(rcvd_msg, ALARM_ACK) == 0){
-	/*Receiving Alarm Ack*/
+	(void)c;
+
+	core_runicast_received(from, seqno);
+
+	if(strcmp(rcvd_msg, STATE_REQ) == 0){
+	/*Receiving State Snapshot Request from a rebooted node*/
+
+		handle_state_request(from);
+
+	}else if(strcmp(rcvd_msg, STATE_DIGEST) == 0){
+	/*Receiving State Digest heartbeat*/
+
+		handle_state_digest(rcvd_msg, from);
+
+	}else if(strcmp(rcvd_msg, TIME_REQ) == 0){
+	/*Receiving Time Synch Request*/
+
+		handle_time_request(rcvd_msg, from);
+
+	}else if(strcmp(rcvd_msg, OPEN_DONE) == 0){
+	/*Receiving Gate or Door Phase Completion*/
+
+		handle_opening_done(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, CONFIRM) == 0){
+	/*Receiving Command Confirmation*/
+
+		handle_confirm(rcvd_msg, CONFIRM_SIZE, from);
+
+	}else if(strcmp(rcvd_msg, ALARM_ACK) == 0){
+	/*Receiving Alarm Ack (confirming the alarm command)*/
+
+		handle_confirm(rcvd_msg, ALARM_ACK_SIZE, from);
 
 		if(from->u8[0] == NODE1_RIME_ADDR)
 
@@ -127,60 +320,93 @@ static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8
 
 //printf("UC [%u.%u]: received ALARM ACK from [%d:%d]!\n", linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], from->u8[0], from->u8[1]);
 	
+	}else if(strcmp(rcvd_msg, AGGREGATE) == 0){
+	/*Receiving the Partial Temperature Aggregate of a subtree*/
+
+		aggregate_merge(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, ALL_REPLY) == 0){
+	/*Receiving House Overview Reply*/
+
+		handle_get_all_reply(rcvd_msg, from);
+
+	}else if(strcmp(rcvd_msg, CONFIG_REPLY) == 0){
+	/*Receiving the Active Configuration of a node*/
+
+		handle_config_reply(rcvd_msg, from);
+
+	}else if(strcmp(rcvd_msg, OTA_REPORT) == 0){
+	/*Receiving the Firmware Update Report of a node*/
+
+		handle_ota_report(rcvd_msg, from);
+
+	}else if(from->u8[0] == NODE1_RIME_ADDR && strcmp(rcvd_msg, TEMP_LOG) == 0){
+	/*Receiving Temperature Log Frame*/
+
+		handle_log_frame();
+
 	}else if(from->u8[0] == NODE1_RIME_ADDR){
-	/*Receiving Temperature Average Reply*/
+	/*Receiving Temperature Statistics Reply*/
 
-		printf("Temperature Average: %d\n", *(int*)packetbuf_dataptr());
+		handle_temp_stats();
 
 	}else if(from->u8[0] == NODE2_RIME_ADDR){
 	/*Receiving External Light Reply*/
 
-		printf("External Light: %d\n", *(int*)packetbuf_dataptr());
+		handle_light();
 	
 	}else if(from->u8[0] == NODE4_RIME_ADDR){
 
 		if(strcmp(rcvd_msg, START_COMFORT_BED) == 0){
 
-			printf("COMFORT BEDROOM ACTIVATED\n");
+			LOGBUF0(LOG_COMFORT_ON);
 			comfort_status = ACTIVE;
+			save_state();
 
-			print_avail_commands();
+			LOGBUF0(LOG_COMMANDS);
 		
 		}else if(strcmp(rcvd_msg, STOP_COMFORT_BED) == 0){
 
-			printf("COMFORT BEDROOM DEACTIVATED\n");
+			LOGBUF0(LOG_COMFORT_OFF);
 			comfort_status = NOT_ACTIVE;
+			save_state();
 
-			print_avail_commands();
+			LOGBUF0(LOG_COMMANDS);
 		}
 
 	}
 }
 
 
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
-
-}
+static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t transmissions){
 
+	core_runicast_timedout(c, to, transmissions);
 
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+	LOGBUF2(LOG_DELIVERY_FAILED, to->u8[0], transmissions - 1);
 
-//printf("Timed out sending to %d.%d, retransmit %d\n",to->u8[0], to->u8[1], retransmissions);
+	confirm_delivery_failed(to->u8[0]);
 }
 
 
-static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
+static const struct runicast_callbacks runicast_calls = {recv_runicast, core_runicast_sent, timedout_runicast};
 
 
 //BROADCAST
 
 static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
 
+	(void)c;
+	(void)from;
+
+	TRACE_PACKET(TRACE_RX_BROADCAST, from, 0);
 }
 
 
 static void broadcast_sent(struct broadcast_conn *c, int status, int num_tx){
 
+	(void)c;
+	(void)status;
+	(void)num_tx;
 }
 
 
@@ -206,20 +432,558 @@ void print_avail_commands(){
 		printf("\t4) GET AVG. TEMP\n\t5) GET EXT. LIGHT\n");
 	}
 	printf("\t6) %s COMFORT BEDROOM\n", (comfort_status == ACTIVE)? "DEACTIVATE" : "ACTIVATE");
+
+	if(alarm_status == NOT_ACTIVE)
+		printf("\t7) GET TEMP LOG\n");
+
+	printf("\t8) SHOW LINK & COMMAND STATS\n");
+
+	if(opening_status == NOT_ACTIVE)
+		printf("\t9) %s\n", (alarm_status == ACTIVE)? "COME HOME" : "LEAVE HOUSE");
+
+	if(alarm_status == NOT_ACTIVE)
+		printf("\t10) GET ALL\n");
+
+	printf("###########################\n");
+}
+
+
+/*Printing the network time of a reading & flagging the ones older than the last printed*/
+void print_reading_time(uint32_t time, uint16_t error_ms, uint32_t *last_time){
+
+	if(error_ms == NETTIME_NOT_SYNCHED){
+
+		printf(" Time: NOT SYNCHED\n");
+		return;
+	}
+
+	printf(" Time: ");
+	nettime_print(time);
+	printf(" (+-%u ms)%s\n", error_ms, (time < *last_time) ? " OUT OF ORDER" : "");
+
+	if(time > *last_time)
+		*last_time = time;
+}
+
+/*Framing & keeping for the log process the Node1 window statistics received in the packetbuf*/
+void handle_temp_stats(){
+
+	memcpy(&temp_stats, packetbuf_dataptr(), sizeof(temp_stats));
+
+	serial_frame_send(SERIAL_FRAME_TEMP_STATS, NODE1_RIME_ADDR, &temp_stats, sizeof(temp_stats));
+
+	LOGBUF0(LOG_TEMP_STATS);
+}
+
+/*Printing the last Node1 window statistics*/
+void print_temp_stats(){
+
+	unsigned int stddev = window_stats_isqrt((unsigned long)temp_stats.variance * 100);
+
+	/*sign apart: -0.50 has no minus in the integer part*/
+	printf("Temperature Average: %s%d.%02d Std.Dev: %u.%02u Min: %d Max: %d Samples: %u", (temp_stats.mean < 0) ? "-" : "",
+		abs(temp_stats.mean)/100, abs(temp_stats.mean)%100, stddev/100, stddev%100, temp_stats.min, temp_stats.max,
+		temp_stats.count);
+
+	print_reading_time(temp_stats.time, temp_stats.error_ms, &last_temp_time);
+}
+
+/*Storing a reply to the running GET_ALL query & waking up the Get All Process*/
+void handle_get_all_reply(const char* rcvd_msg, const linkaddr_t *from){
+
+	int i;
+
+	if(!process_is_running(&get_all_process) || (uint8_t)rcvd_msg[ALL_REPLY_SIZE] != get_all_seq)
+		return;
+
+	for(i=0; i<GET_ALL_NODES; i++)
+
+		if(get_all_addrs[i] == from->u8[0] && get_all_latency[i] == 0){
+
+			memcpy(&get_all_readings[i], rcvd_msg + ALL_REPLY_SIZE + 1, sizeof(struct nettime_reading));
+
+			get_all_latency[i] = ((unsigned long)(clock_time_t)(clock_time() - get_all_start) * 1000) / CLOCK_SECOND + 1;
+			get_all_replies++;
+
+			process_poll(&get_all_process);
+		}
+}
+
+/*Printing the house overview table with the response time of every node*/
+void print_get_all(unsigned long elapsed){
+
+	static const char *names[GET_ALL_NODES] = {"Node1 AVG TEMP", "Node2 EXT LIGHT", "Node4 BEDROOM TEMP"};
+	static uint32_t *last_times[GET_ALL_NODES] = {&last_temp_time, &last_light_time, &last_bedroom_time};
+	struct nettime_reading *r;
+	int i;
+
+	printf("###########################\n#### HOUSE OVERVIEW: %d/%d nodes in %lu ms ####\n", get_all_replies, GET_ALL_NODES, elapsed);
+
+	for(i=0; i<GET_ALL_NODES; i++){
+
+		printf("\t%s [%d:0]: ", names[i], get_all_addrs[i]);
+
+		if(get_all_latency[i] == 0){
+
+			printf("NO REPLY\n");
+			continue;
+		}
+
+		r = &get_all_readings[i];
+
+		if(get_all_addrs[i] == NODE1_RIME_ADDR)
+			printf("%d.%02d C", r->value / 100, abs(r->value % 100));
+		else if(get_all_addrs[i] == NODE2_RIME_ADDR)
+			printf("%d lux", r->value);
+		else
+			printf("%d C", r->value);
+
+		serial_frame_send(SERIAL_FRAME_READING, get_all_addrs[i], r, sizeof(*r));
+
+		printf(" (reply in %lu ms)", get_all_latency[i]);
+		print_reading_time(r->time, r->error_ms, last_times[i]);
+	}
+
 	printf("###########################\n");
 }
 
+/*Framing & logging the Node2 timestamped light reading received in the packetbuf*/
+void handle_light(){
 
-void send_string(char* msg, int size, int rime_addr){
+	struct nettime_reading reading;
 
-		linkaddr_t addr;
-		packetbuf_copyfrom(msg, size);
-	    addr.u8[0] = rime_addr;
-	    addr.u8[1] = 0;
-	    runicast_send(&runicast, &addr, MAX_RETRANSMISSIONS);
+	memcpy(&reading, packetbuf_dataptr(), sizeof(reading));
 
-//printf("UC [%u.%u]: sending %s command!\n", linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], msg);
+	serial_frame_send(SERIAL_FRAME_LIGHT, NODE2_RIME_ADDR, &reading, sizeof(reading));
 
+	LOGBUF3(LOG_LIGHT, reading.value, reading.time, reading.error_ms);
+}
+
+/*Replying to a node Time Synch Request with the CU time*/
+void handle_time_request(const char* rcvd_msg, const linkaddr_t *from){
+
+	struct nettime_request request;
+	struct nettime_reply reply;
+	char msg[TIME_REPLY_SIZE + sizeof(struct nettime_reply)];
+
+	memcpy(&request, rcvd_msg + TIME_REQ_SIZE, sizeof(request));
+
+	nettime_fill_reply(&request, &reply);
+
+	memcpy(msg, TIME_REPLY, TIME_REPLY_SIZE);
+	memcpy(msg + TIME_REPLY_SIZE, &reply, sizeof(reply));
+
+	send_string(msg, sizeof(msg), from->u8[0], RADIO_QUEUE_COMMAND);
+}
+
+/*Applying a configuration value of the CU (from the flash or the console)*/
+void apply_config(uint8_t key, int16_t value){
+
+	/*alarm ack interval & thresholds are read when used*/
+	if(key == CONFIG_MAX_RETX)
+		link_quality_set_max_retx(value);
+}
+
+/*Printing & framing the active configuration of the CU*/
+void report_config(){
+
+	uint8_t frame[sizeof(struct config_header) + CONFIG_KEYS*sizeof(struct config_entry)];
+	struct config_entry entries[CONFIG_KEYS];
+	struct config_header header;
+
+	header.version = config_version();
+	header.count = config_fill(entries);
+
+	memcpy(frame, &header, sizeof(header));
+	memcpy(frame + sizeof(header), entries, header.count*sizeof(entries[0]));
+
+	serial_frame_send(SERIAL_FRAME_CONFIG, linkaddr_node_addr.u8[0], frame, sizeof(header) + header.count*sizeof(entries[0]));
+
+	config_print(linkaddr_node_addr.u8[0], header.version, entries, header.count);
+}
+
+/*Framing & logging the active configuration read back from a node*/
+void handle_config_reply(const char* rcvd_msg, const linkaddr_t *from){
+
+	struct config_header header;
+	int size = packetbuf_datalen() - CONFIG_REPLY_SIZE;
+
+	if(size < (int)sizeof(header))
+		return;
+
+	memcpy(&header, rcvd_msg + CONFIG_REPLY_SIZE, sizeof(header));
+
+	if(header.count > CONFIG_KEYS || (int)(sizeof(header) + header.count*sizeof(struct config_entry)) > size)
+		return;
+
+	if(from->u8[0] > NODE4_RIME_ADDR)
+		return;
+
+	memcpy(config_replies[from->u8[0]], rcvd_msg + CONFIG_REPLY_SIZE + sizeof(header),
+		header.count*sizeof(struct config_entry));
+
+	serial_frame_send(SERIAL_FRAME_CONFIG, from->u8[0], rcvd_msg + CONFIG_REPLY_SIZE,
+		sizeof(header) + header.count*sizeof(struct config_entry));
+
+	LOGBUF3(LOG_CONFIG_REPLY, from->u8[0], header.version, header.count);
+}
+
+/*Filling the snapshot of the state owned by the CU*/
+void fill_state(struct node_state *state){
+
+	state->alarm = alarm_status;
+	state->gate = gate_status;
+	state->comfort = comfort_status;
+	state->version = state_version;
+	state->temp_min = config_get(CONFIG_TEMP_MIN);
+	state->temp_optimal = config_get(CONFIG_TEMP_OPTIMAL);
+	state->temp_max = config_get(CONFIG_TEMP_MAX);
+	state->pad = 0;
+}
+
+/*Versioning & persisting the state after every change*/
+void save_state(){
+
+	struct node_state state;
+
+	state_version++;
+
+	fill_state(&state);
+
+	node_state_save(&state);
+
+	serial_frame_send(SERIAL_FRAME_STATE, linkaddr_node_addr.u8[0], &state, sizeof(state));
+}
+
+/*Restoring the state persisted before a CU reboot*/
+void load_state(){
+
+	struct node_state state;
+
+	if(!node_state_load(&state))
+		return;
+
+	alarm_status = state.alarm;
+	gate_status = state.gate;
+	comfort_status = state.comfort;
+	state_version = state.version;
+
+	printf("STATE RESTORED from flash (version %u)\n", state_version);
+}
+
+/*Replying to a rebooted node with the state snapshot*/
+void handle_state_request(const linkaddr_t *from){
+
+	char msg[STATE_REPLY_SIZE + sizeof(struct node_state)];
+	struct node_state state;
+
+	fill_state(&state);
+
+	memcpy(msg, STATE_REPLY, STATE_REPLY_SIZE);
+	memcpy(msg + STATE_REPLY_SIZE, &state, sizeof(state));
+
+	send_string(msg, sizeof(msg), from->u8[0], RADIO_QUEUE_COMMAND);
+}
+
+/*Keeping the link table a node appended to its digest*/
+void store_links(const char* reports, int size, const linkaddr_t *from){
+
+	int count = size / (int)sizeof(struct link_quality_report);
+
+	if(from->u8[0] > NODE4_RIME_ADDR || count < 0)
+		return;
+
+	if(count > LINK_QUALITY_REPORT_ENTRIES)
+		count = LINK_QUALITY_REPORT_ENTRIES;
+
+	memcpy(node_links[from->u8[0]], reports, count*sizeof(struct link_quality_report));
+	node_links_count[from->u8[0]] = count;
+}
+
+/*Printing the CU link table & the last ones reported by the nodes*/
+void print_links(){
+
+	struct link_quality_report links[LINK_QUALITY_MAX_NEIGHBORS];
+	int addr;
+
+	link_quality_print(linkaddr_node_addr.u8[0], links, link_quality_report(links, LINK_QUALITY_MAX_NEIGHBORS));
+
+	for(addr=1; addr<=NODE4_RIME_ADDR; addr++)
+		if(node_links_count[addr] > 0)
+			link_quality_print(addr, node_links[addr], node_links_count[addr]);
+}
+
+/*Printing & framing the house-wide temperature summary computed by the aggregation tree*/
+void report_house_temperature(const struct aggregate_partial *summary){
+
+	serial_frame_send(SERIAL_FRAME_AGGREGATE, linkaddr_node_addr.u8[0], summary, sizeof(*summary));
+
+	aggregate_print(summary);
+}
+
+/*Comparing a node digest with the CU view of the fields owned by that node & repairing divergences*/
+void handle_state_digest(const char* rcvd_msg, const linkaddr_t *from){
+
+	struct node_state_digest digest, expected;
+	struct node_state state;
+	uint8_t mask = 0;
+	int thresholds = 0;
+
+	memcpy(&digest, rcvd_msg + STATE_DIGEST_SIZE, sizeof(digest));
+
+	store_links(rcvd_msg + STATE_DIGEST_SIZE + sizeof(digest),
+		packetbuf_datalen() - STATE_DIGEST_SIZE - sizeof(digest), from);
+
+	fill_state(&state);
+	node_state_digest(&state, 0, &expected);
+
+	if(from->u8[0] == NODE1_RIME_ADDR)
+
+		mask = NODE_STATE_ALARM;
+
+	else if(from->u8[0] == NODE2_RIME_ADDR)
+
+		mask = NODE_STATE_ALARM | NODE_STATE_GATE;
+
+	else if(from->u8[0] == NODE4_RIME_ADDR){
+
+		mask = NODE_STATE_COMFORT;
+		thresholds = 1;
+	}
+
+	if((digest.flags & mask) == (expected.flags & mask) &&
+		(!thresholds || digest.thresholds == expected.thresholds)){
+
+		/*in synch: a local change is confirmed sending the snapshot back*/
+		if(digest.flags & NODE_STATE_LOCAL)
+			handle_state_request(from);
+
+		return;
+	}
+
+	if((digest.flags & NODE_STATE_LOCAL) && from->u8[0] == NODE4_RIME_ADDR){
+	/*the comfort switched on Node4 is newer than the CU view*/
+
+		comfort_status = (digest.flags & NODE_STATE_COMFORT) ? ACTIVE : NOT_ACTIVE;
+		save_state();
+
+		LOGBUF2(LOG_DIVERGENCE_COMFORT, from->u8[0], comfort_status);
+		LOGBUF0(LOG_COMMANDS);
+
+	}else
+
+		LOGBUF3(LOG_DIVERGENCE, from->u8[0], digest.version, state_version);
+
+	handle_state_request(from);
+}
+
+/*Marking a completed phase of the opening & waking up the Wait Opening Process*/
+void handle_opening_done(const char* rcvd_msg){
+
+	struct nettime_reading done;
+
+	memcpy(&done, rcvd_msg + OPEN_DONE_SIZE, sizeof(done));
+
+	if(done.value == GATE_PHASE)
+		gate_done = RECEIVED;
+	else if(done.value == DOOR_PHASE)
+		door_done = RECEIVED;
+
+	serial_frame_send(SERIAL_FRAME_OPENING, (done.value == GATE_PHASE) ? NODE2_RIME_ADDR : NODE1_RIME_ADDR,
+		&done, sizeof(done));
+
+	LOGBUF3(LOG_OPENING_DONE, done.value, done.time, done.error_ms);
+
+	process_poll(&wait_opening_process);
+}
+
+/*Printing the state confirmed by a node for a whole batch*/
+void print_batch_confirm(int rime_addr, int state, long latency){
+
+	printf("BATCH on [%d:0] (confirmed in %ld ms):", rime_addr, latency);
+
+	if(rime_addr == NODE1_RIME_ADDR || rime_addr == NODE2_RIME_ADDR)
+		printf(" ALARM %s", (state & NODE_STATE_ALARM) ? "ACTIVATED" : "DEACTIVATED");
+
+	if(rime_addr == NODE2_RIME_ADDR)
+		printf(" GATE %s", (state & NODE_STATE_GATE) ? "LOCKED" : "UNLOCKED");
+
+	if(rime_addr == NODE4_RIME_ADDR)
+		printf(" COMFORT BEDROOM %s", (state & NODE_STATE_COMFORT) ? "ACTIVATED" : "DEACTIVATED");
+
+	printf("\n");
+}
+
+/*Logging the state confirmed by a node for a pending command (acking the alarm operation of a batch)*/
+void handle_confirm(const char* rcvd_msg, int tag_size, const linkaddr_t *from){
+
+	struct confirm_reply reply;
+	struct serial_frame_confirm frame;
+	long latency;
+
+	memcpy(&reply, rcvd_msg + tag_size, sizeof(reply));
+
+	latency = confirm_receive(&reply, from->u8[0]);
+
+	if(latency < 0 || reply.cmd >= CONFIRM_COMMANDS)
+		return;
+
+	frame.cmd = reply.cmd;
+	frame.seq = reply.seq;
+	frame.state = reply.state;
+	frame.pad = 0;
+	frame.latency_ms = latency;
+
+	serial_frame_send(SERIAL_FRAME_CONFIRM, from->u8[0], &frame, sizeof(frame));
+
+	if(reply.cmd == CONFIRM_BATCH){
+
+		if(from->u8[0] == NODE1_RIME_ADDR)
+			alarm_ACK_Node1 = RECEIVED;
+		else if(from->u8[0] == NODE2_RIME_ADDR)
+			alarm_ACK_Node2 = RECEIVED;
+
+		LOGBUF3(LOG_BATCH_CONFIRMED, from->u8[0], reply.state, latency);
+		return;
+	}
+
+	if(reply.cmd == CONFIRM_CONFIG){
+
+		LOGBUF3(LOG_CONFIG_CONFIRMED, from->u8[0], reply.state, latency);
+		return;
+	}
+
+	LOGBUF3(LOG_CONFIRMED, reply.cmd | ((reply.state ? 1 : 0) << 8), from->u8[0], latency);
+}
+
+/*Printing the records of a Node1 log frame & granting new credits at the end of each window*/
+void handle_log_frame(){
+
+	struct templog_frame_header header;
+	const uint8_t *packed = (uint8_t *)packetbuf_dataptr() + TEMP_LOG_SIZE + sizeof(header);
+	struct serial_frame_log record;
+	unsigned long time;
+	char credit[LOG_CREDIT_SIZE + 1];
+	int i;
+
+	if(packetbuf_datalen() < TEMP_LOG_SIZE + sizeof(header))
+		return;
+
+	memcpy(&header, (uint8_t *)packetbuf_dataptr() + TEMP_LOG_SIZE, sizeof(header));
+
+	/*short or corrupt frame: no stale packetbuf bytes as records*/
+	if(TEMP_LOG_SIZE + sizeof(header) + header.count*TEMPLOG_PACKED_SIZE > packetbuf_datalen())
+		return;
+
+	time = header.base_time;
+
+	for(i=0; i<header.count; i++){
+
+		time += packed[0] | ((uint16_t)packed[1] << 8);
+
+		record.time = time;
+		record.value = (int8_t)packed[2];
+
+		serial_frame_send(SERIAL_FRAME_LOG, NODE1_RIME_ADDR, &record, sizeof(record));
+
+		printf("Temperature Log: %lu %d\n", time, (int8_t)packed[2]);
+
+		packed += TEMPLOG_PACKED_SIZE;
+	}
+
+	if(header.flags & TEMPLOG_LAST_FRAME){
+
+		printf("Temperature Log: END (%u frames)\n", header.seq + 1);
+
+	}else if((header.seq + 1) % LOG_WINDOW == 0){
+
+		memcpy(credit, LOG_CREDIT, LOG_CREDIT_SIZE);
+		credit[LOG_CREDIT_SIZE] = LOG_WINDOW;
+
+		send_string(credit, sizeof(credit), NODE1_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
+	}
+}
+
+
+
+/*Formatting a deferred log record, called by the log process*/
+void print_log_record(const struct logbuf_record *record){
+
+	static const char *confirmed[CONFIRM_COMMANDS][2] = {
+		{"ALARM DEACTIVATED", "ALARM ACTIVATED"},
+		{"GATE UNLOCKED", "GATE LOCKED"},
+		{"OPENING NOT SCHEDULED", "OPENING SCHEDULED"},
+		{"COMFORT BEDROOM DEACTIVATED", "COMFORT BEDROOM ACTIVATED"}};
+	const int32_t *args = record->args;
+
+	switch(record->event){
+
+		case LOG_COMMANDS:
+			print_avail_commands();
+			break;
+
+		case LOG_COMFORT_ON:
+			printf("COMFORT BEDROOM ACTIVATED\n");
+			break;
+
+		case LOG_COMFORT_OFF:
+			printf("COMFORT BEDROOM DEACTIVATED\n");
+			break;
+
+		case LOG_DELIVERY_FAILED:
+			printf("DELIVERY to [%d:0] FAILED after %d retransmissions\n", (int)args[0], (int)args[1]);
+			break;
+
+		case LOG_CONFIRMED:
+			printf("%s on [%d:0] (confirmed in %ld ms)\n", confirmed[args[0] & 0xFF][args[0] >> 8], (int)args[1], (long)args[2]);
+			break;
+
+		case LOG_DIVERGENCE_COMFORT:
+			printf("STATE DIVERGENCE on Node4 [%d:0]: COMFORT BEDROOM %s\n", (int)args[0],
+				(args[1] == ACTIVE) ? "ACTIVATED" : "DEACTIVATED");
+			break;
+
+		case LOG_DIVERGENCE:
+			printf("STATE DIVERGENCE on [%d:0] (version %u/%u): REPAIRING\n", (int)args[0],
+				(unsigned int)args[1], (unsigned int)args[2]);
+			break;
+
+		case LOG_CONFIG_CONFIRMED:
+			printf("CONFIG on [%d:0] version %u (confirmed in %ld ms)\n", (int)args[0],
+				(unsigned int)args[1], (long)args[2]);
+			break;
+
+		case LOG_TEMP_STATS:
+			print_temp_stats();
+			break;
+
+		case LOG_LIGHT:
+			printf("External Light: %d", (int)args[0]);
+			print_reading_time((uint32_t)args[1], (uint16_t)args[2], &last_light_time);
+			break;
+
+		case LOG_OPENING_DONE:
+			printf("%s CLOSED", (args[0] == GATE_PHASE) ? "GATE" : "DOOR");
+			print_reading_time((uint32_t)args[1], (uint16_t)args[2], &last_opening_time);
+			break;
+
+		case LOG_BATCH_CONFIRMED:
+			print_batch_confirm(args[0], args[1], args[2]);
+			break;
+
+		case LOG_CONFIG_REPLY:
+			config_print(args[0], args[1], config_replies[args[0]], args[2]);
+			break;
+
+		case LOG_OTA_REPORT:
+			print_ota_report(args[0]);
+			break;
+
+		case LOG_COMMAND_FAILED:
+		case LOG_COMMAND_UNTRACKED:
+			confirm_print_record(record);
+			break;
+	}
 }
 
 /*---------------------------HANDLER FUNCTIONS--------------------------*/
@@ -227,9 +991,14 @@ void send_string(char* msg, int size, int rime_addr){
 /*Broadcasting to Node1 and Node2 ALARM command & starting the WAIT ALARM ACK PROCESS*/
 void handle_alarm_command(){
 
+	char msg[ALARM_OFF_SIZE + 1];
+	int size = 0;
+	uint8_t seq = confirm_next_seq();
+
 	if(alarm_status == ACTIVE){
 
-		packetbuf_copyfrom(ALARM_OFF, ALARM_OFF_SIZE);
+		memcpy(msg, ALARM_OFF, ALARM_OFF_SIZE);
+		size = ALARM_OFF_SIZE;
 		alarm_status = NOT_ACTIVE;
 		/*Resetting Alarm ACKs Leds*/
 		leds_off(LEDS_RED);
@@ -237,11 +1006,21 @@ void handle_alarm_command(){
 
 	}else if(alarm_status == NOT_ACTIVE){
 			
-			packetbuf_copyfrom(ALARM_ON, ALARM_ON_SIZE);
+			memcpy(msg, ALARM_ON, ALARM_ON_SIZE);
+			size = ALARM_ON_SIZE;
 			alarm_status = ACTIVE;
 	}
 
+	msg[size++] = seq;
+
+	packetbuf_copyfrom(msg, size);
 	broadcast_send(&broadcast);
+	TRACE_PACKET(TRACE_TX_BROADCAST, NULL, 0);
+
+	confirm_expect(CONFIRM_ALARM, seq, NODE1_RIME_ADDR, msg, size);
+	confirm_expect(CONFIRM_ALARM, seq, NODE2_RIME_ADDR, msg, size);
+
+	save_state();
 
 	alarm_ACK_Node1 = NOT_RECEIVED;
 	alarm_ACK_Node2 = NOT_RECEIVED;
@@ -252,30 +1031,70 @@ void handle_alarm_command(){
 /*Sending the Lock/Unlock Gate Request*/
 void handle_gate_locking_command(){
 
+	char msg[UNLOCK_GATE_SIZE + 1];
+	int size = 0;
+	uint8_t seq = confirm_next_seq();
+
 	if(gate_status == UNLOCKED){
 
-		printf("GATE LOCKED\n");
+		printf("LOCKING GATE ...\n");
 		gate_status = LOCKED;
-		send_string(LOCK_GATE, LOCK_GATE_SIZE, NODE2_RIME_ADDR);
+		memcpy(msg, LOCK_GATE, LOCK_GATE_SIZE);
+		size = LOCK_GATE_SIZE;
 
 	}else if(gate_status == LOCKED){
 
-		printf("GATE UNLOCKED\n");
+		printf("UNLOCKING GATE ...\n");
 		gate_status = UNLOCKED;
-		send_string(UNLOCK_GATE, UNLOCK_GATE_SIZE, NODE2_RIME_ADDR);
+		memcpy(msg, UNLOCK_GATE, UNLOCK_GATE_SIZE);
+		size = UNLOCK_GATE_SIZE;
 	}
 
+	msg[size++] = seq;
+
+	send_string(msg, size, NODE2_RIME_ADDR, confirm_priority(CONFIRM_GATE, NULL, 0));
+
+	confirm_expect(CONFIRM_GATE, seq, NODE2_RIME_ADDR, msg, size);
+
+	save_state();
+
 }
 
-/*Brodcasting Open Gate & Door Request to Node1 and Nod2*/
+/*Brodcasting to Node1 and Nod2 the Open Gate & Door Request scheduling both phases*/
 void handle_gate_door_opening_command(){
 
+	char msg[OPEN_GATE_DOOR_SIZE + 1 + sizeof(struct nettime_schedule)];
+	struct nettime_schedule schedule;
+	uint8_t seq;
+
 	if(opening_status == NOT_ACTIVE){
 
 		printf("OPENING GATE and DOOR ...\n");
 
-		packetbuf_copyfrom(OPEN_GATE_DOOR, OPEN_GATE_DOOR_SIZE);
+		/*gate open for the whole duration, door open at its end*/
+		schedule.sent = nettime_now();
+		schedule.start[GATE_PHASE] = schedule.sent + OPEN_LEAD_TIME;
+		schedule.duration[GATE_PHASE] = OPEN_CLOSE_DURATION;
+		schedule.start[DOOR_PHASE] = schedule.start[GATE_PHASE] +
+									(OPEN_CLOSE_DURATION - DOOR_OPEN_DURATION)*CLOCK_SECOND;
+		schedule.duration[DOOR_PHASE] = DOOR_OPEN_DURATION;
+
+		seq = confirm_next_seq();
+
+		memcpy(msg, OPEN_GATE_DOOR, OPEN_GATE_DOOR_SIZE);
+		msg[OPEN_GATE_DOOR_SIZE] = seq;
+		memcpy(msg + OPEN_GATE_DOOR_SIZE + 1, &schedule, sizeof(schedule));
+
+		packetbuf_copyfrom(msg, sizeof(msg));
 		broadcast_send(&broadcast);
+		TRACE_PACKET(TRACE_TX_BROADCAST, NULL, 0);
+
+		/*a retry carries the same schedule: a late node shortens its phase*/
+		confirm_expect(CONFIRM_OPEN, seq, NODE1_RIME_ADDR, msg, sizeof(msg));
+		confirm_expect(CONFIRM_OPEN, seq, NODE2_RIME_ADDR, msg, sizeof(msg));
+
+		gate_done = NOT_RECEIVED;
+		door_done = NOT_RECEIVED;
 
 		opening_status = ACTIVE;
 
@@ -286,28 +1105,336 @@ void handle_gate_door_opening_command(){
 /*Sending to Node1 the Get Temperature Request & handling Reply in recv_runicast()*/
 void handle_get_temp_command(){
 
-	send_string(GET_TEMP, GET_TEMP_SIZE, NODE1_RIME_ADDR);
+	send_string(GET_TEMP, GET_TEMP_SIZE, NODE1_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
+}
+
+/*Requesting to Node1 the newest Log Records & handling the Stream in recv_runicast()*/
+void handle_get_log_command(){
+
+	char msg[GET_LOG_SIZE + sizeof(struct templog_request)];
+	struct templog_request request;
+
+	request.from = 0;
+	request.to = 0xFFFFFFFF;
+	request.max_records = LOG_QUERY_RECORDS;
+	request.window = LOG_WINDOW;
+	request.pad = 0;
+
+	memcpy(msg, GET_LOG, GET_LOG_SIZE);
+	memcpy(msg + GET_LOG_SIZE, &request, sizeof(request));
+
+	send_string(msg, sizeof(msg), NODE1_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
 }
 
 /*Sending to Node2 the Get Ext. Light Request & handling Reply in recv_runicast()*/
 void handle_get_light_command(){
 
-	send_string(GET_LIGHT, GET_LIGHT_SIZE, NODE2_RIME_ADDR);
+	send_string(GET_LIGHT, GET_LIGHT_SIZE, NODE2_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
 }
 
 /*Sending to Node4 the Start/Stop Comfort Bedroom Temperature Request*/
 void handle_comfort_bedroom_command(){
 
+	char msg[STOP_COMFORT_BED_SIZE + 1];
+	int size = 0;
+	uint8_t seq = confirm_next_seq();
+
 	if(comfort_status == ACTIVE){
 
-		send_string(STOP_COMFORT_BED, STOP_COMFORT_BED_SIZE, NODE4_RIME_ADDR);
+		memcpy(msg, STOP_COMFORT_BED, STOP_COMFORT_BED_SIZE);
+		size = STOP_COMFORT_BED_SIZE;
 		comfort_status = NOT_ACTIVE;
 
 	}else if(comfort_status == NOT_ACTIVE){
 
-		send_string(START_COMFORT_BED, START_COMFORT_BED_SIZE, NODE4_RIME_ADDR);
+		memcpy(msg, START_COMFORT_BED, START_COMFORT_BED_SIZE);
+		size = START_COMFORT_BED_SIZE;
 		comfort_status = ACTIVE;
 	}
+
+	msg[size++] = seq;
+
+	send_string(msg, size, NODE4_RIME_ADDR, confirm_priority(CONFIRM_COMFORT, NULL, 0));
+
+	confirm_expect(CONFIRM_COMFORT, seq, NODE4_RIME_ADDR, msg, size);
+
+	save_state();
+}
+
+/*Sending a configuration update to a node, confirmed with the resulting version*/
+void send_config(int rime_addr, const struct config_entry *entries, int count){
+
+	char msg[CONFIG_SIZE + 1 + CONFIG_MAX_ENTRIES*sizeof(struct config_entry)];
+	int size = CONFIG_SIZE + 1 + count*sizeof(struct config_entry);
+	uint8_t seq = confirm_next_seq();
+
+	printf("CONFIGURING [%d:0] ...\n", rime_addr);
+
+	memcpy(msg, CONFIG, CONFIG_SIZE);
+	msg[CONFIG_SIZE] = seq;
+	memcpy(msg + CONFIG_SIZE + 1, entries, count*sizeof(struct config_entry));
+
+	send_string(msg, size, rime_addr, confirm_priority(CONFIRM_CONFIG, NULL, 0));
+
+	confirm_expect(CONFIRM_CONFIG, seq, rime_addr, msg, size);
+}
+
+/*Reading back or updating the configuration of a node typed on the console (see CONFIGURATION)*/
+void handle_config_command(const char *line){
+
+	static char buf[CONSOLE_LINE_SIZE];
+	char *argv[CONSOLE_ARGS];
+	struct config_entry local[CONFIG_MAX_ENTRIES], remote[CONFIG_MAX_ENTRIES];
+	struct config_entry *entry;
+	int16_t thresholds[3];
+	int argc = 0, n_local = 0, n_remote = 0, changed = 0, addr, key, value, i;
+	linkaddr_t node4;
+	char *p;
+
+	strncpy(buf, line, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+
+	for(p = strtok(buf, " "); p != NULL && argc < CONSOLE_ARGS; p = strtok(NULL, " "))
+		argv[argc++] = p;
+
+	addr = (argc >= 2) ? atoi(argv[1]) : 0;
+
+	if(argc < 2 || strcmp(argv[0], "config") != 0 || argc % 2 != 0 || addr <= 0 || addr > 255){
+
+		printf("Console: config <node> [<key> <value> ...]\n");
+		return;
+	}
+
+	if(argc == 2){
+	/*read back, the reply handled in recv_runicast()*/
+
+		if(addr == linkaddr_node_addr.u8[0])
+			report_config();
+		else
+			send_string(GET_CONFIG, GET_CONFIG_SIZE, addr, RADIO_QUEUE_COMMAND);
+
+		return;
+	}
+
+	for(i=0; i<3; i++)
+		thresholds[i] = config_get(CONFIG_TEMP_MIN + i);
+
+	for(i=2; i<argc; i+=2){
+
+		key = config_key(argv[i]);
+		value = atoi(argv[i+1]);
+
+		if(key < 0 || !config_valid(key, value)){
+
+			printf("Console: invalid %s %s\n", argv[i], argv[i+1]);
+			return;
+		}
+
+		/*the thresholds belong to the CU state, whatever the node*/
+		if(key >= CONFIG_TEMP_MIN && key <= CONFIG_TEMP_MAX){
+
+			thresholds[key - CONFIG_TEMP_MIN] = value;
+			changed = 1;
+		}
+
+		entry = (addr == linkaddr_node_addr.u8[0] || (key >= CONFIG_TEMP_MIN && key <= CONFIG_TEMP_MAX)) ?
+				&local[n_local++] : &remote[n_remote++];
+
+		entry->key = key;
+		entry->pad = 0;
+		entry->value = value;
+	}
+
+	if(changed && (thresholds[0] > thresholds[1] || thresholds[1] > thresholds[2])){
+
+		printf("Console: thresholds %d/%d/%d not ordered\n", thresholds[0], thresholds[1], thresholds[2]);
+		return;
+	}
+
+	if(n_local > 0){
+
+		if(config_set(local, n_local) > 0 && changed){
+		/*new thresholds: new state version, pushed to Node4 now*/
+
+			save_state();
+
+			node4.u8[0] = NODE4_RIME_ADDR;
+			node4.u8[1] = 0;
+			handle_state_request(&node4);
+		}
+
+		report_config();
+	}
+
+	if(n_remote > 0)
+		send_config(addr, remote, n_remote);
+}
+
+/*Framing & logging the firmware update report of a node*/
+void handle_ota_report(const char* rcvd_msg, const linkaddr_t *from){
+
+	struct ota_report report;
+	struct serial_frame_ota frame;
+	char ack[OTA_ACK_SIZE + 1];
+
+	if(packetbuf_datalen() < OTA_REPORT_SIZE + sizeof(report) || from->u8[0] > NODE4_RIME_ADDR)
+		return;
+
+	memcpy(&report, rcvd_msg + OTA_REPORT_SIZE, sizeof(report));
+
+	/*the node installs the image only once acknowledged (or after its last try)*/
+	memcpy(ack, OTA_ACK, OTA_ACK_SIZE);
+	ack[OTA_ACK_SIZE] = report.version;
+
+	send_data(ack, sizeof(ack), from->u8[0], RADIO_QUEUE_TELEMETRY);
+
+	frame.version = report.version;
+	frame.outcome = report.outcome;
+	frame.pad = 0;
+	/*0 if completed before the seed within the synchronisation error*/
+	frame.rollout_ms = ((int32_t)(report.done - ota_seed_time) > 0) ?
+		((report.done - ota_seed_time) * 1000) / CLOCK_SECOND : 0;
+	frame.rx_bytes = report.rx_bytes;
+	frame.tx_bytes = report.tx_bytes;
+
+	serial_frame_send(SERIAL_FRAME_OTA, from->u8[0], &frame, sizeof(frame));
+
+	ota_reports[from->u8[0]] = frame;
+
+	LOGBUF1(LOG_OTA_REPORT, from->u8[0]);
+}
+
+/*Printing the last firmware update report of a node*/
+void print_ota_report(int rime_addr){
+
+	const struct serial_frame_ota *r = &ota_reports[rime_addr];
+
+	/*after the reboot: a rollout only if the image runs*/
+	if(r->outcome == OTA_INSTALLED || r->outcome == OTA_NOT_INSTALLED){
+
+		printf("OTA [%d:0] version %u %s, confirmed %lu ms after the seed\n", rime_addr, r->version,
+			(r->outcome == OTA_INSTALLED) ? "installed" : "staged, not installed", (unsigned long)r->rollout_ms);
+		return;
+	}
+
+	printf("OTA [%d:0] version %u %s rollout %lu ms, received %lu B, sent %lu B\n", rime_addr, r->version,
+		(r->outcome == OTA_REBOOTING) ? "rebooting:" : "stored:", (unsigned long)r->rollout_ms,
+		(unsigned long)r->rx_bytes, (unsigned long)r->tx_bytes);
+}
+
+/*Value of a hexadecimal digit, -1 if not one*/
+int hex_value(char c){
+
+	if(c >= '0' && c <= '9')
+		return c - '0';
+
+	if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+/*Loading & seeding a firmware image typed on the console (see FIRMWARE UPDATE)*/
+void handle_ota_command(const char *line){
+
+	static char buf[CONSOLE_LINE_SIZE];
+	char *argv[OTA_CONSOLE_ARGS];
+	uint8_t data[OTA_LINE_BYTES];
+	int argc = 0, version, target, size, n;
+	char *p;
+
+	strncpy(buf, line, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+
+	for(p = strtok(buf, " "); p != NULL && argc < OTA_CONSOLE_ARGS; p = strtok(NULL, " "))
+		argv[argc++] = p;
+
+	if(argc == 1 && strcmp(argv[0], "ota") == 0){
+
+		ota_print();
+		return;
+	}
+
+	if(argc == 5 && strcmp(argv[1], "load") == 0){
+
+		version = atoi(argv[2]);
+		size = atoi(argv[4]);
+		target = (strcmp(argv[3], "node1") == 0) ? OTA_TARGET_NODE1 : (strcmp(argv[3], "node2") == 0) ?
+			OTA_TARGET_NODE2 : (strcmp(argv[3], "node4") == 0) ? OTA_TARGET_NODE4 : OTA_TARGET_NONE;
+
+		if(target == OTA_TARGET_NONE || version <= 0 || version > 255 || size <= 0 || size > 0xFFFF ||
+			!ota_load(version, target, size))
+			printf("Console: ota load rejected (newer version, up to %d B)\n", OTA_MAX_PAGES*OTA_PAGE_SIZE);
+
+		return;
+	}
+
+	if(argc == 3 && strcmp(argv[1], "data") == 0){
+
+		for(n=0, p=argv[2]; n < OTA_LINE_BYTES && hex_value(p[0]) >= 0 && hex_value(p[1]) >= 0; n++, p += 2)
+			data[n] = (hex_value(p[0]) << 4) | hex_value(p[1]);
+
+		if(n == 0 || *p != '\0' || !ota_write(data, n))
+			printf("Console: ota data rejected\n");
+
+		return;
+	}
+
+	if(argc == 2 && strcmp(argv[1], "seed") == 0){
+
+		if(ota_seed())
+			ota_seed_time = nettime_now();
+		else
+			printf("Console: ota seed rejected (image not loaded)\n");
+
+		return;
+	}
+
+	printf("Console: ota [load <version> <node1|node2|node4> <bytes> | data <hex> | seed]\n");
+}
+
+/*Starting the Get All Process: broadcast query & collection of the replies*/
+void handle_get_all_command(){
+
+	if(process_is_running(&get_all_process)){
+
+		printf("GET ALL already running!\n");
+		return;
+	}
+
+	process_start(&get_all_process, NULL);
+}
+
+/*Batching the operations of the Leave House/Come Home scene: one frame per node*/
+void handle_scene_command(){
+
+	int leaving = (alarm_status == NOT_ACTIVE);
+
+	printf("%s: ALARM %s, GATE %s, COMFORT BEDROOM %s ...\n", leaving ? "LEAVING HOUSE" : "COMING HOME",
+		leaving ? "ON" : "OFF", leaving ? "LOCK" : "UNLOCK", leaving ? "OFF" : "ON");
+
+	alarm_status = leaving ? ACTIVE : NOT_ACTIVE;
+	gate_status = leaving ? LOCKED : UNLOCKED;
+	comfort_status = leaving ? NOT_ACTIVE : ACTIVE;
+
+	batch_add(NODE1_RIME_ADDR, CONFIRM_ALARM, alarm_status);
+	batch_add(NODE2_RIME_ADDR, CONFIRM_ALARM, alarm_status);
+	batch_add(NODE2_RIME_ADDR, CONFIRM_GATE, gate_status);
+	batch_add(NODE4_RIME_ADDR, CONFIRM_COMFORT, comfort_status);
+
+	save_state();
+
+	/*Resetting Alarm ACKs Leds, set again by the batch confirmations*/
+	leds_off(LEDS_RED);
+	leds_off(LEDS_GREEN);
+
+	alarm_ACK_Node1 = NOT_RECEIVED;
+	alarm_ACK_Node2 = NOT_RECEIVED;
+
+	process_start(&wait_alarm_ack_process, NULL);
 }
 
 /*######################################################################*/
@@ -317,14 +1444,32 @@ PROCESS_THREAD(input_reader_process, ev, data){
 
 	static struct etimer input_et;
 	static int count = 0;
+	struct node_state state;
 
 	PROCESS_EXITHANDLER(runicast_close(&runicast));
 	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
 
 	PROCESS_BEGIN();
 
-	runicast_open(&runicast, 144, &runicast_calls);
-	broadcast_open(&broadcast, 129, &broadcast_call);
+	core_radio_open(&runicast, &runicast_calls, &broadcast, &broadcast_call, print_log_record);
+	aggregate_init(AGGREGATE_ROOT, 0, NULL, report_house_temperature);
+
+	nettime_init_authority();
+
+	config_init(config_defaults, sizeof(config_defaults) / sizeof(config_defaults[0]), apply_config);
+
+	ota_init(OTA_TARGET_NONE);
+
+	confirm_init(send_string);
+
+	batch_init(send_string);
+
+	load_state();
+
+	serial_frame_send(SERIAL_FRAME_BOOT, linkaddr_node_addr.u8[0], NULL, 0);
+
+	fill_state(&state);
+	serial_frame_send(SERIAL_FRAME_STATE, linkaddr_node_addr.u8[0], &state, sizeof(state));
 
 	SENSORS_ACTIVATE(button_sensor);
 
@@ -336,6 +1481,8 @@ PROCESS_THREAD(input_reader_process, ev, data){
 
 		if(ev == sensors_event && data == &button_sensor){
 
+			TRACE_EVENT(TRACE_BUTTON);
+
 			if(count == 0)
 				etimer_set(&input_et, INPUT_INTERVAL*CLOCK_SECOND);
 			else	
@@ -346,11 +1493,11 @@ PROCESS_THREAD(input_reader_process, ev, data){
 		}else if(etimer_expired(&input_et) && count != 0){
 			/*count != 0 because conflict with alarm_et expiration! ??*/
 
-			if(alarm_status == ACTIVE && (count != 1 && count != 6)){
+			if(alarm_status == ACTIVE && (count != 1 && count != 6 && count != 8 && count != 9)){
 
 				printf("Command not allowed: ALARM IS ACTIVE!\n");
 
-			}else if(opening_status == ACTIVE && (count == 1 || count == 3)){
+			}else if(opening_status == ACTIVE && (count == 1 || count == 3 || count == 9)){
 
 				printf("Command not allowed: GATE and DOOR OPEN!\n");
 			
@@ -414,6 +1561,25 @@ PROCESS_THREAD(command_handler_process, ev, data){
 				handle_comfort_bedroom_command();
 				break;
 
+			case 7:
+				handle_get_log_command();
+				break;
+
+			case 8:
+				print_links();
+				radio_queue_print_stats("CU");
+				confirm_print_stats();
+				batch_print_stats();
+				break;
+
+			case 9:
+				handle_scene_command();
+				break;
+
+			case 10:
+				handle_get_all_command();
+				break;
+
 			default:
 				break;
 		}
@@ -433,7 +1599,7 @@ PROCESS_THREAD(wait_alarm_ack_process, ev, data){
 
 	PROCESS_BEGIN();
 
-	etimer_set(&alarm_ack_et, ALARM_ACK_INTERVAL*CLOCK_SECOND);
+	etimer_set(&alarm_ack_et, config_get(CONFIG_ALARM_ACK)*CLOCK_SECOND);
 	
 	PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&alarm_ack_et));
 
@@ -464,28 +1630,160 @@ PROCESS_THREAD(wait_alarm_ack_process, ev, data){
 PROCESS_THREAD(wait_opening_process, ev, data){
 
 	static struct etimer opening_et;
-	static int duration;
+	static struct etimer deadline_et;
 
 	PROCESS_BEGIN();
 
 	etimer_set(&opening_et, OPEN_CLOSE_INTERVAL*CLOCK_SECOND);
 
-	duration = OPEN_CLOSE_DURATION;
+	/*fallback if a completion gets lost*/
+	etimer_set(&deadline_et, OPEN_LEAD_TIME + (OPEN_CLOSE_DURATION + OPEN_DONE_MARGIN)*CLOCK_SECOND);
 
-	while(duration > 0){
+	while(gate_done == NOT_RECEIVED || door_done == NOT_RECEIVED){
 	
-		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&opening_et));
+		PROCESS_WAIT_EVENT();
 
-		leds_toggle(LEDS_BLUE);
+		if(etimer_expired(&deadline_et)){
 
-		etimer_reset(&opening_et);
+			if(gate_done == NOT_RECEIVED)
+				printf("GATE COMPLETION from Node2 [%d:0] not received!\n", NODE2_RIME_ADDR);
 
-		duration -= 2;
+			if(door_done == NOT_RECEIVED)
+				printf("DOOR COMPLETION from Node1 [%d:0] not received!\n", NODE1_RIME_ADDR);
+
+			break;
+		}
+
+		if(ev == PROCESS_EVENT_TIMER && data == &opening_et){
+
+			leds_toggle(LEDS_BLUE);
+
+			etimer_reset(&opening_et);
+		}
 	}
 
+	etimer_stop(&opening_et);
+	etimer_stop(&deadline_et);
+
+	leds_off(LEDS_BLUE);
+
 	opening_status = NOT_ACTIVE;
 
 	print_avail_commands();
 
 	PROCESS_END();
 }
+
+/*-----------------------------GET ALL PROCESS------------------------------*/
+
+PROCESS_THREAD(get_all_process, ev, data){
+
+	static struct etimer deadline_et;
+	char msg[GET_ALL_SIZE + 1];
+	int i;
+
+	PROCESS_BEGIN();
+
+	get_all_seq++;
+	get_all_replies = 0;
+
+	for(i=0; i<GET_ALL_NODES; i++)
+		get_all_latency[i] = 0;
+
+	/*one broadcast reaches every node in parallel*/
+	memcpy(msg, GET_ALL, GET_ALL_SIZE);
+	msg[GET_ALL_SIZE] = get_all_seq;
+
+	packetbuf_copyfrom(msg, sizeof(msg));
+	broadcast_send(&broadcast);
+	TRACE_PACKET(TRACE_TX_BROADCAST, NULL, 0);
+
+	get_all_start = clock_time();
+
+	etimer_set(&deadline_et, GET_ALL_DEADLINE*CLOCK_SECOND);
+
+	PROCESS_WAIT_EVENT_UNTIL(get_all_replies == GET_ALL_NODES || etimer_expired(&deadline_et));
+
+	etimer_stop(&deadline_et);
+
+	print_get_all(((unsigned long)(clock_time_t)(clock_time() - get_all_start) * 1000) / CLOCK_SECOND);
+
+	PROCESS_END();
+}
+
+/*-----------------------------CONSOLE PROCESS------------------------------*/
+
+PROCESS_THREAD(console_process, ev, data){
+
+	PROCESS_BEGIN();
+
+	while(1){
+
+		PROCESS_WAIT_EVENT_UNTIL(ev == serial_line_event_message && data != NULL);
+
+		TRACE_CONSOLE_LINE((const char *)data);
+
+		if(strncmp((const char *)data, "ota", 3) == 0)
+			handle_ota_command((const char *)data);
+		else
+			handle_config_command((const char *)data);
+	}
+
+	PROCESS_END();
+}
+
+#if BENCH_ENABLED
+/*------------------------------BENCHMARKS--------------------------------*/
+
+#define BENCH_FRAME_SIZE		16	/*tag & fields of the usual replies*/
+#define BENCH_UNMATCHED			"BENCH"
+
+static char bench_frame[BENCH_FRAME_SIZE];
+static linkaddr_t bench_from;
+
+/*A received frame in the packetbuf: tag & zeroed fields*/
+static void bench_packet(const char *tag, int rime_addr){
+
+	memset(bench_frame, 0, sizeof(bench_frame));
+	strcpy(bench_frame, tag);
+
+	packetbuf_copyfrom(bench_frame, sizeof(bench_frame));
+
+	bench_from.u8[0] = rime_addr;
+	bench_from.u8[1] = 0;
+}
+
+/*a stale confirmation: 5th tag of the dispatch*/
+static void bench_confirm(void){
+
+	bench_packet(CONFIRM, NODE2_RIME_ADDR);
+}
+
+/*an overview reply without query: 8th tag*/
+static void bench_all_reply(void){
+
+	bench_packet(ALL_REPLY, NODE1_RIME_ADDR);
+}
+
+/*worst case: every tag compared*/
+static void bench_unmatched(void){
+
+	bench_packet(BENCH_UNMATCHED, NODE4_RIME_ADDR);
+}
+
+static void bench_recv(void){
+
+	recv_runicast(&runicast, &bench_from, 0);
+}
+
+static const struct bench_case bench_cases[] = {
+
+	{"recv_runicast CONFIRM", bench_confirm, bench_recv, 16},
+	{"recv_runicast ALL", bench_all_reply, bench_recv, 16},
+	{"recv_runicast unmatched", bench_unmatched, bench_recv, 16},
+	{"print_avail_commands", NULL, print_avail_commands, 4}
+};
+
+BENCH_SUITE("CU", bench_cases);
+
+#endif /* BENCH_ENABLED */
@@ -9,9 +9,27 @@
 	BEHAVIOUR:
 		1) Activating/Deactivating Alarm: BLINKING ALLA LEDS
 		1.a) ACK Replay on the Activatin/Deactivating Alarm Request!
-		3) Open Door: wait 14s and BLINK BLUE LED every 2s until 16th s 
-		4) Continously sensing temperature every 10 sec &
-			Replying to Get Average Temperature Request!
+		3) Open Door: at the time scheduled by the CU TOGGLE the BLUE LED
+			for the scheduled duration & reporting the completion
+		4) Continously sensing temperature every 10 sec (5s-80s
+			adapting to the temperature variance, base period set
+			by the CU configuration) &
+			Replying to Get Temperature Request with mean, variance,
+			min, max of the last TEMP_STATS_WINDOW samples!
+			The SHT11 is powered only during each measurement.
+		4.a) Timestamping the samples with the network time synchronised
+			with the Central Unit!
+		4.b) Logging every temperature sample on the external flash &
+			Streaming a time range of the log to the Central Unit!
+	CONFIGURATION:
+		Sampling period & retransmissions cap set by the CU over the
+		air, applied live & persisted on flash (config.h)!
+	FIRMWARE UPDATE:
+		Fetching & relaying the images seeded by the CU page by page
+		(ota.h), rebooting into the ones of this firmware!
+	BOOT:
+		Restoring the alarm status from flash & resynchronising it
+		with the Central Unit state snapshot!
 ------------------------------------------------------------------------*/
 #include "contiki.h"
 #include "stdio.h"
@@ -22,43 +40,70 @@
 #include "net/rime/rime.h"
 #include "string.h"
 #include "stdlib.h"
-
+#include "sensor-power.h"
+#include "adaptive-sampling.h"
+#include "window-stats.h"
+#include "templog.h"
+#include "nettime.h"
+#include "node-state.h"
+#include "confirm.h"
+#include "link-quality.h"
+#include "radio-queue.h"
+#include "batch.h"
+#include "aggregate.h"
+#include "logbuf.h"
+#include "trace.h"
+#include "core.h"
+#include "config.h"
+#include "ota.h"
+#include "bench.h"
 //status values
-#define	ACTIVE 					1
-#define	NOT_ACTIVE				0
-#define ON						1
-#define OFF						0
 #define ALARM_BLINK_INTERVAL	2
 #define TEMPERATURE_INTERVAL	10
-#define OPEN_DOOR_INTERVAL		2
-#define OPEN_DOOR_DURATION		16
+#define TEMPERATURE_MIN_INTERVAL	5
+#define TEMPERATURE_MAX_INTERVAL	80
+#define TEMPERATURE_WAIT_STEP	300	/*s, etimer step: a 16-bit clock_time_t wraps above 511 s*/
+#define TEMP_STATS_WINDOW		12	/*samples summarized by GET_TEMP*/
+#define POWER_REPORT_SAMPLES	30	/*SHT11 on-time report every 30 samples*/
+#define LOG_STALL_TIMEOUT		30	/*giving up a stream without credits*/
 
 //communication values
-#define MAX_RETRANSMISSIONS		5
-#define ALARM_ON				"ALARM_ON"
-#define ALARM_ON_SIZE			9
-#define ALARM_OFF				"ALARM_OFF"
-#define ALARM_OFF_SIZE			10
-#define ALARM_ACK				"ALARM_ACK"
-#define ALARM_ACK_SIZE			10
-#define OPEN_GATE_DOOR			"OPEN"
-#define OPEN_GATE_DOOR_SIZE		5
-#define GET_TEMP				"GET_TEMP"
-#define GET_TEMP_SIZE			9
-#define UC_RIME_ADDR			3
-#define NODE2_RIME_ADDR			2
-#define NODE4_RIME_ADDR			4
+#define AGGREGATE_PARENT		UC_RIME_ADDR	/*aggregation tree*/
+#define AGGREGATE_DEPTH			1
+
+//log events (deferred, see print_log_record)
+#define LOG_ALARM_ON			0
+#define LOG_ALARM_OFF			1
 
 
 //status variables
 static int alarm_status = NOT_ACTIVE;
 static int garden_light_status = OFF;
-static int red_led = OFF;
-static int blue_led = OFF;
-static int green_led = OFF;
 
 static int *last_temp_values = NULL;; /*to compute the average*/
 
+static struct sensor_power sht11_power;
+static struct adaptive_sampler temp_sampler;
+static struct window_stats temp_stats;
+static uint32_t last_temp_time = 0;	/*network time of the newest sample*/
+static int temp_wait = 0;			/*seconds to the next sample after the running step*/
+
+static struct templog_request log_request;
+static long log_next, log_end;		/*log indexes still to stream*/
+static int log_credits = 0;
+static uint8_t log_frame[TEMP_LOG_SIZE + sizeof(struct templog_frame_header) +
+						TEMPLOG_FRAME_RECORDS*TEMPLOG_PACKED_SIZE];
+
+static struct node_state state = {NOT_ACTIVE, 0, NOT_ACTIVE, 0, 0, 0, 0, 0};	/*persisted on flash*/
+static const struct config_entry config_defaults[] = {{CONFIG_SAMPLE_PERIOD, 0, TEMPERATURE_INTERVAL},
+														{CONFIG_MAX_RETX, 0, LINK_QUALITY_MAX_RETX}};
+
+static clock_time_t door_delay;		/*from the open schedule reception*/
+static int door_duration;
+static struct ctimer get_all_timer;	/*reply slot to the GET_ALL broadcast*/
+static uint8_t get_all_seq;
+static int last_open_seq = -1;		/*to ignore the CU retries of a scheduled opening*/
+
 //communication variables
 static struct runicast_conn runicast;
 static struct broadcast_conn broadcast;
@@ -80,96 +125,302 @@ PROCESS(open_door_process, "Open Door Process");
 //tho handle temperature sensing
 PROCESS(temperature_sensing_process, "Temperature Sensing Process");
 
+//to stream the temperature log to the CU
+PROCESS(log_stream_process, "Log Stream Process");
 
-AUTOSTART_PROCESSES(&listening_process, &input_reader_process, &temperature_sensing_process);
+#if BENCH_ENABLED
+AUTOSTART_PROCESSES(&listening_process, &input_reader_process, &temperature_sensing_process, &state_synch_process, &time_synch_process, &bench_process);
+#else
+AUTOSTART_PROCESSES(&listening_process, &input_reader_process, &temperature_sensing_process, &state_synch_process, &time_synch_process);
+#endif
 
 /*---------------------------UTILITY FUNCTIONS--------------------------*/
 
-void send_string(char* msg, int size, int rime_addr){
+/*Formatting a deferred log record, called by the log process*/
+void print_log_record(const struct logbuf_record *record){
+
+	switch(record->event){
 
-		linkaddr_t addr;
-		packetbuf_copyfrom(msg, size);
-	    addr.u8[0] = rime_addr;
-	    addr.u8[1] = 0;
-	    runicast_send(&runicast, &addr, MAX_RETRANSMISSIONS);
+		case LOG_ALARM_ON:
+			printf("Node1: ACTIVATING ALARM...\n");
+			break;
+
+		case LOG_ALARM_OFF:
+			printf("Node1: DEACTIVATING ALARM...\n");
+			break;
+
+		case LOG_STATE_SYNCHED:
+			printf("Node1: STATE SYNCHED with CU in %lu ms\n", (unsigned long)record->args[0]);
+			break;
+
+		case LOG_TIME_SYNCHED:
+			printf("Node1: TIME SYNCHED (error %u ms)\n", (unsigned int)record->args[0]);
+			break;
+
+		case LOG_CONFIG_CHANGED:
+			config_print_local();
+			break;
+	}
 }
 
+/*Adaptive sampling from the configured period, the range widened to include it*/
+void init_temp_sampler(){
 
-void send_int(int msg, int rime_addr){
+	int period = config_get(CONFIG_SAMPLE_PERIOD);
 
-		linkaddr_t addr;
-		packetbuf_copyfrom(&msg, sizeof(int));
-	    addr.u8[0] = rime_addr;
-	    addr.u8[1] = 0;
-	    runicast_send(&runicast, &addr, MAX_RETRANSMISSIONS);
+	adaptive_sampling_init(&temp_sampler, period, (period < TEMPERATURE_MIN_INTERVAL) ? period : TEMPERATURE_MIN_INTERVAL,
+							(period > TEMPERATURE_MAX_INTERVAL) ? period : TEMPERATURE_MAX_INTERVAL, NULL, 0);
 }
 
-void save_led_status(){
+/*Waiting seconds (up to the configured period & beyond) in steps the etimer can hold*/
+void wait_next_sample(struct etimer *et, int seconds){
+
+	int step = (seconds > TEMPERATURE_WAIT_STEP) ? TEMPERATURE_WAIT_STEP : seconds;
 
-	green_led = (leds_get() & LEDS_GREEN) ? ON : OFF;
-	red_led = (leds_get() & LEDS_RED) ? ON : OFF;
-	blue_led = (leds_get() & LEDS_BLUE) ? ON : OFF;
+	temp_wait = seconds - step;
+
+	etimer_set(et, step*CLOCK_SECOND);
 }
 
-void restore_led_status(){
+/*Applying a configuration value (from the flash or the CU)*/
+void apply_config(uint8_t key, int16_t value){
+
+	if(key == CONFIG_SAMPLE_PERIOD)
+	/*restarting the sampling with the new period*/
+
+		process_poll(&temperature_sensing_process);
+
+	else if(key == CONFIG_MAX_RETX)
 
-	(green_led == ON)? leds_on(LEDS_GREEN) : leds_off(LEDS_GREEN);
-	(blue_led == ON)? leds_on(LEDS_BLUE) : leds_off(LEDS_BLUE);
-	(red_led == ON)? leds_on(LEDS_RED) : leds_off(LEDS_RED);
+		link_quality_set_max_retx(value);
 }
 
 /*---------------------------HANDLER FUNCTIONS--------------------------*/
 
-/*Saving LEDS status & start Alarm Blink Process*/
-void handle_alarm_request(const char* rcvd_msg){
+/*Saving/Restoring LEDS status & starting/stopping Alarm Blink Process*/
+void set_alarm_status(int status){
+
+	if(status == alarm_status)
+		return;
 
-	if(strcmp(rcvd_msg, ALARM_ON) == 0){
+	if(status == ACTIVE){
 
 		save_led_status();
 
 		alarm_status = ACTIVE;
-		printf("Node1: ACTIVATING ALARM...\n");
+		LOGBUF0(LOG_ALARM_ON);
 
 		leds_on(LEDS_ALL);
 
 		process_start(&alarm_blink_process, NULL);
 
-		send_string(ALARM_ACK, ALARM_ACK_SIZE, UC_RIME_ADDR);
-
-		return;
-
-	}else if(strcmp(rcvd_msg, ALARM_OFF) == 0){
+	}else{
 
 		alarm_status = NOT_ACTIVE;
-		printf("Node1: DEACTIVATING ALARM...\n");
+		LOGBUF0(LOG_ALARM_OFF);
 
 		process_exit(&alarm_blink_process);
 
-		send_string(ALARM_ACK, ALARM_ACK_SIZE, UC_RIME_ADDR);
-
 		restore_led_status(); 
+	}
+}
 
+/*Applying a state snapshot (from the CU or the flash)*/
+void apply_state(const struct node_state *snapshot, int persist){
+
+	state = *snapshot;
+
+	set_alarm_status(state.alarm);
+
+	if(persist)
+		node_state_save(&state);
+}
+
+/*Switching the Alarm & Confirming the resulting status to the CU*/
+void handle_alarm_request(const char* rcvd_msg){
+
+	int size = (strcmp(rcvd_msg, ALARM_ON) == 0) ? ALARM_ON_SIZE : ALARM_OFF_SIZE;
+
+	set_alarm_status((size == ALARM_ON_SIZE) ? ACTIVE : NOT_ACTIVE);
+
+	state.alarm = alarm_status;
+	node_state_save(&state);
+
+	send_confirm(ALARM_ACK, ALARM_ACK_SIZE, CONFIRM_ALARM, (uint8_t)rcvd_msg[size], alarm_status);
+}
+
+/*Applying the operations of a CU batch & Confirming the resulting state with one reply*/
+void handle_batch_request(const char* rcvd_msg){
+
+	struct batch_op ops[BATCH_MAX_OPS];
+	int count, i;
+	int seq = batch_parse(rcvd_msg, packetbuf_datalen(), ops, &count);
+
+	/*short or corrupt frame*/
+	if(seq < 0)
 		return;
+
+	for(i=0; i<count; i++)
+		if(ops[i].cmd == CONFIRM_ALARM)
+			set_alarm_status(ops[i].value ? ACTIVE : NOT_ACTIVE);
+
+	state.alarm = alarm_status;
+	node_state_save(&state);
+
+	send_batch_confirm(seq, (alarm_status == ACTIVE) ? NODE_STATE_ALARM : 0, ops, count);
+}
+
+/*Starting Open Door Process at the time scheduled by the CU*/
+void handle_door_opening_request(const char* rcvd_msg){
+
+	struct nettime_schedule schedule;
+	uint8_t seq = (uint8_t)rcvd_msg[OPEN_GATE_DOOR_SIZE];
+
+	if(seq != last_open_seq){
+
+		memcpy(&schedule, rcvd_msg + OPEN_GATE_DOOR_SIZE + 1, sizeof(schedule));
+
+		door_delay = nettime_delay(&schedule, DOOR_PHASE);
+		door_duration = schedule.duration[DOOR_PHASE];
+
+		process_exit(&open_door_process);
+		process_start(&open_door_process, NULL);
+
+		last_open_seq = seq;
 	}
+
+	send_confirm(CONFIRM, CONFIRM_SIZE, CONFIRM_OPEN, seq, ACTIVE);
 }
 
-/*Starting Open Door Process*/
-void handle_door_opening_request(){
+/*Reporting to the CU the end of the door phase*/
+void send_opening_done(){
 
-	process_start(&open_door_process, NULL);
+	char msg[OPEN_DONE_SIZE + sizeof(struct nettime_reading)];
+	struct nettime_reading done;
+
+	done.time = nettime_now();
+	done.error_ms = nettime_error_ms();
+	done.value = DOOR_PHASE;
+
+	memcpy(msg, OPEN_DONE, OPEN_DONE_SIZE);
+	memcpy(msg + OPEN_DONE_SIZE, &done, sizeof(done));
+
+	send_data(msg, sizeof(msg), UC_RIME_ADDR, RADIO_QUEUE_COMMAND);
+}
+
+/*Sending the window mean temperature as Node1 entry of the house overview*/
+void send_get_all_reply(void *ptr){
+
+	char msg[ALL_REPLY_SIZE + 1 + sizeof(struct nettime_reading)];
+	struct nettime_reading reading;
+	struct window_stats_summary summary;
+
+	(void)ptr;
+
+	window_stats_summary(&temp_stats, &summary);
+
+	reading.time = last_temp_time;
+	reading.error_ms = nettime_error_ms();
+	reading.value = summary.mean;			/*x100*/
+
+	memcpy(msg, ALL_REPLY, ALL_REPLY_SIZE);
+	msg[ALL_REPLY_SIZE] = get_all_seq;
+	memcpy(msg + ALL_REPLY_SIZE + 1, &reading, sizeof(reading));
+
+	send_data(msg, sizeof(msg), UC_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
+}
+
+/*Scheduling the reply to the GET_ALL broadcast in the slot of this node (no collisions at the CU)*/
+void handle_get_all_request(const char* rcvd_msg){
+
+	get_all_seq = rcvd_msg[GET_ALL_SIZE];
+
+	ctimer_set(&get_all_timer, linkaddr_node_addr.u8[0]*GET_ALL_JITTER, send_get_all_reply, NULL);
 }
 
-/*Sending the AVG TEMP VALUES to the Central Unit*/
+/*Sending the TEMP WINDOW STATISTICS (mean, variance, min, max, count) to the Central Unit*/
 void handle_temp_request(){
 
-	int i, avg_temp = 0;
+	struct window_stats_summary summary;
+
+	window_stats_summary(&temp_stats, &summary);
+
+	summary.time = last_temp_time;
+	summary.error_ms = nettime_error_ms();
+
+	send_data(&summary, sizeof(summary), UC_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
+}
+
+/*Starting a new Log Stream for the requested time range*/
+void handle_log_request(const char* rcvd_msg){
+
+	memcpy(&log_request, rcvd_msg + GET_LOG_SIZE, sizeof(log_request));
+
+	process_exit(&log_stream_process);
+	process_start(&log_stream_process, NULL);
+}
+
+/*Adding the credits granted by the Central Unit to the Log Stream*/
+void handle_log_credit(const char* rcvd_msg){
+
+	log_credits += (uint8_t)rcvd_msg[LOG_CREDIT_SIZE];
+
+	process_poll(&log_stream_process);
+}
+
+/*Packing the next log records in log_frame, returning the frame size*/
+int build_log_frame(uint8_t seq, int *last){
+
+	struct templog_frame_header header;
+	struct templog_record record;
+	uint8_t *packed = log_frame + TEMP_LOG_SIZE + sizeof(header);
+	uint32_t prev_time = 0;
+	unsigned long delta;
+
+	header.count = 0;
+	header.base_time = 0;
+
+	while(log_next < log_end && header.count < TEMPLOG_FRAME_RECORDS){
+
+		if(!templog_read(log_next, &record)){
+		/*skipping corrupted records*/
+
+			log_next++;
+			continue;
+		}
+
+		if(header.count == 0){
+
+			header.base_time = record.time;
+			prev_time = record.time;
+		}
+
+		delta = record.time - prev_time;
+
+		if(delta > 0xFFFF)
+		/*gap not representable: closing the frame*/
+			break;
 
-	for(i=0; i<5; i++)
-		avg_temp += last_temp_values[i];
+		packed[0] = delta & 0xFF;
+		packed[1] = delta >> 8;
+		packed[2] = (uint8_t)(int8_t)record.value;
+		packed += TEMPLOG_PACKED_SIZE;
 
-	avg_temp = avg_temp/5;
+		prev_time = record.time;
+		header.count++;
+		log_next++;
+	}
+
+	header.seq = seq;
+	header.flags = (log_next >= log_end) ? TEMPLOG_LAST_FRAME : 0;
+	header.pad = 0;
+
+	*last = header.flags & TEMPLOG_LAST_FRAME;
+
+	memcpy(log_frame, TEMP_LOG, TEMP_LOG_SIZE);
+	memcpy(log_frame + TEMP_LOG_SIZE, &header, sizeof(header));
 
-	send_int(avg_temp, UC_RIME_ADDR);
+	return TEMP_LOG_SIZE + sizeof(header) + header.count*TEMPLOG_PACKED_SIZE;
 }
 
 /*----------------------------------RIME--------------------------------*/
@@ -180,23 +431,86 @@ static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8
 
 	char* rcvd_msg = (char *)packetbuf_dataptr();
 
-	if(strcmp(rcvd_msg, GET_TEMP) == 0){
+	(void)c;
+
+	core_runicast_received(from, seqno);
+
+	if(strcmp(rcvd_msg, STATE_REPLY) == 0){
+	/*Receiving State Snapshot*/
+
+		handle_state_reply(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, TIME_REPLY) == 0){
+	/*Receiving Time Synch Reply*/
+
+		handle_time_reply(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, ALARM_ON) == 0 || strcmp(rcvd_msg, ALARM_OFF) == 0){
+	/*Receiving Activate/Deactivate Alarm Request retried by the CU*/
+
+		handle_alarm_request(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, BATCH) == 0){
+	/*Receiving Multi-Command Frame*/
+
+		handle_batch_request(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, OPEN_GATE_DOOR) == 0){
+	/*Receiving Open Gate e Door Request retried by the CU*/
+
+		handle_door_opening_request(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, AGGREGATE) == 0){
+	/*Receiving a Partial Temperature Aggregate from a child*/
+
+		aggregate_merge(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, GET_TEMP) == 0){
 	/*Receiving Temperature Average Request*/
 
 		handle_temp_request();
+
+	}else if(strcmp(rcvd_msg, GET_LOG) == 0){
+	/*Receiving Temperature Log Request*/
+
+		handle_log_request(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, LOG_CREDIT) == 0){
+	/*Receiving Log Stream Credits*/
+
+		handle_log_credit(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, CONFIG) == 0 || strcmp(rcvd_msg, GET_CONFIG) == 0){
+	/*Receiving Configuration Update or Read-back Request*/
+
+		config_handle_request(rcvd_msg, packetbuf_datalen());
+
+	}else if(strcmp(rcvd_msg, OTA_ACK) == 0){
+	/*Receiving the Acknowledgement of the Firmware Update Report*/
+
+		ota_report_acked(rcvd_msg);
 	}
 }
 
 
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t transmissions){
+
+	core_runicast_sent(c, to, transmissions);
 
-//printf("sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+	/*the runicast is free again: next log frame if nothing else is queued*/
+	process_poll(&log_stream_process);
+
+//printf("sent to %d.%d, transmissions %d\n", to->u8[0], to->u8[1], transmissions);
 }
 
 
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t transmissions){
+
+	core_runicast_timedout(c, to, transmissions);
 
-//printf("Timed out sending to %d.%d, retransmit %d\n",to->u8[0], to->u8[1], retransmissions);
+	process_poll(&log_stream_process);
+
+//printf("Timed out sending to %d.%d, transmissions %d\n",to->u8[0], to->u8[1], transmissions);
 }
 
 
@@ -209,6 +523,10 @@ static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
 
 	char* rcvd_msg = (char *)packetbuf_dataptr();
 
+	(void)c;
+
+	core_broadcast_received(from);
+
 	if(strcmp(rcvd_msg, ALARM_ON) == 0 || strcmp(rcvd_msg, ALARM_OFF) == 0)
 	/*Receiving Activate/Deaactivate Alarm Request*/	
 		
@@ -217,11 +535,16 @@ static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
 	else if(strcmp(rcvd_msg, OPEN_GATE_DOOR) == 0)
 	/*Receiving Open Gate e Door Request*/
 
-		handle_door_opening_request();
+		handle_door_opening_request(rcvd_msg);
+
+	else if(strcmp(rcvd_msg, GET_ALL) == 0)
+	/*Receiving House Overview Query*/
+
+		handle_get_all_request(rcvd_msg);
 }
 
 
-static const struct broadcast_callbacks broadcast_call = {broadcast_recv}; 
+static const struct broadcast_callbacks broadcast_call = {broadcast_recv, NULL}; 
 
 
 /*######################################################################*/
@@ -234,8 +557,13 @@ PROCESS_THREAD(listening_process, ev, data){
 
 	PROCESS_BEGIN();
 
-	runicast_open(&runicast, 144, &runicast_calls);
-	broadcast_open(&broadcast, 129, &broadcast_call);
+	core_radio_open(&runicast, &runicast_calls, &broadcast, &broadcast_call, print_log_record);
+	core_synch_init("Node1", &state, apply_state, NULL);
+	aggregate_init(AGGREGATE_PARENT, AGGREGATE_DEPTH, send_string, NULL);
+
+	config_init(config_defaults, sizeof(config_defaults) / sizeof(config_defaults[0]), apply_config);
+
+	ota_init(OTA_TARGET_NODE1);
 
 	while(1){
 	
@@ -259,33 +587,18 @@ PROCESS_THREAD(input_reader_process, ev, data){
 
 		PROCESS_WAIT_EVENT_UNTIL(ev == sensors_event && data == &button_sensor);
 
+		TRACE_EVENT(TRACE_BUTTON);
+
 		if(garden_light_status == OFF){
 
 			printf("Node1: TURNING ON GARDEN LIGHTS\n");
-			if(alarm_status == NOT_ACTIVE){
-			/*Switch the leds*/
-				leds_off(LEDS_RED);
-				leds_on(LEDS_GREEN);
-			}
-			else if(alarm_status == ACTIVE){
-			/*Saving the leds status to restore when deactivating the alarm*/
-				green_led = ON;
-				red_led = OFF;
-			}
+			/*on the saved leds while the alarm blinks*/
+			switch_leds(LEDS_GREEN, LEDS_RED);
 		
 		}else{
 
 			printf("Node1: TURNING OFF GARDEN LIGHTS\n");
-			if(alarm_status == NOT_ACTIVE){
-			/*Switch the leds*/
-				leds_on(LEDS_RED);
-				leds_off(LEDS_GREEN);
-			}
-			else if(alarm_status == ACTIVE){
-			/*Saving the leds status to restore when deactivating the alarm*/
-				green_led = OFF;
-				red_led = ON;
-			}
+			switch_leds(LEDS_RED, LEDS_GREEN);
 		}
 
 		garden_light_status = (garden_light_status == OFF) ? ON : OFF;
@@ -321,28 +634,28 @@ PROCESS_THREAD(alarm_blink_process, ev, data){
 PROCESS_THREAD(open_door_process, ev, data){
 
 	static struct etimer open_door_et;
-	static int duration;
 
 	PROCESS_BEGIN();
 
-	etimer_set(&open_door_et, OPEN_DOOR_INTERVAL*CLOCK_SECOND);
+	if(door_delay > 0){
+	/*waiting the scheduled start*/
 
-	duration = OPEN_DOOR_DURATION;
+		etimer_set(&open_door_et, door_delay);
 
-	while(duration > 0){
-	
 		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&open_door_et));
+	}
 
-		if(duration <= 4){
+	printf("Node1: DOOR OPENING...\n");
+	leds_toggle(LEDS_BLUE);
 
-			printf("Node1: DOOR %s\n", (duration == 4) ? "OPENING..." : "CLOSED!");
-			leds_toggle(LEDS_BLUE);
-		}
+	etimer_set(&open_door_et, door_duration*CLOCK_SECOND);
 
-		etimer_reset(&open_door_et);
+	PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&open_door_et));
 
-		duration -= 2;
-	}
+	printf("Node1: DOOR CLOSED!\n");
+	leds_toggle(LEDS_BLUE);
+
+	send_opening_done();
 
 	PROCESS_END();
 }
@@ -353,17 +666,44 @@ PROCESS_THREAD(open_door_process, ev, data){
 PROCESS_THREAD(temperature_sensing_process, ev, data){
 
 	static struct etimer temp_et;
-	int i;
+	static int samples = 0;
+	int i, temperature;
 
 	PROCESS_BEGIN();
 
-	SENSORS_ACTIVATE(sht11_sensor);
+	/*the SHT11 is powered only for each measurement*/
+	sensor_power_init(&sht11_power, &sht11_sensor);
+
+	window_stats_init(&temp_stats, TEMP_STATS_WINDOW);
+
+	templog_init();
+
+	/*no thresholds on Node1: the period follows only the variance*/
+	init_temp_sampler();
 
-	etimer_set(&temp_et, TEMPERATURE_INTERVAL*CLOCK_SECOND);
+	wait_next_sample(&temp_et, temp_sampler.period);
 
 	while(1){
 
-		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&temp_et));
+		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&temp_et) || ev == PROCESS_EVENT_POLL);
+
+		if(ev == PROCESS_EVENT_POLL){
+		/*sampling period configured by the CU*/
+
+			init_temp_sampler();
+			wait_next_sample(&temp_et, temp_sampler.period);
+			continue;
+		}
+
+		if(temp_wait > 0){
+
+			wait_next_sample(&temp_et, temp_wait);
+			continue;
+		}
+
+		temperature = sht11_to_celsius(TRACE_SENSOR(TRACE_SENSOR_TEMP, sensor_power_read(&sht11_power, SHT11_SENSOR_TEMP)));
+
+		aggregate_add(temperature);
 
 		if(last_temp_values == NULL){
 			/*initializing last 5 temperature values*/
@@ -371,20 +711,28 @@ PROCESS_THREAD(temperature_sensing_process, ev, data){
 			last_temp_values = malloc(5*sizeof(int));
 
 			for(i=0; i<5; i++)
-				last_temp_values[i] = (((sht11_sensor.value(SHT11_SENSOR_TEMP)/10) - 396)/10);
+				last_temp_values[i] = temperature;
 		}
-		else{
+		else
 			/*udating last 5 temperature values*/
+			shift_last_temps(last_temp_values, temperature);
 
-			for(i=0; i<4; i++)
-				last_temp_values[i] = last_temp_values[i+1];
+		window_stats_add(&temp_stats, temperature);
 
-			last_temp_values[4] = (((sht11_sensor.value(SHT11_SENSOR_TEMP)/10) - 396)/10);
-		}
+		last_temp_time = nettime_now();
+
+		if(!templog_append(temperature))
+			printf("Node1: TEMPERATURE LOG WRITE FAILED\n");
 	
 //printf("AVG TEMP: %d\n", (last_temp_values[0]+last_temp_values[1]+last_temp_values[2]+last_temp_values[3]+last_temp_values[4])/5);
 
-		etimer_reset(&temp_et);
+		if(++samples == POWER_REPORT_SAMPLES){
+
+			sensor_power_report(&sht11_power, "Node1: SHT11");
+			samples = 0;
+		}
+
+		wait_next_sample(&temp_et, adaptive_sampling_next(&temp_sampler, last_temp_values, 5));
 	}
 
 	free(last_temp_values);
@@ -392,4 +740,135 @@ PROCESS_THREAD(temperature_sensing_process, ev, data){
 	last_temp_values = NULL;
 
 	PROCESS_END();
-}
\ No newline at end of file
+}
+
+/*-------------------------LOG STREAM PROCESS---------------------------*/
+
+PROCESS_THREAD(log_stream_process, ev, data){
+
+	static struct etimer stall_et;
+	static uint8_t seq;
+	static int last;
+	int size;
+
+	PROCESS_BEGIN();
+
+	log_end = templog_upper_bound(log_request.to);
+	log_next = templog_lower_bound(log_request.from);
+
+	if(log_end - log_next > log_request.max_records)
+		log_next = log_end - log_request.max_records;
+
+	log_credits = log_request.window;
+	seq = 0;
+	last = 0;
+
+	while(!last){
+
+		etimer_set(&stall_et, LOG_STALL_TIMEOUT*CLOCK_SECOND);
+
+		/*flow control: CU credits & radio idle (queued messages of any class go first)*/
+		PROCESS_WAIT_EVENT_UNTIL((log_credits > 0 && radio_queue_idle()) ||
+									etimer_expired(&stall_et));
+
+		if(log_credits <= 0 || !radio_queue_idle()){
+
+			printf("Node1: LOG STREAM STALLED at frame %u\n", seq);
+			break;
+		}
+
+		size = build_log_frame(seq, &last);
+
+		send_data(log_frame, size, UC_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
+
+		log_credits--;
+		seq++;
+	}
+
+	etimer_stop(&stall_et);
+
+	PROCESS_END();
+}
+
+#if BENCH_ENABLED
+/*------------------------------BENCHMARKS--------------------------------*/
+
+#define BENCH_RAW_TEMPS			8
+#define BENCH_UNMATCHED			"BENCH"
+#define BENCH_FRAME_SIZE		16
+
+/*SHT11 raw readings from 16 to 23 Celsius degrees*/
+static const int bench_raw_temps[BENCH_RAW_TEMPS] = {5560, 5660, 5760, 5860, 5960, 6060, 6160, 6260};
+static int bench_next = 0;
+static int bench_raw;
+static volatile int bench_result;		/*the results are kept, not optimised out*/
+static int bench_temps[5] = {19, 19, 19, 19, 19};
+static char bench_frame[BENCH_FRAME_SIZE];
+static linkaddr_t bench_from = {{3, 0}};
+
+/*own window & sampler: the firmware ones are left untouched*/
+static struct window_stats bench_stats;
+static struct adaptive_sampler bench_sampler;
+
+static void bench_next_raw(void){
+
+	if(bench_next == 0){
+
+		window_stats_init(&bench_stats, TEMP_STATS_WINDOW);
+		adaptive_sampling_init(&bench_sampler, TEMPERATURE_INTERVAL, TEMPERATURE_MIN_INTERVAL,
+								TEMPERATURE_MAX_INTERVAL, NULL, 0);
+	}
+
+	bench_raw = bench_raw_temps[bench_next++ % BENCH_RAW_TEMPS];
+}
+
+static void bench_unmatched(void){
+
+	memset(bench_frame, 0, sizeof(bench_frame));
+	strcpy(bench_frame, BENCH_UNMATCHED);
+
+	packetbuf_copyfrom(bench_frame, sizeof(bench_frame));
+}
+
+static void bench_sht11_read(void){
+
+	bench_result = sensor_power_read(&sht11_power, SHT11_SENSOR_TEMP);
+}
+
+static void bench_sht11_to_celsius(void){
+
+	bench_result = sht11_to_celsius(bench_raw);
+}
+
+static void bench_shift_last_temps(void){
+
+	shift_last_temps(bench_temps, sht11_to_celsius(bench_raw));
+}
+
+/*the temperature process of a sample without sensor & flash*/
+static void bench_sample(void){
+
+	int temperature = sht11_to_celsius(bench_raw);
+
+	shift_last_temps(bench_temps, temperature);
+	window_stats_add(&bench_stats, temperature);
+	adaptive_sampling_next(&bench_sampler, bench_temps, 5);
+}
+
+static void bench_recv(void){
+
+	recv_runicast(&runicast, &bench_from, 0);
+}
+
+static const struct bench_case bench_cases[] = {
+
+	{"sht11 read", NULL, bench_sht11_read, 4},
+	{"sht11_to_celsius", bench_next_raw, bench_sht11_to_celsius, 64},
+	{"shift_last_temps", bench_next_raw, bench_shift_last_temps, 64},
+	{"temperature sample", bench_next_raw, bench_sample, 64},
+	{"recv_runicast unmatched", bench_unmatched, bench_recv, 16}
+};
+
+BENCH_SUITE("Node1", bench_cases);
+
+#endif /* BENCH_ENABLED */
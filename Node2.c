@@ -9,8 +9,19 @@
 		1) Activating/Deactivating Alarm: BLINKING ALLA LEDS / STOP BLINKING
 		1.a) ACK Replay on the Activatin/Deactivating Alarm Request!
 		2) Locking/Unlocking Gate: TURN ON RED/GREEN & TURN OFF GREEN/RED LEDS
-		3) Opening Gate: BLINKING BLUE LED every 2s for 16s
-		5) Replying to Get External Light Request!
+		3) Opening Gate: BLINKING BLUE LED every 2s for the duration and
+			at the time scheduled by the CU & reporting the completion
+		5) Replying to Get External Light Request with the network
+			time of the reading!
+	CONFIGURATION:
+		Retransmissions cap set by the CU over the air, applied live
+		& persisted on flash (config.h)!
+	FIRMWARE UPDATE:
+		Fetching & relaying the images seeded by the CU page by page
+		(ota.h), rebooting into the ones of this firmware!
+	BOOT:
+		Restoring the alarm & gate status from flash & resynchronising it
+		with the Central Unit state snapshot!
 ------------------------------------------------------------------------*/
 #include "contiki.h"
 #include "stdio.h"
@@ -20,47 +31,41 @@
 #include "sys/etimer.h"
 #include "net/rime/rime.h"
 #include "string.h"
-
+#include "nettime.h"
+#include "node-state.h"
+#include "confirm.h"
+#include "link-quality.h"
+#include "radio-queue.h"
+#include "batch.h"
+#include "logbuf.h"
+#include "trace.h"
+#include "core.h"
+#include "config.h"
+#include "ota.h"
 
 //status values
-#define	ACTIVE 					1
-#define	NOT_ACTIVE				0
-#define ON						1
-#define OFF						0
-#define LOCKED					1
-#define UNLOCKED				0
-
 #define ALARM_BLINK_INTERVAL	2
 #define OPEN_GATE_INTERVAL		2
-#define OPEN_GATE_DURATION		16
-
-//communication values
-#define MAX_RETRANSMISSIONS		5
-#define ALARM_ON				"ALARM_ON"
-#define ALARM_ON_SIZE			9
-#define ALARM_OFF				"ALARM_OFF"
-#define ALARM_OFF_SIZE			10
-#define ALARM_ACK				"ALARM_ACK"
-#define ALARM_ACK_SIZE			10
-#define LOCK_GATE				"LOCK"
-#define LOCK_GATE_SIZE			5
-#define UNLOCK_GATE				"UNLOCK"
-#define UNLOCK_GATE_SIZE		7
-#define OPEN_GATE_DOOR			"OPEN"
-#define OPEN_GATE_DOOR_SIZE		5
-#define GET_LIGHT				"GET_LIGHT"
-#define GET_LIGHT_SIZE			10
-#define UC_RIME_ADDR			3
-#define NODE1_RIME_ADDR			1
-#define NODE4_RIME_ADDR			4
+
+//log events (deferred, see print_log_record)
+#define LOG_ALARM_ON			0
+#define LOG_ALARM_OFF			1
+#define LOG_GATE_LOCKED			2
+#define LOG_GATE_UNLOCKED		3
 
 
 //status variables
 static int alarm_status = NOT_ACTIVE;
 static int gate_status = LOCKED;
-static int red_led = OFF;
-static int blue_led = OFF;
-static int green_led = OFF;
+
+static struct node_state state = {NOT_ACTIVE, LOCKED, NOT_ACTIVE, 0, 0, 0, 0, 0};	/*persisted on flash*/
+static const struct config_entry config_defaults[] = {{CONFIG_MAX_RETX, 0, LINK_QUALITY_MAX_RETX}};
+
+static clock_time_t gate_delay;		/*from the open schedule reception*/
+static int gate_duration;
+static struct ctimer get_all_timer;	/*reply slot to the GET_ALL broadcast*/
+static uint8_t get_all_seq;
+static int last_open_seq = -1;		/*to ignore the CU retries of a scheduled opening*/
 
 //communication variables
 static struct runicast_conn runicast;
@@ -76,102 +81,253 @@ PROCESS(alarm_blink_process, "Alarm Blink Process");
 
 //to handle Open Gate and Door Request
 PROCESS(open_gate_process, "Open Gate Process");
-
-AUTOSTART_PROCESSES(&listening_process);
+AUTOSTART_PROCESSES(&listening_process, &state_synch_process, &time_synch_process);
 
 /*---------------------------UTILITY FUNCTIONS--------------------------*/
 
-void send_string(char* msg, int size, int rime_addr){
+/*Formatting a deferred log record, called by the log process*/
+void print_log_record(const struct logbuf_record *record){
+
+	switch(record->event){
+
+		case LOG_ALARM_ON:
+			printf("Node2: ACTIVATING ALARM...\n");
+			break;
+
+		case LOG_ALARM_OFF:
+			printf("Node2: DEACTIVATING ALARM...\n");
+			break;
+
+		case LOG_GATE_LOCKED:
+			printf("Node2: LOCKING GATE...\n");
+			break;
+
+		case LOG_GATE_UNLOCKED:
+			printf("Node2: UNLOCKING GATE...\n");
+			break;
+
+		case LOG_STATE_SYNCHED:
+			printf("Node2: STATE SYNCHED with CU in %lu ms\n", (unsigned long)record->args[0]);
+			break;
+
+		case LOG_TIME_SYNCHED:
+			printf("Node2: TIME SYNCHED (error %u ms)\n", (unsigned int)record->args[0]);
+			break;
 
-		linkaddr_t addr;
-		packetbuf_copyfrom(msg, size);
-	    addr.u8[0] = rime_addr;
-	    addr.u8[1] = 0;
-	    runicast_send(&runicast, &addr, MAX_RETRANSMISSIONS);
+		case LOG_CONFIG_CHANGED:
+			config_print_local();
+			break;
+	}
 }
 
-void send_int(int msg, int rime_addr){
+/*Applying a configuration value (from the flash or the CU)*/
+void apply_config(uint8_t key, int16_t value){
 
-		linkaddr_t addr;
-		packetbuf_copyfrom(&msg, sizeof(int));
-	    addr.u8[0] = rime_addr;
-	    addr.u8[1] = 0;
-	    runicast_send(&runicast, &addr, MAX_RETRANSMISSIONS);
+	if(key == CONFIG_MAX_RETX)
+		link_quality_set_max_retx(value);
 }
+
 /*---------------------------HANDLER FUNCTIONS--------------------------*/
 
-/*Saving LEDS status & start Alarm Blink Process*/
-void handle_alarm_request(const char* rcvd_msg){
+/*Saving/Restoring LEDS status & starting/stopping Alarm Blink Process*/
+void set_alarm_status(int status){
 
-	if(strcmp(rcvd_msg, ALARM_ON) == 0){
+	if(status == alarm_status)
+		return;
 
-		green_led = (leds_get() & LEDS_GREEN) ? ON : OFF;
-		red_led = (leds_get() & LEDS_RED) ? ON : OFF;
-		blue_led = (leds_get() & LEDS_BLUE) ? ON : OFF;
+	if(status == ACTIVE){
+
+		save_led_status();
 
 		alarm_status = ACTIVE;
-		printf("Node2: ACTIVATING ALARM...\n");
+		LOGBUF0(LOG_ALARM_ON);
 		
 		leds_on(LEDS_ALL);
 
 		process_start(&alarm_blink_process, NULL);
 
-		send_string(ALARM_ACK, ALARM_ACK_SIZE, UC_RIME_ADDR);
-	    
-		return;
-
-	}else if(strcmp(rcvd_msg, ALARM_OFF) == 0){
+	}else{
 
 		alarm_status = NOT_ACTIVE;
-		printf("Node2: DEACTIVATING ALARM...\n");
+		LOGBUF0(LOG_ALARM_OFF);
 
 		process_exit(&alarm_blink_process);
 
-		send_string(ALARM_ACK, ALARM_ACK_SIZE, UC_RIME_ADDR);
+		restore_led_status();
+	}
+}
+
+/*Switching the Alarm & Confirming the resulting status to the CU*/
+void handle_alarm_request(const char* rcvd_msg){
+
+	int size = (strcmp(rcvd_msg, ALARM_ON) == 0) ? ALARM_ON_SIZE : ALARM_OFF_SIZE;
+
+	set_alarm_status((size == ALARM_ON_SIZE) ? ACTIVE : NOT_ACTIVE);
+
+	state.alarm = alarm_status;
+	node_state_save(&state);
 
-		(green_led == ON)? leds_on(LEDS_GREEN) : leds_off(LEDS_GREEN);
-		(blue_led == ON)? leds_on(LEDS_BLUE) : leds_off(LEDS_BLUE);
-		(red_led == ON)? leds_on(LEDS_RED) : leds_off(LEDS_RED);
+	send_confirm(ALARM_ACK, ALARM_ACK_SIZE, CONFIRM_ALARM, (uint8_t)rcvd_msg[size], alarm_status);
+}
+
+/*Handling LEDS for GATE LOCK/UNLOCK (saved LEDS while the alarm blinks)*/
+void set_gate_status(int status){
+
+	if(status == LOCKED){
+
+		LOGBUF0(LOG_GATE_LOCKED);
+
+		switch_leds(LEDS_RED, LEDS_GREEN);
+
+	}else{
+
+		LOGBUF0(LOG_GATE_UNLOCKED);
+
+		switch_leds(LEDS_GREEN, LEDS_RED);
+	}
+
+	gate_status = status;
+}
+
+/*Applying a state snapshot (from the CU or the flash)*/
+void apply_state(const struct node_state *snapshot, int persist){
+
+	state = *snapshot;
+
+	if(state.gate != gate_status)
+		set_gate_status(state.gate);
+
+	set_alarm_status(state.alarm);
 
+	if(persist)
+		node_state_save(&state);
+}
+
+/*Applying the operations of a CU batch & Confirming the resulting state with one reply*/
+void handle_batch_request(const char* rcvd_msg){
+
+	struct batch_op ops[BATCH_MAX_OPS];
+	int count, i;
+	int seq = batch_parse(rcvd_msg, packetbuf_datalen(), ops, &count);
+
+	/*short or corrupt frame*/
+	if(seq < 0)
 		return;
+
+	for(i=0; i<count; i++){
+
+		if(ops[i].cmd == CONFIRM_ALARM)
+			set_alarm_status(ops[i].value ? ACTIVE : NOT_ACTIVE);
+		else if(ops[i].cmd == CONFIRM_GATE)
+			set_gate_status(ops[i].value ? LOCKED : UNLOCKED);
 	}
+
+	state.alarm = alarm_status;
+	state.gate = gate_status;
+	node_state_save(&state);
+
+	send_batch_confirm(seq, ((alarm_status == ACTIVE) ? NODE_STATE_ALARM : 0) | ((gate_status == LOCKED) ? NODE_STATE_GATE : 0),
+		ops, count);
 }
 
-/*Notify Listening Process to HANDLE LEDS for GATE LOCK/UNLOCK*/
+/*Locking/Unlocking the Gate & Confirming the resulting status to the CU*/
 void handle_gate_lock_request(const char* rcvd_msg, const linkaddr_t *from){
 
-	if(strcmp(rcvd_msg, LOCK_GATE) == 0){
+	int size = (strcmp(rcvd_msg, LOCK_GATE) == 0) ? LOCK_GATE_SIZE : UNLOCK_GATE_SIZE;
 
-			leds_on(LEDS_RED);
-			leds_off(LEDS_GREEN);
-			printf("Node2: LOCKING GATE...\n");
-			gate_status = LOCKED;
+	(void)from;
 
-	}else if(strcmp(rcvd_msg, UNLOCK_GATE) == 0){
+	set_gate_status((size == LOCK_GATE_SIZE) ? LOCKED : UNLOCKED);
 
-			leds_on(LEDS_GREEN);
-			leds_off(LEDS_RED);
-			printf("Node2: UNLOCKING GATE...\n");
-			gate_status = UNLOCKED;
+	state.gate = gate_status;
+	node_state_save(&state);
+
+	send_confirm(CONFIRM, CONFIRM_SIZE, CONFIRM_GATE, (uint8_t)rcvd_msg[size], gate_status);
+}
+
+/*Starting Open Gate Process at the time scheduled by the CU*/
+void handle_gate_opening_request(const char* rcvd_msg){
+
+	struct nettime_schedule schedule;
+	uint8_t seq = (uint8_t)rcvd_msg[OPEN_GATE_DOOR_SIZE];
+
+	if(seq != last_open_seq){
+
+		memcpy(&schedule, rcvd_msg + OPEN_GATE_DOOR_SIZE + 1, sizeof(schedule));
+
+		gate_delay = nettime_delay(&schedule, GATE_PHASE);
+		gate_duration = schedule.duration[GATE_PHASE];
+
+		process_exit(&open_gate_process);
+		process_start(&open_gate_process, NULL);
+
+		last_open_seq = seq;
 	}
+
+	send_confirm(CONFIRM, CONFIRM_SIZE, CONFIRM_OPEN, seq, ACTIVE);
 }
 
-/*Starting Open Gate Process*/
-void handle_gate_opening_request(){
+/*Reporting to the CU the end of the gate phase*/
+void send_opening_done(){
+
+	char msg[OPEN_DONE_SIZE + sizeof(struct nettime_reading)];
+	struct nettime_reading done;
+
+	done.time = nettime_now();
+	done.error_ms = nettime_error_ms();
+	done.value = GATE_PHASE;
 
-	process_start(&open_gate_process, NULL);
+	memcpy(msg, OPEN_DONE, OPEN_DONE_SIZE);
+	memcpy(msg + OPEN_DONE_SIZE, &done, sizeof(done));
+
+	send_data(msg, sizeof(msg), UC_RIME_ADDR, RADIO_QUEUE_COMMAND);
 }
 
-/*Starting Light Sensing Process to sense and reply the ext. light value*/
+/*Sensing and replying the ext. light value with its network timestamp*/
 void handle_light_request(){
 
+	struct nettime_reading reading;
+
 	SENSORS_ACTIVATE(light_sensor);
 
-	int light = (10*light_sensor.value(LIGHT_SENSOR_PHOTOSYNTHETIC))/7;
+	reading.value = (10*TRACE_SENSOR(TRACE_SENSOR_LIGHT, light_sensor.value(LIGHT_SENSOR_PHOTOSYNTHETIC)))/7;
+	reading.time = nettime_now();
+	reading.error_ms = nettime_error_ms();
+
+	SENSORS_DEACTIVATE(light_sensor);
+
+	send_data(&reading, sizeof(reading), UC_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
+}
+
+/*Sending the external light as Node2 entry of the house overview*/
+void send_get_all_reply(void *ptr){
 
-	send_int(light, UC_RIME_ADDR);
+	char msg[ALL_REPLY_SIZE + 1 + sizeof(struct nettime_reading)];
+	struct nettime_reading reading;
+
+	(void)ptr;
+
+	SENSORS_ACTIVATE(light_sensor);
+
+	reading.value = (10*TRACE_SENSOR(TRACE_SENSOR_LIGHT, light_sensor.value(LIGHT_SENSOR_PHOTOSYNTHETIC)))/7;
+	reading.time = nettime_now();
+	reading.error_ms = nettime_error_ms();
 
 	SENSORS_DEACTIVATE(light_sensor);
+
+	memcpy(msg, ALL_REPLY, ALL_REPLY_SIZE);
+	msg[ALL_REPLY_SIZE] = get_all_seq;
+	memcpy(msg + ALL_REPLY_SIZE + 1, &reading, sizeof(reading));
+
+	send_data(msg, sizeof(msg), UC_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
+}
+
+/*Scheduling the reply to the GET_ALL broadcast in the slot of this node (no collisions at the CU)*/
+void handle_get_all_request(const char* rcvd_msg){
+
+	get_all_seq = rcvd_msg[GET_ALL_SIZE];
+
+	ctimer_set(&get_all_timer, linkaddr_node_addr.u8[0]*GET_ALL_JITTER, send_get_all_reply, NULL);
 }
 
 /*----------------------------------RIME--------------------------------*/
@@ -182,7 +338,36 @@ static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8
 
 	char* rcvd_msg = (char *)packetbuf_dataptr();
 
-	if((strcmp(rcvd_msg, UNLOCK_GATE) == 0) || (strcmp(rcvd_msg, LOCK_GATE) == 0)){
+	(void)c;
+
+	core_runicast_received(from, seqno);
+
+	if(strcmp(rcvd_msg, STATE_REPLY) == 0){
+	/*Receiving State Snapshot*/
+
+		handle_state_reply(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, TIME_REPLY) == 0){
+	/*Receiving Time Synch Reply*/
+
+		handle_time_reply(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, ALARM_ON) == 0 || strcmp(rcvd_msg, ALARM_OFF) == 0){
+	/*Receiving Activate/Deactivate Alarm Request retried by the CU*/
+
+		handle_alarm_request(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, BATCH) == 0){
+	/*Receiving Multi-Command Frame*/
+
+		handle_batch_request(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, OPEN_GATE_DOOR) == 0){
+	/*Receiving Open Gate e Door Request retried by the CU*/
+
+		handle_gate_opening_request(rcvd_msg);
+
+	}else if((strcmp(rcvd_msg, UNLOCK_GATE) == 0) || (strcmp(rcvd_msg, LOCK_GATE) == 0)){
 	/*Receiving Lock/Unlock Gate Request*/
 		
 		handle_gate_lock_request(rcvd_msg, from);
@@ -191,23 +376,21 @@ static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8
 	/*Receiving Temperature Average Request*/
 
 		handle_light_request();
-	}
-}
 
+	}else if(strcmp(rcvd_msg, CONFIG) == 0 || strcmp(rcvd_msg, GET_CONFIG) == 0){
+	/*Receiving Configuration Update or Read-back Request*/
 
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
-
-//printf("sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
-
+		config_handle_request(rcvd_msg, packetbuf_datalen());
 
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+	}else if(strcmp(rcvd_msg, OTA_ACK) == 0){
+	/*Receiving the Acknowledgement of the Firmware Update Report*/
 
-//printf("timed out sending to %d.%d, retransmit %d\n",to->u8[0], to->u8[1], retransmissions);
+		ota_report_acked(rcvd_msg);
+	}
 }
 
 
-static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
+static const struct runicast_callbacks runicast_calls = {recv_runicast, core_runicast_sent, core_runicast_timedout};
 
 
 //BROADCAST
@@ -216,6 +399,10 @@ static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
 
 	char* rcvd_msg = (char *)packetbuf_dataptr();
 
+	(void)c;
+
+	core_broadcast_received(from);
+
 	if(strcmp(rcvd_msg, ALARM_ON) == 0 || strcmp(rcvd_msg, ALARM_OFF) == 0)
 	/*Receiving Activate/Deaactivate Alarm Request*/	
 
@@ -224,11 +411,16 @@ static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
 	else if(strcmp(rcvd_msg, OPEN_GATE_DOOR) == 0)
 	/*Receiving Open Gate e Door Request*/
 
-		handle_gate_opening_request();
+		handle_gate_opening_request(rcvd_msg);
+
+	else if(strcmp(rcvd_msg, GET_ALL) == 0)
+	/*Receiving House Overview Query*/
+
+		handle_get_all_request(rcvd_msg);
 }
 
 
-static const struct broadcast_callbacks broadcast_call = {broadcast_recv};
+static const struct broadcast_callbacks broadcast_call = {broadcast_recv, NULL};
 
 
 /*######################################################################*/
@@ -241,8 +433,12 @@ PROCESS_THREAD(listening_process, ev, data){
 
 	PROCESS_BEGIN();
 
-	runicast_open(&runicast, 144, &runicast_calls);
-	broadcast_open(&broadcast, 129, &broadcast_call);
+	core_radio_open(&runicast, &runicast_calls, &broadcast, &broadcast_call, print_log_record);
+	core_synch_init("Node2", &state, apply_state, NULL);
+
+	config_init(config_defaults, sizeof(config_defaults) / sizeof(config_defaults[0]), apply_config);
+
+	ota_init(OTA_TARGET_NODE2);
 
 	/*Initializing the LOCK GATE LEDS STATUS*/
 	(gate_status == LOCKED) ? leds_on(LEDS_RED) : leds_on(LEDS_GREEN);
@@ -286,11 +482,19 @@ PROCESS_THREAD(open_gate_process, ev, data){
 
 	PROCESS_BEGIN();
 
+	if(gate_delay > 0){
+	/*waiting the scheduled start*/
+
+		etimer_set(&open_gate_et, gate_delay);
+
+		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&open_gate_et));
+	}
+
 	etimer_set(&open_gate_et, OPEN_GATE_INTERVAL*CLOCK_SECOND);
 
 	printf("Node2: GATE OPENING ...\n");
 
-	duration = OPEN_GATE_DURATION;
+	duration = gate_duration;
 
 	while(duration > 0){
 	
@@ -300,11 +504,12 @@ PROCESS_THREAD(open_gate_process, ev, data){
 
 		etimer_reset(&open_gate_et);
 
-		duration -= 2;
+		duration -= OPEN_GATE_INTERVAL;
 	}
 
 	printf("Node2: GATE CLOSED!\n");
 
+	send_opening_done();
+
 	PROCESS_END();
 }
-
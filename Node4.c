@@ -8,10 +8,27 @@
 		1) ACTIVATE/DEACTIVATE COMFORT BEDROOM.
 	BEHAVIOUR:
 		1) When Active the GREEN LED is ON.  (RED LED OFF)
-			Temperature is SENSED every 300 sec and CHEKED:
+			Temperature is SENSED every 60 sec (20s-300s adapting
+			to the variance and to the thresholds, base period set
+			by the CU configuration) and fed to the comfort
+			controller (comfort-control.h), hysteresis band around
+			the 19° optimum or PI, never switching the AC before a
+			minimum on/off time:
 				if < 15°: Air-Conditionating is Started: BLUE LED BLINKS
 				if > 23°: Air-Conditionating is Stopped: BLUE LED OFF
+			Every switch of the AC (& held one) is logged.
 			When Not Active the RED LED is ON. (GREEN LED OFF)
+	CONFIGURATION:
+		Sampling period, retransmissions cap & comfort control (mode,
+		band, minimum cycle) set by the CU over the air, applied live
+		& persisted on flash (config.h); the thresholds come with the
+		CU state snapshot!
+	FIRMWARE UPDATE:
+		Fetching & relaying the images seeded by the CU page by page
+		(ota.h), rebooting into the ones of this firmware!
+	BOOT:
+		Restoring the comfort status & thresholds from flash & resynchronising it
+		with the Central Unit state snapshot!
 ------------------------------------------------------------------------*/
 #include "contiki.h"
 #include "stdio.h"
@@ -22,36 +39,75 @@
 #include "net/rime/rime.h"
 #include "string.h"
 #include "stdlib.h"
-
+#include "sensor-power.h"
+#include "adaptive-sampling.h"
+#include "nettime.h"
+#include "node-state.h"
+#include "confirm.h"
+#include "link-quality.h"
+#include "radio-queue.h"
+#include "batch.h"
+#include "aggregate.h"
+#include "logbuf.h"
+#include "trace.h"
+#include "core.h"
+#include "config.h"
+#include "ota.h"
+#include "comfort-control.h"
+#include "bench.h"
 //status values
-#define	ACTIVE 					1
-#define	NOT_ACTIVE				0
 #define TEMPERATURE_INTERVAL	60	/*set to 300 for 5 minutes!*/
+#define TEMPERATURE_MIN_INTERVAL	20	/*even: counted down in blink steps*/
+#define TEMPERATURE_MAX_INTERVAL	300
 #define COMFORT_BLINK_INTERVAL	2
 #define TEMPERATURE_OPTIMAL		19
 #define TEMPERATURE_MIN			15
 #define TEMPERATURE_MAX			23
+#define THRESHOLD_MIN			0	/*comfort_thresholds indexes*/
+#define THRESHOLD_OPTIMAL		1
+#define THRESHOLD_MAX			2
+#define COMFORT_CONTROL_MODE	COMFORT_PI	/*the only one settling with less error than the legacy logic (host/sim/comfort)*/
+#define COMFORT_CONTROL_BAND	15	/*1/10 °C, hysteresis & fast sampling edges*/
+#define COMFORT_MIN_CYCLE		180	/*s, minimum on & off time of the AC*/
+#define SAMPLING_THRESHOLDS		4	/*min, band edges, max*/
 
 //communication values
-#define MAX_RETRANSMISSIONS		5
-#define START_COMFORT_BED		"COMFORT"
-#define START_COMFORT_BED_SIZE	8
-#define STOP_COMFORT_BED		"NO_COMFORT"
-#define STOP_COMFORT_BED_SIZE	11
-#define RECEIVED				1
-#define NOT_RECEIVED			0	
-#define UC_RIME_ADDR			3
-#define NODE1_RIME_ADDR			1
-#define NODE2_RIME_ADDR			2
+#define AGGREGATE_PARENT		1	/*Node1, aggregation tree*/
+#define AGGREGATE_DEPTH			2
+
+//log events (deferred, see print_log_record)
+#define LOG_COMFORT_ON			0
+#define LOG_COMFORT_OFF			1
+#define LOG_AC_ON				4	/*decision, 1/100 °C, duty*/
+#define LOG_AC_OFF				5
+#define LOG_AC_HELD				6	/*s in the state, 1/100 °C, duty*/
 
 //status variables
 static int comfort_status = NOT_ACTIVE;
-static int air_conditioner_status = NOT_ACTIVE;
-
-static int *last_temp_values = NULL;; /*to decide if start/stop*/
+static struct comfort_control comfort;		/*air conditioner status*/
+
+static int *last_temp_values = NULL;; /*sampling history*/
+
+static struct sensor_power sht11_power;
+static struct adaptive_sampler temp_sampler;
+static int comfort_thresholds[] = {TEMPERATURE_MIN, TEMPERATURE_OPTIMAL, TEMPERATURE_MAX};
+static int sampling_thresholds[SAMPLING_THRESHOLDS];	/*where the controller switches, set_sampling_thresholds*/
+
+static struct node_state state = {NOT_ACTIVE, 0, NOT_ACTIVE, 0,		/*persisted on flash*/
+									TEMPERATURE_MIN, TEMPERATURE_OPTIMAL, TEMPERATURE_MAX, 0};
+static int state_local_change = 0;	/*comfort switched by the button, not by the CU*/
+static const struct config_entry config_defaults[] = {{CONFIG_SAMPLE_PERIOD, 0, TEMPERATURE_INTERVAL},
+														{CONFIG_MAX_RETX, 0, LINK_QUALITY_MAX_RETX},
+														{CONFIG_CONTROL, 0, COMFORT_CONTROL_MODE},
+														{CONFIG_BAND, 0, COMFORT_CONTROL_BAND},
+														{CONFIG_MIN_CYCLE, 0, COMFORT_MIN_CYCLE}};
+static const char *comfort_decisions[] = {"", "below min", "above max", "band", "duty"};
+static struct ctimer get_all_timer;	/*reply slot to the GET_ALL broadcast*/
+static uint8_t get_all_seq;
 
 //communication variables
 static struct runicast_conn runicast;
+static struct broadcast_conn broadcast;
 
 /*----------------------------------------------------------------------*/
 
@@ -64,29 +120,127 @@ PROCESS(input_reader_process, "User-Input Reader Process");
 //to handle the comfort bedroom command/request
 PROCESS(comfort_bedroom_process, "Comfort Bedroom Temperature Process");
 
-
-AUTOSTART_PROCESSES(&listening_process, &input_reader_process);
+#if BENCH_ENABLED
+AUTOSTART_PROCESSES(&listening_process, &input_reader_process, &state_synch_process, &time_synch_process, &bench_process);
+#else
+AUTOSTART_PROCESSES(&listening_process, &input_reader_process, &state_synch_process, &time_synch_process);
+#endif
 
 /*---------------------------UTILITY FUNCTIONS--------------------------*/
 
-void send_string(char* msg, int size, int rime_addr){
+/*SHT11 raw temperature to 1/100 Celsius degrees*/
+int sht11_to_centi(int raw){
+
+	return raw - 3960;
+}
+
+/*1/100 Celsius degrees as x.yy*/
+void print_centi(int32_t centi){
+
+	printf("%s%ld.%02ld", (centi < 0) ? "-" : "", labs(centi) / 100, labs(centi) % 100);
+}
+
+/*Formatting a deferred log record, called by the log process*/
+void print_log_record(const struct logbuf_record *record){
+
+	switch(record->event){
+
+		case LOG_COMFORT_ON:
+			printf("Node4: COMFORT ACTIVATED\n");
+			break;
+
+		case LOG_COMFORT_OFF:
+			printf("Node4: COMFORT DEACTIVATED\n");
+			break;
+
+		case LOG_STATE_SYNCHED:
+			printf("Node4: STATE SYNCHED with CU in %lu ms\n", (unsigned long)record->args[0]);
+			break;
+
+		case LOG_TIME_SYNCHED:
+			printf("Node4: TIME SYNCHED (error %u ms)\n", (unsigned int)record->args[0]);
+			break;
+
+		case LOG_CONFIG_CHANGED:
+			config_print_local();
+			break;
+
+		case LOG_AC_ON:
+		case LOG_AC_OFF:
+			printf("Node4: AIR CONDITIONER %s (%s) at ", (record->event == LOG_AC_ON) ? "ON" : "OFF",
+				comfort_decisions[record->args[0]]);
+			print_centi(record->args[1]);
+			printf(" C, duty %ld\n", (long)record->args[2]);
+			break;
+
+		case LOG_AC_HELD:
+			printf("Node4: AIR CONDITIONER switch HELD (%lu s in state) at ", (unsigned long)record->args[0]);
+			print_centi(record->args[1]);
+			printf(" C, duty %ld\n", (long)record->args[2]);
+			break;
+	}
+}
+
+/*Adaptive sampling from the configured period (even: blink steps), the range widened to include it*/
+void init_temp_sampler(){
 
-		linkaddr_t addr;
-		packetbuf_copyfrom(msg, size);
-	    addr.u8[0] = rime_addr;
-	    addr.u8[1] = 0;
-	    runicast_send(&runicast, &addr, MAX_RETRANSMISSIONS);
+	int period = config_get(CONFIG_SAMPLE_PERIOD);
+
+	period += period % 2;
+
+	adaptive_sampling_init(&temp_sampler, period, (period < TEMPERATURE_MIN_INTERVAL) ? period : TEMPERATURE_MIN_INTERVAL,
+							(period > TEMPERATURE_MAX_INTERVAL) ? period : TEMPERATURE_MAX_INTERVAL, sampling_thresholds, SAMPLING_THRESHOLDS);
+}
+
+/*Sampling fast near the switching points: the min & max thresholds and the band edges (whole °C)*/
+void set_sampling_thresholds(){
+
+	int band = (config_get(CONFIG_BAND) + 5) / 10;
+
+	sampling_thresholds[0] = comfort_thresholds[THRESHOLD_MIN];
+	sampling_thresholds[1] = comfort_thresholds[THRESHOLD_OPTIMAL] - band;
+	sampling_thresholds[2] = comfort_thresholds[THRESHOLD_OPTIMAL] + band;
+	sampling_thresholds[3] = comfort_thresholds[THRESHOLD_MAX];
+}
+
+/*Comfort controller mode, band & minimum cycle from the configuration*/
+void configure_comfort_control(){
+
+	comfort_control_configure(&comfort, config_get(CONFIG_CONTROL), config_get(CONFIG_BAND)*10,
+								config_get(CONFIG_MIN_CYCLE));
+
+	set_sampling_thresholds();
 }
 
+/*Applying a configuration value (from the flash or the CU)*/
+void apply_config(uint8_t key, int16_t value){
+
+	if(key == CONFIG_SAMPLE_PERIOD)
+	/*restarting the sampling with the new period if comfort is active*/
+
+		process_poll(&comfort_bedroom_process);
+
+	else if(key == CONFIG_MAX_RETX)
+
+		link_quality_set_max_retx(value);
+
+	else if(key == CONFIG_CONTROL || key == CONFIG_BAND || key == CONFIG_MIN_CYCLE)
+
+		configure_comfort_control();
+}
 
 /*---------------------------HANDLER FUNCTIONS--------------------------*/
 
-void handle_comfort_request(const char* rcvd_msg){
+/*Switching the LEDS & starting/stopping the Comfort Bedroom Process*/
+void set_comfort_status(int status){
 
-	if(strcmp(rcvd_msg, START_COMFORT_BED) == 0){
+	if(status == comfort_status)
+		return;
+
+	if(status == ACTIVE){
 
 		comfort_status = ACTIVE;
-		printf("Node4: COMFORT ACTIVATED\n");
+		LOGBUF0(LOG_COMFORT_ON);
 
 		leds_off(LEDS_RED);
 		leds_on(LEDS_GREEN);
@@ -96,7 +250,7 @@ void handle_comfort_request(const char* rcvd_msg){
 	}else{
 
 		comfort_status = NOT_ACTIVE;
-		printf("Node4: COMFORT DEACTIVATED\n");
+		LOGBUF0(LOG_COMFORT_OFF);
 
 		leds_on(LEDS_RED);
 		leds_off(LEDS_GREEN);
@@ -106,6 +260,86 @@ void handle_comfort_request(const char* rcvd_msg){
 	}
 }
 
+/*Applying a state snapshot (from the CU or the flash)*/
+void apply_state(const struct node_state *snapshot, int persist){
+
+	state = *snapshot;
+	state_local_change = 0;
+
+	comfort_thresholds[THRESHOLD_MIN] = state.temp_min;
+	comfort_thresholds[THRESHOLD_OPTIMAL] = state.temp_optimal;
+	comfort_thresholds[THRESHOLD_MAX] = state.temp_max;
+	set_sampling_thresholds();
+
+	set_comfort_status(state.comfort);
+
+	if(persist)
+		node_state_save(&state);
+}
+
+/*Switching the Comfort Bedroom & Confirming the resulting status to the CU*/
+void handle_comfort_request(const char* rcvd_msg){
+
+	int size = (strcmp(rcvd_msg, START_COMFORT_BED) == 0) ? START_COMFORT_BED_SIZE : STOP_COMFORT_BED_SIZE;
+
+	set_comfort_status((size == START_COMFORT_BED_SIZE) ? ACTIVE : NOT_ACTIVE);
+
+	state.comfort = comfort_status;
+	state_local_change = 0;
+	node_state_save(&state);
+
+	send_confirm(CONFIRM, CONFIRM_SIZE, CONFIRM_COMFORT, (uint8_t)rcvd_msg[size], comfort_status);
+}
+
+/*Applying the operations of a CU batch & Confirming the resulting state with one reply*/
+void handle_batch_request(const char* rcvd_msg){
+
+	struct batch_op ops[BATCH_MAX_OPS];
+	int count, i;
+	int seq = batch_parse(rcvd_msg, packetbuf_datalen(), ops, &count);
+
+	/*short or corrupt frame*/
+	if(seq < 0)
+		return;
+
+	for(i=0; i<count; i++)
+		if(ops[i].cmd == CONFIRM_COMFORT)
+			set_comfort_status(ops[i].value ? ACTIVE : NOT_ACTIVE);
+
+	state.comfort = comfort_status;
+	state_local_change = 0;
+	node_state_save(&state);
+
+	send_batch_confirm(seq, (comfort_status == ACTIVE) ? NODE_STATE_COMFORT : 0, ops, count);
+}
+
+/*Sending a fresh bedroom temperature as Node4 entry of the house overview*/
+void send_get_all_reply(void *ptr){
+
+	char msg[ALL_REPLY_SIZE + 1 + sizeof(struct nettime_reading)];
+	struct nettime_reading reading;
+
+	(void)ptr;
+
+	reading.value = (((TRACE_SENSOR(TRACE_SENSOR_TEMP, sensor_power_read(&sht11_power, SHT11_SENSOR_TEMP))/10) - 396)/10);
+	reading.time = nettime_now();
+	reading.error_ms = nettime_error_ms();
+
+	memcpy(msg, ALL_REPLY, ALL_REPLY_SIZE);
+	msg[ALL_REPLY_SIZE] = get_all_seq;
+	memcpy(msg + ALL_REPLY_SIZE + 1, &reading, sizeof(reading));
+
+	send_string(msg, sizeof(msg), UC_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
+}
+
+/*Scheduling the reply to the GET_ALL broadcast in the slot of this node (no collisions at the CU)*/
+void handle_get_all_request(const char* rcvd_msg){
+
+	get_all_seq = rcvd_msg[GET_ALL_SIZE];
+
+	ctimer_set(&get_all_timer, linkaddr_node_addr.u8[0]*GET_ALL_JITTER, send_get_all_reply, NULL);
+}
+
 /*----------------------------------RIME--------------------------------*/
 
 //RUNICAST
@@ -114,27 +348,69 @@ static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8
 
 	char* rcvd_msg = (char *)packetbuf_dataptr();
 
-	if(strcmp(rcvd_msg, START_COMFORT_BED) == 0 || strcmp(rcvd_msg, STOP_COMFORT_BED) == 0){
+	(void)c;
+
+	core_runicast_received(from, seqno);
+
+	if(strcmp(rcvd_msg, STATE_REPLY) == 0){
+	/*Receiving State Snapshot*/
+
+		handle_state_reply(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, TIME_REPLY) == 0){
+	/*Receiving Time Synch Reply*/
+
+		handle_time_reply(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, BATCH) == 0){
+	/*Receiving Multi-Command Frame*/
+
+		handle_batch_request(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, AGGREGATE) == 0){
+	/*Receiving a Partial Temperature Aggregate from a child*/
+
+		aggregate_merge(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, START_COMFORT_BED) == 0 || strcmp(rcvd_msg, STOP_COMFORT_BED) == 0){
 	/*Receiving Activate/Deactivate Comfort Bedroom*/
 
 		handle_comfort_request(rcvd_msg);
+
+	}else if(strcmp(rcvd_msg, CONFIG) == 0 || strcmp(rcvd_msg, GET_CONFIG) == 0){
+	/*Receiving Configuration Update or Read-back Request*/
+
+		config_handle_request(rcvd_msg, packetbuf_datalen());
+
+	}else if(strcmp(rcvd_msg, OTA_ACK) == 0){
+	/*Receiving the Acknowledgement of the Firmware Update Report*/
+
+		ota_report_acked(rcvd_msg);
 	}
 }
 
 
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+static const struct runicast_callbacks runicast_calls = {recv_runicast, core_runicast_sent, core_runicast_timedout};
 
-//printf("sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
 
+//BROADCAST
+
+static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
+
+	char* rcvd_msg = (char *)packetbuf_dataptr();
 
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+	(void)c;
 
-//printf("Timed out sending to %d.%d, retransmit %d\n",to->u8[0], to->u8[1], retransmissions);
+	core_broadcast_received(from);
+
+	if(strcmp(rcvd_msg, GET_ALL) == 0)
+	/*Receiving House Overview Query*/
+
+		handle_get_all_request(rcvd_msg);
 }
 
 
-static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
+static const struct broadcast_callbacks broadcast_call = {broadcast_recv, NULL};
 
 
 /*######################################################################*/
@@ -143,10 +419,23 @@ static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_run
 PROCESS_THREAD(listening_process, ev, data){
 
 	PROCESS_EXITHANDLER(runicast_close(&runicast));
+	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
 
 	PROCESS_BEGIN();
 
-	runicast_open(&runicast, 144, &runicast_calls);
+	core_radio_open(&runicast, &runicast_calls, &broadcast, &broadcast_call, print_log_record);
+	core_synch_init("Node4", &state, apply_state, &state_local_change);
+	aggregate_init(AGGREGATE_PARENT, AGGREGATE_DEPTH, send_string, NULL);
+
+	/*once: the controller keeps the AC on/off time across comfort restarts*/
+	comfort_control_init(&comfort, comfort_thresholds, comfort_thresholds[THRESHOLD_OPTIMAL]*100);
+
+	/*applying every key, the comfort ones by configure_comfort_control*/
+	config_init(config_defaults, sizeof(config_defaults) / sizeof(config_defaults[0]), apply_config);
+
+	ota_init(OTA_TARGET_NODE4);
+
+	sensor_power_init(&sht11_power, &sht11_sensor);
 
 	while(1){
 	
@@ -170,31 +459,24 @@ PROCESS_THREAD(input_reader_process, ev, data){
 		
 		PROCESS_WAIT_EVENT_UNTIL(ev == sensors_event && data == &button_sensor);
 
-		if(comfort_status == NOT_ACTIVE){
-
-			printf("Node4: COMFORT ACTIVATED\n");
+		TRACE_EVENT(TRACE_BUTTON);
 
-			leds_off(LEDS_RED);
-			leds_on(LEDS_GREEN);
+		if(comfort_status == NOT_ACTIVE){
 
-			send_string(START_COMFORT_BED, START_COMFORT_BED_SIZE, UC_RIME_ADDR);
+			set_comfort_status(ACTIVE);
 
-			process_start(&comfort_bedroom_process, NULL);
+			send_string(START_COMFORT_BED, START_COMFORT_BED_SIZE, UC_RIME_ADDR, RADIO_QUEUE_COMMAND);
 		
 		}else{
 
-			printf("Node4: COMFORT DEACTIVATED\n");
-
-			leds_on(LEDS_RED);
-			leds_off(LEDS_GREEN);
-
+			set_comfort_status(NOT_ACTIVE);
 
-			send_string(STOP_COMFORT_BED, STOP_COMFORT_BED_SIZE, UC_RIME_ADDR);
-
-			process_exit(&comfort_bedroom_process);
+			send_string(STOP_COMFORT_BED, STOP_COMFORT_BED_SIZE, UC_RIME_ADDR, RADIO_QUEUE_COMMAND);
 		}
 
-		comfort_status = (comfort_status == NOT_ACTIVE) ? ACTIVE : NOT_ACTIVE;
+		state.comfort = comfort_status;
+		state_local_change = 1;
+		node_state_save(&state);
 	}
 
 	PROCESS_END();
@@ -206,31 +488,49 @@ PROCESS_THREAD(comfort_bedroom_process, ev, data){
 
 	static struct etimer comfort_et;
 	static int temperature_interval;
-	int i;
-	int temperature, avg_temperature;
+	int i, raw, decision;
+	int temperature;
+
+	/*comfort stopped: the AC is switched off*/
+	PROCESS_EXITHANDLER(comfort_control_off(&comfort));
 
 	PROCESS_BEGIN();
 
 	etimer_set(&comfort_et, COMFORT_BLINK_INTERVAL*CLOCK_SECOND);
 
 	temperature_interval = 0;
-	avg_temperature = 0;
+
+	init_temp_sampler();
+
+	/*no measurement of a previous run in the filter*/
+	comfort_control_reset_filter(&comfort);
 
 	while(1){
 
-		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&comfort_et));
+		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&comfort_et) || ev == PROCESS_EVENT_POLL);
+
+		if(ev == PROCESS_EVENT_POLL){
+		/*sampling period configured by the CU: next measurement after it*/
+
+			init_temp_sampler();
+			temperature_interval = temp_sampler.period;
+			continue;
+		}
 
 		if(temperature_interval <= 2){
 
-			temperature_interval = TEMPERATURE_INTERVAL;
+			raw = TRACE_SENSOR(TRACE_SENSOR_TEMP, sensor_power_read(&sht11_power, SHT11_SENSOR_TEMP));
+			temperature = sht11_to_celsius(raw);
 
-			SENSORS_ACTIVATE(sht11_sensor);
+			comfort_control_measure(&comfort, sht11_to_centi(raw));
 
-			temperature = (((sht11_sensor.value(SHT11_SENSOR_TEMP)/10) - 396)/10);
+			aggregate_add(temperature);
 
-			SENSORS_DEACTIVATE(sht11_sensor);
+			printf("Node4: Temperature %d Time: ", temperature);
+			nettime_print(nettime_now());
+			printf("\n");
 
-			printf("Node4: Temperature %d\n", temperature);
+			sensor_power_report(&sht11_power, "Node4: SHT11");
 
 			if(last_temp_values == NULL){
 				/*initializing last 5 temperature values*/
@@ -239,38 +539,28 @@ PROCESS_THREAD(comfort_bedroom_process, ev, data){
 
 				for(i=0; i<5; i++)
 					last_temp_values[i] = temperature;
-
-				avg_temperature = temperature;
 			}
-			else{
-				/*udating last 5 temperature values & computing the averate temp*/
-
-				avg_temperature = 0;
+			else
+				/*udating last 5 temperature values*/
+				shift_last_temps(last_temp_values, temperature);
 
-				for(i=0; i<4; i++){
-
-					avg_temperature += last_temp_values[i];
-					last_temp_values[i] = last_temp_values[i+1];
-				}
+			/*sensing faster when changing fast or close to the thresholds*/
+			temperature_interval = adaptive_sampling_next(&temp_sampler, last_temp_values, 5);
+		}
 
-				avg_temperature += last_temp_values[4];
-				avg_temperature = avg_temperature/5;
+		/*updating the air conditioner status on the last measurement*/
+		decision = comfort_control_step(&comfort, COMFORT_BLINK_INTERVAL);
 
-				last_temp_values[4] = temperature;
-			}
+		if(decision == COMFORT_HELD)
 
-			/*updating the air conditione status*/
-			if(temperature <= TEMPERATURE_MIN || avg_temperature < TEMPERATURE_OPTIMAL)
+			LOGBUF3(LOG_AC_HELD, comfort.elapsed, comfort.temp, comfort.duty);
 
-				air_conditioner_status = ACTIVE;
+		else if(decision != COMFORT_NONE)
 
-			else if(temperature >= TEMPERATURE_MAX || avg_temperature > TEMPERATURE_OPTIMAL)
-
-				air_conditioner_status = NOT_ACTIVE;
-		}
+			LOGBUF3(comfort.on ? LOG_AC_ON : LOG_AC_OFF, decision, comfort.temp, comfort.duty);
 
 		/*blink if ari conditioner is active*/
-		if(air_conditioner_status == ACTIVE)
+		if(comfort.on)
 
 			leds_toggle(LEDS_BLUE);
 		else
@@ -282,4 +572,67 @@ PROCESS_THREAD(comfort_bedroom_process, ev, data){
 	}
 
 	PROCESS_END();
-}
\ No newline at end of file
+}
+
+#if BENCH_ENABLED
+/*------------------------------BENCHMARKS--------------------------------*/
+
+#define BENCH_RAW_TEMPS			8
+
+/*SHT11 raw readings from 16 to 23 Celsius degrees*/
+static const int bench_raw_temps[BENCH_RAW_TEMPS] = {5560, 5660, 5760, 5860, 5960, 6060, 6160, 6260};
+static int bench_next = 0;
+static int bench_raw;
+static volatile int bench_result;		/*the results are kept, not optimised out*/
+static int bench_temps[5] = {19, 19, 19, 19, 19};
+
+static void bench_next_raw(void){
+
+	bench_raw = bench_raw_temps[bench_next++ % BENCH_RAW_TEMPS];
+}
+
+static void bench_sht11_read(void){
+
+	bench_result = sensor_power_read(&sht11_power, SHT11_SENSOR_TEMP);
+}
+
+static void bench_sht11_to_celsius(void){
+
+	bench_result = sht11_to_celsius(bench_raw);
+}
+
+static void bench_shift_last_temps(void){
+
+	bench_result = shift_last_temps(bench_temps, sht11_to_celsius(bench_raw));
+}
+
+static struct comfort_control bench_comfort;
+
+static void bench_comfort_measure(void){
+
+	if(bench_comfort.thresholds == NULL){
+
+		comfort_control_init(&bench_comfort, comfort_thresholds, comfort_thresholds[THRESHOLD_OPTIMAL]*100);
+		comfort_control_configure(&bench_comfort, COMFORT_PI, COMFORT_CONTROL_BAND*10, COMFORT_MIN_CYCLE);
+	}
+
+	bench_next_raw();
+	comfort_control_measure(&bench_comfort, sht11_to_centi(bench_raw));
+}
+
+static void bench_comfort_step(void){
+
+	bench_result = comfort_control_step(&bench_comfort, COMFORT_BLINK_INTERVAL);
+}
+
+static const struct bench_case bench_cases[] = {
+
+	{"sht11 read", NULL, bench_sht11_read, 4},
+	{"sht11_to_celsius", bench_next_raw, bench_sht11_to_celsius, 64},
+	{"shift_last_temps", bench_next_raw, bench_shift_last_temps, 64},
+	{"comfort_control_step PI", bench_comfort_measure, bench_comfort_step, 64}
+};
+
+BENCH_SUITE("Node4", bench_cases);
+
+#endif /* BENCH_ENABLED */
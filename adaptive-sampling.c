@@ -0,0 +1,103 @@
+/*--------------------------Adaptive Sampling-----------------------------
+	Sampling period driven by the temperature history (see
+	adaptive-sampling.h).
+------------------------------------------------------------------------*/
+#include "adaptive-sampling.h"
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+/*count^2 * variance of the values, computed in integer arithmetic*/
+static long window_variance(const int *values, int count){
+
+	long sum = 0, sum_sq = 0;
+	int i;
+
+	for(i=0; i<count; i++){
+
+		sum += values[i];
+		sum_sq += (long)values[i] * values[i];
+	}
+
+	return count*sum_sq - sum*sum;
+}
+
+static int near_threshold(struct adaptive_sampler *as, int value){
+
+	int i, distance;
+
+	for(i=0; i<as->thresholds_num; i++){
+
+		distance = value - as->thresholds[i];
+
+		if(distance <= ADAPTIVE_THRESHOLD_MARGIN && distance >= -ADAPTIVE_THRESHOLD_MARGIN)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+void adaptive_sampling_init(struct adaptive_sampler *as, int period, int min_period, int max_period,
+							const int *thresholds, int thresholds_num){
+
+	as->period = period;
+	as->min_period = min_period;
+	as->max_period = max_period;
+	as->thresholds = thresholds;
+	as->thresholds_num = thresholds_num;
+	as->samples = 0;
+}
+
+
+int adaptive_sampling_next(struct adaptive_sampler *as, const int *values, int count){
+
+	long variance = window_variance(values, count);
+
+	as->samples++;
+
+	if(near_threshold(as, values[count-1]))
+	/*close to a decision point: reacting as fast as possible*/
+
+		as->period = as->min_period;
+
+	else if(variance > (long)ADAPTIVE_FAST_VARIANCE * count * count)
+	/*readings changing fast*/
+
+		as->period /= 2;
+
+	else if(variance == 0)
+	/*readings flat*/
+
+		as->period *= 2;
+
+	if(as->period < as->min_period)
+		as->period = as->min_period;
+
+	if(as->period > as->max_period)
+		as->period = as->max_period;
+
+	return as->period;
+}
+
+
+int sht11_to_celsius(int raw){
+
+	return ((raw/10) - 396)/10;
+}
+
+
+int shift_last_temps(int *values, int temperature){
+
+	int i, avg = 0;
+
+	for(i=0; i<ADAPTIVE_HISTORY-1; i++){
+
+		avg += values[i];
+		values[i] = values[i+1];
+	}
+
+	avg += values[ADAPTIVE_HISTORY-1];
+	values[ADAPTIVE_HISTORY-1] = temperature;
+
+	return avg/ADAPTIVE_HISTORY;
+}
@@ -0,0 +1,48 @@
+/*--------------------------Adaptive Sampling-----------------------------
+	Sampling period driven by the temperature history.
+
+	After each measurement the period is:
+		- set to the minimum when the last value is close to one of
+		  the thresholds (e.g. where the Node4 comfort control
+		  switches: the min & max and the edges of its band, not the
+		  optimum the room sits at);
+		- halved when the variance of the history window is high;
+		- doubled (up to the maximum) when the history is flat;
+		- kept unchanged otherwise.
+
+	The history is the last ADAPTIVE_HISTORY temperatures (°C) of the
+	SHT11, kept by Node1 & Node4 with the helpers below.
+------------------------------------------------------------------------*/
+#ifndef ADAPTIVE_SAMPLING_H_
+#define ADAPTIVE_SAMPLING_H_
+
+/*variance (in °C^2) above which the period is halved*/
+#define ADAPTIVE_FAST_VARIANCE		1
+/*distance (in °C) from a threshold to sample at the minimum period*/
+#define ADAPTIVE_THRESHOLD_MARGIN	1
+/*temperatures kept by shift_last_temps*/
+#define ADAPTIVE_HISTORY			5
+
+struct adaptive_sampler {
+
+	int period;					/*seconds*/
+	int min_period;
+	int max_period;
+	const int *thresholds;
+	int thresholds_num;
+	unsigned int samples;		/*measurements taken*/
+};
+
+void adaptive_sampling_init(struct adaptive_sampler *as, int period, int min_period, int max_period,
+							const int *thresholds, int thresholds_num);
+
+/*Updating the period after a new value is stored in the history (values[count-1] is the last)*/
+int adaptive_sampling_next(struct adaptive_sampler *as, const int *values, int count);
+
+/*SHT11 raw temperature to Celsius degrees*/
+int sht11_to_celsius(int raw);
+
+/*Shifting a new temperature in the last ADAPTIVE_HISTORY values, returning the average of the previous ones*/
+int shift_last_temps(int *values, int temperature);
+
+#endif /* ADAPTIVE_SAMPLING_H_ */
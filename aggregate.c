@@ -0,0 +1,158 @@
+/*------------------------------Aggregate---------------------------------
+	In-network aggregation of the house temperature (see aggregate.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "aggregate.h"
+#include "nettime.h"
+#include "radio-queue.h"
+
+static struct aggregate_partial partial;
+static int local_samples = 0;		/*this node already counted in partial.sensors*/
+static int parent_addr;
+static int tree_depth;
+static struct ctimer report_timer;
+static void (*send_msg)(char* msg, int size, int rime_addr, int priority);
+static void (*report_root)(const struct aggregate_partial *summary);
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+static void reset(void){
+
+	memset(&partial, 0, sizeof(partial));
+	local_samples = 0;
+}
+
+static void count_late(uint8_t late){
+
+	partial.late = (partial.late + late > 0xFF) ? 0xFF : partial.late + late;
+}
+
+static void merge(const struct aggregate_partial *p){
+
+	count_late(p->late);
+
+	if(p->count == 0)
+		return;
+
+	if(partial.count == 0 || p->min < partial.min)
+		partial.min = p->min;
+
+	if(partial.count == 0 || p->max > partial.max)
+		partial.max = p->max;
+
+	partial.sum += p->sum;
+	partial.count += p->count;
+	partial.sensors += p->sensors;
+}
+
+static void report(void *ptr);
+
+/*Waking up at the slot of this depth before the next epoch end, the epoch opened*/
+static void schedule(void){
+
+	uint32_t epoch_ticks = (uint32_t)AGGREGATE_EPOCH*CLOCK_SECOND;
+	uint32_t now = nettime_now();
+	uint32_t next = (now/epoch_ticks + 1)*epoch_ticks - tree_depth*AGGREGATE_SLOT;
+
+	if(next <= now)
+		next += epoch_ticks;
+
+	partial.epoch = (next + tree_depth*AGGREGATE_SLOT) / epoch_ticks;
+
+	ctimer_set(&report_timer, next - now, report, NULL);
+}
+
+static void report(void *ptr){
+
+	char msg[AGGREGATE_SIZE + sizeof(struct aggregate_partial)];
+
+	(void)ptr;
+
+	/*the root hands the house-wide summary to the application*/
+	if(parent_addr == AGGREGATE_ROOT)
+		report_root(&partial);
+	else if(partial.count > 0 || partial.late > 0){
+
+		memcpy(msg, AGGREGATE, AGGREGATE_SIZE);
+		memcpy(msg + AGGREGATE_SIZE, &partial, sizeof(partial));
+
+		send_msg(msg, sizeof(msg), parent_addr, RADIO_QUEUE_TELEMETRY);
+	}
+
+	reset();
+	schedule();
+}
+
+
+void aggregate_init(int parent, int depth, void (*send)(char* msg, int size, int rime_addr, int priority),
+					void (*root)(const struct aggregate_partial *summary)){
+
+	parent_addr = parent;
+	tree_depth = depth;
+	send_msg = send;
+	report_root = root;
+
+	reset();
+	schedule();
+}
+
+
+void aggregate_add(int value){
+
+	struct aggregate_partial sample;
+
+	sample.sum = value;
+	sample.count = 1;
+	sample.min = value;
+	sample.max = value;
+	sample.sensors = local_samples ? 0 : 1;
+
+	merge(&sample);
+
+	local_samples = 1;
+}
+
+
+void aggregate_merge(const char* rcvd_msg){
+
+	struct aggregate_partial child;
+
+	memcpy(&child, rcvd_msg + AGGREGATE_SIZE, sizeof(child));
+
+	/*late (or early on a skewed clock): not mixed into another epoch*/
+	if(child.epoch != partial.epoch){
+
+		count_late(1);
+		return;
+	}
+
+	merge(&child);
+}
+
+
+void aggregate_print(const struct aggregate_partial *p){
+
+	long mean;
+
+	printf("HOUSE TEMPERATURE (epoch %lu):", (unsigned long)p->epoch);
+
+	if(p->count == 0)
+
+		printf(" no samples");
+
+	else{
+
+		mean = (p->sum * 100) / p->count;
+
+		printf(" Average %s%ld.%02ld Min %d Max %d from %u sensors (%u samples)", (mean < 0) ? "-" : "",
+			labs(mean) / 100, labs(mean) % 100, p->min, p->max, p->sensors, p->count);
+	}
+
+	if(p->late > 0)
+		printf(", %u late partials dropped", p->late);
+
+	printf("\n");
+}
@@ -0,0 +1,53 @@
+/*------------------------------Aggregate---------------------------------
+	In-network aggregation of the house temperature.
+
+	The sensing nodes form a tree rooted at the CU: each node merges
+	its own samples and the partial aggregates (sum, count, min, max)
+	of its children, and sends one partial to its parent per epoch.
+	The epochs are aligned on the network time and a node at depth d
+	reports AGGREGATE_SLOT*d before the epoch end, so the children
+	report before their parent forwards. The CU (depth 0) prints one
+	house-wide summary per epoch whose size does not depend on the
+	number of sensors.
+
+	The slot is longer than two runicast retransmissions (Contiki
+	doubles the timeout: 1 s then 2 s) plus a frame ahead in the radio
+	queue. A partial arriving after its parent reported (epoch
+	different from the open one) is dropped and counted as late.
+------------------------------------------------------------------------*/
+#ifndef AGGREGATE_H_
+#define AGGREGATE_H_
+
+#include "contiki.h"
+
+#define AGGREGATE				"AGGR"
+#define AGGREGATE_SIZE			5
+#define AGGREGATE_EPOCH			60				/*seconds*/
+#define AGGREGATE_SLOT			(4*CLOCK_SECOND)	/*per tree level*/
+#define AGGREGATE_ROOT			0				/*parent of the CU*/
+
+struct aggregate_partial {
+
+	uint32_t epoch;				/*network time / AGGREGATE_EPOCH*/
+	int32_t sum;
+	uint16_t count;				/*samples*/
+	int16_t min;
+	int16_t max;
+	uint8_t sensors;			/*nodes contributing samples*/
+	uint8_t late;				/*partials of children dropped in the subtree (saturated)*/
+};
+
+/*send is used for the partials (runicast to the parent, radio-queue class), NULL at the root;
+  root receives the house-wide summary at the root (parent AGGREGATE_ROOT), NULL elsewhere*/
+void aggregate_init(int parent, int depth, void (*send)(char* msg, int size, int rime_addr, int priority),
+					void (*root)(const struct aggregate_partial *summary));
+
+/*Adding a local sample to the current epoch*/
+void aggregate_add(int value);
+
+/*Merging the partial of a child received in an AGGREGATE message*/
+void aggregate_merge(const char* rcvd_msg);
+
+void aggregate_print(const struct aggregate_partial *partial);
+
+#endif /* AGGREGATE_H_ */
@@ -0,0 +1,146 @@
+/*--------------------------------Batch-----------------------------------
+	Multi-command frames (see batch.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "stdio.h"
+#include "string.h"
+#include "batch.h"
+#include "confirm.h"
+#include "radio-queue.h"
+
+struct dest {
+
+	int rime_addr;				/*0 if free*/
+	int count;
+	struct batch_op ops[BATCH_MAX_OPS];
+	struct ctimer timer;
+};
+
+static struct dest dests[BATCH_MAX_DESTS];
+static void (*send_msg)(char* msg, int size, int rime_addr, int priority);
+static unsigned int ops_requested = 0;
+static unsigned int ops_sent = 0;
+static unsigned int frames_sent = 0;
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+/*Window expired: one frame with every operation for the node*/
+static void flush(void *ptr){
+
+	struct dest *d = (struct dest *)ptr;
+	char msg[BATCH_MAX_FRAME_SIZE];
+	struct batch_header header;
+	int size;
+
+	header.seq = confirm_next_seq();
+	header.count = d->count;
+
+	memcpy(msg, BATCH, BATCH_SIZE);
+	memcpy(msg + BATCH_SIZE, &header, sizeof(header));
+	memcpy(msg + BATCH_SIZE + sizeof(header), d->ops, d->count*sizeof(struct batch_op));
+
+	size = BATCH_SIZE + sizeof(header) + d->count*sizeof(struct batch_op);
+
+	send_msg(msg, size, d->rime_addr, confirm_priority(CONFIRM_BATCH, d->ops, d->count));
+
+	confirm_expect(CONFIRM_BATCH, header.seq, d->rime_addr, msg, size);
+
+	ops_sent += d->count;
+	frames_sent++;
+
+	d->rime_addr = 0;
+}
+
+
+void batch_init(void (*send)(char* msg, int size, int rime_addr, int priority)){
+
+	int i;
+
+	send_msg = send;
+
+	for(i=0; i<BATCH_MAX_DESTS; i++)
+		dests[i].rime_addr = 0;
+}
+
+
+void batch_add(int rime_addr, uint8_t cmd, uint8_t value){
+
+	struct dest *d = NULL;
+	int i;
+
+	ops_requested++;
+
+	for(i=0; i<BATCH_MAX_DESTS; i++){
+
+		if(dests[i].rime_addr == rime_addr){
+
+			d = &dests[i];
+			break;
+		}
+
+		if(dests[i].rime_addr == 0 && d == NULL)
+			d = &dests[i];
+	}
+
+	if(d == NULL){
+
+		printf("BATCH to [%d:0] NOT SENT: too many destinations!\n", rime_addr);
+		return;
+	}
+
+	if(d->rime_addr == 0){
+
+		d->rime_addr = rime_addr;
+		d->count = 0;
+
+		ctimer_set(&d->timer, BATCH_WINDOW, flush, d);
+	}
+
+	/*merging: the newest operation of a type wins*/
+	for(i=0; i<d->count; i++)
+
+		if(d->ops[i].cmd == cmd){
+
+			d->ops[i].value = value;
+			return;
+		}
+
+	if(d->count == BATCH_MAX_OPS){
+
+		ctimer_stop(&d->timer);
+		flush(d);
+		batch_add(rime_addr, cmd, value);
+		ops_requested--;
+		return;
+	}
+
+	d->ops[d->count].cmd = cmd;
+	d->ops[d->count].value = value;
+	d->count++;
+}
+
+
+int batch_parse(const char* rcvd_msg, int len, struct batch_op *ops, int *count){
+
+	struct batch_header header;
+
+	if(len < (int)(BATCH_SIZE + sizeof(header)))
+		return -1;
+
+	memcpy(&header, rcvd_msg + BATCH_SIZE, sizeof(header));
+
+	if(BATCH_SIZE + sizeof(header) + header.count*sizeof(struct batch_op) > (unsigned int)len)
+		return -1;
+
+	*count = (header.count > BATCH_MAX_OPS) ? BATCH_MAX_OPS : header.count;
+
+	memcpy(ops, rcvd_msg + BATCH_SIZE + sizeof(header), *count*sizeof(struct batch_op));
+
+	return header.seq;
+}
+
+
+void batch_print_stats(void){
+
+	printf("BATCH: %u operations requested, %u sent in %u frames\n", ops_requested, ops_sent, frames_sent);
+}
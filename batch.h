@@ -0,0 +1,51 @@
+/*--------------------------------Batch-----------------------------------
+	Multi-command frames (Central Unit scenes).
+
+	Operations for the same node requested within BATCH_WINDOW are
+	coalesced (a later operation of the same type replaces the earlier
+	one) and sent as a single BATCH frame:
+
+		"BATCH" | batch_header | batch_op * count
+
+	The node applies all the operations it owns and answers with one
+	combined confirmation (CONFIRM_BATCH) whose state holds the
+	NODE_STATE_* flags resulting from the execution.
+------------------------------------------------------------------------*/
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include "contiki.h"
+
+#define BATCH					"BATCH"
+#define BATCH_SIZE				6
+#define BATCH_MAX_OPS			4
+#define BATCH_MAX_DESTS			3
+#define BATCH_WINDOW			(CLOCK_SECOND/8)	/*coalescing window*/
+
+struct batch_header {
+
+	uint8_t seq;
+	uint8_t count;
+};
+
+struct batch_op {
+
+	uint8_t cmd;				/*CONFIRM_ALARM, CONFIRM_GATE or CONFIRM_COMFORT*/
+	uint8_t value;
+};
+
+#define BATCH_MAX_FRAME_SIZE	(BATCH_SIZE + sizeof(struct batch_header) + BATCH_MAX_OPS*sizeof(struct batch_op))
+
+/*send is used for the frames (runicast to rime_addr, radio-queue class)*/
+void batch_init(void (*send)(char* msg, int size, int rime_addr, int priority));
+
+/*Adding an operation to the frame of the node, sent when the window expires*/
+void batch_add(int rime_addr, uint8_t cmd, uint8_t value);
+
+/*Reading the operations of a received frame of len bytes, returning the sequence number
+  (-1 if the frame is shorter than its operations)*/
+int batch_parse(const char* rcvd_msg, int len, struct batch_op *ops, int *count);
+
+void batch_print_stats(void);
+
+#endif /* BATCH_H_ */
@@ -0,0 +1,155 @@
+/*--------------------------------Bench-----------------------------------
+	Microbenchmarks of the firmware hot paths (see bench.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "stdio.h"
+#include "bench.h"
+
+#if BENCH_ENABLED
+
+#ifndef __MSP430__
+#error "bench.c counts MSP430 cycles: build it for TARGET=sky"
+#endif
+
+#include "msp430def.h"
+#include "isr_compat.h"
+
+#ifdef BENCH_CONF_STACK_DEPTH
+#define STACK_DEPTH				BENCH_CONF_STACK_DEPTH
+#else
+#define STACK_DEPTH				256		/*bytes painted below the caller*/
+#endif
+
+#define STACK_PATTERN			0xA5
+#define TBIV_OVERFLOW			0x0E	/*TBIFG*/
+#define OVERHEAD_CALLS			32
+
+/*high word of the cycle counter*/
+static volatile uint16_t overflows = 0;
+
+PROCESS(bench_process, "Bench Process");
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+ISR(TIMERB1, bench_timerb1_isr){
+
+	if(TBIV == TBIV_OVERFLOW)
+		overflows++;
+}
+
+
+/*Timer B free running on SMCLK (= MCLK on sky), counting the overflows*/
+static void cycles_init(void){
+
+	TBCTL = TBSSEL_2 | TBCLR;
+	TBCTL |= MC_2 | TBIE;
+}
+
+
+/*Inline: no frame of its own in the painted stack*/
+static inline __attribute__((always_inline)) uint32_t cycles(void){
+
+	uint16_t high, low;
+	int s = splhigh();
+
+	low = TBR;
+	high = overflows;
+
+	/*wrapped, the interrupt not taken yet*/
+	if((TBCTL & TBIFG) && low < 0x8000)
+		high++;
+
+	splx(s);
+
+	return ((uint32_t)high << 16) | low;
+}
+
+
+/*Cycles of one call, stack high-water mark in *stack*/
+static uint32_t measure(const struct bench_case *bc, uint16_t *stack){
+
+	uint8_t *sp, *p;
+	uint32_t start, end;
+
+	if(bc->setup != NULL)
+		bc->setup();
+
+	__asm__ __volatile__("mov r1, %0" : "=r"(sp));
+
+	for(p = sp - STACK_DEPTH; p < sp; p++)
+		*p = STACK_PATTERN;
+
+	start = cycles();
+	bc->call();
+	end = cycles();
+
+	for(p = sp - STACK_DEPTH; p < sp && *p == STACK_PATTERN; p++);
+
+	*stack = sp - p;
+
+	return end - start;
+}
+
+
+static void empty_call(void){
+
+}
+
+/*-----------------------------PROCESSES--------------------------------*/
+
+PROCESS_THREAD(bench_process, ev, data){
+
+	static struct etimer bench_et;
+	static const struct bench_case overhead_case = {"overhead", NULL, empty_call, OVERHEAD_CALLS};
+	static const struct bench_case *bc;
+	static uint32_t overhead, total, min, max, elapsed;
+	static uint16_t call, stack, max_stack;
+	static int i;
+
+	PROCESS_BEGIN();
+
+	etimer_set(&bench_et, BENCH_DELAY*CLOCK_SECOND);
+
+	PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&bench_et));
+
+	cycles_init();
+
+	printf("BENCH,firmware,case,calls,min,avg,max,stack\n");
+
+	/*the overhead case first: the cost of an empty call, removed from the others*/
+	overhead = 0;
+
+	for(i = -1; i < bench_suite.count; i++){
+
+		bc = (i < 0) ? &overhead_case : &bench_suite.cases[i];
+		total = max = 0;
+		min = UINT32_MAX;
+		max_stack = 0;
+
+		for(call = 0; call < bc->calls; call++){
+
+			elapsed = measure(bc, &stack);
+			elapsed = (elapsed > overhead) ? elapsed - overhead : 0;
+
+			total += elapsed;
+			min = (elapsed < min) ? elapsed : min;
+			max = (elapsed > max) ? elapsed : max;
+			max_stack = (stack > max_stack) ? stack : max_stack;
+
+			/*the events queued by the call run before the next one*/
+			PROCESS_PAUSE();
+		}
+
+		printf("BENCH,%s,%s,%u,%lu,%lu,%lu,%u\n", bench_suite.firmware, bc->name, bc->calls,
+			(unsigned long)min, (unsigned long)(total / bc->calls), (unsigned long)max, max_stack);
+
+		if(i < 0)
+			overhead = min;
+	}
+
+	printf("BENCH,%s,END\n", bench_suite.firmware);
+
+	PROCESS_END();
+}
+
+#endif /* BENCH_ENABLED */
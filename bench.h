@@ -0,0 +1,66 @@
+/*--------------------------------Bench-----------------------------------
+	Microbenchmarks of the firmware hot paths (BENCH_CONF_ENABLED).
+
+	A benchmark build runs the firmware as usual plus the bench
+	process: BENCH_DELAY seconds after the boot (the firmware state is
+	initialised by then) it runs every case of the firmware suite in
+	isolation, calls times each, and prints one machine-readable line
+	per case on the serial port:
+
+		BENCH,<firmware>,<case>,<calls>,<min>,<avg>,<max>,<stack>
+
+	min/avg/max are CPU cycles per call (the loop overhead removed) and
+	stack is the high-water mark in bytes below the caller. The run
+	ends with "BENCH,<firmware>,END". Run headless by make bench
+	(Cooja/MSPSim, bench.csc), which collects the lines in bench.csv.
+
+	Cycles are counted by Timer B on SMCLK, which the sky platform
+	clocks like MCLK from the DCO with no divider; the interrupts
+	taken during a call are counted, as on the device. setup runs
+	before every call, outside the measure (packetbuf, inputs).
+------------------------------------------------------------------------*/
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include "contiki.h"
+
+#ifdef BENCH_CONF_ENABLED
+#define BENCH_ENABLED			BENCH_CONF_ENABLED
+#else
+#define BENCH_ENABLED			0
+#endif
+
+#if BENCH_ENABLED
+
+#ifdef BENCH_CONF_DELAY
+#define BENCH_DELAY				BENCH_CONF_DELAY
+#else
+#define BENCH_DELAY				10		/*seconds*/
+#endif
+
+struct bench_case {
+
+	const char *name;
+	void (*setup)(void);		/*NULL if none*/
+	void (*call)(void);
+	uint16_t calls;
+};
+
+struct bench_suite {
+
+	const char *firmware;
+	const struct bench_case *cases;
+	int count;
+};
+
+/*Defined by the firmware: BENCH_SUITE("Node1", cases)*/
+extern const struct bench_suite bench_suite;
+
+#define BENCH_SUITE(firmware, cases) \
+	const struct bench_suite bench_suite = {firmware, cases, sizeof(cases) / sizeof(cases[0])}
+
+PROCESS_NAME(bench_process);
+
+#endif /* BENCH_ENABLED */
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,186 @@
+/*---------------------------Comfort Control------------------------------
+	On/off control of the bedroom air-conditioner (see comfort-control.h).
+------------------------------------------------------------------------*/
+#include "comfort-control.h"
+
+#define THRESHOLD_MIN			0
+#define THRESHOLD_OPTIMAL		1
+#define THRESHOLD_MAX			2
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+/*Updating the integral & the duty on the error (1/100 °C) over seconds*/
+static void pi_update(struct comfort_control *cc, int32_t error, uint16_t seconds){
+
+	int32_t p, duty;
+
+	p = (int32_t)COMFORT_KP * error / (1 << COMFORT_Q);
+	duty = p + cc->integral / (1 << COMFORT_Q);
+
+	/*anti-windup: no integration pushing a saturated duty further*/
+	if(!(duty >= COMFORT_DUTY_MAX && error > 0) && !(duty <= 0 && error < 0)){
+
+		cc->integral += (int32_t)COMFORT_KI * error * seconds;
+
+		if(cc->integral < 0)
+			cc->integral = 0;
+
+		if(cc->integral > ((int32_t)COMFORT_DUTY_MAX << COMFORT_Q))
+			cc->integral = (int32_t)COMFORT_DUTY_MAX << COMFORT_Q;
+
+		duty = p + cc->integral / (1 << COMFORT_Q);
+	}
+
+	if(duty < 0)
+		duty = 0;
+
+	if(duty > COMFORT_DUTY_MAX)
+		duty = COMFORT_DUTY_MAX;
+
+	/*on or off times shorter than the minimum cycle are not applied*/
+	if(duty * COMFORT_PI_PERIOD < (int32_t)cc->min_cycle * COMFORT_DUTY_MAX)
+		duty = 0;
+	else if((COMFORT_DUTY_MAX - duty) * COMFORT_PI_PERIOD < (int32_t)cc->min_cycle * COMFORT_DUTY_MAX)
+		duty = COMFORT_DUTY_MAX;
+
+	cc->duty = duty;
+}
+
+
+void comfort_control_init(struct comfort_control *cc, const int *thresholds, int16_t temp){
+
+	cc->mode = COMFORT_HYSTERESIS;
+	cc->on = 0;
+	cc->held = 0;
+	cc->band = 0;
+	cc->min_cycle = 0;
+	cc->temp = temp;
+	cc->duty = 0;
+	cc->integral = 0;
+	cc->elapsed = 0xFFFF;
+	cc->phase = 0;
+	cc->switches = 0;
+	cc->thresholds = thresholds;
+
+	comfort_control_reset_filter(cc);
+}
+
+
+void comfort_control_reset_filter(struct comfort_control *cc){
+
+	cc->filtered = cc->temp;
+	cc->next = 0;
+	cc->filled = 0;
+}
+
+
+void comfort_control_configure(struct comfort_control *cc, uint8_t mode, int16_t band, uint16_t min_cycle){
+
+	if(mode != cc->mode){
+
+		cc->duty = 0;
+		cc->integral = 0;
+		cc->phase = 0;
+	}
+
+	cc->mode = mode;
+	cc->band = band;
+	cc->min_cycle = min_cycle;
+}
+
+
+void comfort_control_measure(struct comfort_control *cc, int16_t temp){
+
+	int32_t sum = 0;
+	int i;
+
+	cc->temp = temp;
+
+	cc->history[cc->next] = temp;
+	cc->next = (cc->next + 1) % COMFORT_FILTER;
+
+	if(cc->filled < COMFORT_FILTER)
+		cc->filled++;
+
+	/*filled from the first entry on after a reset*/
+	for(i=0; i<cc->filled; i++)
+		sum += cc->history[i];
+
+	cc->filtered = sum / cc->filled;
+}
+
+
+int comfort_control_step(struct comfort_control *cc, uint16_t seconds){
+
+	int32_t error = (int32_t)cc->thresholds[THRESHOLD_OPTIMAL] * 100 - cc->temp;
+	int demand, reason;
+
+	cc->elapsed = (cc->elapsed > 0xFFFF - seconds) ? 0xFFFF : cc->elapsed + seconds;
+
+	if(cc->mode == COMFORT_PI){
+
+		pi_update(cc, error, seconds);
+		cc->phase = (cc->phase + seconds) % COMFORT_PI_PERIOD;
+	}
+
+	if(cc->temp <= cc->thresholds[THRESHOLD_MIN] * 100){
+
+		demand = 1;
+		reason = COMFORT_BELOW_MIN;
+
+	}else if(cc->temp >= cc->thresholds[THRESHOLD_MAX] * 100){
+
+		demand = 0;
+		reason = COMFORT_ABOVE_MAX;
+
+	}else if(cc->mode == COMFORT_PI){
+	/*on for the first duty part of the period*/
+
+		demand = (int32_t)cc->phase * COMFORT_DUTY_MAX < (int32_t)cc->duty * COMFORT_PI_PERIOD;
+		reason = COMFORT_DUTY;
+
+	}else{
+
+		error = (int32_t)cc->thresholds[THRESHOLD_OPTIMAL] * 100 - cc->filtered;
+		demand = (error > cc->band) ? 1 : (error < -cc->band) ? 0 : cc->on;
+		reason = COMFORT_BAND;
+	}
+
+	if(demand == cc->on){
+
+		cc->held = 0;
+		return COMFORT_NONE;
+	}
+
+	if(cc->elapsed < cc->min_cycle){
+	/*compressor protection*/
+
+		if(cc->held)
+			return COMFORT_NONE;
+
+		cc->held = 1;
+		return COMFORT_HELD;
+	}
+
+	cc->on = demand;
+	cc->elapsed = 0;
+	cc->held = 0;
+	cc->switches++;
+
+	return reason;
+}
+
+
+void comfort_control_off(struct comfort_control *cc){
+
+	cc->held = 0;
+
+	comfort_control_reset_filter(cc);
+
+	if(!cc->on)
+		return;
+
+	cc->on = 0;
+	cc->elapsed = 0;
+	cc->switches++;
+}
@@ -0,0 +1,87 @@
+/*---------------------------Comfort Control------------------------------
+	On/off control of the bedroom air-conditioner (heating) by Node4.
+
+	Temperatures are in hundredths of °C (SHT11: raw - 3960), compared
+	with the comfort thresholds (°C: min, optimal, max) of the caller.
+	The measurement is held between two samples and the controller is
+	stepped on the elapsed seconds, in one of two modes:
+		- COMFORT_HYSTERESIS: on below optimal - band, off above
+		  optimal + band, unchanged inside the band, on the average
+		  of the last COMFORT_FILTER measurements (the noise of a
+		  single one would switch the AC at the band edges), the
+		  history emptied at init & by comfort_control_off so that
+		  the first measurement seeds it;
+		- COMFORT_PI: duty (per mille) = Kp * error + integral of
+		  Ki * error, in Q8 fixed point, the integral clamped to the
+		  duty range (anti-windup). The duty is applied by time
+		  proportioning over COMFORT_PI_PERIOD seconds, rounded to 0
+		  or 1000 when the on or off time would be shorter than the
+		  minimum cycle.
+	In both modes the min threshold forces on and the max one forces
+	off. A switch happens only after min_cycle seconds in the current
+	state (compressor protection): a demand held by it is reported
+	once as COMFORT_HELD.
+------------------------------------------------------------------------*/
+#ifndef COMFORT_CONTROL_H_
+#define COMFORT_CONTROL_H_
+
+#include "contiki.h"
+
+//control modes (CONFIG_CONTROL)
+#define COMFORT_HYSTERESIS		0
+#define COMFORT_PI				1
+
+#define COMFORT_KP				1024	/*Q8 per mille of duty per 1/100 °C: 400 per °C*/
+#define COMFORT_KI				1		/*Q8 per mille per 1/100 °C per second*/
+#define COMFORT_Q				8
+#define COMFORT_DUTY_MAX		1000	/*per mille*/
+#define COMFORT_PI_PERIOD		900		/*seconds, time proportioning cycle*/
+#define COMFORT_FILTER			5		/*measurements averaged by the hysteresis*/
+
+//decisions (returned by comfort_control_step)
+#define COMFORT_NONE			0	/*actuator unchanged*/
+#define COMFORT_BELOW_MIN		1	/*switched on by the min threshold*/
+#define COMFORT_ABOVE_MAX		2	/*switched off by the max threshold*/
+#define COMFORT_BAND			3	/*switched leaving the hysteresis band*/
+#define COMFORT_DUTY			4	/*switched by the PI time proportioning*/
+#define COMFORT_HELD			5	/*switch demanded before the minimum cycle*/
+
+struct comfort_control {
+
+	uint8_t mode;
+	uint8_t on;					/*actuator state*/
+	uint8_t held;				/*COMFORT_HELD already reported*/
+	int16_t band;				/*1/100 °C, half width*/
+	uint16_t min_cycle;			/*seconds, minimum on & off time*/
+	int16_t temp;				/*last measurement, 1/100 °C*/
+	int16_t filtered;			/*average of the last COMFORT_FILTER measurements*/
+	int16_t history[COMFORT_FILTER];
+	uint8_t next;				/*oldest entry of the history*/
+	uint8_t filled;				/*measurements in the history*/
+	int16_t duty;				/*PI, per mille*/
+	int32_t integral;			/*PI, Q8 per mille*/
+	uint16_t elapsed;			/*seconds in the actuator state (saturating)*/
+	uint16_t phase;				/*seconds in the PI period*/
+	uint16_t switches;
+	const int *thresholds;		/*°C: min, optimal, max*/
+};
+
+/*Actuator off, allowed to switch on at the first step*/
+void comfort_control_init(struct comfort_control *cc, const int *thresholds, int16_t temp);
+
+/*Mode, band (1/100 °C) & minimum cycle (s), kept live: the PI state is reset on a mode change*/
+void comfort_control_configure(struct comfort_control *cc, uint8_t mode, int16_t band, uint16_t min_cycle);
+
+void comfort_control_measure(struct comfort_control *cc, int16_t temp);
+
+/*Advancing by seconds, returning the decision (cc->on is the resulting state)*/
+int comfort_control_step(struct comfort_control *cc, uint16_t seconds);
+
+/*Emptying the history: the filter restarts from the next measurement*/
+void comfort_control_reset_filter(struct comfort_control *cc);
+
+/*Actuator switched off outside the control (comfort stopped): the minimum off time applies,
+  the history is emptied*/
+void comfort_control_off(struct comfort_control *cc);
+
+#endif /* COMFORT_CONTROL_H_ */
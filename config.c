@@ -0,0 +1,271 @@
+/*-------------------------------Config-----------------------------------
+	Runtime configuration of the firmwares (see config.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "stdio.h"
+#include "string.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+#include "lib/crc16.h"
+#include "confirm.h"
+#include "radio-queue.h"
+#include "core.h"
+#include "config.h"
+#include "logbuf.h"
+
+#define CONFIG_FILE		"config"
+
+/*On flash: the version, the keys stored & their values, then the CRC*/
+struct stored_config {
+
+	uint8_t version;
+	uint8_t pad;
+	uint16_t keys;
+	int16_t values[CONFIG_KEYS];
+	uint16_t crc;
+};
+
+/*names (console & print) & valid range of every key*/
+static const struct {
+
+	const char *name;
+	int16_t min;
+	int16_t max;
+} key_info[CONFIG_KEYS] = {
+	{"period", 1, 3600},
+	{"ack", 1, 60},
+	{"retx", 1, 15},
+	{"temp_min", -20, 50},
+	{"temp_optimal", -20, 50},
+	{"temp_max", -20, 50},
+	{"control", 0, 1},
+	{"band", 0, 50},
+	{"min_cycle", 0, 1800}
+};
+
+static int16_t values[CONFIG_KEYS];
+static uint16_t keys = 0;		/*bit per key of the firmware*/
+static uint8_t active_version = 0;
+static void (*apply_key)(uint8_t key, int16_t value);
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+static void save(void){
+
+	struct stored_config stored;
+	int fd;
+
+	stored.version = active_version;
+	stored.pad = 0;
+	stored.keys = keys;
+	memcpy(stored.values, values, sizeof(values));
+	stored.crc = crc16_data((const unsigned char *)&stored, sizeof(stored) - sizeof(stored.crc), 0);
+
+	/*fails (harmlessly) once the file exists*/
+	cfs_coffee_reserve(CONFIG_FILE, sizeof(stored));
+
+	fd = cfs_open(CONFIG_FILE, CFS_WRITE);
+
+	if(fd < 0)
+		return;
+
+	cfs_write(fd, &stored, sizeof(stored));
+
+	cfs_close(fd);
+}
+
+/*Returning 1 if a valid configuration was on flash*/
+static int load(struct stored_config *stored){
+
+	int fd, len;
+
+	fd = cfs_open(CONFIG_FILE, CFS_READ);
+
+	if(fd < 0)
+		return 0;
+
+	len = cfs_read(fd, stored, sizeof(*stored));
+
+	cfs_close(fd);
+
+	return len == sizeof(*stored) &&
+		stored->crc == crc16_data((const unsigned char *)stored, sizeof(*stored) - sizeof(stored->crc), 0);
+}
+
+
+void config_init(const struct config_entry *defaults, int count, void (*apply)(uint8_t key, int16_t value)){
+
+	struct stored_config stored;
+	int i, valid;
+
+	apply_key = apply;
+	keys = 0;
+	active_version = 0;
+
+	for(i=0; i<count; i++){
+
+		keys |= 1 << defaults[i].key;
+		values[defaults[i].key] = defaults[i].value;
+	}
+
+	valid = load(&stored);
+
+	if(valid){
+
+		active_version = stored.version;
+
+		/*a key added by a newer firmware keeps its default*/
+		for(i=0; i<CONFIG_KEYS; i++)
+			if((keys & stored.keys & (1 << i)) && config_valid(i, stored.values[i]))
+				values[i] = stored.values[i];
+	}
+
+	for(i=0; i<CONFIG_KEYS; i++)
+		if(keys & (1 << i))
+			apply_key(i, values[i]);
+
+	if(valid)
+		printf("CONFIG RESTORED from flash (version %u)\n", active_version);
+}
+
+
+int16_t config_get(uint8_t key){
+
+	return values[key];
+}
+
+
+uint8_t config_version(void){
+
+	return active_version;
+}
+
+
+int config_set(const struct config_entry *entries, int count){
+
+	uint16_t changed = 0;
+	int i, n = 0;
+
+	for(i=0; i<count; i++){
+
+		if(entries[i].key >= CONFIG_KEYS || !(keys & (1 << entries[i].key)) ||
+			!config_valid(entries[i].key, entries[i].value) || values[entries[i].key] == entries[i].value)
+			continue;
+
+		values[entries[i].key] = entries[i].value;
+		changed |= 1 << entries[i].key;
+	}
+
+	if(changed == 0)
+		return 0;
+
+	active_version++;
+	save();
+
+	for(i=0; i<CONFIG_KEYS; i++)
+
+		if(changed & (1 << i)){
+
+			apply_key(i, values[i]);
+			n++;
+		}
+
+	return n;
+}
+
+
+int config_fill(struct config_entry *entries){
+
+	int i, n = 0;
+
+	for(i=0; i<CONFIG_KEYS; i++)
+
+		if(keys & (1 << i)){
+
+			entries[n].key = i;
+			entries[n].pad = 0;
+			entries[n].value = values[i];
+			n++;
+		}
+
+	return n;
+}
+
+
+void config_handle_request(const char* rcvd_msg, int len){
+
+	struct config_entry entries[CONFIG_MAX_ENTRIES];
+	struct config_header header;
+	char msg[CONFIG_REPLY_SIZE + sizeof(struct config_header) + sizeof(entries)];
+	int count;
+
+	if(strcmp(rcvd_msg, CONFIG) == 0){
+
+		count = (len - CONFIG_SIZE - 1) / (int)sizeof(struct config_entry);
+
+		if(count < 0)
+			return;
+
+		if(count > CONFIG_MAX_ENTRIES)
+			count = CONFIG_MAX_ENTRIES;
+
+		memcpy(entries, rcvd_msg + CONFIG_SIZE + 1, count*sizeof(struct config_entry));
+
+		if(config_set(entries, count) > 0)
+			LOGBUF0(LOG_CONFIG_CHANGED);
+
+		send_confirm(CONFIRM, CONFIRM_SIZE, CONFIRM_CONFIG, (uint8_t)rcvd_msg[CONFIG_SIZE], active_version);
+
+		return;
+	}
+
+	header.version = active_version;
+	header.count = config_fill(entries);
+
+	memcpy(msg, CONFIG_REPLY, CONFIG_REPLY_SIZE);
+	memcpy(msg + CONFIG_REPLY_SIZE, &header, sizeof(header));
+	memcpy(msg + CONFIG_REPLY_SIZE + sizeof(header), entries, header.count*sizeof(struct config_entry));
+
+	send_data(msg, CONFIG_REPLY_SIZE + sizeof(header) + header.count*sizeof(struct config_entry),
+		UC_RIME_ADDR, RADIO_QUEUE_COMMAND);
+}
+
+
+int config_key(const char *name){
+
+	int i;
+
+	for(i=0; i<CONFIG_KEYS; i++)
+		if(strcmp(name, key_info[i].name) == 0)
+			return i;
+
+	return -1;
+}
+
+
+int config_valid(uint8_t key, int16_t value){
+
+	return key < CONFIG_KEYS && value >= key_info[key].min && value <= key_info[key].max;
+}
+
+
+void config_print(int owner, uint8_t version, const struct config_entry *entries, int count){
+
+	int i;
+
+	printf("CONFIG of [%d:0] version %u:", owner, version);
+
+	for(i=0; i<count; i++)
+		if(entries[i].key < CONFIG_KEYS)
+			printf(" %s %d", key_info[entries[i].key].name, entries[i].value);
+
+	printf("\n");
+}
+
+
+void config_print_local(void){
+
+	struct config_entry entries[CONFIG_KEYS];
+
+	config_print(linkaddr_node_addr.u8[0], active_version, entries, config_fill(entries));
+}
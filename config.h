@@ -0,0 +1,88 @@
+/*-------------------------------Config-----------------------------------
+	Runtime configuration of the firmwares, set over the air by the CU.
+
+	Every firmware owns a small table of parameters (the keys it uses,
+	with its own defaults) persisted on the external flash with a
+	version, incremented by every update changing a value: the flash
+	values are restored at boot, the defaults are used otherwise.
+
+	The CU pushes updates as CONFIG frames (sequence number, then up
+	to CONFIG_MAX_ENTRIES config_entry): the node applies the valid
+	entries of its keys live, persists them and confirms the frame
+	with CONFIRM_CONFIG, state = the resulting version (a retried
+	frame changes nothing and keeps the version). GET_CONFIG is
+	answered with CONFIG_REPLY: config_header and every key of the
+	node with its active value.
+
+	The comfort thresholds are owned by the CU state (node-state.h):
+	the CU keys update its state and Node4 receives them with the
+	state snapshot.
+------------------------------------------------------------------------*/
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include "contiki.h"
+
+#define CONFIG_SAMPLE_PERIOD	0	/*s, base temperature period (Node1, Node4)*/
+#define CONFIG_ALARM_ACK		1	/*s, waiting for the alarm acks (CU)*/
+#define CONFIG_MAX_RETX			2	/*cap of the runicast retransmissions (all)*/
+#define CONFIG_TEMP_MIN			3	/*comfort thresholds (CU, in the state)*/
+#define CONFIG_TEMP_OPTIMAL		4
+#define CONFIG_TEMP_MAX			5
+#define CONFIG_CONTROL			6	/*comfort control mode (Node4, comfort-control.h)*/
+#define CONFIG_BAND				7	/*1/10 °C, hysteresis half band (Node4)*/
+#define CONFIG_MIN_CYCLE		8	/*s, minimum on & off time of the AC (Node4)*/
+#define CONFIG_KEYS				9
+
+#define CONFIG_MAX_ENTRIES		CONFIG_KEYS	/*per frame*/
+
+//communication values (size with the terminator)
+#define CONFIG					"CONFIG"
+#define CONFIG_SIZE				7
+#define GET_CONFIG				"GET_CONFIG"
+#define GET_CONFIG_SIZE			11
+#define CONFIG_REPLY			"CFG"
+#define CONFIG_REPLY_SIZE		4
+
+struct config_entry {
+
+	uint8_t key;
+	uint8_t pad;
+	int16_t value;
+};
+
+/*Body of CONFIG_REPLY, followed by count config_entry*/
+struct config_header {
+
+	uint8_t version;
+	uint8_t count;
+};
+
+/*Loading the flash values (defaults for the missing ones), apply is called for every key*/
+void config_init(const struct config_entry *defaults, int count, void (*apply)(uint8_t key, int16_t value));
+
+int16_t config_get(uint8_t key);
+
+uint8_t config_version(void);
+
+/*Applying & persisting the valid entries of the firmware keys, returning how many changed*/
+int config_set(const struct config_entry *entries, int count);
+
+/*Filling the active value of every key of the firmware (up to CONFIG_KEYS), returning how many*/
+int config_fill(struct config_entry *entries);
+
+/*Handling a CONFIG or GET_CONFIG frame of the CU (node side)*/
+void config_handle_request(const char* rcvd_msg, int len);
+
+/*Key of a name ("period", ...), -1 if unknown*/
+int config_key(const char *name);
+
+/*Returning 0 if the value is out of the range of the key*/
+int config_valid(uint8_t key, int16_t value);
+
+void config_print(int owner, uint8_t version, const struct config_entry *entries, int count);
+
+/*Printing the active configuration of the firmware (from the log process)*/
+void config_print_local(void);
+
+#endif /* CONFIG_H_ */
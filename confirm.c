@@ -0,0 +1,231 @@
+/*-------------------------------Confirm----------------------------------
+	End-to-end confirmation of the actuator commands (see confirm.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "stdio.h"
+#include "string.h"
+#include "confirm.h"
+#include "link-quality.h"
+#include "radio-queue.h"
+#include "batch.h"
+#include "core.h"
+
+struct pending {
+
+	int used;
+	uint8_t cmd;
+	uint8_t seq;
+	uint8_t retries;
+	int rime_addr;
+	clock_time_t sent;			/*first transmission*/
+	struct ctimer timer;
+	int size;
+	char msg[CONFIRM_MAX_MSG_SIZE];
+};
+
+static const char *command_names[CONFIRM_COMMANDS] = {"ALARM", "GATE", "OPEN", "COMFORT", "BATCH", "CONFIG"};
+
+static struct pending pendings[CONFIRM_MAX_PENDING];
+static struct confirm_stats stats[CONFIRM_COMMANDS];
+static void (*send_msg)(char* msg, int size, int rime_addr, int priority);
+static uint8_t seq = 0;
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+static void timeout_callback(void *ptr);
+
+static void retry(struct pending *p){
+
+	struct batch_op ops[BATCH_MAX_OPS];
+	int count = 0;
+
+	if(p->retries == CONFIRM_RETRIES){
+
+		LOGBUF2(LOG_COMMAND_FAILED, p->cmd, p->rime_addr);
+
+		stats[p->cmd].failed++;
+		ctimer_stop(&p->timer);
+		p->used = 0;
+
+		return;
+	}
+
+	p->retries++;
+	stats[p->cmd].retries++;
+
+	if(p->cmd == CONFIRM_BATCH)
+		batch_parse(p->msg, p->size, ops, &count);
+
+	send_msg(p->msg, p->size, p->rime_addr, confirm_priority(p->cmd, ops, count));
+
+	ctimer_set(&p->timer, link_quality_timeout(p->rime_addr, CONFIRM_TIMEOUT), timeout_callback, p);
+}
+
+static void timeout_callback(void *ptr){
+
+	retry((struct pending *)ptr);
+}
+
+
+int confirm_priority(uint8_t cmd, const struct batch_op *ops, int count){
+
+	int i;
+
+	if(cmd == CONFIRM_ALARM || cmd == CONFIRM_GATE)
+		return RADIO_QUEUE_ALARM;
+
+	if(cmd == CONFIRM_BATCH)
+		for(i=0; i<count; i++)
+			if(ops[i].cmd == CONFIRM_ALARM || ops[i].cmd == CONFIRM_GATE)
+				return RADIO_QUEUE_ALARM;
+
+	return RADIO_QUEUE_COMMAND;
+}
+
+
+void confirm_init(void (*send)(char* msg, int size, int rime_addr, int priority)){
+
+	int i;
+
+	send_msg = send;
+
+	for(i=0; i<CONFIRM_MAX_PENDING; i++)
+		pendings[i].used = 0;
+
+	for(i=0; i<CONFIRM_COMMANDS; i++){
+
+		memset(&stats[i], 0, sizeof(stats[i]));
+		stats[i].latency_min_ms = 0xFFFF;
+	}
+}
+
+
+uint8_t confirm_next_seq(void){
+
+	return ++seq;
+}
+
+
+void confirm_expect(uint8_t cmd, uint8_t seq, int rime_addr, const void *msg, int size){
+
+	struct pending *p = NULL;
+	int i;
+
+	for(i=0; i<CONFIRM_MAX_PENDING; i++){
+
+		/*a newer command of the same type supersedes the pending one*/
+		if(pendings[i].used && pendings[i].cmd == cmd && pendings[i].rime_addr == rime_addr){
+
+			ctimer_stop(&pendings[i].timer);
+			p = &pendings[i];
+			break;
+		}
+
+		if(!pendings[i].used && p == NULL)
+			p = &pendings[i];
+	}
+
+	if(p == NULL || size > CONFIRM_MAX_MSG_SIZE){
+
+		LOGBUF2(LOG_COMMAND_UNTRACKED, cmd, rime_addr);
+		return;
+	}
+
+	p->used = 1;
+	p->cmd = cmd;
+	p->seq = seq;
+	p->retries = 0;
+	p->rime_addr = rime_addr;
+	p->sent = clock_time();
+	p->size = size;
+	memcpy(p->msg, msg, size);
+
+	stats[cmd].sent++;
+
+	ctimer_set(&p->timer, link_quality_timeout(rime_addr, CONFIRM_TIMEOUT), timeout_callback, p);
+}
+
+
+long confirm_receive(const struct confirm_reply *reply, int rime_addr){
+
+	struct pending *p;
+	unsigned long latency;
+	int i;
+
+	for(i=0; i<CONFIRM_MAX_PENDING; i++){
+
+		p = &pendings[i];
+
+		if(!p->used || p->cmd != reply->cmd || p->seq != reply->seq || p->rime_addr != rime_addr)
+			continue;
+
+		latency = ((unsigned long)(clock_time_t)(clock_time() - p->sent) * 1000) / CLOCK_SECOND;
+
+		stats[p->cmd].confirmed++;
+		stats[p->cmd].latency_sum_ms += latency;
+
+		if(latency < stats[p->cmd].latency_min_ms)
+			stats[p->cmd].latency_min_ms = latency;
+
+		if(latency > stats[p->cmd].latency_max_ms)
+			stats[p->cmd].latency_max_ms = latency;
+
+		ctimer_stop(&p->timer);
+		p->used = 0;
+
+		return latency;
+	}
+
+	return -1;
+}
+
+
+void confirm_delivery_failed(int rime_addr){
+
+	int i;
+
+	/*only the command whose frame timed out (not a digest, log or reply to the node)*/
+	for(i=0; i<CONFIRM_MAX_PENDING; i++)
+
+		if(pendings[i].used && pendings[i].rime_addr == rime_addr &&
+			radio_queue_completed(pendings[i].msg, pendings[i].size, rime_addr)){
+
+			retry(&pendings[i]);
+			return;
+		}
+}
+
+
+void confirm_print_stats(void){
+
+	struct confirm_stats *s;
+	int i;
+
+	printf("###########################\n#### COMMAND STATS: ####\n");
+
+	for(i=0; i<CONFIRM_COMMANDS; i++){
+
+		s = &stats[i];
+
+		printf("\t%s: sent %u confirmed %u failed %u retries %u", command_names[i],
+			s->sent, s->confirmed, s->failed, s->retries);
+
+		if(s->confirmed > 0)
+			printf(" latency min/avg/max %u/%lu/%u ms", s->latency_min_ms,
+				s->latency_sum_ms / s->confirmed, s->latency_max_ms);
+
+		printf("\n");
+	}
+
+	printf("###########################\n");
+}
+
+
+void confirm_print_record(const struct logbuf_record *record){
+
+	if(record->event == LOG_COMMAND_FAILED)
+		printf("COMMAND %s to [%d:0] FAILED: not confirmed after %d retries!\n",
+			command_names[record->args[0]], (int)record->args[1], CONFIRM_RETRIES);
+	else if(record->event == LOG_COMMAND_UNTRACKED)
+		printf("COMMAND %s to [%d:0] NOT TRACKED!\n", command_names[record->args[0]], (int)record->args[1]);
+}
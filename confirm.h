@@ -0,0 +1,79 @@
+/*-------------------------------Confirm----------------------------------
+	End-to-end confirmation of the actuator commands (Central Unit).
+
+	Every actuator command carries a sequence number (one byte right
+	after the command string) and the node executing it replies with
+	a confirm_reply holding the same sequence number and the state
+	resulting from the execution. The CU keeps a pending entry per
+	(command, node) with a timeout: on timeout, or as soon as the
+	runicast delivery times out, the command is sent again by
+	runicast up to CONFIRM_RETRIES times before the failure is
+	reported. A runicast timeout retries only the pending command
+	whose frame timed out. Confirmation latency statistics are kept per command.
+------------------------------------------------------------------------*/
+#ifndef CONFIRM_H_
+#define CONFIRM_H_
+
+#include "contiki.h"
+#include "logbuf.h"
+
+#define CONFIRM_ALARM			0	/*command types*/
+#define CONFIRM_GATE			1
+#define CONFIRM_OPEN			2
+#define CONFIRM_COMFORT			3
+#define CONFIRM_BATCH			4	/*multi-command frame, state holds NODE_STATE_* flags*/
+#define CONFIRM_CONFIG			5	/*configuration update, state holds the config version*/
+#define CONFIRM_COMMANDS		6
+
+#define CONFIRM_MAX_PENDING		6
+#define CONFIRM_MAX_MSG_SIZE	32
+#define CONFIRM_TIMEOUT			(4*CLOCK_SECOND)
+#define CONFIRM_RETRIES			2
+
+/*Body of the confirmation sent by the nodes*/
+struct confirm_reply {
+
+	uint8_t cmd;
+	uint8_t seq;
+	uint8_t state;				/*resulting state*/
+	uint8_t pad;
+};
+
+struct confirm_stats {
+
+	unsigned int sent;
+	unsigned int confirmed;
+	unsigned int failed;
+	unsigned int retries;
+	unsigned long latency_sum_ms;
+	unsigned int latency_min_ms;
+	unsigned int latency_max_ms;
+};
+
+struct batch_op;
+
+/*Radio-queue class of a command, its confirmation & retries: ALARM for the alarm & gate
+  (a batch holding one of them), COMMAND otherwise*/
+int confirm_priority(uint8_t cmd, const struct batch_op *ops, int count);
+
+/*send is used for the retries (runicast to rime_addr, radio-queue class)*/
+void confirm_init(void (*send)(char* msg, int size, int rime_addr, int priority));
+
+uint8_t confirm_next_seq(void);
+
+/*Expecting the confirmation of msg (already sent) from the node*/
+void confirm_expect(uint8_t cmd, uint8_t seq, int rime_addr, const void *msg, int size);
+
+/*Returning the latency in ms, or -1 if not pending (late or duplicate)*/
+long confirm_receive(const struct confirm_reply *reply, int rime_addr);
+
+/*Runicast delivery to the node timed out: retrying now the command of the timed-out frame, if pending
+  (called after radio_queue_sent, see radio_queue_completed)*/
+void confirm_delivery_failed(int rime_addr);
+
+void confirm_print_stats(void);
+
+/*Formatting the LOG_COMMAND_FAILED & LOG_COMMAND_UNTRACKED records (core.h) of the CU log process*/
+void confirm_print_record(const struct logbuf_record *record);
+
+#endif /* CONFIRM_H_ */
@@ -0,0 +1,290 @@
+/*--------------------------------Core------------------------------------
+	Code shared by the four firmwares (see core.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "stdio.h"
+#include "string.h"
+#include "dev/leds.h"
+#include "nettime.h"
+#include "node-state.h"
+#include "link-quality.h"
+#include "radio-queue.h"
+#include "confirm.h"
+#include "logbuf.h"
+#include "trace.h"
+#include "core.h"
+
+static unsigned char saved_leds;
+static int leds_saved = 0;
+
+static const char *synch_name;
+static struct node_state *synch_state;
+static void (*synch_apply)(const struct node_state *snapshot, int persist);
+static const int *synch_local_change;
+static int state_reply_status = NOT_RECEIVED;
+static int time_reply_status = NOT_RECEIVED;
+
+PROCESS(state_synch_process, "State Synch Process");
+PROCESS(time_synch_process, "Time Synch Process");
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+void core_radio_open(struct runicast_conn *runicast, const struct runicast_callbacks *runicast_calls,
+	struct broadcast_conn *broadcast, const struct broadcast_callbacks *broadcast_call,
+	void (*print)(const struct logbuf_record *record)){
+
+	TRACE_INIT();
+	logbuf_init(print);
+	link_quality_init();
+	radio_queue_init(runicast);
+
+	runicast_open(runicast, RUNICAST_CHANNEL, runicast_calls);
+	broadcast_open(broadcast, BROADCAST_CHANNEL, broadcast_call);
+}
+
+
+void core_runicast_received(const linkaddr_t *from, uint8_t seqno){
+
+	(void)seqno;
+
+	TRACE_PACKET(TRACE_RX_RUNICAST, from, seqno);
+
+	link_quality_received(from);
+}
+
+
+void core_broadcast_received(const linkaddr_t *from){
+
+	TRACE_PACKET(TRACE_RX_BROADCAST, from, 0);
+
+	link_quality_received(from);
+}
+
+
+void core_runicast_sent(struct runicast_conn *c, const linkaddr_t *to, uint8_t transmissions){
+
+	(void)c;
+
+	/*the trace keeps the retransmissions of the simulator*/
+	TRACE_OUTCOME(TRACE_SENT, to, transmissions - 1);
+
+	link_quality_sent(to, transmissions);
+
+	radio_queue_sent();
+}
+
+
+void core_runicast_timedout(struct runicast_conn *c, const linkaddr_t *to, uint8_t transmissions){
+
+	(void)c;
+
+	/*the trace keeps the retransmissions of the simulator*/
+	TRACE_OUTCOME(TRACE_TIMEDOUT, to, transmissions - 1);
+
+	link_quality_timedout(to, transmissions);
+
+	radio_queue_sent();
+}
+
+
+void send_string(char* msg, int size, int rime_addr, int priority){
+
+	radio_queue_send(priority, msg, size, rime_addr);
+}
+
+
+void send_data(const void* msg, int size, int rime_addr, int priority){
+
+	radio_queue_send(priority, msg, size, rime_addr);
+}
+
+
+static void send_confirm_reply(const char* tag, int tag_size, uint8_t cmd, uint8_t seq, uint8_t result, int priority){
+
+	char msg[CONFIRM_SIZE + sizeof(struct confirm_reply)];
+	struct confirm_reply reply;
+
+	reply.cmd = cmd;
+	reply.seq = seq;
+	reply.state = result;
+	reply.pad = 0;
+
+	memcpy(msg, tag, tag_size);
+	memcpy(msg + tag_size, &reply, sizeof(reply));
+
+	send_data(msg, tag_size + sizeof(reply), UC_RIME_ADDR, priority);
+}
+
+
+void send_confirm(const char* tag, int tag_size, uint8_t cmd, uint8_t seq, uint8_t result){
+
+	send_confirm_reply(tag, tag_size, cmd, seq, result, confirm_priority(cmd, NULL, 0));
+}
+
+
+void send_batch_confirm(uint8_t seq, uint8_t result, const struct batch_op *ops, int count){
+
+	send_confirm_reply(CONFIRM, CONFIRM_SIZE, CONFIRM_BATCH, seq, result, confirm_priority(CONFIRM_BATCH, ops, count));
+}
+
+/*---------------------------------SYNCH----------------------------------*/
+
+void core_synch_init(const char *name, struct node_state *state,
+	void (*apply)(const struct node_state *snapshot, int persist), const int *local_change){
+
+	synch_name = name;
+	synch_state = state;
+	synch_apply = apply;
+	synch_local_change = local_change;
+}
+
+
+void handle_state_reply(const char* rcvd_msg){
+
+	struct node_state snapshot;
+
+	memcpy(&snapshot, rcvd_msg + STATE_REPLY_SIZE, sizeof(snapshot));
+
+	synch_apply(&snapshot, 1);
+
+	if(state_reply_status == NOT_RECEIVED)
+		LOGBUF1(LOG_STATE_SYNCHED, node_state_uptime_ms());
+
+	state_reply_status = RECEIVED;
+
+	process_poll(&state_synch_process);
+}
+
+
+void handle_time_reply(const char* rcvd_msg){
+
+	struct nettime_reply reply;
+
+	memcpy(&reply, rcvd_msg + TIME_REPLY_SIZE, sizeof(reply));
+
+	time_reply_status = RECEIVED;
+
+	if(nettime_update(&reply))
+		LOGBUF1(LOG_TIME_SYNCHED, nettime_error_ms());
+}
+
+
+PROCESS_THREAD(state_synch_process, ev, data){
+
+	static struct etimer state_et;
+	struct node_state_digest digest;
+	struct link_quality_report links[LINK_QUALITY_REPORT_ENTRIES];
+	char msg[STATE_DIGEST_SIZE + sizeof(struct node_state_digest) + sizeof(links)];
+	int count;
+
+	PROCESS_BEGIN();
+
+	/*restoring locally before the CU answers*/
+	if(node_state_load(synch_state)){
+
+		synch_apply(synch_state, 0);
+		printf("%s: STATE RESTORED from flash in %lu ms\n", synch_name, node_state_uptime_ms());
+	}
+
+	while(state_reply_status == NOT_RECEIVED){
+
+		send_string(STATE_REQ, STATE_REQ_SIZE, UC_RIME_ADDR, RADIO_QUEUE_COMMAND);
+
+		etimer_set(&state_et, STATE_RETRY*CLOCK_SECOND);
+
+		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&state_et) || state_reply_status == RECEIVED);
+	}
+
+	/*anti-entropy: digests spread over the period by rime address*/
+	etimer_set(&state_et, (DIGEST_PERIOD + linkaddr_node_addr.u8[0])*CLOCK_SECOND);
+
+	while(1){
+
+		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&state_et));
+
+		node_state_digest(synch_state, (synch_local_change != NULL) ? *synch_local_change : 0, &digest);
+
+		/*the link table rides on the digest heartbeat*/
+		count = link_quality_report(links, LINK_QUALITY_REPORT_ENTRIES);
+
+		memcpy(msg, STATE_DIGEST, STATE_DIGEST_SIZE);
+		memcpy(msg + STATE_DIGEST_SIZE, &digest, sizeof(digest));
+		memcpy(msg + STATE_DIGEST_SIZE + sizeof(digest), links, count*sizeof(links[0]));
+
+		send_string(msg, STATE_DIGEST_SIZE + sizeof(digest) + count*sizeof(links[0]), UC_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
+
+		radio_queue_print_stats(synch_name);
+
+		etimer_set(&state_et, DIGEST_PERIOD*CLOCK_SECOND);
+	}
+
+	PROCESS_END();
+}
+
+
+PROCESS_THREAD(time_synch_process, ev, data){
+
+	static struct etimer synch_et;
+	struct nettime_request request;
+	char msg[TIME_REQ_SIZE + sizeof(struct nettime_request)];
+
+	PROCESS_BEGIN();
+
+	nettime_init();
+
+	while(1){
+
+		nettime_fill_request(&request);
+
+		memcpy(msg, TIME_REQ, TIME_REQ_SIZE);
+		memcpy(msg + TIME_REQ_SIZE, &request, sizeof(request));
+
+		time_reply_status = NOT_RECEIVED;
+
+		send_string(msg, sizeof(msg), UC_RIME_ADDR, RADIO_QUEUE_COMMAND);
+
+		etimer_set(&synch_et, NETTIME_RETRY*CLOCK_SECOND);
+
+		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&synch_et));
+
+		if(time_reply_status == RECEIVED){
+
+			etimer_set(&synch_et, (NETTIME_PERIOD - NETTIME_RETRY)*CLOCK_SECOND);
+
+			PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&synch_et));
+		}
+	}
+
+	PROCESS_END();
+}
+
+/*-----------------------------------LEDS---------------------------------*/
+
+void save_led_status(void){
+
+	saved_leds = leds_get() & LEDS_ALL;
+	leds_saved = 1;
+}
+
+
+void restore_led_status(void){
+
+	leds_saved = 0;
+
+	leds_off(~saved_leds & LEDS_ALL);
+	leds_on(saved_leds);
+}
+
+
+void switch_leds(unsigned char on, unsigned char off){
+
+	if(leds_saved){
+
+		saved_leds = (saved_leds & ~off) | on;
+		return;
+	}
+
+	leds_off(off);
+	leds_on(on);
+}
@@ -0,0 +1,153 @@
+/*--------------------------------Core------------------------------------
+	Code shared by the four firmwares: status values, rime addresses
+	& channels, message tags, the setup of the radio services, the
+	default runicast callbacks, the senders, the synchronisation of
+	the nodes with the CU and the LED save/restore around the alarm
+	blink.
+
+	The firmwares are linked with --gc-sections (SMALL in the Makefile):
+	each one keeps only the functions of this module it calls.
+------------------------------------------------------------------------*/
+#ifndef CORE_H_
+#define CORE_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "logbuf.h"
+
+//status values
+#define	ACTIVE 					1
+#define	NOT_ACTIVE				0
+#define ON						1
+#define OFF						0
+#define LOCKED					1
+#define UNLOCKED				0
+#define RECEIVED				1
+#define NOT_RECEIVED			0
+
+//rime addresses & channels
+#define NODE1_RIME_ADDR			1
+#define NODE2_RIME_ADDR			2
+#define UC_RIME_ADDR			3
+#define NODE4_RIME_ADDR			4
+#define RUNICAST_CHANNEL		144
+#define BROADCAST_CHANNEL		129
+
+//protocol timing
+#define GATE_PHASE				0	/*of the CU open schedule*/
+#define DOOR_PHASE				1
+#define STATE_RETRY				1	/*seconds between unanswered STATE_REQ*/
+#define DIGEST_PERIOD			60	/*seconds between state digests*/
+#define GET_ALL_JITTER			(CLOCK_SECOND/16)	/*reply slot per rime address*/
+
+//communication values (size with the terminator)
+#define ALARM_ON				"ALARM_ON"
+#define ALARM_ON_SIZE			9
+#define ALARM_OFF				"ALARM_OFF"
+#define ALARM_OFF_SIZE			10
+#define ALARM_ACK				"ALARM_ACK"
+#define ALARM_ACK_SIZE			10
+#define CONFIRM					"CONFIRM"
+#define CONFIRM_SIZE			8
+#define LOCK_GATE				"LOCK"
+#define LOCK_GATE_SIZE			5
+#define UNLOCK_GATE				"UNLOCK"
+#define UNLOCK_GATE_SIZE		7
+#define OPEN_GATE_DOOR			"OPEN"
+#define OPEN_GATE_DOOR_SIZE		5
+#define OPEN_DONE				"OPEN_DONE"
+#define OPEN_DONE_SIZE			10
+#define GET_TEMP				"GET_TEMP"
+#define GET_TEMP_SIZE			9
+#define GET_LOG					"GET_LOG"
+#define GET_LOG_SIZE			8
+#define TEMP_LOG				"TLOG"
+#define TEMP_LOG_SIZE			5
+#define LOG_CREDIT				"TLOG_CREDIT"
+#define LOG_CREDIT_SIZE			12
+#define STATE_REQ				"STATE_REQ"
+#define STATE_REQ_SIZE			10
+#define STATE_REPLY				"STATE"
+#define STATE_REPLY_SIZE		6
+#define STATE_DIGEST			"DIGEST"
+#define STATE_DIGEST_SIZE		7
+#define TIME_REQ				"TIME_REQ"
+#define TIME_REQ_SIZE			9
+#define TIME_REPLY				"TIME"
+#define TIME_REPLY_SIZE			5
+#define GET_LIGHT				"GET_LIGHT"
+#define GET_LIGHT_SIZE			10
+#define GET_ALL					"GET_ALL"
+#define GET_ALL_SIZE			8
+#define ALL_REPLY				"ALL"
+#define ALL_REPLY_SIZE			4
+#define START_COMFORT_BED		"COMFORT"
+#define START_COMFORT_BED_SIZE	8
+#define STOP_COMFORT_BED		"NO_COMFORT"
+#define STOP_COMFORT_BED_SIZE	11
+
+//log events of the shared modules (the firmware ones are below)
+#define LOG_STATE_SYNCHED		0x40	/*uptime ms*/
+#define LOG_TIME_SYNCHED		0x41	/*error ms*/
+#define LOG_CONFIG_CHANGED		0x42	/*config_print_local*/
+#define LOG_COMMAND_FAILED		0x43	/*command, address (confirm.c, CU)*/
+#define LOG_COMMAND_UNTRACKED	0x44	/*command, address*/
+
+/*Trace, deferred log, link quality & radio queue, then the runicast & broadcast connections*/
+void core_radio_open(struct runicast_conn *runicast, const struct runicast_callbacks *runicast_calls,
+	struct broadcast_conn *broadcast, const struct broadcast_callbacks *broadcast_call,
+	void (*print)(const struct logbuf_record *record));
+
+/*Bookkeeping of a received frame, first statement of the receive callbacks*/
+void core_runicast_received(const linkaddr_t *from, uint8_t seqno);
+
+void core_broadcast_received(const linkaddr_t *from);
+
+/*Default runicast outcome callbacks (trace, link quality, next queued frame),
+  on the transmissions counted by runicast (rxmit, 1 at the first try)*/
+void core_runicast_sent(struct runicast_conn *c, const linkaddr_t *to, uint8_t transmissions);
+
+void core_runicast_timedout(struct runicast_conn *c, const linkaddr_t *to, uint8_t transmissions);
+
+/*Queueing a runicast frame with a radio-queue priority*/
+void send_string(char* msg, int size, int rime_addr, int priority);
+
+void send_data(const void* msg, int size, int rime_addr, int priority);
+
+/*Confirming to the CU the execution of a command with the resulting state*/
+void send_confirm(const char* tag, int tag_size, uint8_t cmd, uint8_t seq, uint8_t result);
+
+struct batch_op;
+
+/*Confirming a CU batch (CONFIRM_BATCH) in the class of its operations*/
+void send_batch_confirm(uint8_t seq, uint8_t result, const struct batch_op *ops, int count);
+
+struct node_state;
+
+/*Synchronisation of a node with the CU, autostarted by Node1, Node2 & Node4:
+	- state_synch_process restores the state from flash, requests the CU
+	  snapshot until the reply, then sends the digests with the link table;
+	- time_synch_process keeps the network time (nettime.h)*/
+PROCESS_NAME(state_synch_process);
+PROCESS_NAME(time_synch_process);
+
+/*Before the processes run: name of the node, its state & how it is applied (persist: saving on
+  flash), local_change (NULL if none) flags the digests of a state changed on the node*/
+void core_synch_init(const char *name, struct node_state *state,
+	void (*apply)(const struct node_state *snapshot, int persist), const int *local_change);
+
+/*Applying the CU state snapshot*/
+void handle_state_reply(const char* rcvd_msg);
+
+/*Applying the CU time to the local clock offset*/
+void handle_time_reply(const char* rcvd_msg);
+
+/*Saving the LEDS before the alarm blinks them all & restoring them after*/
+void save_led_status(void);
+
+void restore_led_status(void);
+
+/*Switching LEDS: on the saved status while the alarm blinks, on the LEDS otherwise*/
+void switch_leds(unsigned char on, unsigned char off);
+
+#endif /* CORE_H_ */
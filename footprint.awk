@@ -0,0 +1,167 @@
+# ROM/RAM/stack breakdown per module of a firmware (make <firmware>.footprint)
+#
+#	awk -f footprint.awk -v firmware=CU -v modules="core radio-queue ..." \
+#		-v rom=49152 -v ram=10240 CU.sky.map obj_sky/*.su CU.su
+#
+# The link map (-Wl,-Map) gives the input sections kept by --gc-sections:
+# .text/.rodata/.vectors count as ROM, .data as ROM & RAM, .bss/.noinit/
+# COMMON as RAM. The stack usage files (-fstack-usage) give the largest
+# frame of each module. Objects of the project are reported by module,
+# the Contiki archive as "contiki", the C runtime & libraries as "libc".
+
+function module_of(file,    name, n, parts) {
+
+	if(file ~ /contiki-[^\/]*\.a\(/)
+		return "contiki"
+
+	if(file ~ /\.a\(/)
+		return "libc"
+
+	n = split(file, parts, "/")
+	name = parts[n]
+	sub(/\.(o|co|c)$/, "", name)
+
+	if(name == firmware || (name in project))
+		return name ".c"
+
+	return (file ~ /^obj_/) ? "contiki" : "libc"
+}
+
+# the map sizes are hexadecimal (strtonum is gawk only)
+function hex(s,    i, v) {
+
+	s = tolower(s)
+	sub(/^0x/, "", s)
+	v = 0
+
+	for(i = 1; i <= length(s); i++)
+		v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+
+	return v
+}
+
+function account(section, size, file,    m) {
+
+	m = module_of(file)
+	size = hex(size)
+	seen[m] = 1
+
+	if(section ~ /^\.(text|rodata|vectors)/)
+		mod_rom[m] += size
+	else if(section ~ /^\.data/){
+
+		mod_rom[m] += size
+		mod_ram[m] += size
+		data += size
+
+	}else if(section ~ /^\.(bss|noinit)/){
+
+		mod_ram[m] += size
+		bss += size
+	}
+}
+
+BEGIN {
+
+	n = split(modules, list, " ")
+
+	for(i = 1; i <= n; i++)
+		project[list[i]] = 1
+}
+
+# ------------------------------ link map ------------------------------
+
+FILENAME ~ /\.map$/ && /^Linker script and memory map/ { in_map = 1; next }
+
+FILENAME ~ /\.map$/ && in_map {
+
+	# output section
+	if($0 ~ /^[._A-Za-z]/){
+
+		output = $1
+		next
+	}
+
+	if(output !~ /^\.(text|rodata|vectors|data|bss|noinit)/)
+		next
+
+	# input section, the name alone on its line when long
+	if(pending != ""){
+
+		if(NF >= 3 && $1 ~ /^0x/ && $2 ~ /^0x/)
+			account(output, $2, $3)
+
+		pending = ""
+		next
+	}
+
+	if($0 ~ /^ (\.|COMMON)/){
+
+		if(NF == 1)
+			pending = $1
+		else if(NF >= 4 && $2 ~ /^0x/ && $3 ~ /^0x/)
+			account(output, $3, $4)
+	}
+
+	next
+}
+
+# --------------------------- stack usage (.su) --------------------------
+
+FILENAME ~ /\.su$/ {
+
+	split($1, where, ":")
+	m = module_of(where[1])
+
+	# the sources of the archive objects
+	if(m == "libc")
+		m = "contiki"
+
+	if(!(m in seen))
+		next
+
+	if($2 + 0 > frame[m]){
+
+		frame[m] = $2 + 0
+		frame_fn[m] = where[4]
+	}
+
+	if($3 != "static")
+		dynamic[m] = 1
+}
+
+# -------------------------------- report --------------------------------
+
+END {
+
+	for(m in seen){
+
+		total_rom += mod_rom[m]
+		total_ram += mod_ram[m]
+	}
+
+	printf("%s: ROM %d/%d B, RAM %d/%d B (data %d, bss %d), %d B left for the stack & heap\n\n",
+		firmware, total_rom, rom, total_ram, ram, data, bss, ram - total_ram)
+
+	printf("%-20s %8s %8s %8s  %s\n", "module", "ROM", "RAM", "frame", "largest frame")
+
+	# largest ROM first
+	n = 0
+	for(m in seen)
+		order[++n] = m
+
+	for(i = 2; i <= n; i++)
+		for(j = i; j > 1 && mod_rom[order[j]] > mod_rom[order[j - 1]]; j--){
+
+			t = order[j]
+			order[j] = order[j - 1]
+			order[j - 1] = t
+		}
+
+	for(i = 1; i <= n; i++){
+
+		m = order[i]
+		printf("%-20s %8d %8d %8s  %s%s\n", m, mod_rom[m], mod_ram[m], (m in frame) ? frame[m] : "-",
+			frame_fn[m], dynamic[m] ? " (dynamic frames)" : "")
+	}
+}
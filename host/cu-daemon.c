@@ -0,0 +1,959 @@
+/*------------------------------CU Daemon---------------------------------
+	Host-side ingest of the binary framed serial output of the CU
+	(see ../serial-frame.h).
+
+	The serial line is read in non-blocking chunks and decoded by a
+	SLIP state machine; frames with a bad crc16 or length are counted
+	and dropped, bytes outside frames (text, boot noise) are skipped.
+	The latest payload of every (type, node) is kept and served to
+	clients of a UNIX socket: one query per line, text answer.
+
+		STATE | TEMP | LIGHT | READINGS | OPENING | CONFIRMS
+		AGGREGATE | LOG | CONFIG | OTA | STATS | ALL
+
+	Usage: cu-daemon [-b] [-s socket] [-t trace] [-x seconds] <tty | file | ->
+	       cu-daemon -g seconds [-p]
+		-b	input is a byte stream (file/stdin), do not set up a tty
+		-t	append the trace records (TRACE_CONF_ENABLED firmware) to
+			a file, as received, for host/sim/replay
+		-g	write to stdout the test stream of seconds of a 115200
+			baud line (8N1): frames of every type with random
+			payloads (escapes included) between lines of text
+		-p	pace the test stream at the line rate
+		-x	exit at the end of the input, failing unless it decoded
+			exactly the frames of the test stream of seconds without
+			crc, length or overrun errors, at the line rate at least
+			(make check)
+------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../serial-frame.h"
+
+#define DEFAULT_SOCKET		"/tmp/cu-daemon.sock"
+#define READ_CHUNK			4096
+#define MAX_NODES			256
+#define MAX_CLIENTS			16
+#define MAX_EVENTS			(MAX_CLIENTS + 2)
+#define LINE_SIZE			64
+#define REPLY_SIZE			8192
+#define LOG_HISTORY			64
+#define LINE_BAUD			115200
+#define LINE_BYTES_S		(LINE_BAUD/10)		/*8N1*/
+#define TEST_CHUNK			64
+#define TEST_TEXT_EVERY		4					/*frames between two text lines*/
+
+/*type, node, payload, crc*/
+#define FRAME_MAX_SIZE		(2 + SERIAL_FRAME_MAX_PAYLOAD + 2)
+
+struct decoder {
+
+	uint8_t buf[FRAME_MAX_SIZE];
+	int len;
+	int in_frame;
+	int escaped;
+	int overrun;
+};
+
+struct slot {
+
+	int valid;
+	int size;
+	uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD];
+	unsigned long count;
+};
+
+struct client {
+
+	int fd;
+	char line[LINE_SIZE];
+	int len;
+};
+
+static struct slot latest[SERIAL_FRAME_TYPES][MAX_NODES];
+static struct client clients[MAX_CLIENTS];
+static struct decoder dec;
+
+static uint8_t log_history[LOG_HISTORY][SERIAL_FRAME_MAX_PAYLOAD];
+static int log_head = 0;
+static int log_count = 0;
+
+static unsigned long bytes_read = 0;
+static unsigned long frames_ok = 0;
+static unsigned long crc_errors = 0;
+static unsigned long bad_frames = 0;		/*short or unknown type*/
+static unsigned long overruns = 0;
+static unsigned long noise_bytes = 0;
+static FILE *trace_file = NULL;
+static struct timespec first_read, last_read;
+static double decode_time = 0;					/*s, -x*/
+
+static const char *type_names[SERIAL_FRAME_TYPES] = {
+	"?", "BOOT", "STATE", "TEMP_STATS", "LIGHT", "READING", "CONFIRM", "OPENING", "AGGREGATE", "LOG", "TRACE", "CONFIG",
+	"OTA"
+};
+
+static const char *confirm_names[] = { "ALARM", "GATE", "OPEN", "COMFORT", "BATCH", "CONFIG" };
+
+/*config.h keys*/
+static const char *config_names[] = { "period", "ack", "retx", "temp_min", "temp_optimal", "temp_max", "control", "band",
+	"min_cycle" };
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+/*Same algorithm as Contiki lib/crc16.c*/
+static uint16_t crc16_add(uint8_t b, uint16_t acc){
+
+	acc ^= b;
+	acc = (acc >> 8) | (acc << 8);
+	acc ^= (acc & 0xff00) << 4;
+	acc ^= (acc >> 8) >> 4;
+	acc ^= (acc & 0xff00) >> 5;
+
+	return acc;
+}
+
+/*The payloads are little-endian firmware structs: explicit field decoding*/
+static uint16_t u16(const uint8_t *p){ return p[0] | (p[1] << 8); }
+static int16_t i16(const uint8_t *p){ return (int16_t)u16(p); }
+static uint32_t u32(const uint8_t *p){ return u16(p) | ((uint32_t)u16(p + 2) << 16); }
+
+/*Minimum payload size of each type*/
+static int payload_size(int type){
+
+	switch(type){
+
+		case SERIAL_FRAME_BOOT:			return 0;
+		case SERIAL_FRAME_STATE:		return 8;
+		case SERIAL_FRAME_TEMP_STATS:	return 16;
+		case SERIAL_FRAME_LIGHT:
+		case SERIAL_FRAME_READING:
+		case SERIAL_FRAME_OPENING:		return 8;
+		case SERIAL_FRAME_CONFIRM:		return 6;
+		case SERIAL_FRAME_AGGREGATE:	return 16;
+		case SERIAL_FRAME_LOG:			return 6;
+		case SERIAL_FRAME_TRACE:		return 4;
+		case SERIAL_FRAME_CONFIG:		return 2;
+		case SERIAL_FRAME_OTA:			return 16;
+		default:						return -1;
+	}
+}
+
+/*Writing a frame back in SLIP for the replay*/
+static void save_trace(const uint8_t *frame, int len){
+
+	int i;
+
+	fputc(SERIAL_FRAME_END, trace_file);
+
+	for(i=0; i<len; i++){
+
+		if(frame[i] == SERIAL_FRAME_END){
+
+			fputc(SERIAL_FRAME_ESC, trace_file);
+			fputc(SERIAL_FRAME_ESC_END, trace_file);
+
+		}else if(frame[i] == SERIAL_FRAME_ESC){
+
+			fputc(SERIAL_FRAME_ESC, trace_file);
+			fputc(SERIAL_FRAME_ESC_ESC, trace_file);
+
+		}else
+			fputc(frame[i], trace_file);
+	}
+
+	fputc(SERIAL_FRAME_END, trace_file);
+	fflush(trace_file);
+}
+
+static void handle_frame(const uint8_t *frame, int len){
+
+	uint16_t crc = 0;
+	int type, node, size, i;
+	struct slot *s;
+
+	if(len < 4){
+
+		bad_frames++;
+		return;
+	}
+
+	for(i=0; i<len-2; i++)
+		crc = crc16_add(frame[i], crc);
+
+	if(crc != u16(frame + len - 2)){
+
+		crc_errors++;
+		return;
+	}
+
+	type = frame[0];
+	node = frame[1];
+	size = len - 4;
+
+	if(type <= 0 || type >= SERIAL_FRAME_TYPES || size < payload_size(type)){
+
+		bad_frames++;
+		return;
+	}
+
+	frames_ok++;
+
+	s = &latest[type][node];
+	s->valid = 1;
+	s->size = size;
+	s->count++;
+	memcpy(s->payload, frame + 2, size);
+
+	if(type == SERIAL_FRAME_TRACE && trace_file != NULL)
+		save_trace(frame, len);
+
+	if(type == SERIAL_FRAME_LOG){
+
+		memcpy(log_history[log_head], frame + 2, size);
+		log_head = (log_head + 1) % LOG_HISTORY;
+
+		if(log_count < LOG_HISTORY)
+			log_count++;
+	}
+}
+
+/*SLIP state machine, fed byte by byte*/
+static void decode(uint8_t b){
+
+	if(b == SERIAL_FRAME_END){
+
+		/*a closing END: the text up to the next leading END is noise*/
+		if(dec.in_frame && dec.len > 0){
+
+			if(!dec.overrun)
+				handle_frame(dec.buf, dec.len);
+
+			dec.in_frame = 0;
+
+		}else
+			dec.in_frame = 1;
+
+		dec.len = 0;
+		dec.escaped = 0;
+		dec.overrun = 0;
+		return;
+	}
+
+	if(!dec.in_frame){
+
+		noise_bytes++;
+		return;
+	}
+
+	if(dec.escaped){
+
+		dec.escaped = 0;
+
+		if(b == SERIAL_FRAME_ESC_END)
+			b = SERIAL_FRAME_END;
+		else if(b == SERIAL_FRAME_ESC_ESC)
+			b = SERIAL_FRAME_ESC;
+		else{
+
+			/*protocol violation: resynchronize on the next END*/
+			bad_frames++;
+			dec.in_frame = 0;
+			return;
+		}
+
+	}else if(b == SERIAL_FRAME_ESC){
+
+		dec.escaped = 1;
+		return;
+	}
+
+	if(dec.len == FRAME_MAX_SIZE){
+
+		if(!dec.overrun)
+			overruns++;
+
+		dec.overrun = 1;
+		return;
+	}
+
+	dec.buf[dec.len++] = b;
+}
+
+/*---------------------------------QUERIES--------------------------------*/
+
+#define APPEND(...)		(n += snprintf(out + n, (n < size) ? size - n : 0, __VA_ARGS__))
+
+static int print_state(char *out, int size){
+
+	int node, n = 0;
+
+	for(node=0; node<MAX_NODES; node++){
+
+		const struct slot *s = &latest[SERIAL_FRAME_STATE][node];
+
+		if(!s->valid)
+			continue;
+
+		APPEND("STATE [%d:0] alarm %s gate %s comfort %s version %u thresholds %d/%d/%d\n", node,
+			s->payload[0] ? "ON" : "OFF", s->payload[1] ? "LOCKED" : "UNLOCKED", s->payload[2] ? "ON" : "OFF",
+			s->payload[3], (int8_t)s->payload[4], (int8_t)s->payload[5], (int8_t)s->payload[6]);
+	}
+
+	return n;
+}
+
+static int print_temp(char *out, int size){
+
+	int node, n = 0;
+
+	for(node=0; node<MAX_NODES; node++){
+
+		const uint8_t *p = latest[SERIAL_FRAME_TEMP_STATS][node].payload;
+		int mean;
+
+		if(!latest[SERIAL_FRAME_TEMP_STATS][node].valid)
+			continue;
+
+		mean = i16(p + 6);
+
+		APPEND("TEMP [%d:0] time %lu (+-%u ms) mean %s%d.%02d variance %u.%02u min %d max %d samples %u\n", node,
+			(unsigned long)u32(p), u16(p + 4), (mean < 0) ? "-" : "", abs(mean) / 100, abs(mean) % 100,
+			u16(p + 8) / 100, u16(p + 8) % 100, i16(p + 10), i16(p + 12), u16(p + 14));
+	}
+
+	return n;
+}
+
+static int print_readings(char *out, int size, int type, const char *name){
+
+	int node, n = 0;
+
+	for(node=0; node<MAX_NODES; node++){
+
+		const uint8_t *p = latest[type][node].payload;
+
+		if(!latest[type][node].valid)
+			continue;
+
+		APPEND("%s [%d:0] time %lu (+-%u ms) value %d\n", name, node, (unsigned long)u32(p), u16(p + 4), i16(p + 6));
+	}
+
+	return n;
+}
+
+static int print_confirms(char *out, int size){
+
+	int node, n = 0;
+
+	for(node=0; node<MAX_NODES; node++){
+
+		const struct slot *s = &latest[SERIAL_FRAME_CONFIRM][node];
+		const uint8_t *p = s->payload;
+
+		if(!s->valid)
+			continue;
+
+		APPEND("CONFIRM [%d:0] last %s seq %u state %u in %u ms (%lu confirmations)\n", node,
+			(p[0] < sizeof(confirm_names)/sizeof(confirm_names[0])) ? confirm_names[p[0]] : "?",
+			p[1], p[2], u16(p + 4), s->count);
+	}
+
+	return n;
+}
+
+static int print_aggregate(char *out, int size){
+
+	int node, n = 0;
+
+	for(node=0; node<MAX_NODES; node++){
+
+		const uint8_t *p = latest[SERIAL_FRAME_AGGREGATE][node].payload;
+		long sum, mean;
+		unsigned count;
+
+		if(!latest[SERIAL_FRAME_AGGREGATE][node].valid)
+			continue;
+
+		sum = (int32_t)u32(p + 4);
+		count = u16(p + 8);
+
+		if(count == 0){
+
+			APPEND("HOUSE epoch %lu no samples late %u\n", (unsigned long)u32(p), p[15]);
+			continue;
+		}
+
+		mean = sum * 100 / (long)count;
+
+		APPEND("HOUSE epoch %lu mean %s%ld.%02ld min %d max %d sensors %u samples %u late %u\n", (unsigned long)u32(p),
+			(mean < 0) ? "-" : "", labs(mean) / 100, labs(mean) % 100, i16(p + 10), i16(p + 12), p[14], count, p[15]);
+	}
+
+	return n;
+}
+
+static int print_log(char *out, int size){
+
+	int i, n = 0;
+
+	for(i=0; i<log_count; i++){
+
+		const uint8_t *p = log_history[(log_head - log_count + i + LOG_HISTORY) % LOG_HISTORY];
+
+		APPEND("LOG %lu %d\n", (unsigned long)u32(p), i16(p + 4));
+	}
+
+	return n;
+}
+
+static int print_config(char *out, int size){
+
+	int node, i, n = 0;
+
+	for(node=0; node<MAX_NODES; node++){
+
+		const struct slot *s = &latest[SERIAL_FRAME_CONFIG][node];
+		const uint8_t *p = s->payload;
+
+		if(!s->valid)
+			continue;
+
+		APPEND("CONFIG [%d:0] version %u", node, p[0]);
+
+		/*config_entry: key, pad, value*/
+		for(i=0; i<p[1] && 2 + 4*(i + 1) <= s->size; i++)
+			APPEND(" %s %d", (p[2 + 4*i] < sizeof(config_names)/sizeof(config_names[0])) ?
+				config_names[p[2 + 4*i]] : "?", i16(p + 2 + 4*i + 2));
+
+		APPEND("\n");
+	}
+
+	return n;
+}
+
+static int print_ota(char *out, int size){
+
+	static const char *outcomes[] = {"stored", "rebooting", "installed", "staged, not installed"};
+	int node, n = 0;
+
+	for(node=0; node<MAX_NODES; node++){
+
+		const struct slot *s = &latest[SERIAL_FRAME_OTA][node];
+		const uint8_t *p = s->payload;
+
+		if(!s->valid)
+			continue;
+
+		/*serial_frame_ota, outcome of ota.h*/
+		APPEND("OTA [%d:0] version %u %s rollout %u ms received %u B sent %u B\n", node, p[0],
+			(p[1] < 4) ? outcomes[p[1]] : "?", u32(p + 4), u32(p + 8), u32(p + 12));
+	}
+
+	return n;
+}
+
+static int print_stats(char *out, int size){
+
+	int type, node, n = 0;
+
+	APPEND("STATS bytes %lu frames %lu crc_errors %lu bad %lu overruns %lu noise %lu\n",
+		bytes_read, frames_ok, crc_errors, bad_frames, overruns, noise_bytes);
+
+	for(type=1; type<SERIAL_FRAME_TYPES; type++){
+
+		unsigned long count = 0;
+
+		for(node=0; node<MAX_NODES; node++)
+			count += latest[type][node].count;
+
+		if(count > 0)
+			APPEND("STATS %s %lu\n", type_names[type], count);
+	}
+
+	return n;
+}
+
+static int answer(const char *query, char *out, int size){
+
+	int n = 0;
+
+	if(strcmp(query, "STATE") == 0)
+		return print_state(out, size);
+
+	if(strcmp(query, "TEMP") == 0)
+		return print_temp(out, size);
+
+	if(strcmp(query, "LIGHT") == 0)
+		return print_readings(out, size, SERIAL_FRAME_LIGHT, "LIGHT");
+
+	if(strcmp(query, "READINGS") == 0)
+		return print_readings(out, size, SERIAL_FRAME_READING, "READING");
+
+	if(strcmp(query, "OPENING") == 0)
+		return print_readings(out, size, SERIAL_FRAME_OPENING, "OPENING");
+
+	if(strcmp(query, "CONFIRMS") == 0)
+		return print_confirms(out, size);
+
+	if(strcmp(query, "AGGREGATE") == 0)
+		return print_aggregate(out, size);
+
+	if(strcmp(query, "LOG") == 0)
+		return print_log(out, size);
+
+	if(strcmp(query, "CONFIG") == 0)
+		return print_config(out, size);
+
+	if(strcmp(query, "OTA") == 0)
+		return print_ota(out, size);
+
+	if(strcmp(query, "STATS") == 0)
+		return print_stats(out, size);
+
+	if(strcmp(query, "ALL") == 0){
+
+		n += print_state(out + n, size - n);
+		n += print_temp(out + n, (n < size) ? size - n : 0);
+		n += print_readings(out + n, (n < size) ? size - n : 0, SERIAL_FRAME_LIGHT, "LIGHT");
+		n += print_readings(out + n, (n < size) ? size - n : 0, SERIAL_FRAME_READING, "READING");
+		n += print_confirms(out + n, (n < size) ? size - n : 0);
+		n += print_aggregate(out + n, (n < size) ? size - n : 0);
+		n += print_config(out + n, (n < size) ? size - n : 0);
+		n += print_ota(out + n, (n < size) ? size - n : 0);
+		n += print_stats(out + n, (n < size) ? size - n : 0);
+		return n;
+	}
+
+	APPEND("ERROR unknown query '%s'\n", query);
+	return n;
+}
+
+/*----------------------------THROUGHPUT CHECK----------------------------*/
+
+static double elapsed(const struct timespec *from, const struct timespec *to){
+
+	return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static void put_byte(uint8_t *out, int *len, uint8_t b){
+
+	if(b == SERIAL_FRAME_END){
+
+		out[(*len)++] = SERIAL_FRAME_ESC;
+		out[(*len)++] = SERIAL_FRAME_ESC_END;
+
+	}else if(b == SERIAL_FRAME_ESC){
+
+		out[(*len)++] = SERIAL_FRAME_ESC;
+		out[(*len)++] = SERIAL_FRAME_ESC_ESC;
+
+	}else
+		out[(*len)++] = b;
+}
+
+/*
+ *	Test stream of seconds of the line, written to fd (-1: only counted),
+ *	paced at the line rate or as fast as the reader takes it.
+ *	Returns the number of frames, the same for the same seconds.
+ */
+static unsigned long test_stream(int seconds, int fd, int paced){
+
+	static const char text[] = "Temperature Average: 21.50 Std.Dev: 0.12 Min: 21 Max: 22\n";
+	uint8_t out[2 * (FRAME_MAX_SIZE + 2) + sizeof(text)];
+	unsigned long budget = (unsigned long)seconds * LINE_BYTES_S, sent = 0, flushed = 0, frames = 0;
+	uint32_t rng = 1;
+	struct timespec start, now, wait;
+	uint16_t crc;
+	uint8_t b;
+	int len, size, type, i, n;
+	double due;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for(;;){
+
+		len = 0;
+		type = 1 + frames % (SERIAL_FRAME_TYPES - 1);
+		size = payload_size(type) + frames % 8;
+		crc = 0;
+
+		if(frames % TEST_TEXT_EVERY == 0){
+
+			memcpy(out, text, sizeof(text) - 1);
+			len = sizeof(text) - 1;
+		}
+
+		out[len++] = SERIAL_FRAME_END;
+
+		for(i=0; i<2+size; i++){
+
+			/*xorshift32: every byte value, END & ESC included*/
+			rng ^= rng << 13;
+			rng ^= rng >> 17;
+			rng ^= rng << 5;
+
+			b = (i == 0) ? (uint32_t)type : (i == 1) ? rng % 8 : rng >> 24;
+			crc = crc16_add(b, crc);
+			put_byte(out, &len, b);
+		}
+
+		put_byte(out, &len, crc & 0xFF);
+		put_byte(out, &len, crc >> 8);
+		out[len++] = SERIAL_FRAME_END;
+
+		if(sent + len > budget)
+			break;
+
+		frames++;
+		sent += len;
+
+		for(i=0; fd >= 0 && i<len; i+=n){
+
+			n = (len - i < TEST_CHUNK) ? len - i : TEST_CHUNK;
+
+			if(paced){
+			/*a chunk is not written before the line would have carried it*/
+
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				due = (double)(flushed + n) / LINE_BYTES_S - elapsed(&start, &now);
+
+				if(due > 0){
+
+					wait.tv_sec = (time_t)due;
+					wait.tv_nsec = (long)((due - wait.tv_sec) * 1e9);
+					nanosleep(&wait, NULL);
+				}
+			}
+
+			if(write(fd, out + i, n) != n){
+
+				perror("write");
+				exit(1);
+			}
+
+			flushed += n;
+		}
+	}
+
+	return frames;
+}
+
+/*Exit status of -x, on the end of the input*/
+static int check_result(int seconds){
+
+	unsigned long expected = test_stream(seconds, -1, 0);
+	double received = (bytes_read > 0) ? elapsed(&first_read, &last_read) : 0;
+	double capacity = (decode_time > 0) ? bytes_read * 10 / decode_time : 0;
+	int ok = frames_ok == expected && crc_errors == 0 && bad_frames == 0 && overruns == 0 && capacity >= LINE_BAUD;
+
+	/*capacity: baud the decoding alone would sustain*/
+	fprintf(stderr, "CHECK %s: frames %lu of %lu, %lu bytes received in %.2f s, decoding capacity %.0f baud (line %d)\n",
+		ok ? "passed" : "FAILED", frames_ok, expected, bytes_read, received, capacity, LINE_BAUD);
+
+	return !ok;
+}
+
+/*--------------------------------EVENT LOOP------------------------------*/
+
+static int open_serial(const char *path, int bytes){
+
+	struct termios tio;
+	int fd;
+
+	if(strcmp(path, "-") == 0)
+		fd = dup(STDIN_FILENO);
+	else
+		fd = open(path, O_RDONLY | O_NOCTTY);
+
+	if(fd < 0){
+
+		perror(path);
+		return -1;
+	}
+
+	if(!bytes && isatty(fd)){
+
+		if(tcgetattr(fd, &tio) < 0){
+
+			perror("tcgetattr");
+			close(fd);
+			return -1;
+		}
+
+		cfmakeraw(&tio);
+		cfsetispeed(&tio, B115200);
+		cfsetospeed(&tio, B115200);
+		tio.c_cflag |= CLOCAL | CREAD;
+
+		if(tcsetattr(fd, TCSANOW, &tio) < 0){
+
+			perror("tcsetattr");
+			close(fd);
+			return -1;
+		}
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	return fd;
+}
+
+static int open_socket(const char *path){
+
+	struct sockaddr_un addr;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+	if(fd < 0){
+
+		perror("socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	unlink(path);
+
+	if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, MAX_CLIENTS) < 0){
+
+		perror(path);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void drop_client(int epfd, struct client *c){
+
+	epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+	c->fd = -1;
+}
+
+static void accept_clients(int epfd, int lfd){
+
+	struct epoll_event ev;
+	int fd, i;
+
+	while((fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK)) >= 0){
+
+		for(i=0; i<MAX_CLIENTS && clients[i].fd >= 0; i++);
+
+		if(i == MAX_CLIENTS){
+
+			close(fd);
+			continue;
+		}
+
+		clients[i].fd = fd;
+		clients[i].len = 0;
+
+		ev.events = EPOLLIN;
+		ev.data.ptr = &clients[i];
+		epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+	}
+}
+
+static void serve_client(int epfd, struct client *c){
+
+	static char reply[REPLY_SIZE];
+	char buf[256];
+	int r, i, n;
+
+	r = read(c->fd, buf, sizeof(buf));
+
+	if(r == 0 || (r < 0 && errno != EAGAIN)){
+
+		drop_client(epfd, c);
+		return;
+	}
+
+	for(i=0; i<r; i++){
+
+		if(buf[i] == '\r')
+			continue;
+
+		if(buf[i] != '\n'){
+
+			if(c->len < LINE_SIZE - 1)
+				c->line[c->len++] = buf[i];
+
+			continue;
+		}
+
+		c->line[c->len] = '\0';
+		c->len = 0;
+
+		n = answer(c->line, reply, sizeof(reply));
+
+		if(n > REPLY_SIZE - 1)
+			n = REPLY_SIZE - 1;
+
+		/*answers are small: a client that cannot take one is dropped*/
+		if(write(c->fd, reply, n) != n){
+
+			drop_client(epfd, c);
+			return;
+		}
+	}
+}
+
+/*Returns 0 at the end of a byte stream input*/
+static int read_serial(int fd){
+
+	uint8_t buf[READ_CHUNK];
+	struct timespec done;
+	int r, i;
+
+	while((r = read(fd, buf, sizeof(buf))) > 0){
+
+		clock_gettime(CLOCK_MONOTONIC, &last_read);
+
+		if(bytes_read == 0)
+			first_read = last_read;
+
+		bytes_read += r;
+
+		for(i=0; i<r; i++)
+			decode(buf[i]);
+
+		clock_gettime(CLOCK_MONOTONIC, &done);
+		decode_time += elapsed(&last_read, &done);
+	}
+
+	return !(r == 0 || (r < 0 && errno != EAGAIN));
+}
+
+static void usage(const char *name){
+
+	fprintf(stderr, "Usage: %s [-b] [-s socket] [-t trace] [-x seconds] <tty | file | ->\n"
+		"       %s -g seconds [-p]\n", name, name);
+	exit(1);
+}
+
+
+int main(int argc, char **argv){
+
+	const char *socket_path = DEFAULT_SOCKET;
+	struct epoll_event ev, events[MAX_EVENTS];
+	int serial_fd, listen_fd, epfd, bytes = 0, opt, i, n;
+	int serial_open = 1, generate = 0, paced = 0, check = 0;
+	char reply[REPLY_SIZE];
+
+	while((opt = getopt(argc, argv, "bs:t:g:px:")) != -1){
+
+		switch(opt){
+
+			case 'b':	bytes = 1; break;
+			case 'g':	generate = atoi(optarg); break;
+			case 'p':	paced = 1; break;
+			case 'x':	check = atoi(optarg); break;
+			case 's':	socket_path = optarg; break;
+			case 't':
+
+				if((trace_file = fopen(optarg, "ab")) == NULL){
+
+					perror(optarg);
+					return 1;
+				}
+				break;
+
+			default:	usage(argv[0]);
+		}
+	}
+
+	if(generate > 0){
+
+		test_stream(generate, STDOUT_FILENO, paced);
+		return 0;
+	}
+
+	if(optind != argc - 1)
+		usage(argv[0]);
+
+	for(i=0; i<MAX_CLIENTS; i++)
+		clients[i].fd = -1;
+
+	serial_fd = open_serial(argv[optind], bytes);
+	listen_fd = open_socket(socket_path);
+
+	if(serial_fd < 0 || listen_fd < 0)
+		return 1;
+
+	epfd = epoll_create1(0);
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+	/*regular files cannot be polled: drained once, then only clients are served*/
+	ev.data.ptr = &serial_fd;
+
+	if(epoll_ctl(epfd, EPOLL_CTL_ADD, serial_fd, &ev) < 0){
+
+		while(read_serial(serial_fd));
+
+		close(serial_fd);
+		serial_open = 0;
+
+		answer("STATS", reply, sizeof(reply));
+		fputs(reply, stderr);
+
+		if(check > 0)
+			return check_result(check);
+	}
+
+	for(;;){
+
+		n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+
+		if(n < 0 && errno != EINTR){
+
+			perror("epoll_wait");
+			return 1;
+		}
+
+		for(i=0; i<n; i++){
+
+			if(events[i].data.ptr == NULL)
+				accept_clients(epfd, listen_fd);
+
+			else if(events[i].data.ptr == &serial_fd){
+
+				if(serial_open && !read_serial(serial_fd)){
+
+					/*end of the stream: the latest state stays available to the clients*/
+					epoll_ctl(epfd, EPOLL_CTL_DEL, serial_fd, NULL);
+					close(serial_fd);
+					serial_open = 0;
+
+					answer("STATS", reply, sizeof(reply));
+					fputs(reply, stderr);
+
+					if(check > 0)
+						return check_result(check);
+				}
+
+			}else
+				serve_client(epfd, (struct client *)events[i].data.ptr);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,275 @@
+/*-------------------------------Comfort----------------------------------
+	Node4 comfort controllers against a thermal model of the bedroom.
+
+	Usage:	comfort [-m legacy|hysteresis|pi] [-d days] [-b band] [-c min_cycle]
+					[-i initial] [-o outside] [-n noise] [-e tolerance] [-s seed]
+
+	The room is a first order model (time constant ROOM_TAU) heated by
+	the air-conditioner through a radiator lag (HEATER_TAU): the
+	heater power settles HEATER_RISE °C above the outside temperature,
+	which swings by OUTSIDE_SWING around -o over the day. The room
+	starts at -i °C with the AC off.
+
+	Every controller runs the Node4 comfort loop: a tick of 2 s, the
+	SHT11 read (room + gaussian noise of -n hundredths, quantised to
+	the raw value) at the periods of the adaptive sampler (fast near
+	15/23 °C and the band edges), and the thresholds 15/19/23 °C:
+		- legacy: the decision of Node4 before comfort-control.c, on
+		  the integer reading & the average of the 5 previous ones;
+		- hysteresis, pi: ../../comfort-control.c with band -b (1/10
+		  °C) and minimum on/off time -c (s), the defaults of Node4.
+	The exit status is 1 when the default mode of Node4 (pi) does not
+	settle in the first half of the run or has a larger mean absolute
+	error than the legacy logic (its starts are bounded by -c).
+	All the controllers see the same noise (-s seed), one line each:
+	AC starts per hour, shortest on & off times, settling time (last
+	time the room was out of optimal +- -e hundredths of °C), then,
+	from the first time the room reached the optimum, the overshoot,
+	mean absolute & RMS error, and the AC on time.
+------------------------------------------------------------------------*/
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../../adaptive-sampling.h"
+#include "../../comfort-control.h"
+
+#define TICK					2		/*s, COMFORT_BLINK_INTERVAL of Node4*/
+#define ROOM_TAU				7200.0	/*s*/
+#define HEATER_TAU				300.0	/*s*/
+#define HEATER_RISE				20.0	/*°C above outside, AC always on*/
+#define OUTSIDE_SWING			4.0		/*°C*/
+#define TEMPERATURE_INTERVAL	60		/*Node4 sampling periods (s)*/
+#define TEMPERATURE_MIN_INTERVAL	20
+#define TEMPERATURE_MAX_INTERVAL	300
+#define LEGACY					-1
+#define DEFAULT_MODE			COMFORT_PI	/*COMFORT_CONTROL_MODE of Node4*/
+
+struct result {
+
+	unsigned long starts;
+	unsigned long on_s;
+	unsigned long min_on, min_off;	/*s, completed cycles (0 if none)*/
+	long settle;					/*s*/
+	double overshoot;				/*°C*/
+	double abs_err, sq_err;			/*°C, from the first crossing*/
+	unsigned long err_n;
+};
+
+static int thresholds[] = {15, 19, 23};
+static int sampling_thresholds[4];	/*set_sampling_thresholds of Node4*/
+static double days = 2, initial = 12, outside = 8, noise = 10;
+static int band = 15, min_cycle = 180, tolerance = 100;
+static unsigned long seed = 1;
+static uint64_t rng;
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+static double rng_uniform(void){
+
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+
+	return ((rng >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double rng_normal(void){
+
+	return sqrt(-2 * log(rng_uniform())) * cos(2 * M_PI * rng_uniform());
+}
+
+/*Node4 before comfort-control.c*/
+static int legacy_decide(int on, int temperature, int avg){
+
+	if(temperature <= thresholds[0] || avg < thresholds[1])
+		return 1;
+
+	if(temperature >= thresholds[2] || avg > thresholds[1])
+		return 0;
+
+	return on;
+}
+
+static void simulate(int mode, struct result *r){
+
+	struct adaptive_sampler sampler;
+	struct comfort_control cc;
+	double room = initial, heater = 0, out, err;
+	unsigned long t, end = (unsigned long)(days * 86400), since = 0;
+	int history[5], interval = 0, samples = 0, on = 0, next, raw, temperature, avg, crossed = 0, i, s;
+
+	memset(r, 0, sizeof(*r));
+	rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+	sampling_thresholds[0] = thresholds[0];
+	sampling_thresholds[1] = thresholds[1] - (band + 5) / 10;
+	sampling_thresholds[2] = thresholds[1] + (band + 5) / 10;
+	sampling_thresholds[3] = thresholds[2];
+
+	adaptive_sampling_init(&sampler, TEMPERATURE_INTERVAL, TEMPERATURE_MIN_INTERVAL, TEMPERATURE_MAX_INTERVAL,
+							sampling_thresholds, 4);
+	comfort_control_init(&cc, thresholds, thresholds[1]*100);
+	comfort_control_configure(&cc, (mode == LEGACY) ? COMFORT_HYSTERESIS : mode, band*10, min_cycle);
+
+	for(t=0; t<end; t+=TICK){
+
+		next = on;
+
+		if(interval <= TICK){
+
+			raw = (int)lround(room * 100 + noise * rng_normal()) + 3960;
+			temperature = sht11_to_celsius(raw);
+
+			if(samples++ == 0){
+
+				for(i=0; i<5; i++)
+					history[i] = temperature;
+
+				avg = temperature;
+
+			}else
+				avg = shift_last_temps(history, temperature);
+
+			interval = adaptive_sampling_next(&sampler, history, 5);
+
+			if(mode == LEGACY)
+				next = legacy_decide(on, temperature, avg);
+			else
+				comfort_control_measure(&cc, raw - 3960);
+		}
+
+		if(mode != LEGACY){
+
+			comfort_control_step(&cc, TICK);
+			next = cc.on;
+		}
+
+		interval -= TICK;
+
+		if(next != on){
+
+			/*the off time before the first start is not a cycle*/
+			if(on && (r->min_on == 0 || t - since < r->min_on))
+				r->min_on = t - since;
+			else if(!on && r->starts > 0 && (r->min_off == 0 || t - since < r->min_off))
+				r->min_off = t - since;
+
+			r->starts += next;
+			on = next;
+			since = t;
+		}
+
+		/*model, 1 s Euler steps*/
+		for(s=0; s<TICK; s++){
+
+			out = outside + OUTSIDE_SWING * sin(2 * M_PI * ((t + s) / 86400.0 - 0.375));
+			heater += ((on ? HEATER_RISE : 0) - heater) / HEATER_TAU;
+			room += (out + heater - room) / ROOM_TAU;
+		}
+
+		r->on_s += on ? TICK : 0;
+		err = room - thresholds[1];
+
+		if(fabs(err) * 100 > tolerance)
+			r->settle = t + TICK;
+
+		if(err >= 0)
+			crossed = 1;
+
+		if(crossed){
+
+			if(err > r->overshoot)
+				r->overshoot = err;
+
+			r->abs_err += fabs(err);
+			r->sq_err += err * err;
+			r->err_n++;
+		}
+	}
+}
+
+static void print_result(const char *name, const struct result *r){
+
+	double hours = days * 24;
+
+	printf("%-11s %8.2f %7lu %8lu %9ld %9.2f %6.3f %6.3f %5.1f\n", name, r->starts / hours,
+		r->min_on, r->min_off, r->settle, r->overshoot, r->err_n ? r->abs_err / r->err_n : 0,
+		r->err_n ? sqrt(r->sq_err / r->err_n) : 0, 100.0 * r->on_s / (days * 86400));
+}
+
+static void usage(void){
+
+	fprintf(stderr, "usage: comfort [-m legacy|hysteresis|pi] [-d days] [-b band] [-c min_cycle]"
+		" [-i initial] [-o outside] [-n noise] [-e tolerance] [-s seed]\n");
+	exit(1);
+}
+
+
+int main(int argc, char *argv[]){
+
+	static const struct { const char *name; int mode; } modes[] = {
+		{"legacy", LEGACY}, {"hysteresis", COMFORT_HYSTERESIS}, {"pi", COMFORT_PI}
+	};
+	struct result r;
+	const char *only = NULL;
+	double legacy_mae = 0, default_mae = 0;
+	long default_settle = 0;
+	int opt, i, compared = 0;
+
+	while((opt = getopt(argc, argv, "m:d:b:c:i:o:n:e:s:")) != -1){
+
+		switch(opt){
+
+			case 'm': only = optarg; break;
+			case 'd': days = atof(optarg); break;
+			case 'b': band = atoi(optarg); break;
+			case 'c': min_cycle = atoi(optarg); break;
+			case 'i': initial = atof(optarg); break;
+			case 'o': outside = atof(optarg); break;
+			case 'n': noise = atof(optarg); break;
+			case 'e': tolerance = atoi(optarg); break;
+			case 's': seed = strtoul(optarg, NULL, 10); break;
+			default: usage();
+		}
+	}
+
+	if(optind != argc || days <= 0 || band < 0 || min_cycle < 0 || tolerance <= 0)
+		usage();
+
+	printf("%.1f days, room from %.1f C, outside %.1f +- %.1f C, noise %.2f C, band %.1f C, min cycle %d s\n",
+		days, initial, outside, OUTSIDE_SWING, noise / 100, band / 10.0, min_cycle);
+	printf("controller   starts/h  min on  min off  settle s  overshoot    mae    rms  on %%\n");
+
+	for(i=0; i<3; i++){
+
+		if(only != NULL && strcmp(only, modes[i].name) != 0)
+			continue;
+
+		simulate(modes[i].mode, &r);
+		print_result(modes[i].name, &r);
+
+		if(modes[i].mode == LEGACY){
+
+			legacy_mae = r.err_n ? r.abs_err / r.err_n : 0;
+			compared++;
+
+		}else if(modes[i].mode == DEFAULT_MODE){
+
+			default_mae = r.err_n ? r.abs_err / r.err_n : 0;
+			default_settle = r.settle;
+			compared++;
+		}
+	}
+
+	if(compared == 2 && (default_settle > days * 86400 / 2 || default_mae > legacy_mae)){
+
+		fprintf(stderr, "FAILED: the default mode settles at %ld s with a mae of %.3f, the legacy logic %.3f\n",
+			default_settle, default_mae, legacy_mae);
+		return 1;
+	}
+
+	return 0;
+}
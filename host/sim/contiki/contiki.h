@@ -0,0 +1,118 @@
+/*-----------------------------Contiki Shim-------------------------------
+	Subset of the Contiki 3.0 API used by the firmwares, implemented by
+	../shim.c on the host: protothread processes, event timers, Rime
+	runicast/broadcast and Coffee over a simulated radio, flash and
+	sensors. Same macros and semantics as the Contiki sources.
+------------------------------------------------------------------------*/
+#ifndef CONTIKI_H_
+#define CONTIKI_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef PROJECT_CONF_H
+#include PROJECT_CONF_H
+#endif
+
+typedef unsigned long clock_time_t;
+
+#define CLOCK_SECOND			128		/*Tmote Sky*/
+
+clock_time_t clock_time(void);
+unsigned long clock_seconds(void);
+
+/*local continuations & protothreads (switch implementation)*/
+typedef unsigned short lc_t;
+
+#define LC_INIT(s)				s = 0;
+#define LC_RESUME(s)			switch(s) { case 0:
+#define LC_SET(s)				s = __LINE__; case __LINE__:
+#define LC_END(s)				}
+
+struct pt {
+
+	lc_t lc;
+};
+
+#define PT_WAITING				0
+#define PT_YIELDED				1
+#define PT_EXITED				2
+#define PT_ENDED				3
+
+#define PT_THREAD(name_args)	char name_args
+#define PT_INIT(pt)				LC_INIT((pt)->lc)
+#define PT_EXIT(pt)				do { PT_INIT(pt); return PT_EXITED; } while(0)
+
+/*processes*/
+typedef unsigned char process_event_t;
+typedef void *process_data_t;
+typedef unsigned char process_num_events_t;
+
+struct process {
+
+	struct process *next;
+	const char *name;
+	PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
+	struct pt pt;
+	unsigned char state, needspoll;
+};
+
+#define PROCESS_NONE			NULL
+#define PROCESS_BROADCAST		NULL
+
+#define PROCESS_ERR_OK			0
+#define PROCESS_ERR_FULL		1
+
+#define PROCESS_EVENT_NONE		0x80
+#define PROCESS_EVENT_INIT		0x81
+#define PROCESS_EVENT_POLL		0x82
+#define PROCESS_EVENT_EXIT		0x83
+#define PROCESS_EVENT_SERVICE_REMOVED	0x84
+#define PROCESS_EVENT_CONTINUE	0x85
+#define PROCESS_EVENT_MSG		0x86
+#define PROCESS_EVENT_EXITED	0x87
+#define PROCESS_EVENT_TIMER		0x88
+#define PROCESS_EVENT_COM		0x89
+#define PROCESS_EVENT_MAX		0x8a
+
+#define PROCESS_CONF_NUMEVENTS	32
+
+#define PROCESS_BEGIN()					{ char PT_YIELD_FLAG = 1; if(PT_YIELD_FLAG) {;} LC_RESUME(process_pt->lc)
+#define PROCESS_END()					LC_END(process_pt->lc); PT_YIELD_FLAG = 0; PT_INIT(process_pt); return PT_ENDED; }
+#define PROCESS_WAIT_EVENT()			PROCESS_YIELD()
+#define PROCESS_WAIT_EVENT_UNTIL(c)		PROCESS_YIELD_UNTIL(c)
+#define PROCESS_YIELD()					do { PT_YIELD_FLAG = 0; LC_SET(process_pt->lc); if(PT_YIELD_FLAG == 0) return PT_YIELDED; } while(0)
+#define PROCESS_YIELD_UNTIL(c)			do { PT_YIELD_FLAG = 0; LC_SET(process_pt->lc); if((PT_YIELD_FLAG == 0) || !(c)) return PT_YIELDED; } while(0)
+#define PROCESS_WAIT_UNTIL(c)			do { LC_SET(process_pt->lc); if(!(c)) return PT_WAITING; } while(0)
+#define PROCESS_WAIT_WHILE(c)			PROCESS_WAIT_UNTIL(!(c))
+#define PROCESS_EXIT()					PT_EXIT(process_pt)
+#define PROCESS_PAUSE()					do { process_post(PROCESS_CURRENT(), PROCESS_EVENT_CONTINUE, NULL); PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE); } while(0)
+#define PROCESS_EXITHANDLER(handler)	if(ev == PROCESS_EVENT_EXIT) { handler; }
+#define PROCESS_POLLHANDLER(handler)	if(ev == PROCESS_EVENT_POLL) { handler; }
+
+/*ev & data belong to the macro, not every process reads them*/
+#define PROCESS_THREAD(name, ev, data)	static PT_THREAD(process_thread_##name(struct pt *process_pt, \
+											process_event_t ev __attribute__((unused)), \
+											process_data_t data __attribute__((unused))))
+#define PROCESS_NAME(name)				extern struct process name
+#define PROCESS(name, strname)			PROCESS_THREAD(name, ev, data); struct process name = { NULL, strname, process_thread_##name, {0}, 0, 0 }
+#define AUTOSTART_PROCESSES(...)		struct process * const autostart_processes[] = {__VA_ARGS__, NULL}
+
+#define PROCESS_CURRENT()				process_current
+
+extern struct process *process_current;
+
+void process_start(struct process *p, process_data_t data);
+int process_post(struct process *p, process_event_t ev, process_data_t data);
+void process_post_synch(struct process *p, process_event_t ev, process_data_t data);
+void process_exit(struct process *p);
+void process_poll(struct process *p);
+int process_is_running(struct process *p);
+process_event_t process_alloc_event(void);
+
+#include "sys/etimer.h"
+#include "sys/ctimer.h"
+#include "sys/rtimer.h"
+#include "lib/sensors.h"
+
+#endif /* CONTIKI_H_ */
@@ -0,0 +1,8 @@
+#ifndef BUTTON_SENSOR_H_
+#define BUTTON_SENSOR_H_
+
+#include "lib/sensors.h"
+
+extern const struct sensors_sensor button_sensor;
+
+#endif /* BUTTON_SENSOR_H_ */
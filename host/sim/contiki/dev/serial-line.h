@@ -0,0 +1,11 @@
+#ifndef SERIAL_LINE_H_
+#define SERIAL_LINE_H_
+
+#include "contiki.h"
+
+#define SERIAL_LINE_CONF_BUFSIZE	80
+
+/*posted to every process with the line (no newline) as data*/
+extern process_event_t serial_line_event_message;
+
+#endif /* SERIAL_LINE_H_ */
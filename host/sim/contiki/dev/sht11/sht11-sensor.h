@@ -0,0 +1,12 @@
+#ifndef SHT11_SENSOR_H_
+#define SHT11_SENSOR_H_
+
+#include "lib/sensors.h"
+
+#define SHT11_SENSOR_TEMP				0
+#define SHT11_SENSOR_HUMIDITY			1
+#define SHT11_SENSOR_BATTERY_INDICATOR	2
+
+extern const struct sensors_sensor sht11_sensor;
+
+#endif /* SHT11_SENSOR_H_ */
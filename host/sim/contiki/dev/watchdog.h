@@ -0,0 +1,7 @@
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+/*rebooting the node once the current activation returns (sim_host.reboot)*/
+void watchdog_reboot(void);
+
+#endif /* WATCHDOG_H_ */
@@ -0,0 +1,20 @@
+#ifndef SENSORS_H_
+#define SENSORS_H_
+
+#define SENSORS_ACTIVE			0x80
+#define SENSORS_READY			0x81
+
+#define SENSORS_ACTIVATE(sensor)	(sensor).configure(SENSORS_ACTIVE, 1)
+#define SENSORS_DEACTIVATE(sensor)	(sensor).configure(SENSORS_ACTIVE, 0)
+
+struct sensors_sensor {
+
+	char *type;
+	int (*value)(int type);
+	int (*configure)(int type, int value);
+	int (*status)(int type);
+};
+
+extern process_event_t sensors_event;
+
+#endif /* SENSORS_H_ */
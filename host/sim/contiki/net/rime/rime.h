@@ -0,0 +1,83 @@
+#ifndef RIME_H_
+#define RIME_H_
+
+#include "contiki.h"
+
+typedef union {
+
+	unsigned char u8[2];
+} linkaddr_t;
+
+extern linkaddr_t linkaddr_node_addr;
+extern const linkaddr_t linkaddr_null;
+
+int linkaddr_cmp(const linkaddr_t *a, const linkaddr_t *b);
+void linkaddr_copy(linkaddr_t *dest, const linkaddr_t *from);
+
+/*packet buffer*/
+#define PACKETBUF_SIZE			128
+
+enum {
+	PACKETBUF_ATTR_NONE,
+	PACKETBUF_ATTR_RSSI,
+	PACKETBUF_ATTR_LINK_QUALITY,
+	PACKETBUF_ATTR_TIMESTAMP,
+	PACKETBUF_ATTR_MAX_REXMIT,
+	PACKETBUF_ATTR_NUM_REXMIT,
+	PACKETBUF_ATTR_RADIO_TXPOWER,
+	PACKETBUF_NUM_ATTRS
+};
+
+typedef uint16_t packetbuf_attr_t;
+
+int packetbuf_copyfrom(const void *from, uint16_t len);
+void *packetbuf_dataptr(void);
+uint16_t packetbuf_datalen(void);
+void packetbuf_clear(void);
+void packetbuf_set_datalen(uint16_t len);
+packetbuf_attr_t packetbuf_attr(uint8_t type);
+int packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val);
+
+/*broadcast*/
+struct broadcast_conn;
+
+struct broadcast_callbacks {
+
+	void (* recv)(struct broadcast_conn *ptr, const linkaddr_t *sender);
+	void (* sent)(struct broadcast_conn *ptr, int status, int num_tx);
+};
+
+struct broadcast_conn {
+
+	const struct broadcast_callbacks *u;
+	uint16_t channel;
+};
+
+void broadcast_open(struct broadcast_conn *c, uint16_t channel, const struct broadcast_callbacks *u);
+void broadcast_close(struct broadcast_conn *c);
+int broadcast_send(struct broadcast_conn *c);
+
+/*reliable unicast*/
+struct runicast_conn;
+
+struct runicast_callbacks {
+
+	void (* recv)(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno);
+	void (* sent)(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions);
+	void (* timedout)(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions);
+};
+
+struct runicast_conn {
+
+	const struct runicast_callbacks *u;
+	uint16_t channel;
+	uint8_t sndnxt, is_tx, rxmit, max_rxmit;
+	linkaddr_t to;
+};
+
+void runicast_open(struct runicast_conn *c, uint16_t channel, const struct runicast_callbacks *u);
+void runicast_close(struct runicast_conn *c);
+int runicast_send(struct runicast_conn *c, const linkaddr_t *receiver, uint8_t max_retransmissions);
+uint8_t runicast_is_transmitting(struct runicast_conn *c);
+
+#endif /* RIME_H_ */
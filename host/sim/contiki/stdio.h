@@ -0,0 +1,13 @@
+/*Firmware console: the shim forwards the printed lines to the simulator*/
+#ifndef SHIM_STDIO_H_
+#define SHIM_STDIO_H_
+
+int printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+int putchar(int c);
+int puts(const char *s);
+
+/*formatting into memory is the host libc one*/
+int sprintf(char *str, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+int snprintf(char *str, unsigned long size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#endif /* SHIM_STDIO_H_ */
@@ -0,0 +1,18 @@
+#ifndef CTIMER_H_
+#define CTIMER_H_
+
+struct ctimer {
+
+	struct etimer etimer;		/*first: found back from the expired etimer*/
+	struct process *p;			/*context of the callback*/
+	void (*f)(void *);
+	void *ptr;
+};
+
+void ctimer_set(struct ctimer *c, clock_time_t t, void (*f)(void *), void *ptr);
+void ctimer_reset(struct ctimer *c);
+void ctimer_restart(struct ctimer *c);
+void ctimer_stop(struct ctimer *c);
+int ctimer_expired(struct ctimer *c);
+
+#endif /* CTIMER_H_ */
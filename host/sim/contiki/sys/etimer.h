@@ -0,0 +1,24 @@
+#ifndef ETIMER_H_
+#define ETIMER_H_
+
+struct timer {
+
+	clock_time_t start;
+	clock_time_t interval;
+};
+
+struct etimer {
+
+	struct timer timer;
+	struct etimer *next;
+	struct process *p;			/*PROCESS_NONE when expired or stopped*/
+};
+
+void etimer_set(struct etimer *et, clock_time_t interval);
+void etimer_reset(struct etimer *et);
+void etimer_restart(struct etimer *et);
+void etimer_stop(struct etimer *et);
+int etimer_expired(struct etimer *et);
+clock_time_t etimer_expiration_time(struct etimer *et);
+
+#endif /* ETIMER_H_ */
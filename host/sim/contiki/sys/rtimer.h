@@ -0,0 +1,12 @@
+#ifndef RTIMER_H_
+#define RTIMER_H_
+
+typedef unsigned short rtimer_clock_t;
+
+#define RTIMER_SECOND			32768
+
+rtimer_clock_t rtimer_arch_now(void);
+
+#define RTIMER_NOW()			rtimer_arch_now()
+
+#endif /* RTIMER_H_ */
@@ -0,0 +1,123 @@
+/*-------------------------------Links------------------------------------
+	Check of ../../link-quality.c on the counts of Contiki's runicast.
+
+	Usage:	links
+
+	runicast.c (Contiki 3.0) counts in rxmit the transmissions of a
+	packet, incremented as each one is sent: an acknowledgement
+	reports sent(rxmit), at least 1, and reaching the max_rxmit given
+	to runicast_send reports timedout(rxmit) at once. Every link of
+	the check is driven by that model, with the limit returned by
+	link_quality_max_retransmissions:
+		- perfect: every packet acknowledged at the first try;
+		- lossy: one loss before every acknowledgement;
+		- dead: never acknowledged, from an unknown neighbour.
+	One line per link: transmissions reported, ETX, retransmission
+	limit, stretched timeout & CC2420 power level. The exit status is
+	1 when one of them differs from the link (a perfect link costs 1
+	transmission, no stretched timeout, and its power is lowered after
+	LINK_QUALITY_POWER_STREAK deliveries; the others stay at full
+	power).
+------------------------------------------------------------------------*/
+#include <stdio.h>
+#include "../../link-quality.h"
+
+#define PACKETS					20
+#define BASE_TIMEOUT			100		/*clock ticks*/
+#define FULL_POWER				31		/*CC2420 PA_LEVEL, 0 dBm*/
+#define ETX(transmissions)		((transmissions) * LINK_QUALITY_ETX_SCALE)
+
+static int failed;
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+/*packetbuf of the shim: no RSSI or LQI sampled here*/
+packetbuf_attr_t packetbuf_attr(uint8_t type){
+
+	(void)type;
+
+	return 0;
+}
+
+int packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val){
+
+	(void)type;
+	(void)val;
+
+	return 1;
+}
+
+/*One packet sent by runicast.c to a link losing its first lost transmissions, returning rxmit*/
+static int runicast(int addr, int lost){
+
+	linkaddr_t to = {{addr, 0}};
+	int max_rxmit = link_quality_max_retransmissions(addr);
+	int rxmit;
+
+	for(rxmit=1; ; rxmit++){
+
+		/*sent_by_stunicast: the limit is checked as soon as the transmission is out*/
+		if(rxmit >= max_rxmit){
+
+			link_quality_timedout(&to, rxmit);
+			return rxmit;
+		}
+
+		if(rxmit > lost){
+
+			link_quality_sent(&to, rxmit);
+			return rxmit;
+		}
+	}
+}
+
+static void check(const char *name, int addr, int lost, int transmissions, int etx, int retx, int timeout,
+	int lowered){
+
+	struct link_quality_report reports[LINK_QUALITY_MAX_NEIGHBORS];
+	int i, count, reported = 0, got_etx = -1, got_power = 0, got_retx, got_timeout;
+
+	for(i=0; i<PACKETS; i++)
+		reported = runicast(addr, lost);
+
+	count = link_quality_report(reports, LINK_QUALITY_MAX_NEIGHBORS);
+
+	for(i=0; i<count; i++)
+		if(reports[i].addr == addr){
+
+			got_etx = reports[i].etx;
+			got_power = reports[i].power;
+		}
+
+	got_retx = link_quality_max_retransmissions(addr);
+	got_timeout = link_quality_timeout(addr, BASE_TIMEOUT);
+
+	printf("%-8s %13d %4d.%02d %10d %8d %6d\n", name, reported, got_etx / LINK_QUALITY_ETX_SCALE,
+		(got_etx % LINK_QUALITY_ETX_SCALE) * 100 / LINK_QUALITY_ETX_SCALE, got_retx, got_timeout, got_power);
+
+	if(reported != transmissions || (etx >= 0 && got_etx != etx) || got_retx != retx || got_timeout != timeout ||
+		(got_power < FULL_POWER) != lowered){
+
+		fprintf(stderr, "FAILED: %s link, expected %d transmissions, ETX %d/%d, limit %d, timeout %d, power %s\n",
+			name, transmissions, etx, LINK_QUALITY_ETX_SCALE, retx, timeout, lowered ? "lowered" : "full");
+		failed = 1;
+	}
+}
+
+
+int main(void){
+
+	link_quality_init();
+
+	printf("%d packets per link, timeout of %d ticks\n", PACKETS, BASE_TIMEOUT);
+	printf("link     transmissions    ETX      limit  timeout  power\n");
+
+	check("perfect", 1, 0, 1, ETX(1), LINK_QUALITY_RETX_PER_ETX, BASE_TIMEOUT, 1);
+	check("lossy", 2, 1, 2, ETX(2), 2 * LINK_QUALITY_RETX_PER_ETX, 2 * BASE_TIMEOUT, 0);
+
+	/*the ETX of the dead link only tends to the timeouts at the cap: not compared*/
+	check("dead", 3, 0xFF, LINK_QUALITY_MAX_RETX, -1, LINK_QUALITY_MAX_RETX,
+		LINK_QUALITY_MAX_TIMEOUT_FACTOR * BASE_TIMEOUT, 0);
+
+	return failed;
+}
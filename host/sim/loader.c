@@ -0,0 +1,155 @@
+/*--------------------------------Loader----------------------------------
+	Firmware shared objects of the simulator and of the replay
+	(see loader.h).
+------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "loader.h"
+
+/*Data/bss & segment ranges from the section & program headers*/
+int loader_layout(const char *path, struct loader_layout *layout){
+
+	struct stat st;
+	const Elf64_Ehdr *eh;
+	const Elf64_Shdr *sh;
+	const Elf64_Phdr *ph;
+	const char *names;
+	uint8_t *file;
+	size_t lo = SIZE_MAX, hi = 0;
+	int fd, i;
+
+	if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0){
+
+		perror(path);
+		return -1;
+	}
+
+	file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(file == MAP_FAILED || memcmp(file, ELFMAG, SELFMAG) != 0 || file[EI_CLASS] != ELFCLASS64){
+
+		fprintf(stderr, "%s: not a 64-bit ELF object\n", path);
+		return -1;
+	}
+
+	eh = (const Elf64_Ehdr *)file;
+	sh = (const Elf64_Shdr *)(file + eh->e_shoff);
+	ph = (const Elf64_Phdr *)(file + eh->e_phoff);
+	names = (const char *)file + sh[eh->e_shstrndx].sh_offset;
+
+	for(i=0; i<eh->e_shnum; i++){
+
+		const char *name = names + sh[i].sh_name;
+
+		if((strncmp(name, ".data", 5) == 0 && strncmp(name, ".data.rel.ro", 12) != 0) || strncmp(name, ".bss", 4) == 0){
+
+			if(sh[i].sh_addr < lo)
+				lo = sh[i].sh_addr;
+
+			if(sh[i].sh_addr + sh[i].sh_size > hi)
+				hi = sh[i].sh_addr + sh[i].sh_size;
+		}
+	}
+
+	layout->data_lo = lo;
+	layout->data_len = (lo < hi) ? hi - lo : 0;
+	layout->map_lo = SIZE_MAX;
+	layout->map_hi = 0;
+
+	for(i=0; i<eh->e_phnum; i++)
+		if(ph[i].p_type == PT_LOAD){
+
+			if(ph[i].p_vaddr < layout->map_lo)
+				layout->map_lo = ph[i].p_vaddr;
+
+			if(ph[i].p_vaddr + ph[i].p_memsz > layout->map_hi)
+				layout->map_hi = ph[i].p_vaddr + ph[i].p_memsz;
+		}
+
+	munmap(file, st.st_size);
+
+	if(layout->data_len == 0){
+
+		fprintf(stderr, "%s: no data section\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*dlopen returns the same handle for one path: every copy is a private file*/
+int loader_open(const char *path, struct loader_copy *copy){
+
+	char tmp[] = "/tmp/sim-fw-XXXXXX";
+	char buf[65536];
+	struct link_map *map;
+	ssize_t n;
+	int in, out, ok = 1;
+
+	if((in = open(path, O_RDONLY)) < 0 || (out = mkstemp(tmp)) < 0){
+
+		perror(path);
+		return -1;
+	}
+
+	while((n = read(in, buf, sizeof(buf))) > 0)
+		if(write(out, buf, n) != n)
+			ok = 0;
+
+	close(in);
+	close(out);
+
+	copy->handle = ok ? dlopen(tmp, RTLD_NOW | RTLD_LOCAL) : NULL;
+	unlink(tmp);
+
+	if(copy->handle == NULL){
+
+		fprintf(stderr, "%s: %s\n", path, ok ? dlerror() : "cannot copy");
+		return -1;
+	}
+
+	if((copy->fw = dlsym(copy->handle, "sim_firmware")) == NULL || dlinfo(copy->handle, RTLD_DI_LINKMAP, &map) != 0){
+
+		fprintf(stderr, "%s: not a simulator firmware\n", path);
+		return -1;
+	}
+
+	copy->base = map->l_addr;
+
+	return 0;
+}
+
+
+uint8_t *loader_data(const struct loader_layout *layout, const struct loader_copy *copy){
+
+	return (uint8_t *)(copy->base + layout->data_lo);
+}
+
+
+void loader_relocate(const struct loader_layout *layout, uint8_t *image, uintptr_t from, uintptr_t to){
+
+	uintptr_t lo = from + layout->map_lo, hi = from + layout->map_hi, *word;
+	size_t i;
+
+	if(from == to)
+		return;
+
+	/*the objects are mapped on page boundaries: the image keeps the alignment of the object*/
+	for(i = (-(from + layout->data_lo)) & 7; i + sizeof(uintptr_t) <= layout->data_len; i += sizeof(uintptr_t)){
+
+		word = (uintptr_t *)(image + i);
+
+		if(*word >= lo && *word < hi)
+			*word += to - from;
+	}
+}
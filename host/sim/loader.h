@@ -0,0 +1,43 @@
+/*--------------------------------Loader----------------------------------
+	Firmware shared objects of the simulator and of the replay.
+
+	The state of a node is the data/bss range of its firmware object:
+	the layout gives that range and the loaded segments, a copy is a
+	private dlopen of the object (one per worker) in which the images
+	of the nodes are loaded. An image saved from a copy mapped at
+	another base is relocated: the aligned words pointing into the
+	source object are shifted (the firmwares keep no other pointers
+	into it than aligned ones).
+------------------------------------------------------------------------*/
+#ifndef LOADER_H_
+#define LOADER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sim-api.h"
+
+struct loader_layout {
+
+	size_t data_lo, data_len;		/*data & bss, offsets in the object*/
+	size_t map_lo, map_hi;			/*loaded segments*/
+};
+
+struct loader_copy {
+
+	void *handle;
+	const struct sim_firmware *fw;
+	uintptr_t base;
+};
+
+/*Both return -1 with a message on stderr*/
+int loader_layout(const char *path, struct loader_layout *layout);
+
+int loader_open(const char *path, struct loader_copy *copy);
+
+/*The data range of the object in copy*/
+uint8_t *loader_data(const struct loader_layout *layout, const struct loader_copy *copy);
+
+/*Shifting the pointers of an image saved from the object mapped at from to the one at to*/
+void loader_relocate(const struct loader_layout *layout, uint8_t *image, uintptr_t from, uintptr_t to);
+
+#endif /* LOADER_H_ */
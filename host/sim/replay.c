@@ -0,0 +1,640 @@
+/*--------------------------------Replay----------------------------------
+	Replay of a firmware trace (../../trace.h) at accelerated virtual
+	time, against the firmware objects of the simulator.
+
+	Usage:	replay [-d dir] [-f object] [-a address] [-r runs] [-v] trace
+
+	The trace is the serial capture of one node running a firmware
+	built with TRACE_CONF_ENABLED (the tty itself, cu-daemon -t, or
+	sim -T): the TRACE frames of the node are decoded, everything else
+	is skipped. The node is the one of the first TRACE frame unless -a
+	is given; the object is chosen from its address (cu.so for 3,
+	node1.so, node2.so, node4.so for the others) unless -f is given.
+
+	Every boot session (from a TRACE_BOOT record) is replayed on a
+	pristine image: the received frames, runicast outcomes, button
+	presses and console lines are injected at their time, the sensor reads return the
+	recorded values in order and the timers run on the virtual clock
+	in between. The frames sent and the LED transitions of the replay
+	are diffed against the recorded ones, printing the first
+	divergence of each; -v prints the console of the replay.
+
+	The records replayed per second of wall time are measured over -r
+	runs of the whole trace.
+------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "sim-api.h"
+#include "loader.h"
+#include "../../serial-frame.h"
+#include "../../trace.h"
+
+#define CU_ADDR					3
+#define RUNICAST_CHANNEL		144		/*opened by all the firmwares*/
+#define BROADCAST_CHANNEL		129
+#define OTA_CHANNEL				130		/*not traced (ota.h)*/
+#define CLOCK_SECOND			128
+#define MAX_ADVANCE				1000000	/*timer activations up to one record*/
+#define FRAME_MAX_SIZE			(2 + SERIAL_FRAME_MAX_PAYLOAD + 2)
+
+struct record {
+
+	uint64_t time;				/*us of the node clock*/
+	uint8_t type;
+	uint16_t len;				/*body*/
+	uint8_t body[TRACE_RECORD_SIZE];
+};
+
+/*A frame sent or an LED transition*/
+struct output {
+
+	uint64_t time;
+	uint8_t type;				/*TRACE_TX_* or TRACE_LEDS*/
+	uint8_t addr;
+	uint8_t leds;
+	uint16_t len;
+	uint8_t data[TRACE_MAX_DATA];
+};
+
+struct outputs {
+
+	struct output *v;
+	int count, capacity;
+};
+
+static struct record *records;
+static int n_records = 0, records_capacity = 0;
+static unsigned long lost = 0, skipped = 0, bad = 0;
+
+static struct loader_layout layout;
+static struct loader_copy copy;
+static uint8_t *pristine;
+static int verbose = 0;
+
+/*state of the session being replayed*/
+static const struct record *session;
+static int session_len;
+static int cursor[2];			/*next TRACE_READING per sensor*/
+static int last_reading[2];
+static unsigned long underruns;
+static unsigned char replay_leds;
+static uint64_t now;
+static struct outputs replayed;
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+static double wall_seconds(void){
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *grow(void *v, int *capacity, size_t size){
+
+	*capacity = *capacity ? 2 * *capacity : 256;
+
+	if((v = realloc(v, *capacity * size)) == NULL){
+
+		fprintf(stderr, "replay: out of memory\n");
+		exit(1);
+	}
+
+	return v;
+}
+
+static struct output *add_output(struct outputs *o, uint64_t time, uint8_t type){
+
+	struct output *out;
+
+	if(o->count == o->capacity)
+		o->v = grow(o->v, &o->capacity, sizeof(struct output));
+
+	out = &o->v[o->count++];
+	memset(out, 0, sizeof(*out));
+	out->time = time;
+	out->type = type;
+
+	return out;
+}
+
+/*Same algorithm as Contiki lib/crc16.c*/
+static uint16_t crc16_add(uint8_t b, uint16_t acc){
+
+	acc ^= b;
+	acc = (acc >> 8) | (acc << 8);
+	acc ^= (acc & 0xff00) << 4;
+	acc ^= (acc >> 8) >> 4;
+	acc ^= (acc & 0xff00) >> 5;
+
+	return acc;
+}
+
+/*-------------------------------PARSING---------------------------------*/
+
+/*A decoded frame: TRACE records of the node (the first one seen if *node < 0)*/
+static void handle_frame(const uint8_t *frame, int len, int *node, uint64_t *ticks, int *seq){
+
+	struct trace_header header;
+	struct record *r;
+	uint32_t boot;
+	uint16_t crc = 0;
+	int i;
+
+	if(len < 4){
+
+		bad++;
+		return;
+	}
+
+	for(i=0; i<len-2; i++)
+		crc = crc16_add(frame[i], crc);
+
+	if(crc != (frame[len - 2] | (frame[len - 1] << 8))){
+
+		bad++;
+		return;
+	}
+
+	if(frame[0] != SERIAL_FRAME_TRACE || (*node >= 0 && frame[1] != *node))
+		return;
+
+	if(len - 4 < (int)sizeof(header)){
+
+		bad++;
+		return;
+	}
+
+	*node = frame[1];
+	memcpy(&header, frame + 2, sizeof(header));
+
+	if(header.type == TRACE_BOOT && len - 4 - (int)sizeof(header) >= (int)sizeof(boot)){
+
+		memcpy(&boot, frame + 2 + sizeof(header), sizeof(boot));
+		*ticks = boot;
+
+	}else
+		*ticks += header.delta;
+
+	if(*seq >= 0)
+		lost += (uint8_t)(header.seq - *seq - 1);
+
+	*seq = header.seq;
+
+	if(header.type == TRACE_IDLE || header.type >= TRACE_TYPES)
+		return;
+
+	if(n_records == records_capacity)
+		records = grow(records, &records_capacity, sizeof(struct record));
+
+	r = &records[n_records++];
+	r->time = (*ticks * 1000000 + CLOCK_SECOND - 1) / CLOCK_SECOND;
+	r->type = header.type;
+	r->len = len - 4 - sizeof(header);
+	memcpy(r->body, frame + 2 + sizeof(header), r->len);
+}
+
+/*SLIP decoding of the capture, the bytes outside the frames are skipped*/
+static int read_trace(const char *path, int node){
+
+	uint8_t frame[FRAME_MAX_SIZE];
+	uint64_t ticks = 0;
+	int c, len = 0, in_frame = 0, escaped = 0, overrun = 0, seq = -1;
+	FILE *f;
+
+	if((f = fopen(path, "rb")) == NULL){
+
+		perror(path);
+		exit(1);
+	}
+
+	while((c = fgetc(f)) != EOF){
+
+		if(c == SERIAL_FRAME_END){
+
+			if(in_frame && len > 0 && !overrun)
+				handle_frame(frame, len, &node, &ticks, &seq);
+
+			in_frame = 1;
+			len = 0;
+			escaped = overrun = 0;
+			continue;
+		}
+
+		if(!in_frame)
+			continue;
+
+		if(c == SERIAL_FRAME_ESC){
+
+			escaped = 1;
+			continue;
+		}
+
+		if(escaped){
+
+			c = (c == SERIAL_FRAME_ESC_END) ? SERIAL_FRAME_END : (c == SERIAL_FRAME_ESC_ESC) ? SERIAL_FRAME_ESC : c;
+			escaped = 0;
+		}
+
+		if(len == FRAME_MAX_SIZE)
+			overrun = 1;
+		else
+			frame[len++] = c;
+	}
+
+	fclose(f);
+
+	return node;
+}
+
+/*---------------------------------HOST----------------------------------*/
+
+static void host_output(const char *line, int len){
+
+	if(verbose)
+		printf("%12.3f  %.*s\n", now / 1e6, len, line);
+}
+
+static void host_radio_send(int kind, uint16_t channel, int dst, uint8_t seqno, const void *data, int len,
+	int txpower, int max_rexmit){
+
+	struct output *out;
+
+	(void)seqno;
+	(void)txpower;
+	(void)max_rexmit;
+
+	if(channel == OTA_CHANNEL)
+		return;
+
+	out = add_output(&replayed, now, (kind == SIM_RUNICAST) ? TRACE_TX_RUNICAST : TRACE_TX_BROADCAST);
+	out->addr = (kind == SIM_RUNICAST) ? dst : 0;
+	out->len = (len < TRACE_MAX_DATA) ? len : TRACE_MAX_DATA;
+	memcpy(out->data, data, out->len);
+}
+
+/*The recorded values in order: SIM_SENSOR_TEMP/LIGHT are TRACE_SENSOR_TEMP/LIGHT*/
+static int host_sensor(int sensor){
+
+	struct trace_reading reading;
+	int i;
+
+	for(i = cursor[sensor]; i < session_len; i++){
+
+		if(session[i].type != TRACE_READING)
+			continue;
+
+		memcpy(&reading, session[i].body, sizeof(reading));
+
+		if(reading.sensor == sensor){
+
+			cursor[sensor] = i + 1;
+			last_reading[sensor] = reading.value;
+
+			return reading.value;
+		}
+	}
+
+	underruns++;
+
+	return last_reading[sensor];
+}
+
+static void host_leds(unsigned char leds){
+
+	if(leds == replay_leds)
+		return;
+
+	replay_leds = leds;
+	add_output(&replayed, now, TRACE_LEDS)->leds = leds;
+}
+
+static void host_serial(unsigned char c){
+
+	(void)c;
+}
+
+/*the recording goes on with the TRACE_BOOT of the next session*/
+static void host_reboot(void){
+}
+
+static const struct sim_host host = {host_output, host_radio_send, host_sensor, host_leds, host_serial, host_reboot};
+
+/*--------------------------------REPLAY---------------------------------*/
+
+/*Running the timers up to t*/
+static void advance(const struct sim_firmware *fw, uint64_t t){
+
+	uint64_t wake;
+	int steps = 0;
+
+	while((wake = fw->next_wake()) <= t && ++steps < MAX_ADVANCE){
+
+		now = wake;
+		fw->run(wake);
+	}
+
+	now = t;
+}
+
+static void replay_session(const struct sim_firmware *fw, int node, const struct record *s, int len){
+
+	struct sim_packet packet;
+	struct trace_packet tp;
+	struct trace_outcome outcome;
+	char line[TRACE_MAX_DATA + 1];
+	int i, size;
+
+	session = s;
+	session_len = len;
+	cursor[0] = cursor[1] = 0;
+	last_reading[0] = last_reading[1] = 0;
+	underruns = 0;
+	replay_leds = 0;
+	replayed.count = 0;
+	now = s[0].time;
+
+	memcpy(loader_data(&layout, &copy), pristine, layout.data_len);
+	fw->boot(&host, node, now, 0);
+
+	for(i=1; i<len; i++){
+
+		advance(fw, s[i].time);
+
+		switch(s[i].type){
+
+			case TRACE_RX_RUNICAST:
+			case TRACE_RX_BROADCAST:
+
+				memcpy(&tp, s[i].body, sizeof(tp));
+				memset(&packet, 0, sizeof(packet));
+				packet.kind = (s[i].type == TRACE_RX_RUNICAST) ? SIM_RUNICAST : SIM_BROADCAST;
+				packet.channel = (s[i].type == TRACE_RX_RUNICAST) ? RUNICAST_CHANNEL : BROADCAST_CHANNEL;
+				packet.src = tp.addr;
+				packet.seqno = tp.seqno;
+				packet.rssi = tp.rssi;
+				packet.lqi = tp.lqi;
+				packet.len = s[i].len - sizeof(tp);
+				memcpy(packet.data, s[i].body + sizeof(tp), packet.len);
+
+				fw->deliver(&packet, now);
+				break;
+
+			case TRACE_SENT:
+			case TRACE_TIMEDOUT:
+
+				memcpy(&outcome, s[i].body, sizeof(outcome));
+				fw->tx_done(SIM_RUNICAST, RUNICAST_CHANNEL, outcome.addr, outcome.retransmissions,
+					s[i].type == TRACE_SENT, now);
+				break;
+
+			case TRACE_BUTTON:
+
+				fw->button(now);
+				break;
+
+			case TRACE_CONSOLE:
+
+				size = (s[i].len < TRACE_MAX_DATA) ? s[i].len : TRACE_MAX_DATA;
+				memcpy(line, s[i].body, size);
+				line[size] = '\0';
+
+				fw->console(line, now);
+				break;
+		}
+	}
+}
+
+/*----------------------------------DIFF---------------------------------*/
+
+static int same_output(const struct output *a, const struct output *b){
+
+	if(a->type != b->type)
+		return 0;
+
+	if(a->type == TRACE_LEDS)
+		return a->leds == b->leds;
+
+	return a->addr == b->addr && a->len == b->len && memcmp(a->data, b->data, a->len) == 0;
+}
+
+static void print_output(const char *who, const struct output *o){
+
+	int i;
+
+	printf("      %-9s %12.3f  ", who, o->time / 1e6);
+
+	if(o->type == TRACE_LEDS){
+
+		printf("LEDS 0x%02x\n", o->leds);
+		return;
+	}
+
+	printf("%s to [%d:0] \"", (o->type == TRACE_TX_RUNICAST) ? "RUNICAST" : "BROADCAST", o->addr);
+
+	/*the messages start with a string tag*/
+	for(i=0; i<o->len && o->data[i] != '\0'; i++)
+		putchar((o->data[i] >= 32 && o->data[i] < 127) ? o->data[i] : '.');
+
+	printf("\" %u bytes\n", o->len);
+}
+
+/*Diffing the outputs of one kind (frames sent or LED transitions)*/
+static int diff(const char *name, const struct outputs *recorded, int leds){
+
+	const struct output *a[2] = {NULL, NULL};
+	int n[2] = {0, 0}, i, k, j[2] = {0, 0}, divergence = -1;
+	int64_t skew, max_skew = 0;
+	const struct outputs *o[2] = {recorded, &replayed};
+
+	for(k=0; k<2; k++)
+		for(i=0; i<o[k]->count; i++)
+			n[k] += ((o[k]->v[i].type == TRACE_LEDS) == leds);
+
+	for(i=0; ; i++){
+
+		for(k=0; k<2; k++){
+
+			while(j[k] < o[k]->count && (o[k]->v[j[k]].type == TRACE_LEDS) != leds)
+				j[k]++;
+
+			a[k] = (j[k] < o[k]->count) ? &o[k]->v[j[k]++] : NULL;
+		}
+
+		if(a[0] == NULL || a[1] == NULL){
+
+			if(a[0] != a[1])
+				divergence = i;
+			break;
+		}
+
+		if(!same_output(a[0], a[1])){
+
+			divergence = i;
+			break;
+		}
+
+		skew = (int64_t)a[1]->time - (int64_t)a[0]->time;
+
+		if(llabs(skew) > llabs(max_skew))
+			max_skew = skew;
+	}
+
+	printf("  %s: %d recorded, %d replayed, ", name, n[0], n[1]);
+
+	if(divergence < 0){
+
+		printf("identical (max time skew %+.3f s)\n", max_skew / 1e6);
+		return 0;
+	}
+
+	printf("first divergence at #%d\n", divergence + 1);
+
+	if(a[0] != NULL)
+		print_output("recorded", a[0]);
+	else
+		printf("      recorded  (none)\n");
+
+	if(a[1] != NULL)
+		print_output("replayed", a[1]);
+	else
+		printf("      replayed  (none)\n");
+
+	return 1;
+}
+
+/*---------------------------------MAIN----------------------------------*/
+
+static void usage(void){
+
+	fprintf(stderr, "usage: replay [-d dir] [-f object] [-a address] [-r runs] [-v] trace\n");
+	exit(2);
+}
+
+
+int main(int argc, char *argv[]){
+
+	char dir[4096], path[8192];
+	const char *object = NULL;
+	struct outputs recorded = {NULL, 0, 0};
+	struct trace_packet tp;
+	int opt, node = -1, runs = 1, run, i, start, end, sessions = 0, diverged = 0;
+	unsigned long replayed_records = 0;
+	double wall;
+	ssize_t len;
+
+	if((len = readlink("/proc/self/exe", dir, sizeof(dir) - 1)) > 0){
+
+		dir[len] = '\0';
+		*strrchr(dir, '/') = '\0';
+
+	}else
+		strcpy(dir, ".");
+
+	while((opt = getopt(argc, argv, "d:f:a:r:v")) != -1)
+		switch(opt){
+
+			case 'd': snprintf(dir, sizeof(dir), "%s", optarg); break;
+			case 'f': object = optarg; break;
+			case 'a': node = atoi(optarg); break;
+			case 'r': runs = atoi(optarg); break;
+			case 'v': verbose = 1; break;
+			default: usage();
+		}
+
+	if(optind != argc - 1 || runs <= 0)
+		usage();
+
+	node = read_trace(argv[optind], node);
+
+	if(node < 0){
+
+		fprintf(stderr, "replay: no trace record in %s\n", argv[optind]);
+		return 1;
+	}
+
+	if(object == NULL)
+		object = (node == CU_ADDR) ? "cu.so" : (node == 1) ? "node1.so" : (node == 2) ? "node2.so" : "node4.so";
+
+	if(strchr(object, '/') != NULL)
+		snprintf(path, sizeof(path), "%s", object);
+	else
+		snprintf(path, sizeof(path), "%s/%s", dir, object);
+
+	if(loader_layout(path, &layout) < 0 || loader_open(path, &copy) < 0)
+		return 1;
+
+	pristine = malloc(layout.data_len);
+	memcpy(pristine, loader_data(&layout, &copy), layout.data_len);
+
+	/*the recorded outputs, split in sessions later*/
+	for(i=0; i<n_records && records[i].type != TRACE_BOOT; i++);
+
+	skipped = i;
+
+	printf("trace %s: node [%d:0] (%s), %d records, %lu lost, %lu before the first boot, %lu bad frames\n",
+		argv[optind], node, copy.fw->name, n_records, lost, skipped, bad);
+
+	if(lost > 0)
+		printf("  records were lost: the replay may diverge after the gaps\n");
+
+	wall = wall_seconds();
+
+	for(run=0; run<runs; run++){
+
+		for(start = skipped; start < n_records; start = end){
+
+			for(end = start + 1; end < n_records && records[end].type != TRACE_BOOT; end++);
+
+			replay_session(copy.fw, node, &records[start], end - start);
+			replayed_records += end - start;
+
+			if(run > 0)
+				continue;
+
+			/*diff of the first run*/
+			sessions++;
+			recorded.count = 0;
+
+			for(i=start; i<end; i++){
+
+				struct output *out;
+
+				if(records[i].type == TRACE_TX_RUNICAST || records[i].type == TRACE_TX_BROADCAST){
+
+					memcpy(&tp, records[i].body, sizeof(tp));
+					out = add_output(&recorded, records[i].time, records[i].type);
+					out->addr = tp.addr;
+					out->len = records[i].len - sizeof(tp);
+					memcpy(out->data, records[i].body + sizeof(tp), out->len);
+
+				}else if(records[i].type == TRACE_LEDS)
+					add_output(&recorded, records[i].time, TRACE_LEDS)->leds = records[i].body[0];
+			}
+
+			printf("session %d: %d records, %.3f s\n", sessions, end - start,
+				(records[end - 1].time - records[start].time) / 1e6);
+
+			diverged |= diff("frames sent", &recorded, 0);
+			diverged |= diff("LED transitions", &recorded, 1);
+
+			if(underruns > 0)
+				printf("  %lu sensor reads beyond the recorded ones\n", underruns);
+		}
+	}
+
+	wall = wall_seconds() - wall;
+
+	printf("replayed %lu records in %.3f s: %.0f records/s\n", replayed_records, wall,
+		(wall > 0) ? replayed_records / wall : 0);
+
+	return diverged;
+}
@@ -0,0 +1,1224 @@
+/*-----------------------------Contiki Shim-------------------------------
+	Host implementation of the Contiki subset declared in contiki/,
+	linked with every firmware shared object of the simulator.
+
+	All the state is in static variables: the simulator swaps the
+	whole data/bss image of the shared object to run another node,
+	and resets it but the flash on watchdog_reboot().
+	Event timers expire against the simulated clock given by the
+	simulator; radio, sensors and console go through struct sim_host.
+------------------------------------------------------------------------*/
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "cfs/cfs-coffee.h"
+#include "lib/crc16.h"
+#include "lib/random.h"
+#include "dev/leds.h"
+#include "dev/button-sensor.h"
+#include "dev/light-sensor.h"
+#include "dev/sht11/sht11-sensor.h"
+#include "dev/serial-line.h"
+#include "dev/watchdog.h"
+#include "sim-api.h"
+
+#ifndef SIM_FIRMWARE_NAME
+#define SIM_FIRMWARE_NAME		"firmware"
+#endif
+
+#ifndef SIM_FLASH_SIZE
+#define SIM_FLASH_SIZE			1024		/*Coffee space of this firmware*/
+#endif
+
+#define PROCESS_STATE_NONE		0
+#define PROCESS_STATE_RUNNING	1
+#define PROCESS_STATE_CALLED	2
+
+#define MAX_RUN_STEPS			100000		/*events of one activation: livelock guard*/
+#define MAX_CONNS				4
+#define LINE_SIZE				128
+#define CFS_MAX_FILES			12
+#define CFS_MAX_FDS				4
+#define CFS_NAME_SIZE			16
+#define CFS_DEFAULT_SIZE		256
+
+int vsnprintf(char *str, size_t size, const char *format, va_list ap);
+
+extern struct process * const autostart_processes[];
+
+static const struct sim_host *host;
+static uint64_t now_us;
+static int rebooting = 0;
+
+/*--------------------------------PROCESSES------------------------------*/
+
+struct process *process_current = NULL;
+process_event_t sensors_event;
+process_event_t serial_line_event_message;
+
+static struct process *process_list = NULL;
+static process_event_t lastevent;
+
+static struct {
+
+	process_event_t ev;
+	process_data_t data;
+	struct process *p;
+} events[PROCESS_CONF_NUMEVENTS];
+
+static unsigned int nevents = 0, fevent = 0;
+static unsigned char poll_requested = 0;
+
+static struct etimer *timerlist = NULL;
+
+/*contexts of the timer callbacks and of the radio callbacks*/
+PROCESS(ctimer_process, "Ctimer Process");
+PROCESS(rime_process, "Rime Process");
+
+PROCESS_THREAD(ctimer_process, ev, data){
+
+	PROCESS_BEGIN();
+
+	while(1)
+		PROCESS_WAIT_EVENT();
+
+	PROCESS_END();
+}
+
+PROCESS_THREAD(rime_process, ev, data){
+
+	PROCESS_BEGIN();
+
+	while(1)
+		PROCESS_WAIT_EVENT();
+
+	PROCESS_END();
+}
+
+static void remove_timers(struct process *p);
+
+static void exit_process(struct process *p, struct process *fromprocess){
+
+	struct process *q, *old_current = process_current;
+
+	if(!process_is_running(p))
+		return;
+
+	p->state = PROCESS_STATE_NONE;
+
+	for(q = process_list; q != NULL; q = q->next)
+		if(p != q && q->state == PROCESS_STATE_RUNNING){
+
+			process_current = q;
+			q->state = PROCESS_STATE_CALLED;
+
+			if(q->thread(&q->pt, PROCESS_EVENT_EXITED, p) >= PT_EXITED)
+				exit_process(q, q);
+			else if(q->state == PROCESS_STATE_CALLED)
+				q->state = PROCESS_STATE_RUNNING;
+		}
+
+	if(p->thread != NULL && p != fromprocess){
+
+		process_current = p;
+		p->thread(&p->pt, PROCESS_EVENT_EXIT, NULL);
+	}
+
+	if(p == process_list)
+		process_list = process_list->next;
+	else
+		for(q = process_list; q != NULL; q = q->next)
+			if(q->next == p){
+
+				q->next = p->next;
+				break;
+			}
+
+	remove_timers(p);
+
+	process_current = old_current;
+}
+
+static void call_process(struct process *p, process_event_t ev, process_data_t data){
+
+	int ret;
+
+	if(p->state != PROCESS_STATE_RUNNING || p->thread == NULL)
+		return;
+
+	process_current = p;
+	p->state = PROCESS_STATE_CALLED;
+
+	ret = p->thread(&p->pt, ev, data);
+
+	if(ret == PT_EXITED || ret == PT_ENDED || ev == PROCESS_EVENT_EXIT)
+		exit_process(p, p);
+	else if(p->state == PROCESS_STATE_CALLED)
+		p->state = PROCESS_STATE_RUNNING;
+}
+
+
+void process_start(struct process *p, process_data_t data){
+
+	struct process *q;
+
+	for(q = process_list; q != p && q != NULL; q = q->next);
+
+	if(q == p)
+		return;
+
+	p->next = process_list;
+	process_list = p;
+	p->state = PROCESS_STATE_RUNNING;
+	p->needspoll = 0;
+	PT_INIT(&p->pt);
+
+	process_post_synch(p, PROCESS_EVENT_INIT, data);
+}
+
+
+int process_post(struct process *p, process_event_t ev, process_data_t data){
+
+	unsigned int snum;
+
+	if(nevents == PROCESS_CONF_NUMEVENTS)
+		return PROCESS_ERR_FULL;
+
+	snum = (fevent + nevents) % PROCESS_CONF_NUMEVENTS;
+	events[snum].ev = ev;
+	events[snum].data = data;
+	events[snum].p = p;
+	nevents++;
+
+	return PROCESS_ERR_OK;
+}
+
+
+void process_post_synch(struct process *p, process_event_t ev, process_data_t data){
+
+	struct process *caller = process_current;
+
+	call_process(p, ev, data);
+
+	process_current = caller;
+}
+
+
+void process_exit(struct process *p){
+
+	exit_process(p, PROCESS_CURRENT());
+}
+
+
+void process_poll(struct process *p){
+
+	if(p != NULL && (p->state == PROCESS_STATE_RUNNING || p->state == PROCESS_STATE_CALLED)){
+
+		p->needspoll = 1;
+		poll_requested = 1;
+	}
+}
+
+
+int process_is_running(struct process *p){
+
+	return p->state != PROCESS_STATE_NONE;
+}
+
+
+process_event_t process_alloc_event(void){
+
+	return lastevent++;
+}
+
+static int do_poll(void){
+
+	struct process *p;
+
+	if(!poll_requested)
+		return 0;
+
+	poll_requested = 0;
+
+	for(p = process_list; p != NULL; p = p->next)
+		if(p->needspoll){
+
+			p->state = PROCESS_STATE_RUNNING;
+			p->needspoll = 0;
+			call_process(p, PROCESS_EVENT_POLL, NULL);
+		}
+
+	return 1;
+}
+
+static int do_event(void){
+
+	process_event_t ev;
+	process_data_t data;
+	struct process *receiver, *p, *next;
+
+	if(nevents == 0)
+		return 0;
+
+	ev = events[fevent].ev;
+	data = events[fevent].data;
+	receiver = events[fevent].p;
+
+	fevent = (fevent + 1) % PROCESS_CONF_NUMEVENTS;
+	nevents--;
+
+	if(receiver == PROCESS_BROADCAST){
+
+		for(p = process_list; p != NULL; p = next){
+
+			next = p->next;
+
+			do_poll();
+			call_process(p, ev, data);
+		}
+
+	}else
+		call_process(receiver, ev, data);
+
+	return 1;
+}
+
+/*---------------------------------CLOCK--------------------------------*/
+
+clock_time_t clock_time(void){
+
+	return (clock_time_t)(now_us * CLOCK_SECOND / 1000000);
+}
+
+
+unsigned long clock_seconds(void){
+
+	return (unsigned long)(now_us / 1000000);
+}
+
+
+rtimer_clock_t rtimer_arch_now(void){
+
+	return (rtimer_clock_t)(now_us * RTIMER_SECOND / 1000000);
+}
+
+/*---------------------------------TIMERS-------------------------------*/
+
+static void add_timer(struct etimer *timer){
+
+	struct etimer *t;
+
+	if(timer->p != PROCESS_NONE)
+		for(t = timerlist; t != NULL; t = t->next)
+			if(t == timer){
+
+				timer->p = PROCESS_CURRENT();
+				return;
+			}
+
+	timer->p = PROCESS_CURRENT();
+	timer->next = timerlist;
+	timerlist = timer;
+}
+
+static void unlink_timer(struct etimer *timer){
+
+	struct etimer *t;
+
+	if(timerlist == timer)
+		timerlist = timer->next;
+	else
+		for(t = timerlist; t != NULL; t = t->next)
+			if(t->next == timer){
+
+				t->next = timer->next;
+				break;
+			}
+}
+
+static void remove_timers(struct process *p){
+
+	struct etimer *t, *next;
+
+	for(t = timerlist; t != NULL; t = next){
+
+		next = t->next;
+
+		if(t->p == p){
+
+			unlink_timer(t);
+			t->p = PROCESS_NONE;
+		}
+	}
+}
+
+/*Posting the timer events & running the callbacks of the expired timers*/
+static int expire_timers(void){
+
+	struct etimer *t;
+	struct ctimer *c;
+	struct process *old;
+	int expired = 0;
+
+restart:
+	for(t = timerlist; t != NULL; t = t->next){
+
+		if((clock_time_t)(clock_time() - t->timer.start) < t->timer.interval)
+			continue;
+
+		if(t->p == &ctimer_process){
+
+			unlink_timer(t);
+			t->p = PROCESS_NONE;
+
+			c = (struct ctimer *)t;
+			old = process_current;
+			process_current = c->p;
+
+			if(c->f != NULL)
+				c->f(c->ptr);
+
+			process_current = old;
+
+		}else{
+
+			if(process_post(t->p, PROCESS_EVENT_TIMER, t) != PROCESS_ERR_OK)
+				continue;
+
+			unlink_timer(t);
+			t->p = PROCESS_NONE;
+		}
+
+		expired = 1;
+
+		/*the callback may have changed the list*/
+		goto restart;
+	}
+
+	return expired;
+}
+
+
+void etimer_set(struct etimer *et, clock_time_t interval){
+
+	et->timer.start = clock_time();
+	et->timer.interval = interval;
+	add_timer(et);
+}
+
+
+void etimer_reset(struct etimer *et){
+
+	et->timer.start += et->timer.interval;
+	add_timer(et);
+}
+
+
+void etimer_restart(struct etimer *et){
+
+	et->timer.start = clock_time();
+	add_timer(et);
+}
+
+
+void etimer_stop(struct etimer *et){
+
+	unlink_timer(et);
+	et->p = PROCESS_NONE;
+}
+
+
+int etimer_expired(struct etimer *et){
+
+	return et->p == PROCESS_NONE;
+}
+
+
+clock_time_t etimer_expiration_time(struct etimer *et){
+
+	return et->timer.start + et->timer.interval;
+}
+
+
+void ctimer_set(struct ctimer *c, clock_time_t t, void (*f)(void *), void *ptr){
+
+	struct process *old = process_current;
+
+	c->p = process_current;
+	c->f = f;
+	c->ptr = ptr;
+
+	process_current = &ctimer_process;
+	etimer_set(&c->etimer, t);
+	process_current = old;
+}
+
+
+void ctimer_reset(struct ctimer *c){
+
+	struct process *old = process_current;
+
+	process_current = &ctimer_process;
+	etimer_reset(&c->etimer);
+	process_current = old;
+}
+
+
+void ctimer_restart(struct ctimer *c){
+
+	struct process *old = process_current;
+
+	process_current = &ctimer_process;
+	etimer_restart(&c->etimer);
+	process_current = old;
+}
+
+
+void ctimer_stop(struct ctimer *c){
+
+	etimer_stop(&c->etimer);
+}
+
+
+int ctimer_expired(struct ctimer *c){
+
+	return etimer_expired(&c->etimer);
+}
+
+/*--------------------------------CONSOLE-------------------------------*/
+
+static char line[LINE_SIZE];
+static int line_len = 0;
+static int in_frame = 0;
+
+
+int putchar(int c){
+
+	/*the binary serial frames (SLIP, END = 0xC0) are not console lines*/
+	if((unsigned char)c == 0xC0)
+		in_frame = !in_frame;
+
+	if(in_frame || (unsigned char)c == 0xC0){
+
+		host->serial((unsigned char)c);
+		return c;
+	}
+
+	if(c == '\n' || line_len == LINE_SIZE){
+
+		host->output(line, line_len);
+		line_len = 0;
+
+		if(c == '\n')
+			return c;
+	}
+
+	line[line_len++] = (char)c;
+
+	return c;
+}
+
+
+int puts(const char *s){
+
+	while(*s)
+		putchar(*s++);
+
+	putchar('\n');
+
+	return 1;
+}
+
+
+int printf(const char *fmt, ...){
+
+	char buf[256];
+	va_list ap;
+	int i, n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	if(n > (int)sizeof(buf) - 1)
+		n = sizeof(buf) - 1;
+
+	for(i=0; i<n; i++)
+		putchar((unsigned char)buf[i]);
+
+	return n;
+}
+
+/*---------------------------LEDS & SENSORS-----------------------------*/
+
+static unsigned char leds = 0;
+static int button_active = 0;
+
+
+void leds_on(unsigned char l){
+
+	leds |= l;
+	host->leds(leds);
+}
+
+
+void leds_off(unsigned char l){
+
+	leds &= ~l;
+	host->leds(leds);
+}
+
+
+void leds_toggle(unsigned char l){
+
+	leds ^= l;
+	host->leds(leds);
+}
+
+
+unsigned char leds_get(void){
+
+	return leds;
+}
+
+static int button_value(int type){
+
+	(void)type;
+
+	return 0;
+}
+
+static int button_configure(int type, int value){
+
+	if(type == SENSORS_ACTIVE)
+		button_active = value;
+
+	return 1;
+}
+
+static int button_status(int type){
+
+	(void)type;
+
+	return button_active;
+}
+
+/*SHT11 raw temperature: T = -39.60 + 0.01 * raw*/
+static int sht11_value(int type){
+
+	return (type == SHT11_SENSOR_TEMP) ? host->sensor(SIM_SENSOR_TEMP) : 0;
+}
+
+static int light_value(int type){
+
+	return (type == LIGHT_SENSOR_PHOTOSYNTHETIC) ? host->sensor(SIM_SENSOR_LIGHT) : 0;
+}
+
+static int sensor_configure(int type, int value){
+
+	(void)type;
+	(void)value;
+
+	return 1;
+}
+
+static int sensor_status(int type){
+
+	(void)type;
+
+	return 1;
+}
+
+const struct sensors_sensor button_sensor = {"Button", button_value, button_configure, button_status};
+const struct sensors_sensor sht11_sensor = {"SHT11", sht11_value, sensor_configure, sensor_status};
+const struct sensors_sensor light_sensor = {"Light", light_value, sensor_configure, sensor_status};
+
+/*----------------------------------LIB---------------------------------*/
+
+static unsigned short rand_state = 1;
+
+
+unsigned short crc16_add(unsigned char b, unsigned short acc){
+
+	acc ^= b;
+	acc = (acc >> 8) | (acc << 8);
+	acc ^= (acc & 0xff00) << 4;
+	acc ^= (acc >> 8) >> 4;
+	acc ^= (acc & 0xff00) >> 5;
+
+	return acc;
+}
+
+
+unsigned short crc16_data(const unsigned char *data, int len, unsigned short acc){
+
+	int i;
+
+	for(i=0; i<len; i++)
+		acc = crc16_add(data[i], acc);
+
+	return acc;
+}
+
+
+void random_init(unsigned short seed){
+
+	rand_state = seed;
+}
+
+
+unsigned short random_rand(void){
+
+	rand_state = rand_state * 2053 + 13849;
+
+	return rand_state;
+}
+
+/*-------------------------------RIME-----------------------------------*/
+
+linkaddr_t linkaddr_node_addr;
+const linkaddr_t linkaddr_null = {{0, 0}};
+
+static uint8_t packetbuf[PACKETBUF_SIZE];
+static uint16_t packetbuf_len = 0;
+static packetbuf_attr_t packetbuf_attrs[PACKETBUF_NUM_ATTRS];
+
+static struct broadcast_conn *broadcast_conns[MAX_CONNS];
+static struct runicast_conn *runicast_conns[MAX_CONNS];
+
+
+int linkaddr_cmp(const linkaddr_t *a, const linkaddr_t *b){
+
+	return a->u8[0] == b->u8[0] && a->u8[1] == b->u8[1];
+}
+
+
+void linkaddr_copy(linkaddr_t *dest, const linkaddr_t *from){
+
+	*dest = *from;
+}
+
+
+void packetbuf_clear(void){
+
+	packetbuf_len = 0;
+	memset(packetbuf_attrs, 0, sizeof(packetbuf_attrs));
+}
+
+
+int packetbuf_copyfrom(const void *from, uint16_t len){
+
+	packetbuf_clear();
+
+	if(len > PACKETBUF_SIZE)
+		len = PACKETBUF_SIZE;
+
+	memcpy(packetbuf, from, len);
+	packetbuf_len = len;
+
+	return len;
+}
+
+
+void *packetbuf_dataptr(void){
+
+	return packetbuf;
+}
+
+
+uint16_t packetbuf_datalen(void){
+
+	return packetbuf_len;
+}
+
+
+void packetbuf_set_datalen(uint16_t len){
+
+	packetbuf_len = (len > PACKETBUF_SIZE) ? PACKETBUF_SIZE : len;
+}
+
+
+packetbuf_attr_t packetbuf_attr(uint8_t type){
+
+	return (type < PACKETBUF_NUM_ATTRS) ? packetbuf_attrs[type] : 0;
+}
+
+
+int packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val){
+
+	if(type >= PACKETBUF_NUM_ATTRS)
+		return 0;
+
+	packetbuf_attrs[type] = val;
+
+	return 1;
+}
+
+/*The cc2420 driver applies attribute - 1, 0 keeps the maximum power*/
+static int txpower(void){
+
+	return packetbuf_attrs[PACKETBUF_ATTR_RADIO_TXPOWER] ? packetbuf_attrs[PACKETBUF_ATTR_RADIO_TXPOWER] - 1 : 31;
+}
+
+static void add_conn(void **conns, void *c){
+
+	int i;
+
+	for(i=0; i<MAX_CONNS; i++)
+		if(conns[i] == NULL || conns[i] == c){
+
+			conns[i] = c;
+			return;
+		}
+}
+
+static void remove_conn(void **conns, void *c){
+
+	int i;
+
+	for(i=0; i<MAX_CONNS; i++)
+		if(conns[i] == c)
+			conns[i] = NULL;
+}
+
+
+void broadcast_open(struct broadcast_conn *c, uint16_t channel, const struct broadcast_callbacks *u){
+
+	c->channel = channel;
+	c->u = u;
+	add_conn((void **)broadcast_conns, c);
+}
+
+
+void broadcast_close(struct broadcast_conn *c){
+
+	remove_conn((void **)broadcast_conns, c);
+}
+
+
+int broadcast_send(struct broadcast_conn *c){
+
+	host->radio_send(SIM_BROADCAST, c->channel, 0, 0, packetbuf, packetbuf_len, txpower(), 0);
+
+	return 1;
+}
+
+
+void runicast_open(struct runicast_conn *c, uint16_t channel, const struct runicast_callbacks *u){
+
+	c->channel = channel;
+	c->u = u;
+	c->is_tx = 0;
+	c->sndnxt = 0;
+	add_conn((void **)runicast_conns, c);
+}
+
+
+void runicast_close(struct runicast_conn *c){
+
+	remove_conn((void **)runicast_conns, c);
+}
+
+
+int runicast_send(struct runicast_conn *c, const linkaddr_t *receiver, uint8_t max_retransmissions){
+
+	if(c->is_tx)
+		return 0;
+
+	c->is_tx = 1;
+	c->max_rxmit = max_retransmissions;
+	c->rxmit = 0;
+	linkaddr_copy(&c->to, receiver);
+
+	host->radio_send(SIM_RUNICAST, c->channel, receiver->u8[0], c->sndnxt++, packetbuf, packetbuf_len,
+		txpower(), max_retransmissions);
+
+	return 1;
+}
+
+
+uint8_t runicast_is_transmitting(struct runicast_conn *c){
+
+	return c->is_tx;
+}
+
+/*--------------------------------COFFEE--------------------------------*/
+
+/*the external flash, Coffee directory included: kept by a reboot (sim_firmware.flash)*/
+static struct {
+
+	struct {
+
+		char name[CFS_NAME_SIZE];
+		cfs_offset_t start;
+		cfs_offset_t size;			/*reserved*/
+		cfs_offset_t end;			/*written*/
+		uint8_t used;
+	} files[CFS_MAX_FILES];
+
+	uint8_t data[SIM_FLASH_SIZE];
+} flash;
+
+static struct {
+
+	int file;					/*-1 if free*/
+	cfs_offset_t offset;
+	int flags;
+} fds[CFS_MAX_FDS];
+
+static int find_file(const char *name){
+
+	int i;
+
+	for(i=0; i<CFS_MAX_FILES; i++)
+		if(flash.files[i].used && strncmp(flash.files[i].name, name, CFS_NAME_SIZE) == 0)
+			return i;
+
+	return -1;
+}
+
+/*First fit in the flash between the allocated files*/
+static int create_file(const char *name, cfs_offset_t size){
+
+	cfs_offset_t start = 0;
+	int i, f = -1, moved = 1;
+
+	for(i=0; i<CFS_MAX_FILES; i++)
+		if(!flash.files[i].used){
+
+			f = i;
+			break;
+		}
+
+	if(f < 0)
+		return -1;
+
+	while(moved){
+
+		moved = 0;
+
+		for(i=0; i<CFS_MAX_FILES; i++)
+			if(flash.files[i].used && start < flash.files[i].start + flash.files[i].size &&
+				flash.files[i].start < start + size){
+
+				start = flash.files[i].start + flash.files[i].size;
+				moved = 1;
+			}
+	}
+
+	if(start + size > SIM_FLASH_SIZE)
+		return -1;
+
+	strncpy(flash.files[f].name, name, CFS_NAME_SIZE);
+	flash.files[f].start = start;
+	flash.files[f].size = size;
+	flash.files[f].end = 0;
+	flash.files[f].used = 1;
+
+	return f;
+}
+
+
+int cfs_coffee_reserve(const char *name, cfs_offset_t size){
+
+	if(find_file(name) >= 0)
+		return -1;
+
+	return (create_file(name, size) < 0) ? -1 : 0;
+}
+
+
+int cfs_coffee_format(void){
+
+	memset(flash.files, 0, sizeof(flash.files));
+
+	return 0;
+}
+
+
+int cfs_open(const char *name, int flags){
+
+	int f = find_file(name), fd;
+
+	if(f < 0 && (flags & CFS_WRITE))
+		f = create_file(name, CFS_DEFAULT_SIZE);
+
+	if(f < 0)
+		return -1;
+
+	for(fd=0; fd<CFS_MAX_FDS; fd++)
+		if(fds[fd].file < 0){
+
+			fds[fd].file = f;
+			fds[fd].flags = flags;
+			fds[fd].offset = (flags & CFS_APPEND) ? flash.files[f].end : 0;
+
+			return fd;
+		}
+
+	return -1;
+}
+
+
+void cfs_close(int fd){
+
+	if(fd >= 0 && fd < CFS_MAX_FDS)
+		fds[fd].file = -1;
+}
+
+
+int cfs_read(int fd, void *buf, unsigned int len){
+
+	int f;
+
+	if(fd < 0 || fd >= CFS_MAX_FDS || (f = fds[fd].file) < 0 || !(fds[fd].flags & CFS_READ))
+		return -1;
+
+	if(fds[fd].offset + (cfs_offset_t)len > flash.files[f].end)
+		len = (flash.files[f].end > fds[fd].offset) ? flash.files[f].end - fds[fd].offset : 0;
+
+	memcpy(buf, flash.data + flash.files[f].start + fds[fd].offset, len);
+	fds[fd].offset += len;
+
+	return len;
+}
+
+
+int cfs_write(int fd, const void *buf, unsigned int len){
+
+	int f;
+
+	if(fd < 0 || fd >= CFS_MAX_FDS || (f = fds[fd].file) < 0 || !(fds[fd].flags & CFS_WRITE))
+		return -1;
+
+	if(fds[fd].offset + (cfs_offset_t)len > flash.files[f].size){
+
+		if(fds[fd].offset >= flash.files[f].size)
+			return -1;
+
+		len = flash.files[f].size - fds[fd].offset;
+	}
+
+	memcpy(flash.data + flash.files[f].start + fds[fd].offset, buf, len);
+	fds[fd].offset += len;
+
+	if(fds[fd].offset > flash.files[f].end)
+		flash.files[f].end = fds[fd].offset;
+
+	return len;
+}
+
+
+cfs_offset_t cfs_seek(int fd, cfs_offset_t offset, int whence){
+
+	cfs_offset_t pos;
+	int f;
+
+	if(fd < 0 || fd >= CFS_MAX_FDS || (f = fds[fd].file) < 0)
+		return -1;
+
+	if(whence == CFS_SEEK_SET)
+		pos = offset;
+	else if(whence == CFS_SEEK_CUR)
+		pos = fds[fd].offset + offset;
+	else
+		pos = flash.files[f].end + offset;
+
+	if(pos < 0 || pos > flash.files[f].size)
+		return -1;
+
+	fds[fd].offset = pos;
+
+	return pos;
+}
+
+
+int cfs_remove(const char *name){
+
+	int f = find_file(name);
+
+	if(f < 0)
+		return -1;
+
+	flash.files[f].used = 0;
+
+	return 0;
+}
+
+/*-------------------------------WATCHDOG-------------------------------*/
+
+void watchdog_reboot(void){
+
+	rebooting = 1;
+	host->reboot();
+}
+
+/*--------------------------------ENTRIES-------------------------------*/
+
+static void run(uint64_t now){
+
+	int steps = 0;
+
+	now_us = now;
+
+	while(!rebooting && (expire_timers() | do_poll() | do_event()))
+
+		if(++steps == MAX_RUN_STEPS){
+
+			printf("SIM: %d events without idling, livelock?\n", steps);
+			break;
+		}
+}
+
+static void boot(const struct sim_host *h, int addr, uint64_t now, unsigned short seed){
+
+	int i;
+
+	host = h;
+	now_us = now;
+
+	linkaddr_node_addr.u8[0] = addr;
+	linkaddr_node_addr.u8[1] = 0;
+
+	random_init(seed);
+
+	for(i=0; i<CFS_MAX_FDS; i++)
+		fds[i].file = -1;
+
+	lastevent = PROCESS_EVENT_MAX;
+	sensors_event = process_alloc_event();
+	serial_line_event_message = process_alloc_event();
+
+	process_start(&ctimer_process, NULL);
+	process_start(&rime_process, NULL);
+
+	for(i=0; autostart_processes[i] != NULL; i++)
+		process_start(autostart_processes[i], NULL);
+
+	run(now);
+}
+
+static uint64_t next_wake(void){
+
+	struct etimer *t;
+	uint64_t wake = SIM_NEVER, at;
+
+	if(nevents > 0 || poll_requested)
+		return now_us;
+
+	for(t = timerlist; t != NULL; t = t->next){
+
+		/*first microsecond at which clock_time() reaches the expiration*/
+		at = ((uint64_t)(t->timer.start + t->timer.interval) * 1000000 + CLOCK_SECOND - 1) / CLOCK_SECOND;
+
+		if(at < wake)
+			wake = at;
+	}
+
+	return (wake < now_us) ? now_us : wake;
+}
+
+static void deliver(const struct sim_packet *packet, uint64_t now){
+
+	linkaddr_t from;
+	int i;
+
+	now_us = now;
+
+	packetbuf_copyfrom(packet->data, packet->len);
+	packetbuf_attrs[PACKETBUF_ATTR_RSSI] = (packetbuf_attr_t)(int16_t)packet->rssi;
+	packetbuf_attrs[PACKETBUF_ATTR_LINK_QUALITY] = packet->lqi;
+
+	from.u8[0] = packet->src;
+	from.u8[1] = 0;
+
+	process_current = &rime_process;
+
+	if(packet->kind == SIM_BROADCAST){
+
+		for(i=0; i<MAX_CONNS; i++)
+			if(broadcast_conns[i] != NULL && broadcast_conns[i]->channel == packet->channel &&
+				broadcast_conns[i]->u->recv != NULL)
+				broadcast_conns[i]->u->recv(broadcast_conns[i], &from);
+
+	}else{
+
+		for(i=0; i<MAX_CONNS; i++)
+			if(runicast_conns[i] != NULL && runicast_conns[i]->channel == packet->channel &&
+				runicast_conns[i]->u->recv != NULL)
+				runicast_conns[i]->u->recv(runicast_conns[i], &from, packet->seqno);
+	}
+
+	process_current = NULL;
+
+	run(now);
+}
+
+static void tx_done(int kind, uint16_t channel, int dst, int retransmissions, int ok, uint64_t now){
+
+	struct runicast_conn *c;
+	int i;
+
+	now_us = now;
+	process_current = &rime_process;
+
+	for(i=0; i<MAX_CONNS; i++){
+
+		if(kind == SIM_BROADCAST){
+
+			if(broadcast_conns[i] != NULL && broadcast_conns[i]->channel == channel &&
+				broadcast_conns[i]->u->sent != NULL)
+				broadcast_conns[i]->u->sent(broadcast_conns[i], 0, 1);
+
+			continue;
+		}
+
+		c = runicast_conns[i];
+
+		if(c == NULL || c->channel != channel || !c->is_tx || c->to.u8[0] != dst)
+			continue;
+
+		/*as Contiki's runicast: rxmit counts the transmissions, 1 at the first try*/
+		c->is_tx = 0;
+		c->rxmit = retransmissions + 1;
+
+		if(ok && c->u->sent != NULL)
+			c->u->sent(c, &c->to, c->rxmit);
+		else if(!ok && c->u->timedout != NULL)
+			c->u->timedout(c, &c->to, c->rxmit);
+	}
+
+	process_current = NULL;
+
+	run(now);
+}
+
+static void button(uint64_t now){
+
+	now_us = now;
+
+	if(button_active)
+		process_post(PROCESS_BROADCAST, sensors_event, (process_data_t)&button_sensor);
+
+	run(now);
+}
+
+static void console(const char *line, uint64_t now){
+
+	static char buf[SERIAL_LINE_CONF_BUFSIZE];
+
+	now_us = now;
+
+	strncpy(buf, line, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+
+	process_post(PROCESS_BROADCAST, serial_line_event_message, buf);
+
+	run(now);
+}
+
+__attribute__((visibility("default")))
+const struct sim_firmware sim_firmware = {SIM_FIRMWARE_NAME, boot, run, next_wake, deliver, tx_done, button, console,
+	&flash, sizeof(flash)};
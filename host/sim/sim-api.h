@@ -0,0 +1,88 @@
+/*-------------------------------Sim API----------------------------------
+	Interface between the simulator (sim.c) and a firmware built with
+	the Contiki shim (shim.c) as a shared object.
+
+	The firmware exports one struct sim_firmware; every call runs the
+	node whose memory image is currently loaded in that copy of the
+	shared object. The shim reaches the simulator only through the
+	struct sim_host given at boot, on behalf of the current node.
+
+	Times are in microseconds of simulated time.
+------------------------------------------------------------------------*/
+#ifndef SIM_API_H_
+#define SIM_API_H_
+
+#include <stdint.h>
+
+#define SIM_NEVER				UINT64_MAX
+#define SIM_PACKET_SIZE			128			/*PACKETBUF_SIZE*/
+
+#define SIM_BROADCAST			0
+#define SIM_RUNICAST			1
+
+#define SIM_SENSOR_TEMP			0			/*SHT11 raw temperature*/
+#define SIM_SENSOR_LIGHT		1			/*photosynthetic light raw*/
+
+struct sim_packet {
+
+	uint8_t kind;				/*SIM_BROADCAST/SIM_RUNICAST*/
+	uint8_t src;
+	uint16_t channel;
+	uint8_t seqno;
+	int8_t rssi;
+	uint8_t lqi;
+	uint8_t pad;
+	uint16_t len;
+	uint8_t data[SIM_PACKET_SIZE];
+};
+
+/*Services of the simulator, on behalf of the current node*/
+struct sim_host {
+
+	/*a line printed by the firmware (putchar/printf), without the newline*/
+	void (*output)(const char *line, int len);
+
+	/*transmission of the packetbuf; runicast deliveries are acknowledged with tx_done*/
+	void (*radio_send)(int kind, uint16_t channel, int dst, uint8_t seqno, const void *data, int len,
+		int txpower, int max_rexmit);
+
+	int (*sensor)(int sensor);
+
+	void (*leds)(unsigned char leds);
+
+	/*a byte of the binary serial frames (SLIP, the END delimiters included)*/
+	void (*serial)(unsigned char c);
+
+	/*watchdog_reboot(): booting again once the call returns, with the flash kept*/
+	void (*reboot)(void);
+};
+
+struct sim_firmware {
+
+	const char *name;
+
+	/*booting the loaded (pristine) image as rime address addr*/
+	void (*boot)(const struct sim_host *host, int addr, uint64_t now, unsigned short seed);
+
+	/*expiring the timers up to now & running every pending event*/
+	void (*run)(uint64_t now);
+
+	/*earliest timer expiration, SIM_NEVER if none*/
+	uint64_t (*next_wake)(void);
+
+	/*the following calls run the resulting events before returning*/
+	void (*deliver)(const struct sim_packet *packet, uint64_t now);
+
+	void (*tx_done)(int kind, uint16_t channel, int dst, int retransmissions, int ok, uint64_t now);
+
+	void (*button)(uint64_t now);
+
+	/*a line typed on the serial console (serial_line_event_message)*/
+	void (*console)(const char *line, uint64_t now);
+
+	/*external flash in the data/bss image, kept by a reboot*/
+	void *flash;
+	unsigned long flash_size;
+};
+
+#endif /* SIM_API_H_ */
@@ -0,0 +1,1266 @@
+/*-------------------------------Simulator--------------------------------
+	Many-house simulator of the CU, Node1, Node2 and Node4 firmwares.
+
+	Usage:	sim [-H houses] [-n nodes] [-w workers] [-t seconds]
+				[-c command_period] [-s seed] [-v house] [-d dir]
+				[-T trace_prefix] [-k seconds:line ...]
+				[-u seconds:version:target:bytes ...]
+
+	The firmwares are the unmodified sources built against the Contiki
+	shim (shim.c) as shared objects (cu.so, node1.so, node2.so,
+	node4.so, searched in -d, default the directory of the binary).
+	A house is the CU (address 3), Node1, Node2, Node4 and -n - 4
+	more nodes running the Node4 firmware (addresses 5, 6, ...).
+
+	Node memory images: the whole state of a firmware is its static
+	data, so every node owns a copy of the data/bss range of its
+	shared object and runs by loading it in the object. Every worker
+	dlopens its own copy of each object; pointers into the object are
+	shifted when an image moves to a copy mapped at another address.
+
+	Scheduling: the houses do not share a medium, so a house is the
+	unit of work. A house runs its discrete events in order (virtual
+	clock in microseconds) for CHUNK_US of simulated time, then goes
+	back to the deque of its worker; idle workers steal houses from
+	the others (Chase-Lev deques). Runs are reproducible: every house
+	draws from its own random generator.
+
+	Channel: log-distance path loss with per-link shadowing, the CC2420
+	output power levels, a loss probability rising around the receiver
+	sensitivity, 250 kbps airtime and a busy medium deferring the
+	transmissions. Runicast data and acknowledgements are lost
+	independently and retransmitted every second (Rime REXMIT_TIME).
+
+	Workload: a command typed on the CU button every -c seconds (GET
+	ALL, GET AVG. TEMP, GET EXT. LIGHT, comfort, gate), Node4 button
+	presses every 10 minutes; every -k line is typed on the CU console
+	of every house at its time (e.g. -k "600:config 1 period 30" to
+	compare configurations); every -u uploads a firmware image of
+	random bytes on the CU console at its time (ota load, data & seed
+	lines, e.g. -u 600:1:node4:16384), disseminated by ota.c. The
+	report gives the simulated time over the wall time, the radio
+	counters and the latency percentiles of the runicast deliveries
+	and of the commands printed by the CU, and with -u the rollout
+	time of the OTA reports & the OTA bytes per node.
+
+	A firmware calling watchdog_reboot() boots again REBOOT_US later
+	from its pristine image, the flash of the shim (Coffee) kept.
+
+	-v prints the console of one house; with -T the serial frames of
+	its nodes go to <trace_prefix><address>.trace, that is the traces
+	of firmwares built with make TRACE=1 (host/sim/replay input).
+------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sim-api.h"
+#include "loader.h"
+
+#define NODE1_ADDR				1
+#define NODE2_ADDR				2
+#define CU_ADDR					3
+#define NODE4_ADDR				4
+#define MIN_NODES				4
+#define MAX_NODES				50
+#define MAX_WORKERS				256
+
+#define FW_CU					0
+#define FW_NODE1				1
+#define FW_NODE2				2
+#define FW_NODE4				3
+#define FIRMWARES				4
+
+#define SECOND_US				1000000ULL
+#define CHUNK_US				(10 * SECOND_US)	/*run by a house before yielding the worker*/
+#define BOOT_SPREAD_US			SECOND_US
+#define FIRST_COMMAND_US		(30 * SECOND_US)
+#define PRESS_US				150000				/*between two button presses*/
+#define MAX_CONSOLE				16					/*-k lines & -u images*/
+#define CONSOLE_LINE			80					/*SERIAL_LINE_CONF_BUFSIZE*/
+#define UPLOAD_BYTES			32					/*per ota data line*/
+#define REBOOT_US				SECOND_US			/*watchdog reset to the boot*/
+#define NODE4_PRESS_US			(600 * SECOND_US)
+#define MAX_SAME_TIME			10000				/*activations of a node at one time*/
+
+/*radio (CC2420)*/
+#define BYTE_US					32					/*250 kbps*/
+#define FRAME_OVERHEAD			23					/*PHY, 802.15.4 MAC & Rime header bytes*/
+#define ACK_US					(192 + 11 * BYTE_US)
+#define REXMIT_US				SECOND_US
+#define TX_DBM					0.0
+#define PATH_LOSS_1M			40.0
+#define PATH_LOSS_EXPONENT		3.0
+#define SHADOWING_DB			6.0
+#define SENSITIVITY_DBM			(-88.0)				/*50% loss*/
+#define LOSS_SLOPE_DB			2.0
+#define RSSI_OFFSET				(-45)				/*LINK_QUALITY_RSSI_OFFSET*/
+
+#define LATENCY_BUCKETS			10001				/*ms, the last one collects the rest*/
+
+#define EV_DELIVER				0
+#define EV_TX_DONE				1
+
+/*---------------------------------TYPES---------------------------------*/
+
+struct firmware {
+
+	const char *file;
+	struct loader_layout layout;
+	uint8_t *pristine;
+	uintptr_t pristine_base;
+};
+
+struct copy {
+
+	struct loader_copy object;
+	struct node *resident;
+};
+
+struct node {
+
+	int addr;
+	int fw;
+	int booted;
+	int rebooting;
+	unsigned short seed;
+	uint64_t wake;
+	uint64_t next_press;
+	unsigned int same_time;
+	double x, y;
+	int temp_offset;				/*0.01 C*/
+	uint8_t *image;
+	uintptr_t image_base;			/*base of the copy the image was saved from*/
+};
+
+struct radio_event {
+
+	uint64_t time;
+	uint64_t seq;
+	int type;
+	int node;
+	int dst;
+	int retransmissions;
+	int ok;
+	struct sim_packet packet;
+};
+
+struct house {
+
+	int id;
+	int n;
+	struct node nodes[MAX_NODES];
+	int index[256];					/*rime address to node*/
+	float *rssi;					/*dBm at full power, n x n*/
+	uint64_t now;
+	uint64_t rng;
+	uint64_t medium_busy;
+	uint64_t next_command;
+	int presses;					/*left in the current command*/
+	int console;					/*next line of the console script*/
+	struct radio_event *events;		/*binary heap on (time, seq)*/
+	int nevents, capacity;
+	uint64_t seq;
+};
+
+struct stats {
+
+	uint64_t activations, lines, livelocks;
+	uint64_t broadcasts, runicasts, attempts, deliveries, losses, timeouts;
+	uint64_t commands, confirms, failures, get_alls;
+	uint64_t reboots, ota_reports, ota_installs, ota_rebooted, ota_staged, ota_rx, ota_tx;
+	uint64_t runicast_ms[LATENCY_BUCKETS];
+	uint64_t confirm_ms[LATENCY_BUCKETS];
+	uint64_t get_all_ms[LATENCY_BUCKETS];
+	uint64_t ota_s[LATENCY_BUCKETS];		/*rollout, seconds*/
+};
+
+struct deque {
+
+	_Atomic int64_t top, bottom;
+	_Atomic int *buf;
+	int64_t mask;
+};
+
+struct worker {
+
+	pthread_t thread;
+	int id;
+	uint64_t rng;
+	struct deque deque;
+	struct copy copies[FIRMWARES];
+	struct stats stats;
+};
+
+/*------------------------------GLOBAL STATE-----------------------------*/
+
+static struct firmware firmwares[FIRMWARES] = {{.file = "cu.so"}, {.file = "node1.so"}, {.file = "node2.so"}, {.file = "node4.so"}};
+
+static struct house *houses;
+static struct worker *workers;
+static int n_houses = 100, n_nodes = MIN_NODES, n_workers = 0, verbose_house = -1;
+static const char *trace_prefix = NULL;
+static FILE *trace_files[256];
+static uint64_t end_us = 3600 * SECOND_US, command_us = 60 * SECOND_US, seed = 1;
+static atomic_int remaining;
+
+static __thread struct worker *cur_worker;
+static __thread struct house *cur_house;
+static __thread struct node *cur_node;
+static __thread const char *cur_line;		/*typed on the CU console*/
+
+/*CU commands: button presses*/
+static const struct {
+
+	const char *name;
+	int presses;
+} commands[] = {{"GATE", 2}, {"GET AVG. TEMP", 4}, {"GET EXT. LIGHT", 5}, {"COMFORT BEDROOM", 6}, {"GET ALL", 10}};
+
+#define COMMANDS				(sizeof(commands) / sizeof(commands[0]))
+
+/*CU console script (-k, -u), in time order*/
+static struct {
+
+	uint64_t time;
+	const char *line;				/*NULL for an image*/
+	int version;
+	char target[8];
+	int bytes;
+} console_script[MAX_CONSOLE];
+
+static int n_console = 0;
+
+/*CC2420 PA_LEVEL to output power*/
+static const struct {
+
+	int level;
+	double db;
+} power_table[] = {{31, 0}, {27, -1}, {23, -3}, {19, -5}, {15, -7}, {11, -10}, {7, -15}, {3, -25}};
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+static void fail(const char *what, const char *detail){
+
+	fprintf(stderr, "sim: %s%s%s\n", what, detail ? ": " : "", detail ? detail : "");
+	exit(1);
+}
+
+static void *xcalloc(size_t n, size_t size){
+
+	void *p = calloc(n, size);
+
+	if(p == NULL)
+		fail("out of memory", NULL);
+
+	return p;
+}
+
+static uint64_t rng_next(uint64_t *s){
+
+	*s ^= *s >> 12;
+	*s ^= *s << 25;
+	*s ^= *s >> 27;
+
+	return *s * 0x2545F4914F6CDD1DULL;
+}
+
+static double rng_uniform(uint64_t *s){
+
+	return (rng_next(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_normal(uint64_t *s){
+
+	double u = rng_uniform(s), v = rng_uniform(s);
+
+	return sqrt(-2.0 * log(u + 1e-300)) * cos(2 * M_PI * v);
+}
+
+static double wall_seconds(void){
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void add_latency(uint64_t *histogram, uint64_t ms){
+
+	histogram[(ms < LATENCY_BUCKETS - 1) ? ms : LATENCY_BUCKETS - 1]++;
+}
+
+/*-------------------------------FIRMWARES-------------------------------*/
+
+static void save_image(struct copy *c){
+
+	struct node *n = c->resident;
+	const struct firmware *f = &firmwares[n->fw];
+
+	memcpy(n->image, loader_data(&f->layout, &c->object), f->layout.data_len);
+	n->image_base = c->object.base;
+	c->resident = NULL;
+}
+
+/*Loading the image of node in its firmware copy*/
+static const struct sim_firmware *load_image(struct node *n){
+
+	struct copy *c = &cur_worker->copies[n->fw];
+	const struct firmware *f = &firmwares[n->fw];
+	uint8_t *data = loader_data(&f->layout, &c->object);
+
+	if(c->resident == n)
+		return c->object.fw;
+
+	if(c->resident != NULL)
+		save_image(c);
+
+	memcpy(data, n->image, f->layout.data_len);
+	loader_relocate(&f->layout, data, n->image_base, c->object.base);
+	c->resident = n;
+
+	return c->object.fw;
+}
+
+/*Resetting the resident image of n to the pristine one but the flash*/
+static void reboot_image(struct node *n, const struct sim_firmware *fw){
+
+	struct copy *c = &cur_worker->copies[n->fw];
+	const struct firmware *f = &firmwares[n->fw];
+	uint8_t *data = loader_data(&f->layout, &c->object), *flash;
+	size_t offset = (uint8_t *)fw->flash - data, size = fw->flash_size;
+
+	flash = xcalloc(1, size);
+	memcpy(flash, data + offset, size);
+
+	memcpy(data, f->pristine, f->layout.data_len);
+	loader_relocate(&f->layout, data, f->pristine_base, c->object.base);
+	memcpy(data + offset, flash, size);
+
+	free(flash);
+}
+
+/*Saving the images of the house before it can be stolen by another worker*/
+static void flush_images(void){
+
+	int i;
+
+	for(i=0; i<FIRMWARES; i++)
+		if(cur_worker->copies[i].resident != NULL)
+			save_image(&cur_worker->copies[i]);
+}
+
+static void load_firmwares(const char *dir){
+
+	struct firmware *f;
+	char path[4096];
+	int i, w;
+
+	for(i=0; i<FIRMWARES; i++){
+
+		f = &firmwares[i];
+		snprintf(path, sizeof(path), "%s/%s", dir, f->file);
+
+		if(loader_layout(path, &f->layout) < 0)
+			exit(1);
+
+		for(w=0; w<n_workers; w++)
+			if(loader_open(path, &workers[w].copies[i].object) < 0)
+				exit(1);
+
+		/*the image of a node that never ran*/
+		f->pristine = xcalloc(1, f->layout.data_len);
+		f->pristine_base = workers[0].copies[i].object.base;
+		memcpy(f->pristine, loader_data(&f->layout, &workers[0].copies[i].object), f->layout.data_len);
+	}
+}
+
+/*--------------------------------EVENTS---------------------------------*/
+
+static int event_before(const struct radio_event *a, const struct radio_event *b){
+
+	return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+/*Appending an event, the caller fills it then calls commit_event*/
+static struct radio_event *push_event(struct house *h, uint64_t time, int type, int node){
+
+	struct radio_event *e;
+
+	if(h->nevents == h->capacity){
+
+		h->capacity = h->capacity ? 2 * h->capacity : 64;
+		h->events = realloc(h->events, h->capacity * sizeof(struct radio_event));
+
+		if(h->events == NULL)
+			fail("out of memory", NULL);
+	}
+
+	e = &h->events[h->nevents++];
+	e->time = time;
+	e->seq = h->seq++;
+	e->type = type;
+	e->node = node;
+
+	return e;
+}
+
+static void commit_event(struct house *h){
+
+	struct radio_event tmp;
+	int i = h->nevents - 1, parent;
+
+	while(i > 0){
+
+		parent = (i - 1) / 2;
+
+		if(!event_before(&h->events[i], &h->events[parent]))
+			break;
+
+		tmp = h->events[i];
+		h->events[i] = h->events[parent];
+		h->events[parent] = tmp;
+		i = parent;
+	}
+}
+
+static void pop_event(struct house *h, struct radio_event *out){
+
+	struct radio_event tmp;
+	int i = 0, child;
+
+	*out = h->events[0];
+	h->events[0] = h->events[--h->nevents];
+
+	while((child = 2 * i + 1) < h->nevents){
+
+		if(child + 1 < h->nevents && event_before(&h->events[child + 1], &h->events[child]))
+			child++;
+
+		if(!event_before(&h->events[child], &h->events[i]))
+			break;
+
+		tmp = h->events[i];
+		h->events[i] = h->events[child];
+		h->events[child] = tmp;
+		i = child;
+	}
+}
+
+/*--------------------------------CHANNEL--------------------------------*/
+
+static double tx_gain(int power){
+
+	unsigned int i;
+
+	for(i=0; i<sizeof(power_table) / sizeof(power_table[0]); i++)
+		if(power >= power_table[i].level)
+			return power_table[i].db;
+
+	return -30;
+}
+
+/*Received power in dBm*/
+static double link_dbm(struct house *h, int from, int to, int power){
+
+	return h->rssi[from * h->n + to] + tx_gain(power);
+}
+
+static int frame_lost(struct house *h, double dbm){
+
+	return rng_uniform(&h->rng) < 1.0 / (1.0 + exp((dbm - SENSITIVITY_DBM) / LOSS_SLOPE_DB));
+}
+
+static void fill_packet(struct radio_event *e, int kind, int src, uint16_t channel, uint8_t seqno, const void *data,
+	int len, double dbm){
+
+	int lqi = 110 - 2 * (int)(-60.0 - dbm);
+
+	e->packet.kind = kind;
+	e->packet.src = src;
+	e->packet.channel = channel;
+	e->packet.seqno = seqno;
+	e->packet.rssi = (int8_t)lround(dbm - RSSI_OFFSET);
+	e->packet.lqi = (lqi > 110) ? 110 : (lqi < 50) ? 50 : lqi;
+	e->packet.len = len;
+	memcpy(e->packet.data, data, len);
+}
+
+static void host_radio_send(int kind, uint16_t channel, int dst, uint8_t seqno, const void *data, int len,
+	int txpower, int max_rexmit){
+
+	struct house *h = cur_house;
+	struct stats *s = &cur_worker->stats;
+	int src = cur_node - h->nodes, to = (dst >= 0 && dst < 256) ? h->index[dst] : -1;
+	uint64_t airtime = (uint64_t)(len + FRAME_OVERHEAD) * BYTE_US, start, at;
+	struct radio_event *e;
+	int i, attempt, delivered = 0;
+	double dbm;
+
+	if(len > SIM_PACKET_SIZE)
+		len = SIM_PACKET_SIZE;
+
+	start = (h->medium_busy > h->now) ? h->medium_busy : h->now;
+	h->medium_busy = start + airtime + ((kind == SIM_RUNICAST) ? ACK_US : 0);
+
+	if(kind == SIM_BROADCAST){
+
+		s->broadcasts++;
+		s->attempts++;
+
+		for(i=0; i<h->n; i++){
+
+			if(i == src)
+				continue;
+
+			dbm = link_dbm(h, src, i, txpower);
+
+			if(frame_lost(h, dbm)){
+
+				s->losses++;
+				continue;
+			}
+
+			e = push_event(h, start + airtime, EV_DELIVER, i);
+			fill_packet(e, SIM_BROADCAST, cur_node->addr, channel, seqno, data, len, dbm);
+			commit_event(h);
+			s->deliveries++;
+		}
+
+		e = push_event(h, start + airtime, EV_TX_DONE, src);
+		e->packet.kind = SIM_BROADCAST;
+		e->packet.channel = channel;
+		e->dst = 0;
+		e->retransmissions = 0;
+		e->ok = 1;
+		commit_event(h);
+
+		return;
+	}
+
+	s->runicasts++;
+
+	/*the data reaches the receiver once, the sender waits for an acknowledged attempt*/
+	for(attempt = 0; attempt <= max_rexmit; attempt++){
+
+		at = start + attempt * REXMIT_US;
+		s->attempts++;
+
+		if(to < 0 || to == src || frame_lost(h, dbm = link_dbm(h, src, to, txpower))){
+
+			s->losses++;
+			continue;
+		}
+
+		if(!delivered){
+
+			e = push_event(h, at + airtime, EV_DELIVER, to);
+			fill_packet(e, SIM_RUNICAST, cur_node->addr, channel, seqno, data, len, dbm);
+			commit_event(h);
+			s->deliveries++;
+			delivered = 1;
+		}
+
+		/*acknowledgement at full power*/
+		if(frame_lost(h, link_dbm(h, to, src, 31))){
+
+			s->losses++;
+			continue;
+		}
+
+		e = push_event(h, at + airtime + ACK_US, EV_TX_DONE, src);
+		e->packet.kind = SIM_RUNICAST;
+		e->packet.channel = channel;
+		e->dst = dst;
+		e->retransmissions = attempt;
+		e->ok = 1;
+		commit_event(h);
+
+		add_latency(s->runicast_ms, (at + airtime + ACK_US - h->now) / 1000);
+
+		return;
+	}
+
+	s->timeouts++;
+
+	e = push_event(h, start + (max_rexmit + 1) * REXMIT_US, EV_TX_DONE, src);
+	e->packet.kind = SIM_RUNICAST;
+	e->packet.channel = channel;
+	e->dst = dst;
+	e->retransmissions = max_rexmit;
+	e->ok = 0;
+	commit_event(h);
+}
+
+/*---------------------------------HOST----------------------------------*/
+
+static void host_output(const char *line, int len){
+
+	struct stats *s = &cur_worker->stats;
+	char text[256];
+	char state[16];
+	const char *p;
+	unsigned long rx, tx;
+	long ms;
+	int replies, nodes;
+
+	if(len > (int)sizeof(text) - 1)
+		len = sizeof(text) - 1;
+
+	memcpy(text, line, len);
+	text[len] = '\0';
+	s->lines++;
+
+	if(cur_house->id == verbose_house)
+		printf("%10.3f [%d:0] %s\n", cur_house->now / 1e6, cur_node->addr, text);
+
+	if(cur_node->addr != CU_ADDR)
+		return;
+
+	if((p = strstr(text, "(confirmed in ")) != NULL && sscanf(p, "(confirmed in %ld ms)", &ms) == 1){
+
+		s->confirms++;
+		add_latency(s->confirm_ms, (ms > 0) ? ms : 0);
+
+	}else if((p = strstr(text, "HOUSE OVERVIEW: ")) != NULL &&
+		sscanf(p, "HOUSE OVERVIEW: %d/%d nodes in %ld ms", &replies, &nodes, &ms) == 3){
+
+		s->get_alls++;
+		add_latency(s->get_all_ms, (ms > 0) ? ms : 0);
+
+	}else if((p = strstr(text, "OTA [")) != NULL &&
+		sscanf(p, "OTA [%*d:0] version %*u %15s rollout %ld ms, received %lu B, sent %lu B", state, &ms, &rx, &tx) == 4){
+
+		s->ota_reports++;
+		s->ota_installs += strcmp(state, "rebooting:") == 0;
+		s->ota_rx += rx;
+		s->ota_tx += tx;
+		add_latency(s->ota_s, (ms > 0) ? ms / 1000 : 0);
+
+	}else if((p = strstr(text, "OTA [")) != NULL && strstr(p, " installed, confirmed ") != NULL){
+
+		s->ota_rebooted++;
+		s->ota_staged += strstr(p, "not installed") != NULL;
+
+	}else if(strstr(text, "DELIVERY to ") != NULL && strstr(text, "FAILED") != NULL)
+		s->failures++;
+	else if(strncmp(text, "SIM: ", 5) == 0)
+		s->livelocks++;
+}
+
+/*Day temperature between 18 and 24 C, SHT11 raw = T * 100 + 3960*/
+static int host_sensor(int sensor){
+
+	double day = fmod(cur_house->now / 1e6 / 86400.0, 1.0), t, lux;
+
+	if(sensor == SIM_SENSOR_TEMP){
+
+		t = 2100 + 300 * sin(2 * M_PI * (day - 0.375)) + cur_node->temp_offset + 10 * rng_normal(&cur_house->rng);
+
+		return (int)t + 3960;
+	}
+
+	/*daylight from 6 to 18, firmware lux = 10 * raw / 7*/
+	lux = (day > 0.25 && day < 0.75) ? 1000 * sin(2 * M_PI * (day - 0.25)) : 0;
+
+	return (int)(lux * 7 / 10);
+}
+
+static void host_leds(unsigned char leds){
+
+	(void)leds;
+}
+
+/*Serial frames of the verbose house, one file per node*/
+static void host_serial(unsigned char c){
+
+	FILE **f = &trace_files[cur_node->addr];
+	char path[4096];
+
+	if(cur_house->id != verbose_house || trace_prefix == NULL)
+		return;
+
+	if(*f == NULL){
+
+		snprintf(path, sizeof(path), "%s%d.trace", trace_prefix, cur_node->addr);
+
+		if((*f = fopen(path, "wb")) == NULL)
+			fail("cannot write", path);
+	}
+
+	fputc(c, *f);
+}
+
+/*Rebooted by activate() once the firmware returns*/
+static void host_reboot(void){
+
+	cur_node->rebooting = 1;
+}
+
+static const struct sim_host host = {host_output, host_radio_send, host_sensor, host_leds, host_serial, host_reboot};
+
+/*--------------------------------HOUSES---------------------------------*/
+
+static void init_house(struct house *h, int id){
+
+	double side = 6 * sqrt(n_nodes), d, shadow;
+	struct node *n;
+	int i, j;
+
+	h->id = id;
+	h->n = n_nodes;
+	h->rng = (seed * 0x9E3779B97F4A7C15ULL) ^ (id + 1) * 0xBF58476D1CE4E5B9ULL;
+
+	if(h->rng == 0)
+		h->rng = 1;
+
+	for(i=0; i<256; i++)
+		h->index[i] = -1;
+
+	for(i=0; i<h->n; i++){
+
+		n = &h->nodes[i];
+		n->addr = i + 1;
+		n->fw = (n->addr == CU_ADDR) ? FW_CU : (n->addr == NODE1_ADDR) ? FW_NODE1 :
+			(n->addr == NODE2_ADDR) ? FW_NODE2 : FW_NODE4;
+		n->seed = (unsigned short)rng_next(&h->rng);
+		n->wake = rng_next(&h->rng) % BOOT_SPREAD_US;
+		n->next_press = (n->fw == FW_NODE4) ? NODE4_PRESS_US / 2 + rng_next(&h->rng) % NODE4_PRESS_US : SIM_NEVER;
+		n->temp_offset = (int)(50 * rng_normal(&h->rng));
+		n->image = xcalloc(1, firmwares[n->fw].layout.data_len);
+		memcpy(n->image, firmwares[n->fw].pristine, firmwares[n->fw].layout.data_len);
+		n->image_base = firmwares[n->fw].pristine_base;
+
+		/*the CU in the middle of the house*/
+		n->x = (n->addr == CU_ADDR) ? side / 2 : side * rng_uniform(&h->rng);
+		n->y = (n->addr == CU_ADDR) ? side / 2 : side * rng_uniform(&h->rng);
+
+		h->index[n->addr] = i;
+	}
+
+	h->rssi = xcalloc(h->n * h->n, sizeof(float));
+
+	for(i=0; i<h->n; i++)
+		for(j=i+1; j<h->n; j++){
+
+			d = hypot(h->nodes[i].x - h->nodes[j].x, h->nodes[i].y - h->nodes[j].y);
+			shadow = SHADOWING_DB * rng_normal(&h->rng);
+			h->rssi[i * h->n + j] = h->rssi[j * h->n + i] =
+				TX_DBM - PATH_LOSS_1M - 10 * PATH_LOSS_EXPONENT * log10((d < 1) ? 1 : d) - shadow;
+		}
+
+	h->next_command = FIRST_COMMAND_US + rng_next(&h->rng) % command_us;
+}
+
+/*Activating node n: boot, events delivery or timers*/
+static void activate(struct house *h, struct node *n, const struct radio_event *e, int press){
+
+	const struct sim_firmware *fw = load_image(n);
+	uint64_t wake;
+
+	cur_node = n;
+	cur_worker->stats.activations++;
+
+	if(!n->booted){
+
+		n->booted = 1;
+		fw->boot(&host, n->addr, h->now, n->seed);
+
+	}else if(e != NULL && e->type == EV_DELIVER)
+		fw->deliver(&e->packet, h->now);
+	else if(e != NULL)
+		fw->tx_done(e->packet.kind, e->packet.channel, e->dst, e->retransmissions, e->ok, h->now);
+	else if(press == 3)
+		fw->console(cur_line, h->now);
+	else if(press)
+		fw->button(h->now);
+	else
+		fw->run(h->now);
+
+	wake = fw->next_wake();
+
+	/*a node rescheduling itself forever at one time would stall the house*/
+	if(wake <= h->now && ++n->same_time > MAX_SAME_TIME){
+
+		cur_worker->stats.livelocks++;
+		wake = h->now + 1000;
+	}
+
+	if(wake > h->now)
+		n->same_time = 0;
+
+	n->wake = wake;
+
+	if(n->rebooting){
+
+		reboot_image(n, fw);
+
+		cur_worker->stats.reboots++;
+		n->rebooting = 0;
+		n->booted = 0;
+		n->wake = h->now + REBOOT_US;
+	}
+}
+
+/*Next CU button press of the scripted commands*/
+static void command_press(struct house *h){
+
+	struct node *cu = &h->nodes[h->index[CU_ADDR]];
+
+	if(h->presses == 0){
+
+		h->presses = commands[rng_next(&h->rng) % COMMANDS].presses;
+		cur_worker->stats.commands++;
+	}
+
+	if(cu->booted)
+		activate(h, cu, NULL, 1);
+
+	if(--h->presses > 0)
+		h->next_command = h->now + PRESS_US;
+	else
+		h->next_command = h->now + command_us / 2 + rng_next(&h->rng) % command_us;
+}
+
+static void type_line(struct house *h, struct node *cu, const char *line){
+
+	cur_line = line;
+
+	if(cu->booted)
+		activate(h, cu, NULL, 3);
+}
+
+/*Next line of the console script, or the lines of an image, typed on the CU*/
+static void console_line(struct house *h){
+
+	struct node *cu = &h->nodes[h->index[CU_ADDR]];
+	int version = console_script[h->console].version, bytes = console_script[h->console].bytes, i, n;
+	uint64_t rng = (version + 1) * 0x9E3779B97F4A7C15ULL;
+	char line[CONSOLE_LINE], *p;
+
+	if(console_script[h->console].line != NULL){
+
+		type_line(h, cu, console_script[h->console].line);
+		h->console++;
+
+		return;
+	}
+
+	/*the same image in every house*/
+	snprintf(line, sizeof(line), "ota load %d %s %d", version, console_script[h->console].target, bytes);
+	type_line(h, cu, line);
+
+	for(i=0; i<bytes; i+=UPLOAD_BYTES){
+
+		p = line + sprintf(line, "ota data ");
+
+		for(n=0; n<UPLOAD_BYTES && i + n < bytes; n++)
+			p += sprintf(p, "%02x", (unsigned int)(rng_next(&rng) >> 56));
+
+		type_line(h, cu, line);
+	}
+
+	type_line(h, cu, "ota seed");
+	h->console++;
+}
+
+/*Running the events of house h up to until*/
+static void run_house(struct house *h, uint64_t until){
+
+	struct radio_event e;
+	struct node *n, *first;
+	uint64_t t;
+	int i, press;
+
+	cur_house = h;
+
+	for(;;){
+
+		first = NULL;
+		press = 0;
+		t = SIM_NEVER;
+
+		/*radio events first, then the buttons, then the timers at one time*/
+		if(h->nevents > 0)
+			t = h->events[0].time;
+
+		if(h->next_command < t){
+
+			t = h->next_command;
+			press = 1;
+		}
+
+		if(h->console < n_console && console_script[h->console].time < t){
+
+			t = console_script[h->console].time;
+			press = 3;
+		}
+
+		for(i=0; i<h->n; i++){
+
+			n = &h->nodes[i];
+
+			if(n->next_press < t){
+
+				t = n->next_press;
+				first = n;
+				press = 2;
+			}
+
+			if(n->wake < t){
+
+				t = n->wake;
+				first = n;
+				press = 0;
+			}
+		}
+
+		if(t > until)
+			break;
+
+		h->now = t;
+
+		if(first == NULL && press == 0){
+
+			pop_event(h, &e);
+			n = &h->nodes[e.node];
+
+			if(n->booted)
+				activate(h, n, &e, 0);
+
+		}else if(press == 1)
+			command_press(h);
+		else if(press == 3)
+			console_line(h);
+		else if(press == 2){
+
+			first->next_press = h->now + NODE4_PRESS_US / 2 + rng_next(&h->rng) % NODE4_PRESS_US;
+
+			if(first->booted)
+				activate(h, first, NULL, 1);
+
+		}else
+			activate(h, first, NULL, 0);
+	}
+
+	h->now = until;
+}
+
+/*---------------------------------POOL----------------------------------*/
+
+static void deque_init(struct deque *d, int capacity){
+
+	int size = 1;
+
+	while(size < capacity)
+		size <<= 1;
+
+	d->buf = xcalloc(size, sizeof(int));
+	d->mask = size - 1;
+	atomic_init(&d->top, 0);
+	atomic_init(&d->bottom, 0);
+}
+
+/*Owner only*/
+static void deque_push(struct deque *d, int house){
+
+	int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+
+	atomic_store_explicit(&d->buf[b & d->mask], house, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+/*Owner only, -1 if empty*/
+static int deque_pop(struct deque *d){
+
+	int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1, t;
+	int house = -1;
+
+	atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+	if(t <= b){
+
+		house = atomic_load_explicit(&d->buf[b & d->mask], memory_order_relaxed);
+
+		if(t == b){
+
+			/*last one: race with the thieves*/
+			if(!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+				memory_order_relaxed))
+				house = -1;
+
+			atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+		}
+
+	}else
+		atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+
+	return house;
+}
+
+/*Any worker, -1 if empty or lost the race*/
+static int deque_steal(struct deque *d){
+
+	int64_t t = atomic_load_explicit(&d->top, memory_order_acquire), b;
+	int house;
+
+	atomic_thread_fence(memory_order_seq_cst);
+	b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+	if(t >= b)
+		return -1;
+
+	house = atomic_load_explicit(&d->buf[t & d->mask], memory_order_relaxed);
+
+	if(!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+		return -1;
+
+	return house;
+}
+
+static void *worker_main(void *arg){
+
+	struct worker *w = arg;
+	struct house *h;
+	uint64_t until;
+	int house, i;
+
+	cur_worker = w;
+
+	while(atomic_load_explicit(&remaining, memory_order_acquire) > 0){
+
+		if((house = deque_pop(&w->deque)) < 0){
+
+			for(i=0; i<n_workers && house < 0; i++)
+				house = deque_steal(&workers[rng_next(&w->rng) % n_workers].deque);
+
+			if(house < 0){
+
+				sched_yield();
+				continue;
+			}
+		}
+
+		h = &houses[house];
+		until = (h->now + CHUNK_US < end_us) ? h->now + CHUNK_US : end_us;
+
+		run_house(h, until);
+		flush_images();
+
+		if(h->now < end_us)
+			deque_push(&w->deque, house);
+		else
+			atomic_fetch_sub_explicit(&remaining, 1, memory_order_release);
+	}
+
+	return NULL;
+}
+
+/*--------------------------------REPORT---------------------------------*/
+
+static void merge_stats(struct stats *total){
+
+	uint64_t *t = (uint64_t *)total, *s;
+	size_t i;
+	int w;
+
+	memset(total, 0, sizeof(*total));
+
+	for(w=0; w<n_workers; w++)
+		for(i=0, s = (uint64_t *)&workers[w].stats; i<sizeof(*total) / sizeof(uint64_t); i++)
+			t[i] += s[i];
+}
+
+static void print_percentiles(const char *name, const uint64_t *histogram, const char *unit){
+
+	static const double quantiles[] = {0.5, 0.9, 0.99, 1.0};
+	uint64_t count = 0, seen = 0;
+	int i, q = 0;
+
+	for(i=0; i<LATENCY_BUCKETS; i++)
+		count += histogram[i];
+
+	printf("%-22s %10lu", name, (unsigned long)count);
+
+	for(i=0; i<LATENCY_BUCKETS && count > 0 && q < 4; i++){
+
+		seen += histogram[i];
+
+		while(q < 4 && seen >= quantiles[q] * count)
+			printf("  p%-3g %5d%s", quantiles[q++] * 100, i, (i == LATENCY_BUCKETS - 1) ? "+" : "");
+	}
+
+	printf("%s%s\n", (count > 0) ? " " : "", (count > 0) ? unit : "");
+}
+
+static void report(double wall){
+
+	struct stats s;
+	double simulated = end_us / 1e6;
+
+	merge_stats(&s);
+
+	printf("houses %d x %d nodes, %d workers: %.0f s simulated in %.2f s (%.0fx real time, %.0f node-s/s)\n",
+		n_houses, n_nodes, n_workers, simulated, wall, simulated / wall, simulated * n_houses * n_nodes / wall);
+	printf("activations %lu (%.0f/s), console lines %lu, livelocks %lu\n", (unsigned long)s.activations,
+		s.activations / wall, (unsigned long)s.lines, (unsigned long)s.livelocks);
+	printf("radio: %lu broadcasts, %lu runicasts (%lu timed out), %lu frames, %lu delivered, %lu lost (%.2f%%)\n",
+		(unsigned long)s.broadcasts, (unsigned long)s.runicasts, (unsigned long)s.timeouts, (unsigned long)s.attempts,
+		(unsigned long)s.deliveries, (unsigned long)s.losses,
+		(s.deliveries + s.losses) ? 100.0 * s.losses / (s.deliveries + s.losses) : 0);
+	printf("commands %lu, delivery failures %lu\n", (unsigned long)s.commands, (unsigned long)s.failures);
+
+	print_percentiles("runicast delivery", s.runicast_ms, "ms");
+	print_percentiles("command confirmation", s.confirm_ms, "ms");
+	print_percentiles("get all", s.get_all_ms, "ms");
+
+	if(s.ota_reports > 0 || s.reboots > 0){
+
+		printf("ota: %lu nodes reported (%lu rebooting: %lu installed, %lu staged), %lu reboots, per node %.0f B received,"
+			" %.0f B sent\n", (unsigned long)s.ota_reports, (unsigned long)s.ota_installs,
+			(unsigned long)(s.ota_rebooted - s.ota_staged), (unsigned long)s.ota_staged, (unsigned long)s.reboots,
+			s.ota_reports ? (double)s.ota_rx / s.ota_reports : 0, s.ota_reports ? (double)s.ota_tx / s.ota_reports : 0);
+		print_percentiles("ota rollout", s.ota_s, "s");
+	}
+}
+
+/*---------------------------------MAIN----------------------------------*/
+
+/*Inserting an entry of the console script at time, in time order*/
+static int add_console(uint64_t time){
+
+	int i;
+
+	for(i = n_console++; i > 0 && console_script[i - 1].time > time; i--)
+		console_script[i] = console_script[i - 1];
+
+	memset(&console_script[i], 0, sizeof(console_script[i]));
+	console_script[i].time = time;
+
+	return i;
+}
+
+/*"seconds:line"*/
+static void add_console_line(const char *arg){
+
+	const char *colon = strchr(arg, ':');
+
+	if(colon == NULL || n_console == MAX_CONSOLE)
+		fail("bad or too many -k lines", arg);
+
+	console_script[add_console(strtoull(arg, NULL, 10) * SECOND_US)].line = colon + 1;
+}
+
+/*"seconds:version:target:bytes"*/
+static void add_upload(const char *arg){
+
+	unsigned long long seconds;
+	char target[8];
+	int version, bytes, i;
+
+	if(sscanf(arg, "%llu:%d:%7[^:]:%d", &seconds, &version, target, &bytes) != 4 || bytes <= 0 ||
+		n_console == MAX_CONSOLE)
+		fail("bad or too many -u images", arg);
+
+	i = add_console(seconds * SECOND_US);
+	console_script[i].version = version;
+	console_script[i].bytes = bytes;
+	strcpy(console_script[i].target, target);
+}
+
+static void usage(void){
+
+	fprintf(stderr, "usage: sim [-H houses] [-n nodes 4..%d] [-w workers] [-t seconds] [-c command_period]"
+		" [-s seed] [-v house] [-d firmware_dir] [-T trace_prefix] [-k seconds:line ...]"
+		" [-u seconds:version:target:bytes ...]\n", MAX_NODES);
+	exit(2);
+}
+
+
+int main(int argc, char *argv[]){
+
+	char dir[4096];
+	ssize_t len;
+	double start;
+	int opt, i;
+
+	/*firmware objects next to the binary by default*/
+	if((len = readlink("/proc/self/exe", dir, sizeof(dir) - 1)) > 0){
+
+		dir[len] = '\0';
+		*strrchr(dir, '/') = '\0';
+
+	}else
+		strcpy(dir, ".");
+
+	while((opt = getopt(argc, argv, "H:n:w:t:c:s:v:d:T:k:u:")) != -1)
+		switch(opt){
+
+			case 'H': n_houses = atoi(optarg); break;
+			case 'n': n_nodes = atoi(optarg); break;
+			case 'w': n_workers = atoi(optarg); break;
+			case 't': end_us = strtoull(optarg, NULL, 10) * SECOND_US; break;
+			case 'c': command_us = strtoull(optarg, NULL, 10) * SECOND_US; break;
+			case 's': seed = strtoull(optarg, NULL, 10); break;
+			case 'v': verbose_house = atoi(optarg); break;
+			case 'd': snprintf(dir, sizeof(dir), "%s", optarg); break;
+			case 'T': trace_prefix = optarg; break;
+			case 'k': add_console_line(optarg); break;
+			case 'u': add_upload(optarg); break;
+			default: usage();
+		}
+
+	if(n_workers <= 0)
+		n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if(n_houses <= 0 || n_nodes < MIN_NODES || n_nodes > MAX_NODES || n_workers > MAX_WORKERS || command_us == 0)
+		usage();
+
+	workers = xcalloc(n_workers, sizeof(struct worker));
+	houses = xcalloc(n_houses, sizeof(struct house));
+
+	load_firmwares(dir);
+
+	for(i=0; i<n_houses; i++)
+		init_house(&houses[i], i);
+
+	/*houses dealt round robin, the idle workers steal the rest*/
+	for(i=0; i<n_workers; i++){
+
+		workers[i].id = i;
+		workers[i].rng = seed + i + 1;
+		deque_init(&workers[i].deque, n_houses);
+	}
+
+	for(i=0; i<n_houses; i++)
+		deque_push(&workers[i % n_workers].deque, i);
+
+	atomic_init(&remaining, n_houses);
+
+	start = wall_seconds();
+
+	for(i=0; i<n_workers; i++)
+		if(pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0)
+			fail("cannot start the workers", NULL);
+
+	for(i=0; i<n_workers; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	report(wall_seconds() - start);
+
+	for(i=0; i<256; i++)
+		if(trace_files[i] != NULL)
+			fclose(trace_files[i]);
+
+	return 0;
+}
@@ -0,0 +1,959 @@
+/*-------------------------------TS Store---------------------------------
+	Host-side columnar time-series store of the house telemetry.
+
+	Every sensor series of a house is kept in two memory-mapped column
+	files, <house>-<sensor>.ts and <house>-<sensor>.val, made of blocks
+	of BLOCK_ROWS rows:
+
+		.ts	 block: base time, last time, count | uint16 deltas (s)
+		.val block: base, min, max, last        | int16 deltas
+
+	Deltas are taken from the previous row of the block (the first is
+	0). A time gap longer than 65535 s starts a new block; value deltas
+	wrap modulo 2^16, so every int16 value is stored exactly. The block
+	headers are zone maps: blocks outside a query range are skipped
+	without touching their rows, blocks inside one bucket are
+	aggregated without decoding their times.
+
+	Decoding (prefix sums) and the avg/min/max kernels are vectorised
+	with SSE2 (AVX2 for the aggregates when built with -mavx2), with a
+	scalar fallback used on other targets and as benchmark reference.
+
+	Values are the ones printed by the CU: temperature averages x100
+	("Temperature Average: 21.50") and external light in lux
+	("External Light: 300").
+
+	Usage:
+		ts-store ingest [-b epoch] <dir> <house>	  < CU serial output
+		ts-store query <dir> <house> temp|light hour|day [from [to]]
+		ts-store bench <dir> [rows]
+
+	Without -b the rows are stamped with the host time at ingest; with
+	-b the network time printed by the CU is added to epoch (replay of
+	a captured log) and readings not synched are skipped.
+------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define BLOCK_ROWS			4096
+#define MAX_TIME_DELTA		65535
+#define MAGIC_TS			0x31535448	/*"HTS1"*/
+#define MAGIC_VAL			0x31565448	/*"HTV1"*/
+#define GROW_BLOCKS			16			/*file growth step*/
+#define LINE_SIZE			256
+#define DEFAULT_BENCH_ROWS	20000000L
+
+struct file_header {
+
+	uint32_t magic;
+	uint32_t block_rows;
+	uint32_t blocks;			/*in use, the last one may be partial*/
+	uint32_t capacity;			/*blocks allocated in the file*/
+	uint64_t rows;
+	uint8_t pad[40];
+};
+
+struct ts_block {
+
+	int64_t base;
+	int64_t last;
+	uint32_t count;
+	uint32_t pad;
+	uint16_t delta[BLOCK_ROWS];
+};
+
+struct val_block {
+
+	int16_t base;
+	int16_t min;
+	int16_t max;
+	int16_t last;
+	int16_t delta[BLOCK_ROWS];
+};
+
+struct column {
+
+	int fd;
+	size_t block_size;
+	size_t mapped;
+	struct file_header *header;
+	uint8_t *blocks;
+};
+
+struct series {
+
+	struct column ts;
+	struct column val;
+};
+
+struct aggregate {
+
+	int64_t sum;
+	int16_t min;
+	int16_t max;
+	uint64_t count;
+};
+
+/*---------------------------COLUMN FILES-------------------------------*/
+
+static size_t file_size(const struct column *c, uint32_t blocks){
+
+	return sizeof(struct file_header) + (size_t)blocks * c->block_size;
+}
+
+static int column_map(struct column *c, uint32_t capacity){
+
+	void *map;
+
+	if(c->header != NULL)
+		munmap(c->header, c->mapped);
+
+	c->mapped = file_size(c, capacity);
+
+	map = mmap(NULL, c->mapped, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+
+	if(map == MAP_FAILED){
+
+		perror("mmap");
+		c->header = NULL;
+		return -1;
+	}
+
+	c->header = (struct file_header *)map;
+	c->blocks = (uint8_t *)map + sizeof(struct file_header);
+
+	return 0;
+}
+
+static int column_open(struct column *c, const char *path, uint32_t magic, size_t block_size){
+
+	struct stat st;
+
+	memset(c, 0, sizeof(*c));
+	c->block_size = block_size;
+
+	c->fd = open(path, O_RDWR | O_CREAT, 0644);
+
+	if(c->fd < 0 || fstat(c->fd, &st) < 0){
+
+		perror(path);
+		return -1;
+	}
+
+	if(st.st_size == 0){
+
+		if(ftruncate(c->fd, file_size(c, GROW_BLOCKS)) < 0){
+
+			perror(path);
+			return -1;
+		}
+
+		if(column_map(c, GROW_BLOCKS) < 0)
+			return -1;
+
+		c->header->magic = magic;
+		c->header->block_rows = BLOCK_ROWS;
+		c->header->capacity = GROW_BLOCKS;
+
+		return 0;
+	}
+
+	if((size_t)st.st_size < sizeof(struct file_header) || column_map(c, 0) < 0)
+		return -1;
+
+	if(c->header->magic != magic || c->header->block_rows != BLOCK_ROWS ||
+		(size_t)st.st_size < file_size(c, c->header->capacity)){
+
+		fprintf(stderr, "%s: not a column file of this format\n", path);
+		return -1;
+	}
+
+	return column_map(c, c->header->capacity);
+}
+
+/*Returning the block index, growing the file by GROW_BLOCKS when full*/
+static int column_add_block(struct column *c){
+
+	uint32_t capacity = c->header->capacity;
+
+	if(c->header->blocks == capacity){
+
+		capacity += (capacity < GROW_BLOCKS*64) ? capacity : GROW_BLOCKS*64;
+
+		if(ftruncate(c->fd, file_size(c, capacity)) < 0 || column_map(c, capacity) < 0){
+
+			perror("grow");
+			return -1;
+		}
+
+		c->header->capacity = capacity;
+	}
+
+	return c->header->blocks++;
+}
+
+static void column_close(struct column *c){
+
+	if(c->header != NULL){
+
+		msync(c->header, c->mapped, MS_ASYNC);
+		munmap(c->header, c->mapped);
+	}
+
+	if(c->fd >= 0)
+		close(c->fd);
+}
+
+static int series_open(struct series *s, const char *dir, const char *house, const char *sensor){
+
+	char path[512];
+
+	snprintf(path, sizeof(path), "%s/%s-%s.ts", dir, house, sensor);
+
+	if(column_open(&s->ts, path, MAGIC_TS, sizeof(struct ts_block)) < 0)
+		return -1;
+
+	snprintf(path, sizeof(path), "%s/%s-%s.val", dir, house, sensor);
+
+	if(column_open(&s->val, path, MAGIC_VAL, sizeof(struct val_block)) < 0)
+		return -1;
+
+	if(s->ts.header->blocks != s->val.header->blocks || s->ts.header->rows != s->val.header->rows){
+
+		fprintf(stderr, "%s/%s-%s: columns out of step\n", dir, house, sensor);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void series_close(struct series *s){
+
+	column_close(&s->ts);
+	column_close(&s->val);
+}
+
+#define TS_BLOCK(s, i)		((struct ts_block *)((s)->ts.blocks + (size_t)(i) * sizeof(struct ts_block)))
+#define VAL_BLOCK(s, i)		((struct val_block *)((s)->val.blocks + (size_t)(i) * sizeof(struct val_block)))
+
+/*Appending a row, rows must come in time order*/
+static int series_append(struct series *s, int64_t time, int16_t value){
+
+	struct ts_block *tb = NULL;
+	struct val_block *vb = NULL;
+	uint32_t blocks = s->ts.header->blocks;
+	int b;
+
+	if(blocks > 0){
+
+		tb = TS_BLOCK(s, blocks - 1);
+		vb = VAL_BLOCK(s, blocks - 1);
+
+		if(time < tb->last)
+			return -1;
+	}
+
+	if(blocks == 0 || tb->count == BLOCK_ROWS || time - tb->last > MAX_TIME_DELTA){
+
+		if((b = column_add_block(&s->ts)) < 0 || column_add_block(&s->val) < 0)
+			return -1;
+
+		tb = TS_BLOCK(s, b);
+		vb = VAL_BLOCK(s, b);
+
+		tb->base = tb->last = time;
+		tb->count = 1;
+		tb->delta[0] = 0;
+
+		vb->base = vb->min = vb->max = vb->last = value;
+		vb->delta[0] = 0;
+
+	}else{
+
+		tb->delta[tb->count] = (uint16_t)(time - tb->last);
+		vb->delta[tb->count] = (int16_t)(uint16_t)((uint16_t)value - (uint16_t)vb->last);
+
+		tb->last = time;
+		tb->count++;
+
+		vb->last = value;
+
+		if(value < vb->min)
+			vb->min = value;
+
+		if(value > vb->max)
+			vb->max = value;
+	}
+
+	s->ts.header->rows++;
+	s->val.header->rows++;
+
+	return 0;
+}
+
+/*-----------------------------KERNELS----------------------------------*/
+
+/*Prefix sums of the deltas: values of the block*/
+static void decode_values_scalar(const struct val_block *vb, int n, int16_t *out){
+
+	uint16_t acc = (uint16_t)vb->base;
+	int i;
+
+	for(i=0; i<n; i++){
+
+		acc += (uint16_t)vb->delta[i];
+		out[i] = (int16_t)acc;
+	}
+}
+
+/*Prefix sums of the deltas: seconds from the block base*/
+static void decode_times_scalar(const struct ts_block *tb, int n, uint32_t *out){
+
+	uint32_t acc = 0;
+	int i;
+
+	for(i=0; i<n; i++){
+
+		acc += tb->delta[i];
+		out[i] = acc;
+	}
+}
+
+static void aggregate_scalar(const int16_t *v, int n, struct aggregate *a){
+
+	int64_t sum = 0;
+	int16_t min = a->min, max = a->max;
+	int i;
+
+	for(i=0; i<n; i++){
+
+		sum += v[i];
+
+		if(v[i] < min)
+			min = v[i];
+
+		if(v[i] > max)
+			max = v[i];
+	}
+
+	a->sum += sum;
+	a->min = min;
+	a->max = max;
+	a->count += n;
+}
+
+#ifdef __SSE2__
+
+/*In-register inclusive scan of 8 int16 lanes, carried across registers*/
+static void decode_values_simd(const struct val_block *vb, int n, int16_t *out){
+
+	__m128i carry = _mm_set1_epi16(vb->base);
+	int i;
+
+	for(i=0; i + 8 <= n; i+=8){
+
+		__m128i x = _mm_loadu_si128((const __m128i *)(vb->delta + i));
+
+		x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+		x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+		x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+		x = _mm_add_epi16(x, carry);
+
+		_mm_storeu_si128((__m128i *)(out + i), x);
+
+		carry = _mm_set1_epi16((int16_t)_mm_extract_epi16(x, 7));
+	}
+
+	for(; i<n; i++)
+		out[i] = (int16_t)(uint16_t)((uint16_t)(i ? out[i-1] : vb->base) + (uint16_t)vb->delta[i]);
+}
+
+/*Same scan on 4 uint32 lanes after widening the uint16 deltas*/
+static void decode_times_simd(const struct ts_block *tb, int n, uint32_t *out){
+
+	const __m128i zero = _mm_setzero_si128();
+	__m128i carry = zero;
+	int i;
+
+	for(i=0; i + 8 <= n; i+=8){
+
+		__m128i d = _mm_loadu_si128((const __m128i *)(tb->delta + i));
+		__m128i lo = _mm_unpacklo_epi16(d, zero);
+		__m128i hi = _mm_unpackhi_epi16(d, zero);
+
+		lo = _mm_add_epi32(lo, _mm_slli_si128(lo, 4));
+		lo = _mm_add_epi32(lo, _mm_slli_si128(lo, 8));
+		lo = _mm_add_epi32(lo, carry);
+		carry = _mm_shuffle_epi32(lo, 0xFF);
+
+		hi = _mm_add_epi32(hi, _mm_slli_si128(hi, 4));
+		hi = _mm_add_epi32(hi, _mm_slli_si128(hi, 8));
+		hi = _mm_add_epi32(hi, carry);
+		carry = _mm_shuffle_epi32(hi, 0xFF);
+
+		_mm_storeu_si128((__m128i *)(out + i), lo);
+		_mm_storeu_si128((__m128i *)(out + i + 4), hi);
+	}
+
+	for(; i<n; i++)
+		out[i] = (i ? out[i-1] : 0) + tb->delta[i];
+}
+
+/*Sums by pairs in int32 lanes (madd), flushed to int64 before they can overflow*/
+static void aggregate_simd(const int16_t *v, int n, struct aggregate *a){
+
+	int64_t sum = 0;
+	int16_t lanes[16];
+	int i = 0, j, k;
+
+#ifdef __AVX2__
+	__m256i vmin = _mm256_set1_epi16(a->min), vmax = _mm256_set1_epi16(a->max);
+	const __m256i ones = _mm256_set1_epi16(1);
+
+	while(i + 16 <= n){
+
+		__m256i acc = _mm256_setzero_si256();
+		int32_t parts[8];
+
+		/*at most 2^14 pairs of int16 per int32 lane*/
+		for(j=0; j<16384 && i + 16 <= n; j++, i+=16){
+
+			__m256i x = _mm256_loadu_si256((const __m256i *)(v + i));
+
+			acc = _mm256_add_epi32(acc, _mm256_madd_epi16(x, ones));
+			vmin = _mm256_min_epi16(vmin, x);
+			vmax = _mm256_max_epi16(vmax, x);
+		}
+
+		_mm256_storeu_si256((__m256i *)parts, acc);
+
+		for(k=0; k<8; k++)
+			sum += parts[k];
+	}
+
+	_mm256_storeu_si256((__m256i *)lanes, vmin);
+	for(k=0; k<16; k++)
+		if(lanes[k] < a->min)
+			a->min = lanes[k];
+
+	_mm256_storeu_si256((__m256i *)lanes, vmax);
+	for(k=0; k<16; k++)
+		if(lanes[k] > a->max)
+			a->max = lanes[k];
+#else
+	__m128i vmin = _mm_set1_epi16(a->min), vmax = _mm_set1_epi16(a->max);
+	const __m128i ones = _mm_set1_epi16(1);
+
+	while(i + 8 <= n){
+
+		__m128i acc = _mm_setzero_si128();
+		int32_t parts[4];
+
+		for(j=0; j<16384 && i + 8 <= n; j++, i+=8){
+
+			__m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(x, ones));
+			vmin = _mm_min_epi16(vmin, x);
+			vmax = _mm_max_epi16(vmax, x);
+		}
+
+		_mm_storeu_si128((__m128i *)parts, acc);
+
+		for(k=0; k<4; k++)
+			sum += parts[k];
+	}
+
+	_mm_storeu_si128((__m128i *)lanes, vmin);
+	for(k=0; k<8; k++)
+		if(lanes[k] < a->min)
+			a->min = lanes[k];
+
+	_mm_storeu_si128((__m128i *)lanes, vmax);
+	for(k=0; k<8; k++)
+		if(lanes[k] > a->max)
+			a->max = lanes[k];
+#endif
+
+	a->sum += sum;
+	a->count += i;
+
+	aggregate_scalar(v + i, n - i, a);
+}
+
+#else
+
+#define decode_values_simd		decode_values_scalar
+#define decode_times_simd		decode_times_scalar
+#define aggregate_simd			aggregate_scalar
+
+#endif /* __SSE2__ */
+
+struct kernels {
+
+	void (*decode_values)(const struct val_block *vb, int n, int16_t *out);
+	void (*decode_times)(const struct ts_block *tb, int n, uint32_t *out);
+	void (*aggregate)(const int16_t *v, int n, struct aggregate *a);
+};
+
+static const struct kernels scalar_kernels = {decode_values_scalar, decode_times_scalar, aggregate_scalar};
+static const struct kernels simd_kernels = {decode_values_simd, decode_times_simd, aggregate_simd};
+
+/*-----------------------------QUERIES----------------------------------*/
+
+static void aggregate_reset(struct aggregate *a){
+
+	a->sum = 0;
+	a->min = INT16_MAX;
+	a->max = INT16_MIN;
+	a->count = 0;
+}
+
+/*First row with offset >= target in the sorted offsets*/
+static int lower_bound(const uint32_t *offsets, int n, int64_t target){
+
+	int lo = 0, hi = n;
+
+	if(target <= 0)
+		return 0;
+
+	while(lo < hi){
+
+		int mid = (lo + hi) / 2;
+
+		if((int64_t)offsets[mid] < target)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*Aggregating [from, to) by buckets of width seconds, emit is called in time order*/
+static uint64_t series_query(const struct series *s, int64_t from, int64_t to, int64_t width, const struct kernels *k,
+	void (*emit)(int64_t bucket, const struct aggregate *a, void *ctx), void *ctx){
+
+	static int16_t values[BLOCK_ROWS];
+	static uint32_t offsets[BLOCK_ROWS];
+	struct aggregate acc;
+	int64_t bucket = INT64_MIN;
+	uint64_t scanned = 0;
+	uint32_t b;
+
+	aggregate_reset(&acc);
+
+	for(b=0; b<s->ts.header->blocks; b++){
+
+		const struct ts_block *tb = TS_BLOCK(s, b);
+		const struct val_block *vb = VAL_BLOCK(s, b);
+		int n = tb->count, row, end;
+
+		/*zone map: skipping the blocks outside the range*/
+		if(tb->last < from || tb->base >= to)
+			continue;
+
+		k->decode_values(vb, n, values);
+		scanned += n;
+
+		/*whole block in one bucket: no time decoding*/
+		if(tb->base >= from && tb->last < to && tb->base / width == tb->last / width){
+
+			if(tb->base / width * width != bucket){
+
+				if(acc.count > 0)
+					emit(bucket, &acc, ctx);
+
+				aggregate_reset(&acc);
+				bucket = tb->base / width * width;
+			}
+
+			k->aggregate(values, n, &acc);
+			continue;
+		}
+
+		k->decode_times(tb, n, offsets);
+
+		row = (from > tb->base) ? lower_bound(offsets, n, from - tb->base) : 0;
+		end = lower_bound(offsets, n, to - tb->base);
+
+		while(row < end){
+
+			int64_t t = tb->base + offsets[row];
+			int64_t start = t / width * width;
+			int next = lower_bound(offsets, end, start + width - tb->base);
+
+			if(start != bucket){
+
+				if(acc.count > 0)
+					emit(bucket, &acc, ctx);
+
+				aggregate_reset(&acc);
+				bucket = start;
+			}
+
+			k->aggregate(values + row, next - row, &acc);
+			row = next;
+		}
+	}
+
+	if(acc.count > 0)
+		emit(bucket, &acc, ctx);
+
+	return scanned;
+}
+
+struct print_ctx {
+
+	int scale;					/*100 for the temperature*/
+};
+
+static void print_bucket(int64_t bucket, const struct aggregate *a, void *ctx){
+
+	const struct print_ctx *p = (const struct print_ctx *)ctx;
+	time_t t = (time_t)bucket;
+	struct tm tm;
+	char when[32];
+	double avg = (double)a->sum / a->count;
+
+	gmtime_r(&t, &tm);
+	strftime(when, sizeof(when), "%Y-%m-%d %H:%M", &tm);
+
+	printf("%s  avg %8.2f  min %8.2f  max %8.2f  rows %lu\n", when, avg / p->scale,
+		(double)a->min / p->scale, (double)a->max / p->scale, (unsigned long)a->count);
+}
+
+/*------------------------------INGEST----------------------------------*/
+
+/*Parsing "[-]I.FF" as a x100 fixed point value*/
+static int parse_centi(const char *s, int *value){
+
+	int neg = 0, units, cents = 0, digits = 0;
+
+	while(*s == ' ')
+		s++;
+
+	if(*s == '-'){
+
+		neg = 1;
+		s++;
+	}
+
+	if(sscanf(s, "%d", &units) != 1)
+		return -1;
+
+	while(*s >= '0' && *s <= '9')
+		s++;
+
+	if(*s == '.')
+		for(s++; *s >= '0' && *s <= '9' && digits < 2; s++, digits++)
+			cents = cents * 10 + (*s - '0');
+
+	if(digits == 1)
+		cents *= 10;
+
+	*value = units * 100 + cents;
+
+	if(neg)
+		*value = -*value;
+
+	return 0;
+}
+
+/*Network time printed by print_reading_time, -1 if not synched*/
+static int64_t parse_time(const char *line){
+
+	const char *p = strstr(line, " Time: ");
+	unsigned long seconds;
+
+	if(p == NULL || sscanf(p + 7, "%lu.", &seconds) != 1)
+		return -1;
+
+	return seconds;
+}
+
+static int ingest(int argc, char **argv){
+
+	struct series temp, light;
+	char line[LINE_SIZE];
+	const char *p;
+	int64_t base = -1, stamp;
+	unsigned long rows = 0, skipped = 0;
+	int opt, value;
+
+	optind = 2;
+
+	while((opt = getopt(argc, argv, "b:")) != -1){
+
+		if(opt != 'b')
+			return 1;
+
+		base = strtoll(optarg, NULL, 10);
+	}
+
+	if(argc - optind != 2)
+		return 1;
+
+	mkdir(argv[optind], 0755);
+
+	if(series_open(&temp, argv[optind], argv[optind + 1], "temp") < 0 ||
+		series_open(&light, argv[optind], argv[optind + 1], "light") < 0)
+		return 2;
+
+	while(fgets(line, sizeof(line), stdin) != NULL){
+
+		struct series *s;
+
+		if((p = strstr(line, "Temperature Average:")) != NULL){
+
+			if(parse_centi(p + 20, &value) < 0)
+				continue;
+
+			s = &temp;
+
+		}else if((p = strstr(line, "External Light:")) != NULL){
+
+			if(sscanf(p + 15, "%d", &value) != 1)
+				continue;
+
+			s = &light;
+
+		}else
+			continue;
+
+		if(base >= 0){
+
+			if((stamp = parse_time(line)) < 0){
+
+				skipped++;
+				continue;
+			}
+
+			stamp += base;
+
+		}else
+			stamp = (int64_t)time(NULL);
+
+		if(series_append(s, stamp, (int16_t)value) < 0){
+
+			skipped++;
+			continue;
+		}
+
+		rows++;
+	}
+
+	printf("ingested %lu rows (%lu skipped): temp %lu rows, light %lu rows\n", rows, skipped,
+		(unsigned long)temp.ts.header->rows, (unsigned long)light.ts.header->rows);
+
+	series_close(&temp);
+	series_close(&light);
+
+	return 0;
+}
+
+static int query(int argc, char **argv){
+
+	struct series s;
+	struct print_ctx ctx;
+	int64_t from = INT64_MIN, to = INT64_MAX, width;
+
+	if(argc < 6)
+		return 1;
+
+	if(strcmp(argv[5], "hour") == 0)
+		width = 3600;
+	else if(strcmp(argv[5], "day") == 0)
+		width = 86400;
+	else
+		return 1;
+
+	if(strcmp(argv[4], "temp") == 0)
+		ctx.scale = 100;
+	else if(strcmp(argv[4], "light") == 0)
+		ctx.scale = 1;
+	else
+		return 1;
+
+	if(argc > 6)
+		from = strtoll(argv[6], NULL, 10);
+
+	if(argc > 7)
+		to = strtoll(argv[7], NULL, 10);
+
+	if(series_open(&s, argv[2], argv[3], argv[4]) < 0)
+		return 2;
+
+	series_query(&s, from, to, width, &simd_kernels, print_bucket, &ctx);
+
+	series_close(&s);
+
+	return 0;
+}
+
+/*------------------------------BENCHMARK-------------------------------*/
+
+struct bench_ctx {
+
+	int64_t sum;
+	uint64_t count;
+	int16_t min;
+	int16_t max;
+	unsigned long buckets;
+};
+
+static void sum_bucket(int64_t bucket, const struct aggregate *a, void *ctx){
+
+	struct bench_ctx *b = (struct bench_ctx *)ctx;
+
+	(void)bucket;
+
+	b->sum += a->sum;
+	b->count += a->count;
+	b->min = (a->min < b->min) ? a->min : b->min;
+	b->max = (a->max > b->max) ? a->max : b->max;
+	b->buckets++;
+}
+
+static double now(void){
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int run_scan(const char *name, const struct series *s, int64_t width, const struct kernels *k, struct bench_ctx *out){
+
+	double start, elapsed, best = 1e9;
+	uint64_t rows = 0;
+	int run;
+
+	for(run=0; run<3; run++){
+
+		memset(out, 0, sizeof(*out));
+		out->min = INT16_MAX;
+		out->max = INT16_MIN;
+
+		start = now();
+		rows = series_query(s, INT64_MIN, INT64_MAX, width, k, sum_bucket, out);
+
+		elapsed = now() - start;
+
+		if(elapsed < best)
+			best = elapsed;
+	}
+
+	printf("%-8s %-4s buckets: %10.1f Mrows/s (%lu rows, %lu buckets, avg %.2f min %d max %d)\n", name,
+		(width == 3600) ? "hour" : "day", rows / best / 1e6, (unsigned long)rows, out->buckets,
+		(double)out->sum / out->count / 100, out->min, out->max);
+
+	return 0;
+}
+
+static int bench(int argc, char **argv){
+
+	struct series s;
+	struct bench_ctx scalar, simd;
+	long rows = (argc > 3) ? strtol(argv[3], NULL, 10) : DEFAULT_BENCH_ROWS;
+	int64_t time = 1483228800;		/*2017-01-01*/
+	int16_t value = 2000;
+	uint32_t seed = 1;
+	double start;
+	char path[512];
+	long i;
+	int w;
+
+	mkdir(argv[2], 0755);
+
+	/*starting from empty columns*/
+	snprintf(path, sizeof(path), "%s/bench-temp.ts", argv[2]);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/bench-temp.val", argv[2]);
+	unlink(path);
+
+	if(series_open(&s, argv[2], "bench", "temp") < 0)
+		return 2;
+
+	start = now();
+
+	/*a temperature random walk sampled every 5-80 s (adaptive sampling)*/
+	for(i=0; i<rows; i++){
+
+		seed = seed * 1103515245 + 12345;
+
+		time += 5 + (seed >> 16) % 76;
+		value += (int16_t)((seed >> 8) % 21) - 10;
+
+		if(value < 1000 || value > 3000)
+			value = 2000;
+
+		series_append(&s, time, value);
+	}
+
+	printf("append   %ld rows: %10.1f Mrows/s, %.1f bytes/row on disk\n", rows, rows / (now() - start) / 1e6,
+		(double)(file_size(&s.ts, s.ts.header->blocks) + file_size(&s.val, s.val.header->blocks)) / rows);
+
+	for(w=0; w<2; w++){
+
+		int64_t width = w ? 86400 : 3600;
+
+		run_scan("scalar", &s, width, &scalar_kernels, &scalar);
+		run_scan("simd", &s, width, &simd_kernels, &simd);
+
+		if(scalar.sum != simd.sum || scalar.count != simd.count || scalar.min != simd.min ||
+			scalar.max != simd.max || scalar.buckets != simd.buckets){
+
+			fprintf(stderr, "MISMATCH between scalar and simd kernels\n");
+			series_close(&s);
+			return 3;
+		}
+	}
+
+	series_close(&s);
+
+	return 0;
+}
+
+
+static void usage(const char *name){
+
+	fprintf(stderr, "Usage:\t%s ingest [-b epoch] <dir> <house>  < CU serial output\n"
+		"\t%s query <dir> <house> temp|light hour|day [from [to]]\n"
+		"\t%s bench <dir> [rows]\n", name, name, name);
+}
+
+
+int main(int argc, char **argv){
+
+	int r = 1;
+
+	if(argc >= 3 && strcmp(argv[1], "ingest") == 0)
+		r = ingest(argc, argv);
+	else if(argc >= 3 && strcmp(argv[1], "query") == 0)
+		r = query(argc, argv);
+	else if(argc >= 3 && strcmp(argv[1], "bench") == 0)
+		r = bench(argc, argv);
+
+	if(r == 1)
+		usage(argv[0]);
+
+	return r;
+}
@@ -0,0 +1,278 @@
+/*----------------------------Link Quality--------------------------------
+	Per-neighbour link estimation (see link-quality.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "stdio.h"
+#include "string.h"
+#include "link-quality.h"
+
+static struct link_quality_entry neighbors[LINK_QUALITY_MAX_NEIGHBORS];
+static uint8_t max_retx = LINK_QUALITY_MAX_RETX;
+
+/*CC2420 PA_LEVEL (0, -1, -3, -5, -7, -10, -15, -25 dBm) & TX current in 0.1 mA*/
+static const uint8_t power_levels[LINK_QUALITY_POWER_LEVELS] = {31, 27, 23, 19, 15, 11, 7, 3};
+static const uint8_t power_current[LINK_QUALITY_POWER_LEVELS] = {174, 165, 152, 139, 125, 112, 99, 85};
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+static struct link_quality_entry *lookup(int rime_addr){
+
+	int i;
+
+	for(i=0; i<LINK_QUALITY_MAX_NEIGHBORS; i++)
+		if(neighbors[i].addr == rime_addr)
+			return &neighbors[i];
+
+	return NULL;
+}
+
+/*Allocating the neighbour, replacing the least known one when full*/
+static struct link_quality_entry *get(int rime_addr){
+
+	struct link_quality_entry *e = lookup(rime_addr);
+	int i;
+
+	if(e != NULL)
+		return e;
+
+	e = &neighbors[0];
+
+	for(i=0; i<LINK_QUALITY_MAX_NEIGHBORS; i++){
+
+		if(neighbors[i].addr == 0){
+
+			e = &neighbors[i];
+			break;
+		}
+
+		if(neighbors[i].samples < e->samples)
+			e = &neighbors[i];
+	}
+
+	memset(e, 0, sizeof(*e));
+	e->addr = rime_addr;
+	e->streak_goal = LINK_QUALITY_POWER_STREAK;
+
+	return e;
+}
+
+static int ewma(int average, int sample){
+
+	return average + ((sample - average) >> LINK_QUALITY_EWMA_SHIFT);
+}
+
+static void update_etx(struct link_quality_entry *e, int transmissions){
+
+	int sample = transmissions * LINK_QUALITY_ETX_SCALE;
+
+	e->etx = (e->samples == 0) ? sample : ewma(e->etx, sample);
+
+	if(e->samples < 0xFF)
+		e->samples++;
+}
+
+/*Charging the transmissions of a packet to the energy spent at its power level*/
+static void account_energy(struct link_quality_entry *e, int transmissions, int delivered){
+
+	int bucket = (e->power == 0) ? 0 : 1;
+
+	/*mA x V x us, in 0.1 uJ*/
+	e->energy[bucket] += (uint32_t)transmissions * power_current[e->power] *
+		LINK_QUALITY_SUPPLY_DV * (LINK_QUALITY_FRAME_US / 100) / 100;
+
+	if(delivered)
+		e->delivered[bucket]++;
+}
+
+/*Lowering the power after a clean streak & raising it on retransmissions*/
+static void control_power(struct link_quality_entry *e, int transmissions){
+
+	if(transmissions == 1){
+
+		if(++e->streak < e->streak_goal)
+			return;
+
+		if(e->power < LINK_QUALITY_POWER_LEVELS - 1)
+			e->power++;
+
+		e->streak = 0;
+		return;
+	}
+
+	e->streak = 0;
+
+	if(e->power > 0){
+
+		e->power--;
+
+		/*backing off: the level just left was lossy*/
+		if(e->streak_goal < LINK_QUALITY_POWER_MAX_STREAK)
+			e->streak_goal *= 2;
+	}
+}
+
+static uint16_t energy_per_packet(const struct link_quality_entry *e, int bucket){
+
+	if(e->delivered[bucket] == 0)
+		return 0;
+
+	return e->energy[bucket] / e->delivered[bucket] / 10;
+}
+
+
+void link_quality_init(void){
+
+	memset(neighbors, 0, sizeof(neighbors));
+}
+
+
+void link_quality_received(const linkaddr_t *from){
+
+	struct link_quality_entry *e = get(from->u8[0]);
+	int rssi = ((int8_t)packetbuf_attr(PACKETBUF_ATTR_RSSI) + LINK_QUALITY_RSSI_OFFSET) << 4;
+	int lqi = packetbuf_attr(PACKETBUF_ATTR_LINK_QUALITY) << 4;
+
+	if(e->lqi == 0 && e->rssi == 0){
+
+		e->rssi = rssi;
+		e->lqi = lqi;
+
+	}else{
+
+		e->rssi = ewma(e->rssi, rssi);
+		e->lqi = ewma(e->lqi, lqi);
+	}
+}
+
+
+void link_quality_sent(const linkaddr_t *to, uint8_t transmissions){
+
+	struct link_quality_entry *e = get(to->u8[0]);
+
+	e->sent++;
+
+	update_etx(e, transmissions);
+
+	account_energy(e, transmissions, 1);
+
+	control_power(e, transmissions);
+}
+
+
+void link_quality_timedout(const linkaddr_t *to, uint8_t transmissions){
+
+	struct link_quality_entry *e = get(to->u8[0]);
+
+	e->timedout++;
+
+	update_etx(e, transmissions + LINK_QUALITY_TIMEOUT_PENALTY);
+
+	account_energy(e, transmissions, 0);
+
+	e->streak = 0;
+	e->power = 0;
+}
+
+
+uint8_t link_quality_max_retransmissions(int rime_addr){
+
+	struct link_quality_entry *e = lookup(rime_addr);
+	int retx;
+
+	if(e == NULL || e->samples == 0)
+		retx = LINK_QUALITY_DEFAULT_RETX;
+	else
+		retx = ((long)e->etx * LINK_QUALITY_RETX_PER_ETX + LINK_QUALITY_ETX_SCALE - 1) / LINK_QUALITY_ETX_SCALE;
+
+	if(retx < LINK_QUALITY_MIN_RETX)
+		retx = LINK_QUALITY_MIN_RETX;
+
+	/*the configured cap wins over the minimum*/
+	if(retx > max_retx)
+		retx = max_retx;
+
+	return retx;
+}
+
+
+void link_quality_set_max_retx(uint8_t retx){
+
+	max_retx = retx;
+}
+
+
+void link_quality_prepare(int rime_addr){
+
+	struct link_quality_entry *e = lookup(rime_addr);
+
+	/*the cc2420 driver applies attribute - 1, 0 keeps the default*/
+	if(e != NULL)
+		packetbuf_set_attr(PACKETBUF_ATTR_RADIO_TXPOWER, power_levels[e->power] + 1);
+}
+
+
+clock_time_t link_quality_timeout(int rime_addr, clock_time_t base){
+
+	struct link_quality_entry *e = lookup(rime_addr);
+	unsigned long timeout;
+
+	if(e == NULL || e->samples == 0 || e->etx <= LINK_QUALITY_ETX_SCALE)
+		return base;
+
+	timeout = ((unsigned long)base * e->etx) / LINK_QUALITY_ETX_SCALE;
+
+	if(timeout > (unsigned long)base * LINK_QUALITY_MAX_TIMEOUT_FACTOR)
+		timeout = (unsigned long)base * LINK_QUALITY_MAX_TIMEOUT_FACTOR;
+
+	return timeout;
+}
+
+
+int link_quality_report(struct link_quality_report *reports, int max){
+
+	int i, count = 0;
+
+	for(i=0; i<LINK_QUALITY_MAX_NEIGHBORS && count < max; i++){
+
+		if(neighbors[i].addr == 0)
+			continue;
+
+		reports[count].addr = neighbors[i].addr;
+		reports[count].rssi = neighbors[i].rssi >> 4;
+		reports[count].lqi = neighbors[i].lqi >> 4;
+		reports[count].etx = (neighbors[i].etx > 0xFF) ? 0xFF : neighbors[i].etx;
+		reports[count].power = power_levels[neighbors[i].power];
+		reports[count].pad = 0;
+		reports[count].energy_full = energy_per_packet(&neighbors[i], 0);
+		reports[count].energy_adapted = energy_per_packet(&neighbors[i], 1);
+		count++;
+	}
+
+	return count;
+}
+
+
+void link_quality_print(int owner, const struct link_quality_report *reports, int count){
+
+	int i;
+
+	printf("LINKS of [%d:0]:%s\n", owner, (count == 0) ? " none" : "");
+
+	for(i=0; i<count; i++){
+
+		printf("\t-> [%d:0] RSSI %d dBm LQI %u", reports[i].addr, reports[i].rssi, reports[i].lqi);
+
+		if(reports[i].etx == 0){
+
+			printf(" ETX n/a\n");
+			continue;
+		}
+
+		printf(" ETX %u.%02u TX POWER %u\n", reports[i].etx / LINK_QUALITY_ETX_SCALE,
+			(reports[i].etx % LINK_QUALITY_ETX_SCALE) * 100 / LINK_QUALITY_ETX_SCALE, reports[i].power);
+
+		printf("\t   ENERGY per delivered packet: full power %u uJ, adapted %u uJ\n",
+			reports[i].energy_full, reports[i].energy_adapted);
+	}
+}
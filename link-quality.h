@@ -0,0 +1,106 @@
+/*----------------------------Link Quality--------------------------------
+	Per-neighbour link estimation driving the runicast retransmissions.
+
+	RSSI and LQI are averaged from the packetbuf attributes of every
+	packet received from a neighbour; the ETX (expected transmissions
+	per delivered packet) is averaged from the transmission counts
+	reported by the runicast sent/timedout callbacks (Contiki's rxmit:
+	1 for a delivery at the first try), a timeout being charged
+	LINK_QUALITY_TIMEOUT_PENALTY extra transmissions.
+
+	The retransmission limit of a runicast grows with the ETX of the
+	destination, so a good link gives up early instead of wasting
+	airtime on a dead peer and a marginal one (the garden gate) gets
+	enough retries; end-to-end timeouts are stretched the same way.
+	A neighbour never heard from uses the former fixed limit. The cap
+	of every limit is set at runtime (CONFIG_MAX_RETX, config.h).
+
+	Transmit power control: every runicast carries the CC2420 power
+	level of its destination as packetbuf attribute. After a streak
+	of deliveries without retransmissions the level is lowered one
+	step; retransmissions raise it one step and double the streak
+	needed to lower it again (so a link settles just above its loss
+	threshold), a timeout restores full power. The energy spent per
+	delivered packet is accounted separately at full power (before)
+	and at the adapted levels (after).
+------------------------------------------------------------------------*/
+#ifndef LINK_QUALITY_H_
+#define LINK_QUALITY_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+
+#define LINK_QUALITY_MAX_NEIGHBORS		4
+#define LINK_QUALITY_ETX_SCALE			16	/*ETX fixed point*/
+#define LINK_QUALITY_EWMA_SHIFT			2	/*new sample weight 1/4*/
+#define LINK_QUALITY_TIMEOUT_PENALTY	2	/*transmissions charged to a timeout*/
+#define LINK_QUALITY_DEFAULT_RETX		5	/*unknown neighbour*/
+#define LINK_QUALITY_MIN_RETX			2
+#define LINK_QUALITY_MAX_RETX			10	/*default cap*/
+#define LINK_QUALITY_RETX_PER_ETX		3	/*retransmissions per expected transmission*/
+#define LINK_QUALITY_MAX_TIMEOUT_FACTOR	4
+#define LINK_QUALITY_RSSI_OFFSET		(-45)	/*CC2420 register to dBm*/
+#define LINK_QUALITY_REPORT_ENTRIES		3
+#define LINK_QUALITY_POWER_LEVELS		8	/*CC2420 PA_LEVEL steps, 0 dBm first*/
+#define LINK_QUALITY_POWER_STREAK		10	/*clean deliveries before lowering*/
+#define LINK_QUALITY_POWER_MAX_STREAK	160
+#define LINK_QUALITY_FRAME_US			1000	/*average frame airtime*/
+#define LINK_QUALITY_SUPPLY_DV			30	/*supply voltage, 0.1 V*/
+
+struct link_quality_entry {
+
+	uint8_t addr;				/*rime address, 0 if free*/
+	uint8_t samples;			/*ETX samples, saturated*/
+	int16_t rssi;				/*dBm, Q4*/
+	uint16_t lqi;				/*Q4*/
+	uint16_t etx;				/*LINK_QUALITY_ETX_SCALE*/
+	uint16_t sent;
+	uint16_t timedout;
+	uint8_t power;				/*index in the power levels, 0 is full power*/
+	uint8_t streak;				/*deliveries without retransmissions*/
+	uint8_t streak_goal;
+	uint8_t pad;
+	uint16_t delivered[2];		/*at full power, at lowered power*/
+	uint32_t energy[2];			/*0.1 uJ, same split*/
+};
+
+/*Compact entry sent to the CU (no padding)*/
+struct link_quality_report {
+
+	uint8_t addr;
+	int8_t rssi;				/*dBm*/
+	uint8_t lqi;
+	uint8_t etx;				/*LINK_QUALITY_ETX_SCALE, saturated*/
+	uint8_t power;				/*CC2420 power level*/
+	uint8_t pad;
+	uint16_t energy_full;		/*uJ per delivered packet at full power*/
+	uint16_t energy_adapted;	/*uJ per delivered packet at lowered power*/
+};
+
+void link_quality_init(void);
+
+/*Sampling RSSI and LQI of the packet in the packetbuf*/
+void link_quality_received(const linkaddr_t *from);
+
+/*Transmissions as reported by runicast, at least 1*/
+void link_quality_sent(const linkaddr_t *to, uint8_t transmissions);
+
+void link_quality_timedout(const linkaddr_t *to, uint8_t transmissions);
+
+uint8_t link_quality_max_retransmissions(int rime_addr);
+
+/*Capping the retransmission limit of every destination*/
+void link_quality_set_max_retx(uint8_t retx);
+
+/*Setting the transmit power of the destination on the packetbuf (after copying the message)*/
+void link_quality_prepare(int rime_addr);
+
+/*Stretching an end-to-end timeout by the ETX of the destination*/
+clock_time_t link_quality_timeout(int rime_addr, clock_time_t base);
+
+/*Filling up to max entries, returning how many*/
+int link_quality_report(struct link_quality_report *reports, int max);
+
+void link_quality_print(int owner, const struct link_quality_report *reports, int count);
+
+#endif /* LINK_QUALITY_H_ */
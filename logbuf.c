@@ -0,0 +1,81 @@
+/*--------------------------------Log Buf---------------------------------
+	Deferred logging (see logbuf.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "stdio.h"
+#include "logbuf.h"
+
+#define MASK	(LOGBUF_RECORDS - 1)
+
+static struct logbuf_record ring[LOGBUF_RECORDS];
+static volatile uint8_t head = 0;			/*next record to write*/
+static volatile uint8_t tail = 0;			/*next record to print*/
+static volatile unsigned int dropped = 0;
+static unsigned int reported = 0;
+static void (*print_record)(const struct logbuf_record *record);
+
+PROCESS(logbuf_process, "Deferred Log Process");
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+void logbuf_init(void (*print)(const struct logbuf_record *record)){
+
+	print_record = print;
+	head = tail = 0;
+
+	if(!process_is_running(&logbuf_process))
+		process_start(&logbuf_process, NULL);
+}
+
+
+void logbuf_write(uint8_t event, int32_t arg0, int32_t arg1, int32_t arg2){
+
+	struct logbuf_record *r;
+
+	if((uint8_t)(head - tail) == LOGBUF_RECORDS){
+
+		dropped++;
+		return;
+	}
+
+	r = &ring[head & MASK];
+	r->event = event;
+	r->args[0] = arg0;
+	r->args[1] = arg1;
+	r->args[2] = arg2;
+
+	head++;
+
+	process_poll(&logbuf_process);
+}
+
+/*-----------------------------PROCESSES--------------------------------*/
+
+PROCESS_THREAD(logbuf_process, ev, data){
+
+	PROCESS_BEGIN();
+
+	while(1){
+
+		PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+
+		while(tail != head){
+
+			print_record(&ring[tail & MASK]);
+			tail++;
+
+			/*one record per turn: queued events go first*/
+			if(process_post(PROCESS_CURRENT(), PROCESS_EVENT_CONTINUE, NULL) != PROCESS_ERR_OK)
+				process_poll(PROCESS_CURRENT());
+			PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE || ev == PROCESS_EVENT_POLL);
+		}
+
+		if(dropped != reported){
+
+			printf("LOG: %u records dropped\n", dropped - reported);
+			reported = dropped;
+		}
+	}
+
+	PROCESS_END();
+}
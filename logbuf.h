@@ -0,0 +1,43 @@
+/*--------------------------------Log Buf---------------------------------
+	Deferred logging.
+
+	Radio callbacks and request handlers do not printf: they append a
+	compact binary record (event id + LOGBUF_ARGS arguments) to a
+	static ring in O(1), without formatting nor UART time. The
+	records are formatted later by the log process, one per scheduling
+	turn, so pending events always run first. The firmware formats
+	its own events in the print callback given to logbuf_init.
+
+	When the ring is full the new record is dropped and counted; the
+	count is reported by the log process once the ring is drained.
+------------------------------------------------------------------------*/
+#ifndef LOGBUF_H_
+#define LOGBUF_H_
+
+#include "contiki.h"
+
+#ifdef LOGBUF_CONF_RECORDS
+#define LOGBUF_RECORDS		LOGBUF_CONF_RECORDS
+#else
+#define LOGBUF_RECORDS		16		/*power of 2, at most 128*/
+#endif
+#define LOGBUF_ARGS			3
+
+struct logbuf_record {
+
+	uint8_t event;
+	int32_t args[LOGBUF_ARGS];
+};
+
+/*Starting the log process, print formats one record on the serial port*/
+void logbuf_init(void (*print)(const struct logbuf_record *record));
+
+/*Appending a record (unused arguments are 0)*/
+void logbuf_write(uint8_t event, int32_t arg0, int32_t arg1, int32_t arg2);
+
+#define LOGBUF0(e)				logbuf_write(e, 0, 0, 0)
+#define LOGBUF1(e, a)			logbuf_write(e, a, 0, 0)
+#define LOGBUF2(e, a, b)		logbuf_write(e, a, b, 0)
+#define LOGBUF3(e, a, b, c)		logbuf_write(e, a, b, c)
+
+#endif /* LOGBUF_H_ */
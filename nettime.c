@@ -0,0 +1,120 @@
+/*-------------------------------Net Time---------------------------------
+	Lightweight network time synchronisation (see nettime.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "stdio.h"
+#include "nettime.h"
+
+#define TICKS_TO_MS(t)	(((unsigned long)(t) * 1000) / CLOCK_SECOND)
+
+static int32_t offset = 0;
+static uint16_t error_ms = NETTIME_NOT_SYNCHED;
+static unsigned long synched_at = 0;	/*local seconds of the last accepted sample*/
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+void nettime_init_authority(void){
+
+	offset = 0;
+	error_ms = 0;
+}
+
+
+void nettime_init(void){
+
+	offset = 0;
+	error_ms = NETTIME_NOT_SYNCHED;
+}
+
+
+uint32_t nettime_local(void){
+
+	unsigned long seconds;
+	clock_time_t ticks;
+
+	/*the two clocks are read apart: a second boundary between them would jump by 1 s*/
+	do{
+
+		seconds = clock_seconds();
+		ticks = clock_time();
+
+	}while(seconds != clock_seconds());
+
+	return (uint32_t)seconds * CLOCK_SECOND + (ticks % CLOCK_SECOND);
+}
+
+
+uint32_t nettime_now(void){
+
+	return nettime_local() + offset;
+}
+
+
+unsigned long nettime_seconds(void){
+
+	return nettime_now() / CLOCK_SECOND;
+}
+
+
+int nettime_synched(void){
+
+	return error_ms != NETTIME_NOT_SYNCHED;
+}
+
+
+uint16_t nettime_error_ms(void){
+
+	return error_ms;
+}
+
+
+void nettime_fill_request(struct nettime_request *request){
+
+	request->t1 = nettime_local();
+	request->error_ms = error_ms;
+	request->pad = 0;
+}
+
+
+void nettime_fill_reply(const struct nettime_request *request, struct nettime_reply *reply){
+
+	reply->t1 = request->t1;
+	reply->t2 = nettime_now();
+}
+
+
+int nettime_update(const struct nettime_reply *reply){
+
+	uint32_t t4 = nettime_local();
+	uint32_t rtt = t4 - reply->t1;
+	unsigned long sample_error = TICKS_TO_MS(rtt / 2 + 1);
+
+	/*a worse sample replaces the current one only when that is stale*/
+	if(sample_error > error_ms && clock_seconds() - synched_at < 2*NETTIME_PERIOD)
+		return 0;
+
+	offset = (int32_t)(reply->t2 + rtt/2 - t4);
+	error_ms = (sample_error >= NETTIME_NOT_SYNCHED) ? NETTIME_NOT_SYNCHED - 1 : sample_error;
+	synched_at = clock_seconds();
+
+	return 1;
+}
+
+
+clock_time_t nettime_delay(const struct nettime_schedule *schedule, int phase){
+
+	int32_t delay;
+
+	if(nettime_synched())
+		delay = (int32_t)(schedule->start[phase] - nettime_now());
+	else
+		delay = (int32_t)(schedule->start[phase] - schedule->sent);
+
+	return (delay > 0) ? (clock_time_t)delay : 0;
+}
+
+
+void nettime_print(uint32_t time){
+
+	printf("%lu.%03lu", (unsigned long)(time / CLOCK_SECOND), TICKS_TO_MS(time % CLOCK_SECOND));
+}
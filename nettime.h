@@ -0,0 +1,87 @@
+/*-------------------------------Net Time---------------------------------
+	Lightweight network time synchronisation.
+
+	The Central Unit is the time authority. Every node periodically
+	sends a TIME_REQ carrying its local send time t1; the CU replies
+	with t1 and its own time t2 and the node, receiving at t4, sets
+
+		offset = t2 + (t4 - t1)/2 - t4		(Cristian's algorithm)
+
+	The synchronisation error is bounded by half the round trip
+	(runicast retransmissions included), so a sample is accepted only
+	if its error is not worse than the current one, or if the current
+	one is too old. Network time is in 1/CLOCK_SECOND ticks.
+------------------------------------------------------------------------*/
+#ifndef NETTIME_H_
+#define NETTIME_H_
+
+#include "contiki.h"
+
+#define NETTIME_PERIOD			300		/*seconds between synchronisations*/
+#define NETTIME_RETRY			5		/*seconds between unanswered requests*/
+#define NETTIME_NOT_SYNCHED		0xFFFF
+
+/*TIME_REQ body: node send time & error of the current synchronisation*/
+struct nettime_request {
+
+	uint32_t t1;
+	uint16_t error_ms;
+	uint16_t pad;
+};
+
+/*TIME body*/
+struct nettime_reply {
+
+	uint32_t t1;
+	uint32_t t2;
+};
+
+/*Timestamped telemetry value*/
+struct nettime_reading {
+
+	uint32_t time;
+	uint16_t error_ms;
+	int16_t value;
+};
+
+/*Actions scheduled by the CU on the network time line: a node not
+  synchronised yet falls back to delays relative to "sent"*/
+#define NETTIME_SCHEDULE_PHASES	2
+
+struct nettime_schedule {
+
+	uint32_t sent;
+	uint32_t start[NETTIME_SCHEDULE_PHASES];
+	uint16_t duration[NETTIME_SCHEDULE_PHASES];	/*seconds*/
+};
+
+/*The CU never synchronises: its local time is the network time*/
+void nettime_init_authority(void);
+
+void nettime_init(void);
+
+uint32_t nettime_local(void);
+
+uint32_t nettime_now(void);
+
+unsigned long nettime_seconds(void);
+
+int nettime_synched(void);
+
+/*Sync error bound in ms (NETTIME_NOT_SYNCHED if never synchronised)*/
+uint16_t nettime_error_ms(void);
+
+void nettime_fill_request(struct nettime_request *request);
+
+void nettime_fill_reply(const struct nettime_request *request, struct nettime_reply *reply);
+
+/*Applying a reply received now, returning 1 if accepted*/
+int nettime_update(const struct nettime_reply *reply);
+
+/*Ticks to wait from now (the schedule reception) to the phase start*/
+clock_time_t nettime_delay(const struct nettime_schedule *schedule, int phase);
+
+/*Printing "<seconds>.<ms>" of a network time*/
+void nettime_print(uint32_t time);
+
+#endif /* NETTIME_H_ */
@@ -0,0 +1,84 @@
+/*------------------------------Node State--------------------------------
+	Compact snapshot of the house state (see node-state.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+#include "lib/crc16.h"
+#include "node-state.h"
+
+#define STATE_FILE		"nstate"
+
+/*On flash: the state followed by its CRC*/
+struct stored_state {
+
+	struct node_state state;
+	uint16_t crc;
+};
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+void node_state_digest(const struct node_state *state, int local, struct node_state_digest *digest){
+
+	digest->version = state->version;
+
+	digest->flags = (state->alarm ? NODE_STATE_ALARM : 0) |
+					(state->gate ? NODE_STATE_GATE : 0) |
+					(state->comfort ? NODE_STATE_COMFORT : 0) |
+					(local ? NODE_STATE_LOCAL : 0);
+
+	digest->thresholds = (uint8_t)crc16_data((const unsigned char *)&state->temp_min, 3, 0);
+	digest->pad = 0;
+}
+
+
+int node_state_load(struct node_state *state){
+
+	struct stored_state stored;
+	int fd, len;
+
+	fd = cfs_open(STATE_FILE, CFS_READ);
+
+	if(fd < 0)
+		return 0;
+
+	len = cfs_read(fd, &stored, sizeof(stored));
+
+	cfs_close(fd);
+
+	if(len != sizeof(stored) ||
+		stored.crc != crc16_data((const unsigned char *)&stored.state, sizeof(stored.state), 0))
+		return 0;
+
+	*state = stored.state;
+
+	return 1;
+}
+
+
+void node_state_save(const struct node_state *state){
+
+	struct stored_state stored;
+	int fd;
+
+	stored.state = *state;
+	stored.crc = crc16_data((const unsigned char *)state, sizeof(*state), 0);
+
+	/*fails (harmlessly) once the file exists*/
+	cfs_coffee_reserve(STATE_FILE, sizeof(stored));
+
+	fd = cfs_open(STATE_FILE, CFS_WRITE);
+
+	if(fd < 0)
+		return;
+
+	cfs_write(fd, &stored, sizeof(stored));
+
+	cfs_close(fd);
+}
+
+
+unsigned long node_state_uptime_ms(void){
+
+	return clock_seconds() * 1000 + ((clock_time() % CLOCK_SECOND) * 1000) / CLOCK_SECOND;
+}
@@ -0,0 +1,55 @@
+/*------------------------------Node State--------------------------------
+	Compact snapshot of the house state owned by the Central Unit.
+
+	The CU sends it to a node answering STATE_REQ (sent by every node
+	at boot) and every firmware persists the part it uses on the
+	external flash, so after a reboot the state is restored locally
+	before the CU answers.
+
+	Anti-entropy: every node periodically sends a 4-byte digest of its
+	state; the CU compares the fields the node owns with its own view
+	and sends the snapshot back only on a mismatch. A node changing
+	its state locally (Node4 button) flags the digest, so on a
+	mismatch the CU adopts the node value instead of overwriting it.
+------------------------------------------------------------------------*/
+#ifndef NODE_STATE_H_
+#define NODE_STATE_H_
+
+#include "contiki.h"
+
+struct node_state {
+
+	uint8_t alarm;
+	uint8_t gate;
+	uint8_t comfort;
+	uint8_t version;			/*incremented by the CU on every change*/
+	int8_t temp_min;			/*comfort thresholds*/
+	int8_t temp_optimal;
+	int8_t temp_max;
+	uint8_t pad;
+};
+
+#define NODE_STATE_ALARM		0x01	/*digest flags*/
+#define NODE_STATE_GATE			0x02
+#define NODE_STATE_COMFORT		0x04
+#define NODE_STATE_LOCAL		0x80	/*changed locally since the last CU snapshot*/
+
+struct node_state_digest {
+
+	uint8_t version;			/*of the last CU snapshot applied*/
+	uint8_t flags;
+	uint8_t thresholds;			/*hash of the comfort thresholds*/
+	uint8_t pad;
+};
+
+void node_state_digest(const struct node_state *state, int local, struct node_state_digest *digest);
+
+/*Returning 1 if a valid state was on flash*/
+int node_state_load(struct node_state *state);
+
+void node_state_save(const struct node_state *state);
+
+/*Milliseconds since boot, to report the time-to-correct-state*/
+unsigned long node_state_uptime_ms(void);
+
+#endif /* NODE_STATE_H_ */
@@ -0,0 +1,756 @@
+/*---------------------------------OTA------------------------------------
+	Over-the-air dissemination of firmware images (see ota.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "stdio.h"
+#include "string.h"
+#include "net/rime/rime.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+#include "lib/crc16.h"
+#include "lib/random.h"
+#include "dev/watchdog.h"
+#include "link-quality.h"
+#include "radio-queue.h"
+#include "nettime.h"
+#include "core.h"
+#include "ota.h"
+
+#define OTA_FILE			"ota"
+#define OTA_HEADER_FILE		"otahdr"
+#define NO_PAGE				0xFF
+#define CRC_CHUNK			32		/*bytes read at once to check a CRC*/
+
+#define NEWER(a, b)			((int8_t)((a) - (b)) > 0)
+#define PAGES(size)			(((size) + OTA_PAGE_SIZE - 1) / OTA_PAGE_SIZE)
+
+/*On flash: the image & the progress of its reception, then the CRC*/
+struct ota_header {
+
+	uint8_t version;
+	uint8_t target;
+	uint8_t state;
+	uint8_t complete;			/*pages held*/
+	uint16_t size;
+	uint16_t crc;				/*of the image*/
+	uint16_t check;				/*of the fields above*/
+};
+
+static const char *state_names[] = {"EMPTY", "LOADING", "RECEIVING", "COMPLETE", "PENDING", "RUNNING", "STAGED"};
+
+static struct ota_header image;
+static uint8_t firmware_target;
+static struct broadcast_conn ota_broadcast;
+static uint32_t rx_bytes = 0;
+static uint32_t tx_bytes = 0;
+static uint32_t done_time;
+static uint16_t loaded;			/*bytes typed on the CU console*/
+
+//Trickle advertisement
+static struct ctimer trickle_timer;
+static clock_time_t interval;
+static clock_time_t interval_rest;	/*after the advertisement time*/
+static uint8_t heard;				/*consistent advertisements in the interval*/
+static uint8_t advertised;			/*in the interval*/
+
+//fetching the page image.complete
+static struct ctimer req_timer;
+static uint16_t missing;
+static uint16_t page_crc;			/*announced by the data packets*/
+static uint8_t server = 0;			/*0 if none*/
+static uint8_t server_pages;		/*advertised by the server*/
+static uint8_t retries;
+static uint8_t requested;
+static uint8_t data_seen;			/*since the last request*/
+
+//serving one page at a time
+static struct ctimer tx_timer;
+static uint8_t tx_page = NO_PAGE;
+static uint16_t tx_missing;
+static uint16_t tx_crc;
+
+static struct ctimer done_timer;
+static uint8_t report_tries = 0;	/*reports sent waiting for OTA_ACK*/
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+static void save_header(void){
+
+	int fd;
+
+	image.check = crc16_data((const unsigned char *)&image, sizeof(image) - sizeof(image.check), 0);
+
+	/*fails (harmlessly) once the file exists*/
+	cfs_coffee_reserve(OTA_HEADER_FILE, sizeof(image));
+
+	fd = cfs_open(OTA_HEADER_FILE, CFS_WRITE);
+
+	if(fd < 0)
+		return;
+
+	cfs_write(fd, &image, sizeof(image));
+
+	cfs_close(fd);
+}
+
+/*Returning 1 if a valid header was on flash*/
+static int load_header(void){
+
+	int fd, len;
+
+	fd = cfs_open(OTA_HEADER_FILE, CFS_READ);
+
+	if(fd < 0)
+		return 0;
+
+	len = cfs_read(fd, &image, sizeof(image));
+
+	cfs_close(fd);
+
+	return len == sizeof(image) &&
+		image.check == crc16_data((const unsigned char *)&image, sizeof(image) - sizeof(image.check), 0);
+}
+
+static void erase_image(void){
+
+	cfs_remove(OTA_FILE);
+	cfs_coffee_reserve(OTA_FILE, (cfs_offset_t)OTA_MAX_PAGES * OTA_PAGE_SIZE);
+}
+
+static int image_io(int flags, cfs_offset_t offset, void *buf, int len){
+
+	int fd = cfs_open(OTA_FILE, flags);
+
+	if(fd < 0)
+		return -1;
+
+	if(cfs_seek(fd, offset, CFS_SEEK_SET) >= 0)
+		len = (flags == CFS_READ) ? cfs_read(fd, buf, len) : cfs_write(fd, buf, len);
+	else
+		len = -1;
+
+	cfs_close(fd);
+
+	return len;
+}
+
+static uint16_t image_crc(cfs_offset_t offset, uint16_t len){
+
+	unsigned char buf[CRC_CHUNK];
+	uint16_t crc = 0;
+	int n;
+
+	while(len > 0){
+
+		n = (len < CRC_CHUNK) ? len : CRC_CHUNK;
+
+		if(image_io(CFS_READ, offset, buf, n) != n)
+			return ~crc;
+
+		crc = crc16_data(buf, n, crc);
+		offset += n;
+		len -= n;
+	}
+
+	return crc;
+}
+
+static uint16_t page_bytes(uint8_t page){
+
+	uint16_t rest = image.size - (uint16_t)page * OTA_PAGE_SIZE;
+
+	return (rest < OTA_PAGE_SIZE) ? rest : OTA_PAGE_SIZE;
+}
+
+/*Bit per packet of the page*/
+static uint16_t page_mask(uint8_t page){
+
+	int packets = (page_bytes(page) + OTA_PACKET_DATA - 1) / OTA_PACKET_DATA;
+
+	return (packets == OTA_PAGE_PACKETS) ? 0xFFFF : (1U << packets) - 1;
+}
+
+static void send_frame(const void *frame, int len){
+
+	packetbuf_copyfrom(frame, len);
+	broadcast_send(&ota_broadcast);
+
+	tx_bytes += len;
+}
+
+/*-------------------------------TRICKLE--------------------------------*/
+
+static void trickle_callback(void *ptr);
+
+static void send_adv(void){
+
+	struct ota_adv adv;
+
+	adv.type = OTA_ADV;
+	adv.version = image.version;
+	adv.target = image.target;
+	adv.complete = image.complete;
+	adv.size = image.size;
+	adv.crc = image.crc;
+
+	send_frame(&adv, sizeof(adv));
+}
+
+/*New interval, advertising at a random time of its second half*/
+static void trickle_start(clock_time_t i){
+
+	clock_time_t t = i/2 + random_rand() % (i/2);
+
+	interval = i;
+	interval_rest = i - t;
+	heard = 0;
+	advertised = 0;
+
+	ctimer_set(&trickle_timer, t, trickle_callback, NULL);
+}
+
+static void trickle_callback(void *ptr){
+
+	(void)ptr;
+
+	if(!advertised){
+
+		if(heard < OTA_REDUNDANCY)
+			send_adv();
+
+		advertised = 1;
+		ctimer_set(&trickle_timer, interval_rest, trickle_callback, NULL);
+
+		return;
+	}
+
+	trickle_start((interval < OTA_TAU_HIGH/2) ? 2*interval : OTA_TAU_HIGH);
+}
+
+/*Inconsistency heard: advertising soon*/
+static void trickle_reset(void){
+
+	if(interval != OTA_TAU_LOW || ctimer_expired(&trickle_timer))
+		trickle_start(OTA_TAU_LOW);
+}
+
+/*------------------------------RECEPTION-------------------------------*/
+
+static void req_callback(void *ptr);
+
+static void schedule_request(clock_time_t delay){
+
+	requested = 0;
+	ctimer_set(&req_timer, delay, req_callback, NULL);
+}
+
+static void fetch_from(uint8_t from, uint8_t pages){
+
+	server = from;
+	server_pages = pages;
+	retries = 0;
+
+	schedule_request(1 + random_rand() % OTA_REQ_DELAY);
+}
+
+/*Requesting the missing packets of the page, again on timeout*/
+static void req_callback(void *ptr){
+
+	struct ota_req req;
+
+	(void)ptr;
+
+	if(image.state != OTA_RECEIVING || server == 0)
+		return;
+
+	if(data_seen)
+		retries = 0;
+	else if(requested && ++retries > OTA_REQ_RETRIES){
+	/*waiting for the next advertisement*/
+
+		server = 0;
+		return;
+	}
+
+	req.type = OTA_REQ;
+	req.version = image.version;
+	req.page = image.complete;
+	req.server = server;
+	req.missing = missing;
+
+	send_frame(&req, sizeof(req));
+
+	requested = 1;
+	data_seen = 0;
+	ctimer_set(&req_timer, OTA_REQ_TIMEOUT, req_callback, NULL);
+}
+
+static void settle_callback(void *ptr);
+
+/*All the pages received: checking the image*/
+static void image_done(void){
+
+	ctimer_stop(&req_timer);
+	server = 0;
+
+	if(image_crc(0, image.size) != image.crc){
+
+		printf("OTA: version %u image CRC error, fetching it again\n", image.version);
+
+		image.complete = 0;
+		missing = page_mask(0);
+		save_header();
+
+		return;
+	}
+
+	image.state = OTA_COMPLETE;
+	save_header();
+
+	done_time = nettime_now();
+
+	printf("OTA: version %u complete (%u B), received %lu B, sent %lu B\n", image.version, image.size,
+		(unsigned long)rx_bytes, (unsigned long)tx_bytes);
+
+	ctimer_set(&done_timer, OTA_SETTLE*CLOCK_SECOND, settle_callback, NULL);
+}
+
+static void page_done(void){
+
+	if(image_crc((cfs_offset_t)image.complete * OTA_PAGE_SIZE, page_bytes(image.complete)) != page_crc){
+
+		printf("OTA: version %u page %u CRC error\n", image.version, image.complete);
+
+		missing = page_mask(image.complete);
+		schedule_request(1);
+
+		return;
+	}
+
+	image.complete++;
+	save_header();
+
+	/*new pages to offer*/
+	trickle_reset();
+
+	if(image.complete == PAGES(image.size)){
+
+		image_done();
+		return;
+	}
+
+	missing = page_mask(image.complete);
+	retries = 0;
+
+	if(image.complete < server_pages)
+		schedule_request(1);
+	else
+		server = 0;
+}
+
+static void recv_data(const struct ota_data *data, int len){
+
+	uint16_t bit = 1U << data->packet, bytes;
+
+	/*sent by another server: not repeated*/
+	if(data->version == image.version && data->page == tx_page && data->packet < OTA_PAGE_PACKETS)
+		tx_missing &= ~bit;
+
+	if(len < (int)sizeof(*data) - OTA_PACKET_DATA || image.state != OTA_RECEIVING || data->version != image.version ||
+		data->page != image.complete || data->packet >= OTA_PAGE_PACKETS || !(missing & bit))
+		return;
+
+	/*the CRC of the first packet of the page holds for the others*/
+	if(missing == page_mask(data->page))
+		page_crc = data->page_crc;
+	else if(data->page_crc != page_crc)
+		return;
+
+	bytes = page_bytes(data->page) - data->packet * OTA_PACKET_DATA;
+
+	if(bytes > OTA_PACKET_DATA)
+		bytes = OTA_PACKET_DATA;
+
+	if(len < (int)(sizeof(*data) - OTA_PACKET_DATA + bytes) ||
+		image_io(CFS_WRITE, (cfs_offset_t)data->page * OTA_PAGE_SIZE + data->packet * OTA_PACKET_DATA,
+		(void *)data->data, bytes) != bytes)
+		return;
+
+	missing &= ~bit;
+	data_seen = 1;
+
+	if(missing == 0)
+		page_done();
+}
+
+static void recv_adv(const struct ota_adv *adv, const linkaddr_t *from){
+
+	if(image.state == OTA_EMPTY || NEWER(adv->version, image.version)){
+
+		if(adv->size == 0 || PAGES(adv->size) > OTA_MAX_PAGES)
+			return;
+
+		ctimer_stop(&done_timer);
+		ctimer_stop(&tx_timer);
+		tx_page = NO_PAGE;
+		report_tries = 0;
+
+		image.version = adv->version;
+		image.target = adv->target;
+		image.state = OTA_RECEIVING;
+		image.complete = 0;
+		image.size = adv->size;
+		image.crc = adv->crc;
+
+		erase_image();
+		save_header();
+
+		rx_bytes = sizeof(*adv);
+		tx_bytes = 0;
+		missing = page_mask(0);
+
+		printf("OTA: RECEIVING version %u (%u B) from [%d:0]\n", image.version, image.size, from->u8[0]);
+
+		trickle_reset();
+		fetch_from(from->u8[0], adv->complete);
+
+		return;
+	}
+
+	if(NEWER(image.version, adv->version)){
+	/*an older neighbour: advertising soon*/
+
+		trickle_reset();
+		return;
+	}
+
+	if(adv->complete == image.complete)
+		heard++;
+	else
+		trickle_reset();
+
+	if(image.state == OTA_RECEIVING && adv->complete > image.complete && server == 0)
+		fetch_from(from->u8[0], adv->complete);
+}
+
+/*-------------------------------SERVING--------------------------------*/
+
+static void tx_callback(void *ptr){
+
+	struct ota_data data;
+	uint16_t bytes;
+	int packet;
+
+	(void)ptr;
+
+	for(packet = 0; packet < OTA_PAGE_PACKETS && !(tx_missing & (1U << packet)); packet++);
+
+	if(packet == OTA_PAGE_PACKETS){
+
+		tx_page = NO_PAGE;
+		return;
+	}
+
+	tx_missing &= ~(1U << packet);
+
+	bytes = page_bytes(tx_page) - packet * OTA_PACKET_DATA;
+
+	if(bytes > OTA_PACKET_DATA)
+		bytes = OTA_PACKET_DATA;
+
+	data.type = OTA_DATA;
+	data.version = image.version;
+	data.page = tx_page;
+	data.packet = packet;
+	data.page_crc = tx_crc;
+
+	if(image_io(CFS_READ, (cfs_offset_t)tx_page * OTA_PAGE_SIZE + packet * OTA_PACKET_DATA, data.data, bytes) == bytes)
+		send_frame(&data, sizeof(data) - OTA_PACKET_DATA + bytes);
+
+	if(tx_missing)
+		ctimer_set(&tx_timer, OTA_DATA_INTERVAL, tx_callback, NULL);
+	else
+		tx_page = NO_PAGE;
+}
+
+static void recv_req(const struct ota_req *req){
+
+	if(req->version != image.version)
+		return;
+
+	if(req->server == linkaddr_node_addr.u8[0] && req->page < image.complete){
+
+		if(tx_page == NO_PAGE){
+
+			tx_page = req->page;
+			tx_missing = req->missing & page_mask(req->page);
+			tx_crc = image_crc((cfs_offset_t)tx_page * OTA_PAGE_SIZE, page_bytes(tx_page));
+
+			ctimer_set(&tx_timer, OTA_DATA_INTERVAL, tx_callback, NULL);
+
+		}else if(tx_page == req->page)
+			tx_missing |= req->missing & page_mask(req->page);
+
+		/*another page: requested again once this one is sent*/
+
+	}else if(image.state == OTA_RECEIVING && req->page == image.complete && !requested){
+	/*overheard request of the same page: its data will do*/
+
+		if(server == 0){
+
+			server = req->server;
+			server_pages = req->page + 1;
+		}
+
+		requested = 1;
+		data_seen = 0;
+		ctimer_set(&req_timer, OTA_REQ_TIMEOUT, req_callback, NULL);
+	}
+}
+
+/*------------------------------COMPLETION------------------------------*/
+
+static void reboot_callback(void *ptr){
+
+	(void)ptr;
+
+	image.state = OTA_PENDING;
+	save_header();
+
+	printf("OTA: REBOOTING into version %u\n", image.version);
+
+	watchdog_reboot();
+}
+
+/*Once reported: installing if targeted (not again after the reboot)*/
+static void report_done(void){
+
+	report_tries = 0;
+
+	if(image.state == OTA_COMPLETE && (image.target & firmware_target))
+		ctimer_set(&done_timer, OTA_REBOOT_DELAY*CLOCK_SECOND, reboot_callback, NULL);
+}
+
+/*Reporting to the CU until OTA_ACK, OTA_REPORT_TRIES times at most*/
+static void report_callback(void *ptr){
+
+	char msg[OTA_REPORT_SIZE + sizeof(struct ota_report)];
+	struct ota_report report;
+
+	(void)ptr;
+
+	/*the CU keeps its own images*/
+	if(linkaddr_node_addr.u8[0] == UC_RIME_ADDR){
+
+		report_done();
+		return;
+	}
+
+	report.version = image.version;
+
+	if(image.state == OTA_RUNNING)
+		report.outcome = OTA_INSTALLED;
+	else if(image.state == OTA_STAGED)
+		report.outcome = OTA_NOT_INSTALLED;
+	else
+		report.outcome = (image.target & firmware_target) ? OTA_REBOOTING : OTA_STORED;
+
+	report.pad = 0;
+	report.done = done_time;
+	report.rx_bytes = rx_bytes;
+	report.tx_bytes = tx_bytes;
+
+	memcpy(msg, OTA_REPORT, OTA_REPORT_SIZE);
+	memcpy(msg + OTA_REPORT_SIZE, &report, sizeof(report));
+
+	send_data(msg, sizeof(msg), UC_RIME_ADDR, RADIO_QUEUE_TELEMETRY);
+
+	if(++report_tries < OTA_REPORT_TRIES){
+
+		ctimer_set(&done_timer, OTA_REPORT_RETRY*CLOCK_SECOND, report_callback, NULL);
+		return;
+	}
+
+	printf("OTA: version %u report not acknowledged after %u tries\n", image.version, report_tries);
+
+	report_done();
+}
+
+/*Reporting to the CU after serving the neighbours*/
+static void settle_callback(void *ptr){
+
+	report_tries = 0;
+
+	report_callback(ptr);
+}
+
+/*Reporting the outcome of the reboot, on the network time synchronised again*/
+static void boot_report_callback(void *ptr){
+
+	done_time = nettime_now();
+
+	settle_callback(ptr);
+}
+
+/*----------------------------------RIME--------------------------------*/
+
+void ota_report_acked(const char* rcvd_msg){
+
+	/*an acknowledgement of a retry already answered, or of an older image*/
+	if(packetbuf_datalen() < OTA_ACK_SIZE + 1 || report_tries == 0 || image.state < OTA_COMPLETE ||
+		(uint8_t)rcvd_msg[OTA_ACK_SIZE] != image.version)
+		return;
+
+	ctimer_stop(&done_timer);
+
+	report_done();
+}
+
+static void ota_recv(struct broadcast_conn *c, const linkaddr_t *from){
+
+	const uint8_t *frame = (const uint8_t *)packetbuf_dataptr();
+	int len = packetbuf_datalen();
+
+	(void)c;
+
+	link_quality_received(from);
+
+	rx_bytes += len;
+
+	/*the CU console is loading a newer image*/
+	if(len < 1 || image.state == OTA_LOADING)
+		return;
+
+	if(frame[0] == OTA_ADV && len >= (int)sizeof(struct ota_adv))
+
+		recv_adv((const struct ota_adv *)frame, from);
+
+	else if(frame[0] == OTA_REQ && len >= (int)sizeof(struct ota_req))
+
+		recv_req((const struct ota_req *)frame);
+
+	else if(frame[0] == OTA_DATA)
+
+		recv_data((const struct ota_data *)frame, len);
+}
+
+static const struct broadcast_callbacks ota_call = {ota_recv, NULL};
+
+
+void ota_init(uint8_t target){
+
+	firmware_target = target;
+
+	if(!load_header())
+		memset(&image, 0, sizeof(image));
+
+	if(image.state == OTA_PENDING){
+	/*started by a boot loader only if the firmware is the image*/
+
+		image.state = (image.version == OTA_FIRMWARE_VERSION) ? OTA_RUNNING : OTA_STAGED;
+		save_header();
+
+		if(image.state == OTA_RUNNING)
+			printf("OTA: RUNNING image version %u\n", image.version);
+		else
+			printf("OTA: image version %u STAGED, not installed (firmware version %u)\n", image.version,
+				OTA_FIRMWARE_VERSION);
+
+		ctimer_set(&done_timer, OTA_SETTLE*CLOCK_SECOND, boot_report_callback, NULL);
+
+	}else if(image.state == OTA_LOADING){
+
+		image.state = OTA_EMPTY;
+		save_header();
+	}
+
+	broadcast_open(&ota_broadcast, OTA_CHANNEL, &ota_call);
+
+	if(image.state == OTA_EMPTY)
+		return;
+
+	/*a partial page is fetched again*/
+	if(image.state == OTA_RECEIVING)
+		missing = page_mask(image.complete);
+
+	/*rebooted before the report*/
+	if(image.state == OTA_COMPLETE && image.target != OTA_TARGET_NONE){
+
+		done_time = nettime_now();
+		ctimer_set(&done_timer, OTA_SETTLE*CLOCK_SECOND, settle_callback, NULL);
+	}
+
+	trickle_start(OTA_TAU_LOW);
+}
+
+
+int ota_load(uint8_t version, uint8_t target, uint16_t size){
+
+	if(size == 0 || PAGES(size) > OTA_MAX_PAGES || (image.state != OTA_EMPTY && !NEWER(version, image.version)))
+		return 0;
+
+	ctimer_stop(&trickle_timer);
+	ctimer_stop(&req_timer);
+	ctimer_stop(&tx_timer);
+	ctimer_stop(&done_timer);
+	tx_page = NO_PAGE;
+	server = 0;
+	report_tries = 0;
+
+	image.version = version;
+	image.target = target;
+	image.state = OTA_LOADING;
+	image.complete = 0;
+	image.size = size;
+	image.crc = 0;
+
+	erase_image();
+	save_header();
+
+	loaded = 0;
+
+	printf("OTA: LOADING version %u (%u B)\n", version, size);
+
+	return 1;
+}
+
+
+int ota_write(const uint8_t *data, int len){
+
+	if(image.state != OTA_LOADING || len <= 0 || loaded + len > image.size ||
+		image_io(CFS_WRITE, loaded, (void *)data, len) != len)
+		return 0;
+
+	loaded += len;
+
+	return 1;
+}
+
+
+int ota_seed(void){
+
+	if(image.state != OTA_LOADING || loaded != image.size)
+		return 0;
+
+	image.crc = image_crc(0, image.size);
+	image.complete = PAGES(image.size);
+	image.state = OTA_COMPLETE;
+	save_header();
+
+	rx_bytes = 0;
+	tx_bytes = 0;
+
+	printf("OTA: SEEDING version %u (%u B, %u pages, CRC %04x)\n", image.version, image.size, image.complete, image.crc);
+
+	trickle_start(OTA_TAU_LOW);
+
+	return 1;
+}
+
+
+void ota_print(void){
+
+	printf("OTA: version %u target %u %s, %u/%u pages, received %lu B, sent %lu B\n", image.version, image.target,
+		(image.state <= OTA_STAGED) ? state_names[image.state] : "?", image.complete, PAGES(image.size),
+		(unsigned long)rx_bytes, (unsigned long)tx_bytes);
+}
@@ -0,0 +1,164 @@
+/*---------------------------------OTA------------------------------------
+	Over-the-air dissemination of firmware images (Deluge-style).
+
+	An image is split in pages of OTA_PAGE_PACKETS packets and is
+	identified by a version (newer if (int8_t)(a - b) > 0), a target
+	firmware, its size and its CRC. Every node holding an image
+	advertises it on OTA_CHANNEL with a Trickle timer (interval from
+	OTA_TAU_LOW doubling up to OTA_TAU_HIGH, an advertisement sent
+	only if less than OTA_REDUNDANCY consistent ones were heard in
+	the interval; an inconsistent one restarts from OTA_TAU_LOW). A
+	node without an image stays silent until it hears one.
+
+	A node hearing a newer version drops its image and fetches the
+	pages in order from a neighbour advertising more of them: a
+	request names the server, the page and the bitmap of the missing
+	packets, the server broadcasts them (any node waiting for that
+	page stores them too, so an overheard request is not repeated).
+	Every data packet carries the CRC of its page: a page failing it
+	is requested again, and a complete image is checked against the
+	advertised CRC. Pages and progress are kept on the external flash
+	(Coffee files), so a rebooted node resumes where it stopped.
+
+	Once complete, the node serves its neighbours for OTA_SETTLE
+	seconds and reports to the CU (OTA_REPORT: completion time on
+	the network time line and OTA bytes received & sent), again
+	every OTA_REPORT_RETRY seconds until the CU answers OTA_ACK, at
+	most OTA_REPORT_TRIES times. A node of the target firmware then
+	marks the image OTA_PENDING and reboots: a boot loader copies a
+	pending image to the MCU flash before starting it. None is in
+	this tree (a stock Sky restarts the same firmware), so ota_init()
+	marks the image OTA_RUNNING only when the running firmware was
+	built as that version (OTA_FIRMWARE_VERSION), OTA_STAGED (kept
+	and served, not installed) otherwise, and reports the outcome to
+	the CU again after OTA_SETTLE seconds.
+
+	The CU seeds an image typed on its console (see CU.c). The OTA
+	frames are not traced: the bulk data would flood the trace ring.
+------------------------------------------------------------------------*/
+#ifndef OTA_H_
+#define OTA_H_
+
+#include "contiki.h"
+
+#define OTA_CHANNEL				130
+
+#define OTA_PACKET_DATA			64	/*bytes of image per data packet*/
+#define OTA_PAGE_PACKETS		16	/*bits of the missing bitmap*/
+#define OTA_PAGE_SIZE			(OTA_PAGE_PACKETS*OTA_PACKET_DATA)
+
+#ifdef OTA_CONF_MAX_PAGES
+#define OTA_MAX_PAGES			OTA_CONF_MAX_PAGES
+#else
+#define OTA_MAX_PAGES			48	/*MSP430F1611 flash*/
+#endif
+
+#define OTA_TAU_LOW				(2*CLOCK_SECOND)	/*Trickle interval*/
+#define OTA_TAU_HIGH			(64*CLOCK_SECOND)
+#define OTA_REDUNDANCY			1
+#define OTA_REQ_DELAY			(CLOCK_SECOND/8)	/*random, before a request*/
+#define OTA_REQ_TIMEOUT			CLOCK_SECOND		/*without data of the page*/
+#define OTA_REQ_RETRIES			3					/*to one server*/
+#define OTA_DATA_INTERVAL		(CLOCK_SECOND/64)	/*between two data packets*/
+#define OTA_SETTLE				30	/*seconds serving before the report*/
+#define OTA_REPORT_RETRY		10	/*seconds between unacknowledged reports*/
+#define OTA_REPORT_TRIES		5	/*reports before rebooting unacknowledged*/
+#define OTA_REBOOT_DELAY		5	/*seconds from the acknowledgement to the reboot*/
+
+/*image version of the running firmware, 0 if not built as one (versions start at 1)*/
+#ifdef OTA_CONF_FIRMWARE_VERSION
+#define OTA_FIRMWARE_VERSION	OTA_CONF_FIRMWARE_VERSION
+#else
+#define OTA_FIRMWARE_VERSION	0
+#endif
+
+//targets (firmwares installing the image)
+#define OTA_TARGET_NONE			0
+#define OTA_TARGET_NODE1		1
+#define OTA_TARGET_NODE2		2
+#define OTA_TARGET_NODE4		4
+
+//image states (on flash)
+#define OTA_EMPTY				0
+#define OTA_LOADING				1	/*typed on the CU console*/
+#define OTA_RECEIVING			2
+#define OTA_COMPLETE			3
+#define OTA_PENDING				4	/*installed by the boot loader*/
+#define OTA_RUNNING				5
+#define OTA_STAGED				6	/*pending at the reboot, not the running firmware*/
+
+//report outcomes (ota_report.outcome)
+#define OTA_STORED				0	/*not of the target firmware*/
+#define OTA_REBOOTING			1	/*rebooting into the image once acknowledged*/
+#define OTA_INSTALLED			2	/*after the reboot: running the image*/
+#define OTA_NOT_INSTALLED		3	/*after the reboot: staged, the firmware unchanged*/
+
+//frame types (OTA_CHANNEL)
+#define OTA_ADV					0
+#define OTA_REQ					1
+#define OTA_DATA				2
+
+//communication values (size with the terminator)
+#define OTA_REPORT				"OTA"
+#define OTA_REPORT_SIZE			4
+#define OTA_ACK					"OTA_ACK"	/*+ uint8_t version*/
+#define OTA_ACK_SIZE			8
+
+struct ota_adv {
+
+	uint8_t type;
+	uint8_t version;
+	uint8_t target;
+	uint8_t complete;			/*pages held*/
+	uint16_t size;				/*bytes*/
+	uint16_t crc;				/*of the image*/
+};
+
+struct ota_req {
+
+	uint8_t type;
+	uint8_t version;
+	uint8_t page;
+	uint8_t server;				/*rime address*/
+	uint16_t missing;			/*bit per packet*/
+};
+
+struct ota_data {
+
+	uint8_t type;
+	uint8_t version;
+	uint8_t page;
+	uint8_t packet;
+	uint16_t page_crc;
+	uint8_t data[OTA_PACKET_DATA];
+};
+
+/*Body of OTA_REPORT*/
+struct ota_report {
+
+	uint8_t version;
+	uint8_t outcome;			/*OTA_STORED ... OTA_NOT_INSTALLED*/
+	uint16_t pad;
+	uint32_t done;				/*network time of the completion (of the report after the reboot)*/
+	uint32_t rx_bytes;			/*OTA frames*/
+	uint32_t tx_bytes;
+};
+
+/*Restoring the image of the flash and opening OTA_CHANNEL, target of the firmware*/
+void ota_init(uint8_t target);
+
+/*CU seeding: a new image of size bytes, its data in order, then the start of the dissemination.
+  Returning 0 on error*/
+int ota_load(uint8_t version, uint8_t target, uint16_t size);
+
+int ota_write(const uint8_t *data, int len);
+
+int ota_seed(void);
+
+/*OTA_ACK of the CU to the report of the image*/
+void ota_report_acked(const char* rcvd_msg);
+
+/*Version, state & pages of the image, OTA bytes received & sent*/
+void ota_print(void);
+
+#endif /* OTA_H_ */
@@ -4,4 +4,18 @@
 #undef NETSTACK_CONF_RDC
 #define NETSTACK_CONF_RDC nullrdc_driver
 
+/*UART drained by interrupt: printf and the serial frames only fill the TX buffer*/
+#undef UART1_CONF_TX_WITH_INTERRUPT
+#define UART1_CONF_TX_WITH_INTERRUPT 1
+
+/*Trace of the frames, buttons, readings & LEDs on the UART for the host replay (trace.h)*/
+#ifndef TRACE_CONF_ENABLED
+#define TRACE_CONF_ENABLED 0
+#endif
+
+/*Microbenchmarks of the hot paths run by the bench process (bench.h, make bench)*/
+#ifndef BENCH_CONF_ENABLED
+#define BENCH_CONF_ENABLED 0
+#endif
+
 #endif /* PROJECT_CONF_H_ */
@@ -0,0 +1,187 @@
+/*-----------------------------Radio Queue--------------------------------
+	Priority classes for the outgoing runicast messages (see radio-queue.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "stdio.h"
+#include "string.h"
+#include "lib/crc16.h"
+#include "radio-queue.h"
+#include "link-quality.h"
+#include "trace.h"
+
+struct queued {
+
+	uint8_t rime_addr;
+	uint8_t size;
+	clock_time_t enqueued;
+	char msg[RADIO_QUEUE_MSG_SIZE];
+};
+
+struct queue {
+
+	struct queued entries[RADIO_QUEUE_LENGTH];
+	uint8_t head;				/*oldest message*/
+	uint8_t count;
+};
+
+static const char *class_names[RADIO_QUEUE_CLASSES] = {"ALARM", "COMMAND", "TELEMETRY"};
+
+static struct runicast_conn *runicast;
+static struct queue queues[RADIO_QUEUE_CLASSES];
+static struct radio_queue_stats stats[RADIO_QUEUE_CLASSES];
+
+/*frame in the runicast & the last one completed, identified by size & CRC*/
+static struct {
+
+	uint8_t rime_addr;
+	uint8_t size;
+	uint16_t crc;
+} inflight, completed;
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+static int transmit(int priority, const void *msg, int size, int rime_addr, clock_time_t enqueued){
+
+	struct radio_queue_stats *s = &stats[priority];
+	unsigned long delay;
+	linkaddr_t addr;
+
+	packetbuf_copyfrom(msg, size);
+	addr.u8[0] = rime_addr;
+	addr.u8[1] = 0;
+	link_quality_prepare(rime_addr);
+
+	if(!runicast_send(runicast, &addr, link_quality_max_retransmissions(rime_addr))){
+
+		s->dropped++;
+		return 0;
+	}
+
+	TRACE_PACKET(TRACE_TX_RUNICAST, &addr, 0);
+
+	inflight.rime_addr = rime_addr;
+	inflight.size = size;
+	inflight.crc = crc16_data((const unsigned char *)msg, size, 0);
+
+	delay = ((unsigned long)(clock_time_t)(clock_time() - enqueued) * 1000) / CLOCK_SECOND;
+
+	s->sent++;
+	s->delay_sum_ms += delay;
+
+	if(delay > s->delay_max_ms)
+		s->delay_max_ms = delay;
+
+	return 1;
+}
+
+
+void radio_queue_init(struct runicast_conn *c){
+
+	runicast = c;
+
+	memset(queues, 0, sizeof(queues));
+	memset(stats, 0, sizeof(stats));
+	memset(&inflight, 0, sizeof(inflight));
+	memset(&completed, 0, sizeof(completed));
+}
+
+
+int radio_queue_send(int priority, const void *msg, int size, int rime_addr){
+
+	struct queue *q = &queues[priority];
+	struct queued *e;
+
+	if(radio_queue_idle())
+		return transmit(priority, msg, size, rime_addr, clock_time());
+
+	if(q->count == RADIO_QUEUE_LENGTH || size > RADIO_QUEUE_MSG_SIZE){
+
+		stats[priority].dropped++;
+		stats[priority].too_long += size > RADIO_QUEUE_MSG_SIZE;
+		return 0;
+	}
+
+	e = &q->entries[(q->head + q->count) % RADIO_QUEUE_LENGTH];
+	e->rime_addr = rime_addr;
+	e->size = size;
+	e->enqueued = clock_time();
+	memcpy(e->msg, msg, size);
+
+	q->count++;
+
+	return 1;
+}
+
+
+void radio_queue_sent(void){
+
+	struct queue *q;
+	struct queued *e;
+	int i;
+
+	completed = inflight;
+	inflight.size = 0;
+
+	for(i=0; i<RADIO_QUEUE_CLASSES; i++){
+
+		q = &queues[i];
+
+		/*a message refused by the runicast gets no callback: going on with the next*/
+		while(q->count > 0){
+
+			e = &q->entries[q->head];
+			q->head = (q->head + 1) % RADIO_QUEUE_LENGTH;
+			q->count--;
+
+			if(transmit(i, e->msg, e->size, e->rime_addr, e->enqueued))
+				return;
+		}
+	}
+}
+
+
+int radio_queue_completed(const void *msg, int size, int rime_addr){
+
+	return completed.size != 0 && completed.size == size && completed.rime_addr == rime_addr &&
+		completed.crc == crc16_data((const unsigned char *)msg, size, 0);
+}
+
+
+int radio_queue_idle(void){
+
+	int i;
+
+	if(runicast_is_transmitting(runicast))
+		return 0;
+
+	for(i=0; i<RADIO_QUEUE_CLASSES; i++)
+		if(queues[i].count > 0)
+			return 0;
+
+	return 1;
+}
+
+
+void radio_queue_print_stats(const char *name){
+
+	struct radio_queue_stats *s;
+	int i;
+
+	printf("%s: RADIO QUEUES:\n", name);
+
+	for(i=0; i<RADIO_QUEUE_CLASSES; i++){
+
+		s = &stats[i];
+
+		printf("\t%s: sent %u dropped %u queued %u", class_names[i], s->sent, s->dropped, queues[i].count);
+
+		if(s->sent > 0)
+			printf(" delay avg/max %lu/%u ms", s->delay_sum_ms / s->sent, s->delay_max_ms);
+
+		if(s->too_long > 0)
+			printf(" ERROR: %u too long", s->too_long);
+
+		printf("\n");
+	}
+}
@@ -0,0 +1,58 @@
+/*-----------------------------Radio Queue--------------------------------
+	Priority classes for the outgoing runicast messages.
+
+	Every message is sent with a class; while the runicast is busy
+	(one packet in flight, retransmissions included) it waits in the
+	queue of its class, and when the runicast gets free the oldest
+	message of the highest class goes first. Alarm and security
+	traffic thus overtakes queued telemetry, waiting at most for the
+	packet already in flight. Broadcasts do not use the runicast and
+	are never queued.
+
+	The queueing delay (from the send request to the radio) is kept
+	per class together with the sent and dropped counts.
+------------------------------------------------------------------------*/
+#ifndef RADIO_QUEUE_H_
+#define RADIO_QUEUE_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+
+#define RADIO_QUEUE_ALARM			0	/*alarm & gate (security) commands and acks*/
+#define RADIO_QUEUE_COMMAND			1	/*other commands, confirmations, state & time synch*/
+#define RADIO_QUEUE_TELEMETRY		2	/*readings, logs, digests*/
+#define RADIO_QUEUE_CLASSES			3
+
+#define RADIO_QUEUE_LENGTH			3	/*messages per class*/
+/*queued slot: the longest queued messages are the CU CONFIG frame (44 B) and the state
+  digest (41 B, 51 B with 4 link reports); longer ones (the temperature log frames of Node1)
+  are only sent on an idle runicast, dropped & counted as too long otherwise*/
+#define RADIO_QUEUE_MSG_SIZE		56
+
+struct radio_queue_stats {
+
+	unsigned int sent;
+	unsigned int dropped;
+	unsigned int too_long;		/*of the dropped, longer than RADIO_QUEUE_MSG_SIZE*/
+	unsigned long delay_sum_ms;
+	unsigned int delay_max_ms;
+};
+
+void radio_queue_init(struct runicast_conn *c);
+
+/*Sending now if the runicast is idle, queueing otherwise. Returning 0 if dropped*/
+int radio_queue_send(int priority, const void *msg, int size, int rime_addr);
+
+/*To be called by the runicast sent/timedout callbacks: sending the next message (skipping the
+  ones refused by the runicast, no callback would follow them)*/
+void radio_queue_sent(void);
+
+/*Returning 1 if msg is the frame whose sent/timedout callback is running (size & CRC)*/
+int radio_queue_completed(const void *msg, int size, int rime_addr);
+
+/*Nothing queued and nothing in flight*/
+int radio_queue_idle(void);
+
+void radio_queue_print_stats(const char *name);
+
+#endif /* RADIO_QUEUE_H_ */
@@ -0,0 +1,79 @@
+/*-----------------------------Sensor Power-------------------------------
+	Duty-cycling layer for the on-board sensors (see sensor-power.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "stdio.h"
+#include "sensor-power.h"
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+void sensor_power_init(struct sensor_power *sp, const struct sensors_sensor *sensor){
+
+	sp->sensor = sensor;
+	sp->on_ms = 0;
+	sp->start_sec = clock_seconds();
+	sp->activations = 0;
+	sp->powered = 0;
+}
+
+
+void sensor_power_on(struct sensor_power *sp){
+
+	if(sp->powered)
+		return;
+
+	SENSORS_ACTIVATE(*sp->sensor);
+
+	sp->on_since = RTIMER_NOW();
+	sp->powered = 1;
+	sp->activations++;
+}
+
+
+void sensor_power_off(struct sensor_power *sp){
+
+	rtimer_clock_t on_ticks;
+
+	if(!sp->powered)
+		return;
+
+	SENSORS_DEACTIVATE(*sp->sensor);
+
+	/*a single measurement is far shorter than the rtimer wrap-around*/
+	on_ticks = RTIMER_NOW() - sp->on_since;
+	sp->on_ms += ((unsigned long)on_ticks * 1000) / RTIMER_SECOND;
+	sp->powered = 0;
+}
+
+
+int sensor_power_read(struct sensor_power *sp, int type){
+
+	int value;
+
+	sensor_power_on(sp);
+
+	value = sp->sensor->value(type);
+
+	sensor_power_off(sp);
+
+	return value;
+}
+
+
+unsigned int sensor_power_ratio(struct sensor_power *sp){
+
+	unsigned long elapsed = clock_seconds() - sp->start_sec;
+
+	if(elapsed == 0)
+		return (sp->powered) ? 1000 : 0;
+
+	/*on_ms / (elapsed * 1000) in per mille*/
+	return (unsigned int)(sp->on_ms / elapsed);
+}
+
+
+void sensor_power_report(struct sensor_power *sp, const char *name){
+
+	printf("%s: on-time %u/1000 (%lu ms in %lu s, %u activations)\n", name,
+		sensor_power_ratio(sp), sp->on_ms, clock_seconds() - sp->start_sec, sp->activations);
+}
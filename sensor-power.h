@@ -0,0 +1,39 @@
+/*-----------------------------Sensor Power-------------------------------
+	Duty-cycling layer for the on-board sensors.
+
+	A sensor is powered only for the time needed by a single
+	measurement and the accumulated on-time is tracked, so every
+	firmware can report the on-time ratio (per mille) of its sensors
+	and the energy saved w.r.t. keeping them always active.
+------------------------------------------------------------------------*/
+#ifndef SENSOR_POWER_H_
+#define SENSOR_POWER_H_
+
+#include "contiki.h"
+#include "lib/sensors.h"
+
+struct sensor_power {
+
+	const struct sensors_sensor *sensor;
+	rtimer_clock_t on_since;		/*rtimer ticks when last powered on*/
+	unsigned long on_ms;			/*accumulated on-time*/
+	unsigned long start_sec;		/*when the tracking started*/
+	unsigned int activations;
+	int powered;
+};
+
+void sensor_power_init(struct sensor_power *sp, const struct sensors_sensor *sensor);
+
+void sensor_power_on(struct sensor_power *sp);
+
+void sensor_power_off(struct sensor_power *sp);
+
+/*Powering the sensor, reading a single value and powering it off*/
+int sensor_power_read(struct sensor_power *sp, int type);
+
+/*On-time ratio in per mille since sensor_power_init()*/
+unsigned int sensor_power_ratio(struct sensor_power *sp);
+
+void sensor_power_report(struct sensor_power *sp, const char *name);
+
+#endif /* SENSOR_POWER_H_ */
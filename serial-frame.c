@@ -0,0 +1,54 @@
+/*-----------------------------Serial Frame-------------------------------
+	Binary framed serial output of the Central Unit (see serial-frame.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "stdio.h"
+#include "lib/crc16.h"
+#include "serial-frame.h"
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+static void put_escaped(uint8_t b){
+
+	if(b == SERIAL_FRAME_END){
+
+		putchar(SERIAL_FRAME_ESC);
+		putchar(SERIAL_FRAME_ESC_END);
+
+	}else if(b == SERIAL_FRAME_ESC){
+
+		putchar(SERIAL_FRAME_ESC);
+		putchar(SERIAL_FRAME_ESC_ESC);
+
+	}else
+
+		putchar(b);
+}
+
+
+void serial_frame_send(uint8_t type, uint8_t node, const void *payload, int size){
+
+	const uint8_t *p = (const uint8_t *)payload;
+	unsigned short crc;
+	int i;
+
+	if(size > SERIAL_FRAME_MAX_PAYLOAD)
+		return;
+
+	crc = crc16_add(type, 0);
+	crc = crc16_add(node, crc);
+	crc = crc16_data(p, size, crc);
+
+	putchar(SERIAL_FRAME_END);
+
+	put_escaped(type);
+	put_escaped(node);
+
+	for(i=0; i<size; i++)
+		put_escaped(p[i]);
+
+	put_escaped(crc & 0xFF);
+	put_escaped(crc >> 8);
+
+	putchar(SERIAL_FRAME_END);
+}
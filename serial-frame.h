@@ -0,0 +1,76 @@
+/*-----------------------------Serial Frame-------------------------------
+	Binary framed serial output of the Central Unit.
+
+	Events and readings are written on the UART as SLIP frames:
+
+		END | type | node | payload | crc16 (LE) | END
+
+	END (0xC0) and ESC (0xDB) inside the frame are escaped as ESC
+	ESC_END / ESC ESC_ESC. The crc16 (Contiki lib/crc16, initial value
+	0) covers type, node and payload. The leading END flushes any
+	text printed in between, so the host decoder drops it as noise.
+	Payloads are the little-endian firmware structs listed by type.
+
+	This header is shared with the host tools (host/): the firmware
+	API is only declared in a Contiki build.
+------------------------------------------------------------------------*/
+#ifndef SERIAL_FRAME_H_
+#define SERIAL_FRAME_H_
+
+#define SERIAL_FRAME_END			0xC0
+#define SERIAL_FRAME_ESC			0xDB
+#define SERIAL_FRAME_ESC_END		0xDC
+#define SERIAL_FRAME_ESC_ESC		0xDD
+#define SERIAL_FRAME_MAX_PAYLOAD	136		/*trace record of a full packet*/
+
+/*frame types & payloads*/
+#define SERIAL_FRAME_BOOT			0x01	/*none*/
+#define SERIAL_FRAME_STATE			0x02	/*struct node_state*/
+#define SERIAL_FRAME_TEMP_STATS		0x03	/*struct window_stats_summary*/
+#define SERIAL_FRAME_LIGHT			0x04	/*struct nettime_reading*/
+#define SERIAL_FRAME_READING		0x05	/*struct nettime_reading (house overview)*/
+#define SERIAL_FRAME_CONFIRM		0x06	/*struct serial_frame_confirm*/
+#define SERIAL_FRAME_OPENING		0x07	/*struct nettime_reading, value = phase*/
+#define SERIAL_FRAME_AGGREGATE		0x08	/*struct aggregate_partial*/
+#define SERIAL_FRAME_LOG			0x09	/*struct serial_frame_log*/
+#define SERIAL_FRAME_TRACE			0x0A	/*trace record (trace.h), any node*/
+#define SERIAL_FRAME_CONFIG			0x0B	/*struct config_header, config_entry * count*/
+#define SERIAL_FRAME_OTA			0x0C	/*struct serial_frame_ota*/
+#define SERIAL_FRAME_TYPES			0x0D
+
+#ifdef CONTIKI
+
+#include "contiki.h"
+
+struct serial_frame_confirm {
+
+	uint8_t cmd;				/*CONFIRM_* command*/
+	uint8_t seq;
+	uint8_t state;
+	uint8_t pad;
+	uint16_t latency_ms;
+};
+
+struct serial_frame_log {
+
+	uint32_t time;
+	int16_t value;
+};
+
+/*OTA report of a node: rollout time since the seed & OTA bytes*/
+struct serial_frame_ota {
+
+	uint8_t version;
+	uint8_t outcome;			/*OTA_STORED ... OTA_NOT_INSTALLED (ota.h)*/
+	uint16_t pad;
+	uint32_t rollout_ms;
+	uint32_t rx_bytes;
+	uint32_t tx_bytes;
+};
+
+/*Writing one frame on the UART, node is the rime address of the source*/
+void serial_frame_send(uint8_t type, uint8_t node, const void *payload, int size);
+
+#endif /* CONTIKI */
+
+#endif /* SERIAL_FRAME_H_ */
@@ -0,0 +1,233 @@
+/*-------------------------------Temp Log---------------------------------
+	Timestamped temperature log on the external flash (see templog.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "stdio.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+#include "lib/crc16.h"
+#include "templog.h"
+#include "nettime.h"
+
+#define SEGMENT_BYTES	((cfs_offset_t)TEMPLOG_SEGMENT_RECORDS * TEMPLOG_RECORD_SIZE)
+
+static int segment_records[TEMPLOG_SEGMENTS];
+static int current = 0;						/*segment being appended*/
+static unsigned long time_base = 0;
+static unsigned long last_time = 0;			/*newest record on flash*/
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+static void segment_name(char *name, int segment){
+
+	sprintf(name, "tlog%d", segment);
+}
+
+static uint16_t record_check(const struct templog_record *record){
+
+	return crc16_data((const unsigned char *)record, 6, 0) | 0x8000;
+}
+
+static int read_segment(int segment, int offset, struct templog_record *record){
+
+	char name[8];
+	int fd, len = 0;
+
+	segment_name(name, segment);
+
+	fd = cfs_open(name, CFS_READ);
+
+	if(fd < 0)
+		return 0;
+
+	if(cfs_seek(fd, (cfs_offset_t)offset * TEMPLOG_RECORD_SIZE, CFS_SEEK_SET) >= 0)
+		len = cfs_read(fd, record, TEMPLOG_RECORD_SIZE);
+
+	cfs_close(fd);
+
+	return (len == TEMPLOG_RECORD_SIZE && record->check == record_check(record));
+}
+
+/*Oldest non-empty segment comes right after the current one*/
+static int segment_at(long *index){
+
+	int i, segment;
+
+	for(i=1; i<=TEMPLOG_SEGMENTS; i++){
+
+		segment = (current + i) % TEMPLOG_SEGMENTS;
+
+		if(*index < segment_records[segment])
+			return segment;
+
+		*index -= segment_records[segment];
+	}
+
+	return TEMPLOG_NOT_FOUND;
+}
+
+
+void templog_init(void){
+
+	struct templog_record record;
+	unsigned long newest = 0;
+	char name[8];
+	cfs_offset_t end;
+	int fd, i;
+
+	current = 0;
+
+	for(i=0; i<TEMPLOG_SEGMENTS; i++){
+
+		segment_name(name, i);
+		segment_records[i] = 0;
+
+		fd = cfs_open(name, CFS_READ);
+
+		if(fd < 0)
+			continue;
+
+		end = cfs_seek(fd, 0, CFS_SEEK_END);
+		cfs_close(fd);
+
+		if(end > 0)
+			segment_records[i] = end / TEMPLOG_RECORD_SIZE;
+
+		/*the segment with the newest first record is the current one*/
+		if(segment_records[i] > 0 && read_segment(i, 0, &record) && record.time >= newest){
+
+			newest = record.time;
+			current = i;
+		}
+	}
+
+	if(segment_records[current] > 0 && read_segment(current, segment_records[current] - 1, &record)){
+
+		last_time = record.time;
+		time_base = record.time + 1;
+	}
+
+	time_base -= clock_seconds();
+}
+
+
+unsigned long templog_time(void){
+
+	unsigned long now;
+
+	now = (nettime_synched()) ? nettime_seconds() : time_base + clock_seconds();
+
+	/*the binary search needs the log sorted: never going back*/
+	if(templog_count() > 0 && now <= last_time)
+		now = last_time + 1;
+
+	return now;
+}
+
+
+int templog_append(int value){
+
+	struct templog_record record;
+	char name[8];
+	int fd, len;
+
+	if(segment_records[current] == TEMPLOG_SEGMENT_RECORDS){
+	/*recycling the oldest segment*/
+
+		current = (current + 1) % TEMPLOG_SEGMENTS;
+		segment_name(name, current);
+
+		segment_records[current] = 0;
+	}
+
+	segment_name(name, current);
+
+	if(segment_records[current] == 0){
+	/*(re)allocating the segment in fresh flash*/
+
+		cfs_remove(name);
+		cfs_coffee_reserve(name, SEGMENT_BYTES);
+	}
+
+	record.time = templog_time();
+	record.value = value;
+	record.check = record_check(&record);
+
+	fd = cfs_open(name, CFS_WRITE | CFS_APPEND);
+
+	if(fd < 0)
+		return 0;
+
+	len = cfs_write(fd, &record, TEMPLOG_RECORD_SIZE);
+
+	cfs_close(fd);
+
+	if(len != TEMPLOG_RECORD_SIZE)
+		return 0;
+
+	segment_records[current]++;
+	last_time = record.time;
+
+	return 1;
+}
+
+
+long templog_count(void){
+
+	long count = 0;
+	int i;
+
+	for(i=0; i<TEMPLOG_SEGMENTS; i++)
+		count += segment_records[i];
+
+	return count;
+}
+
+
+int templog_read(long index, struct templog_record *record){
+
+	int segment = segment_at(&index);
+
+	if(segment == TEMPLOG_NOT_FOUND)
+		return 0;
+
+	return read_segment(segment, (int)index, record);
+}
+
+
+long templog_lower_bound(unsigned long from){
+
+	struct templog_record record;
+	long low = 0, high = templog_count(), mid;
+
+	while(low < high){
+
+		mid = (low + high) / 2;
+
+		if(templog_read(mid, &record) && record.time < from)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+
+long templog_upper_bound(unsigned long to){
+
+	struct templog_record record;
+	long low = 0, high = templog_count(), mid;
+
+	while(low < high){
+
+		mid = (low + high) / 2;
+
+		if(templog_read(mid, &record) && record.time <= to)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
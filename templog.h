@@ -0,0 +1,75 @@
+/*-------------------------------Temp Log---------------------------------
+	Timestamped temperature log on the external flash (Coffee FS).
+
+	Records are appended to TEMPLOG_SEGMENTS fixed-size segment files
+	used as a ring: when the current segment is full the oldest one is
+	removed and re-reserved. Every segment is written only once per
+	lap, and Coffee allocates the re-reserved file in fresh sectors,
+	so the erase cycles are spread over the flash (wear levelling).
+	Only the segment positions are kept in RAM.
+
+	Records are retrieved by logical index (0 = oldest) and a time
+	range is mapped to an index range by binary search.
+------------------------------------------------------------------------*/
+#ifndef TEMPLOG_H_
+#define TEMPLOG_H_
+
+#include "contiki.h"
+
+#define TEMPLOG_SEGMENTS			4
+#define TEMPLOG_SEGMENT_RECORDS		1024
+#define TEMPLOG_RECORD_SIZE			8
+#define TEMPLOG_NOT_FOUND			-1
+
+/*Record on flash: check is never zero so Coffee keeps the record end*/
+struct templog_record {
+
+	uint32_t time;
+	int16_t value;
+	uint16_t check;
+};
+
+/*Streaming frames: header + TEMPLOG_FRAME_RECORDS records packed as
+  {uint16 seconds since the previous record, int8 value} (3 bytes)*/
+#define TEMPLOG_FRAME_RECORDS		29
+#define TEMPLOG_PACKED_SIZE			3
+#define TEMPLOG_LAST_FRAME			0x01
+
+struct templog_request {
+
+	uint32_t from;
+	uint32_t to;
+	uint16_t max_records;		/*the newest ones in the range*/
+	uint8_t window;				/*frames sent before waiting for credits*/
+	uint8_t pad;
+};
+
+struct templog_frame_header {
+
+	uint32_t base_time;			/*time of the record before the first one*/
+	uint8_t seq;
+	uint8_t count;
+	uint8_t flags;
+	uint8_t pad;
+};
+
+/*Reading the segments already on flash & restoring the time base*/
+void templog_init(void);
+
+/*Network seconds once synchronised, local ones before (monotonic across reboots)*/
+unsigned long templog_time(void);
+
+int templog_append(int value);
+
+/*Records currently stored*/
+long templog_count(void);
+
+int templog_read(long index, struct templog_record *record);
+
+/*Index of the first record with time >= from (templog_count() if none)*/
+long templog_lower_bound(unsigned long from);
+
+/*Index of the first record with time > to (templog_count() if none)*/
+long templog_upper_bound(unsigned long to);
+
+#endif /* TEMPLOG_H_ */
@@ -0,0 +1,235 @@
+/*--------------------------------Trace-----------------------------------
+	Optional record of the inputs and outputs of a firmware (see trace.h).
+------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "string.h"
+#include "dev/leds.h"
+#include "serial-frame.h"
+#include "trace.h"
+
+#if TRACE_ENABLED
+
+#ifdef TRACE_CONF_RECORDS
+#define TRACE_RECORDS		TRACE_CONF_RECORDS
+#else
+#define TRACE_RECORDS		8		/*power of 2, at most 128: ~1.1 KB of RAM*/
+#endif
+
+#define MASK				(TRACE_RECORDS - 1)
+#define MAX_DELTA			0xFFFF
+
+struct record {
+
+	uint8_t size;
+	uint8_t data[TRACE_RECORD_SIZE];
+};
+
+static struct record ring[TRACE_RECORDS];
+static volatile uint8_t head = 0;			/*next record to write*/
+static volatile uint8_t tail = 0;			/*next record to send*/
+static uint8_t seq = 0;
+static clock_time_t last_time;
+static unsigned char last_leds;
+
+PROCESS(trace_process, "Trace Process");
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+/*Body of a new record, NULL if the ring is full (the seq is spent anyway)*/
+static uint8_t *reserve(uint8_t type, uint16_t delta, int size){
+
+	struct trace_header header;
+	struct record *r;
+
+	header.type = type;
+	header.seq = seq++;
+	header.delta = delta;
+
+	if((uint8_t)(head - tail) == TRACE_RECORDS)
+		return NULL;
+
+	r = &ring[head & MASK];
+	r->size = sizeof(header) + size;
+	memcpy(r->data, &header, sizeof(header));
+
+	return r->data + sizeof(header);
+}
+
+static void commit(void){
+
+	head++;
+
+	process_poll(&trace_process);
+}
+
+static uint8_t *begin(uint8_t type, int size){
+
+	clock_time_t now = clock_time();
+	clock_time_t elapsed = now - last_time;
+
+	last_time = now;
+
+	while(elapsed > MAX_DELTA){
+
+		if(reserve(TRACE_IDLE, MAX_DELTA, 0) != NULL)
+			commit();
+
+		elapsed -= MAX_DELTA;
+	}
+
+	return reserve(type, elapsed, size);
+}
+
+
+void trace_init(void){
+
+	uint32_t ticks;
+	uint8_t *body;
+
+	head = tail = 0;
+	seq = 0;
+	last_time = clock_time();
+	last_leds = leds_get();
+
+	if(!process_is_running(&trace_process))
+		process_start(&trace_process, NULL);
+
+	/*the clock at the start, the replay runs from there*/
+	if((body = reserve(TRACE_BOOT, 0, sizeof(ticks))) != NULL){
+
+		ticks = last_time;
+		memcpy(body, &ticks, sizeof(ticks));
+		commit();
+	}
+}
+
+
+void trace_packet(uint8_t type, const linkaddr_t *addr, uint8_t seqno){
+
+	struct trace_packet packet;
+	int len = packetbuf_datalen();
+	uint8_t *body;
+
+	if(len > TRACE_MAX_DATA)
+		len = TRACE_MAX_DATA;
+
+	if((body = begin(type, sizeof(packet) + len)) == NULL)
+		return;
+
+	packet.addr = (addr != NULL) ? addr->u8[0] : 0;
+	packet.seqno = seqno;
+	packet.rssi = (int8_t)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+	packet.lqi = packetbuf_attr(PACKETBUF_ATTR_LINK_QUALITY);
+
+	memcpy(body, &packet, sizeof(packet));
+	memcpy(body + sizeof(packet), packetbuf_dataptr(), len);
+
+	commit();
+}
+
+
+void trace_outcome(uint8_t type, const linkaddr_t *to, uint8_t retransmissions){
+
+	struct trace_outcome outcome;
+	uint8_t *body;
+
+	if((body = begin(type, sizeof(outcome))) == NULL)
+		return;
+
+	outcome.addr = to->u8[0];
+	outcome.retransmissions = retransmissions;
+	memcpy(body, &outcome, sizeof(outcome));
+
+	commit();
+}
+
+
+void trace_event(uint8_t type){
+
+	if(begin(type, 0) != NULL)
+		commit();
+}
+
+
+int trace_reading(uint8_t sensor, int value){
+
+	struct trace_reading reading;
+	uint8_t *body;
+
+	if((body = begin(TRACE_READING, sizeof(reading))) == NULL)
+		return value;
+
+	reading.sensor = sensor;
+	reading.pad = 0;
+	reading.value = value;
+	memcpy(body, &reading, sizeof(reading));
+
+	commit();
+
+	return value;
+}
+
+
+void trace_console(const char *line){
+
+	int len = strlen(line);
+	uint8_t *body;
+
+	if(len > TRACE_MAX_DATA)
+		len = TRACE_MAX_DATA;
+
+	if((body = begin(TRACE_CONSOLE, len)) == NULL)
+		return;
+
+	memcpy(body, line, len);
+
+	commit();
+}
+
+
+void trace_leds(void){
+
+	unsigned char leds = leds_get();
+	uint8_t *body;
+
+	if(leds == last_leds)
+		return;
+
+	last_leds = leds;
+
+	if((body = begin(TRACE_LEDS, 1)) == NULL)
+		return;
+
+	body[0] = leds;
+
+	commit();
+}
+
+/*-----------------------------PROCESSES--------------------------------*/
+
+PROCESS_THREAD(trace_process, ev, data){
+
+	PROCESS_BEGIN();
+
+	while(1){
+
+		PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+
+		while(tail != head){
+
+			serial_frame_send(SERIAL_FRAME_TRACE, linkaddr_node_addr.u8[0], ring[tail & MASK].data,
+				ring[tail & MASK].size);
+			tail++;
+
+			/*one record per turn: queued events go first*/
+			if(process_post(PROCESS_CURRENT(), PROCESS_EVENT_CONTINUE, NULL) != PROCESS_ERR_OK)
+				process_poll(PROCESS_CURRENT());
+			PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE || ev == PROCESS_EVENT_POLL);
+		}
+	}
+
+	PROCESS_END();
+}
+
+#endif /* TRACE_ENABLED */
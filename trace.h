@@ -0,0 +1,139 @@
+/*--------------------------------Trace-----------------------------------
+	Optional record of the inputs and outputs of a firmware, replayed
+	on the host to reproduce field issues (host/sim/replay).
+
+	With TRACE_CONF_ENABLED every received and sent frame, runicast
+	outcome, button press, console line, sensor reading and LED
+	change is appended
+	to a static ring and written on the UART by the trace process as a
+	serial frame of type SERIAL_FRAME_TRACE (node = own rime address),
+	one record per frame. Without it the hooks compile to nothing.
+
+	Record: struct trace_header, then by type
+		TRACE_BOOT					clock ticks (uint32_t), the replay starts here
+		TRACE_RX_*, TRACE_TX_*		struct trace_packet, packet data
+		TRACE_SENT, TRACE_TIMEDOUT	struct trace_outcome
+		TRACE_BUTTON				none
+		TRACE_READING				struct trace_reading (raw value)
+		TRACE_LEDS					leds after the change (1 byte)
+		TRACE_IDLE					none, delta overflow
+		TRACE_CONSOLE				line typed on the serial console (no terminator)
+
+	delta is in clock ticks since the previous record; seq counts the
+	records, dropped ones included, so a gap tells the replay that the
+	ring overflowed. Little-endian fields, as the serial frames.
+------------------------------------------------------------------------*/
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+
+#ifdef TRACE_CONF_ENABLED
+#define TRACE_ENABLED			TRACE_CONF_ENABLED
+#else
+#define TRACE_ENABLED			0
+#endif
+
+/*record types*/
+#define TRACE_BOOT				0
+#define TRACE_RX_RUNICAST		1
+#define TRACE_RX_BROADCAST		2
+#define TRACE_TX_RUNICAST		3
+#define TRACE_TX_BROADCAST		4
+#define TRACE_SENT				5
+#define TRACE_TIMEDOUT			6
+#define TRACE_BUTTON			7
+#define TRACE_READING			8
+#define TRACE_LEDS				9
+#define TRACE_IDLE				10
+#define TRACE_CONSOLE			11
+#define TRACE_TYPES				12
+
+/*sensors of TRACE_READING*/
+#define TRACE_SENSOR_TEMP		0	/*SHT11 raw temperature*/
+#define TRACE_SENSOR_LIGHT		1	/*photosynthetic light raw*/
+
+#define TRACE_MAX_DATA			128	/*PACKETBUF_SIZE*/
+
+struct trace_header {
+
+	uint8_t type;
+	uint8_t seq;
+	uint16_t delta;				/*clock ticks*/
+};
+
+struct trace_packet {
+
+	uint8_t addr;				/*sender or receiver, 0 for a broadcast*/
+	uint8_t seqno;				/*runicast reception*/
+	int8_t rssi;				/*reception, CC2420 register*/
+	uint8_t lqi;
+};
+
+struct trace_outcome {
+
+	uint8_t addr;
+	uint8_t retransmissions;
+};
+
+struct trace_reading {
+
+	uint8_t sensor;
+	uint8_t pad;
+	int16_t value;
+};
+
+#define TRACE_RECORD_SIZE		(sizeof(struct trace_header) + sizeof(struct trace_packet) + TRACE_MAX_DATA)
+
+#ifdef CONTIKI
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "dev/leds.h"
+
+#if TRACE_ENABLED
+
+/*Starting the trace process and writing the TRACE_BOOT record*/
+void trace_init(void);
+
+/*Frame in the packetbuf: received from or sent to addr (NULL for a broadcast)*/
+void trace_packet(uint8_t type, const linkaddr_t *addr, uint8_t seqno);
+
+void trace_outcome(uint8_t type, const linkaddr_t *to, uint8_t retransmissions);
+
+void trace_event(uint8_t type);
+
+/*Returning value, so the hook wraps the read*/
+int trace_reading(uint8_t sensor, int value);
+
+void trace_console(const char *line);
+
+/*Recording the LEDs if they changed*/
+void trace_leds(void);
+
+#define TRACE_INIT()							trace_init()
+#define TRACE_PACKET(type, addr, seqno)			trace_packet(type, addr, seqno)
+#define TRACE_OUTCOME(type, to, retransmissions)	trace_outcome(type, to, retransmissions)
+#define TRACE_EVENT(type)						trace_event(type)
+#define TRACE_SENSOR(sensor, value)				trace_reading(sensor, value)
+#define TRACE_CONSOLE_LINE(line)				trace_console(line)
+
+/*The firmwares drive the LEDs directly: the calls are wrapped (no recursion in the macros)*/
+#define leds_on(l)								(leds_on(l), trace_leds())
+#define leds_off(l)								(leds_off(l), trace_leds())
+#define leds_toggle(l)							(leds_toggle(l), trace_leds())
+
+#else
+
+#define TRACE_INIT()
+#define TRACE_PACKET(type, addr, seqno)
+#define TRACE_OUTCOME(type, to, retransmissions)
+#define TRACE_EVENT(type)
+#define TRACE_SENSOR(sensor, value)				(value)
+#define TRACE_CONSOLE_LINE(line)
+
+#endif /* TRACE_ENABLED */
+
+#endif /* CONTIKI */
+
+#endif /* TRACE_H_ */
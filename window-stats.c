@@ -0,0 +1,171 @@
+/*-----------------------------Window Stats-------------------------------
+	Streaming statistics over a sliding window (see window-stats.h).
+------------------------------------------------------------------------*/
+#include "window-stats.h"
+
+/*---------------------------UTILITY FUNCTIONS--------------------------*/
+
+/*Recomputing mean, m2, min and max from the samples in the window*/
+static void reseed(struct window_stats *ws){
+
+	long sum = 0, dev;
+	int i, v;
+
+	ws->m2 = 0;
+
+	for(i=0; i<ws->count; i++){
+
+		v = ws->values[i];
+		sum += v;
+
+		if(i == 0 || v < ws->min)
+			ws->min = v;
+
+		if(i == 0 || v > ws->max)
+			ws->max = v;
+	}
+
+	ws->mean = (sum << WINDOW_STATS_SHIFT) / ws->count;
+
+	for(i=0; i<ws->count; i++){
+
+		dev = ((long)ws->values[i] << WINDOW_STATS_SHIFT) - ws->mean;
+		ws->m2 += dev * dev;
+	}
+}
+
+static void rescan_min_max(struct window_stats *ws){
+
+	int i;
+
+	ws->min = ws->max = ws->values[0];
+
+	for(i=1; i<ws->count; i++){
+
+		if(ws->values[i] < ws->min)
+			ws->min = ws->values[i];
+
+		if(ws->values[i] > ws->max)
+			ws->max = ws->values[i];
+	}
+}
+
+
+void window_stats_init(struct window_stats *ws, int size){
+
+	if(size > WINDOW_STATS_MAX_SIZE)
+		size = WINDOW_STATS_MAX_SIZE;
+
+	ws->size = (size > 0) ? size : 1;
+	ws->count = 0;
+	ws->head = 0;
+	ws->mean = 0;
+	ws->m2 = 0;
+	ws->min = 0;
+	ws->max = 0;
+}
+
+
+void window_stats_add(struct window_stats *ws, int value){
+
+	long x = (long)value << WINDOW_STATS_SHIFT;
+	long delta;
+	int old;
+
+	if(ws->count == ws->size){
+	/*removing the oldest sample (Welford downdate)*/
+
+		old = ws->values[ws->head];
+		ws->values[ws->head] = value;
+
+		if(ws->count == 1){
+
+			ws->mean = x;
+			ws->m2 = 0;
+
+		}else{
+
+			delta = ((long)old << WINDOW_STATS_SHIFT) - ws->mean;
+			ws->mean -= delta / (ws->count - 1);
+			ws->m2 -= delta * (((long)old << WINDOW_STATS_SHIFT) - ws->mean);
+
+			delta = x - ws->mean;
+			ws->mean += delta / ws->count;
+			ws->m2 += delta * (x - ws->mean);
+		}
+
+		if(ws->m2 < 0)
+			ws->m2 = 0;
+
+		if(old == ws->min || old == ws->max)
+			rescan_min_max(ws);
+
+	}else{
+	/*window still filling (Welford update)*/
+
+		ws->values[ws->head] = value;
+		ws->count++;
+
+		delta = x - ws->mean;
+		ws->mean += delta / ws->count;
+		ws->m2 += delta * (x - ws->mean);
+
+		if(ws->count == 1)
+			ws->min = ws->max = value;
+	}
+
+	if(value < ws->min)
+		ws->min = value;
+
+	if(value > ws->max)
+		ws->max = value;
+
+	ws->head++;
+
+	if(ws->head == ws->size){
+	/*bounding the fixed-point drift once per window*/
+
+		ws->head = 0;
+		reseed(ws);
+	}
+}
+
+
+void window_stats_summary(struct window_stats *ws, struct window_stats_summary *summary){
+
+	long variance = 0;
+
+	if(ws->count > 1)
+		variance = (((ws->m2 / (ws->count - 1)) >> WINDOW_STATS_SHIFT) * 100) >> WINDOW_STATS_SHIFT;
+
+	summary->mean = (int16_t)((ws->mean * 100) >> WINDOW_STATS_SHIFT);
+	summary->variance = (variance > 0xFFFF) ? 0xFFFF : (uint16_t)variance;
+	summary->min = ws->min;
+	summary->max = ws->max;
+	summary->count = ws->count;
+}
+
+
+unsigned int window_stats_isqrt(unsigned long value){
+
+	unsigned long root = 0, bit = 1UL << 30;
+
+	while(bit > value)
+		bit >>= 2;
+
+	while(bit != 0){
+
+		if(value >= root + bit){
+
+			value -= root + bit;
+			root = (root >> 1) + bit;
+
+		}else
+
+			root >>= 1;
+
+		bit >>= 2;
+	}
+
+	return (unsigned int)root;
+}
@@ -0,0 +1,55 @@
+/*-----------------------------Window Stats-------------------------------
+	Streaming statistics over a sliding window of samples.
+
+	Mean and variance are kept with Welford updates (adding the new
+	sample and removing the oldest one) in fixed-point arithmetic, so
+	each sample costs O(1). Rounding drift is bounded by re-seeding
+	the accumulators exactly every time the window wraps around.
+	Min and max are rescanned only when the outgoing sample was one
+	of them.
+------------------------------------------------------------------------*/
+#ifndef WINDOW_STATS_H_
+#define WINDOW_STATS_H_
+
+#include "contiki.h"
+
+#ifndef WINDOW_STATS_MAX_SIZE
+#define WINDOW_STATS_MAX_SIZE		32
+#endif
+
+#define WINDOW_STATS_SHIFT			8	/*fixed-point Q8 for the mean*/
+
+struct window_stats {
+
+	int values[WINDOW_STATS_MAX_SIZE];
+	int size;					/*configured window*/
+	int count;					/*samples in the window*/
+	int head;					/*next slot to write*/
+	long mean;					/*Q8*/
+	long m2;					/*sum of squared deviations, Q16*/
+	int min;
+	int max;
+};
+
+/*Compact summary sent in one reply (no padding)*/
+struct window_stats_summary {
+
+	uint32_t time;				/*newest sample, filled by the caller*/
+	uint16_t error_ms;			/*time synch error, filled by the caller*/
+	int16_t mean;				/*x100*/
+	uint16_t variance;			/*x100*/
+	int16_t min;
+	int16_t max;
+	uint16_t count;
+};
+
+void window_stats_init(struct window_stats *ws, int size);
+
+void window_stats_add(struct window_stats *ws, int value);
+
+void window_stats_summary(struct window_stats *ws, struct window_stats_summary *summary);
+
+/*Integer square root, used to print the standard deviation*/
+unsigned int window_stats_isqrt(unsigned long value);
+
+#endif /* WINDOW_STATS_H_ */